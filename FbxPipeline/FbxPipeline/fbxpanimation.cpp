@@ -1,5 +1,228 @@
-#include <fbxppch.h>
-#include <fbxpstate.h>
+#include <fbxppch.h>
+#include <fbxpstate.h>
+
+namespace {
+    const double kRadiansToDegrees = 180.0 / 3.14159265358979323846;
+
+    inline apemodefb::vec3 Lerp( apemodefb::vec3 const& a, apemodefb::vec3 const& b, float t ) {
+        return apemodefb::vec3( a.x( ) + ( b.x( ) - a.x( ) ) * t, a.y( ) + ( b.y( ) - a.y( ) ) * t, a.z( ) + ( b.z( ) - a.z( ) ) * t );
+    }
+
+    inline float Distance( apemodefb::vec3 const& a, apemodefb::vec3 const& b ) {
+        return std::max( std::abs( a.x( ) - b.x( ) ), std::max( std::abs( a.y( ) - b.y( ) ), std::abs( a.z( ) - b.z( ) ) ) );
+    }
+
+    /**
+     * Returns true if the linear interpolation between the keys [first] and [last] reproduces
+     * all the samples in between within the error.
+     **/
+    bool CanSkipSamples( std::vector< apemodefb::AnimKeyFb > const& samples, size_t first, size_t last, float maxError ) {
+        const float duration = samples[ last ].time( ) - samples[ first ].time( );
+        for ( size_t i = first + 1; i < last; ++i ) {
+            const float t = ( samples[ i ].time( ) - samples[ first ].time( ) ) / duration;
+            if ( Distance( Lerp( samples[ first ].value( ), samples[ last ].value( ), t ), samples[ i ].value( ) ) > maxError )
+                return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Greedy error-bounded key reduction: the segment from the last kept key is extended while
+     * the skipped samples stay within the error, the first and the last samples are always kept.
+     **/
+    void ReduceKeys( std::vector< apemodefb::AnimKeyFb > const& samples, float maxError, std::vector< apemodefb::AnimKeyFb >& keys ) {
+        if ( samples.size( ) < 3 ) {
+            keys.insert( keys.end( ), samples.begin( ), samples.end( ) );
+            return;
+        }
+
+        size_t anchor = 0;
+        keys.push_back( samples[ anchor ] );
+
+        for ( size_t i = 2; i < samples.size( ); ++i ) {
+            if ( false == CanSkipSamples( samples, anchor, i, maxError ) ) {
+                anchor = i - 1;
+                keys.push_back( samples[ anchor ] );
+            }
+        }
+
+        keys.push_back( samples.back( ) );
+    }
+
+    /**
+     * Resamples the channel curves at the fixed rate (the components without the curves keep the property value),
+     * reduces the keys and appends the track to the layer. The constant tracks that match the property value are skipped.
+     **/
+    void ExportTrack( FbxPropertyT< FbxDouble3 >& property,
+                      apemodefb::EAnimChannelFb channel,
+                      uint32_t                  nodeId,
+                      apemode::AnimStack const& stack,
+                      apemode::AnimLayer&       layer,
+                      float                     maxError ) {
+        auto& s = apemode::Get( );
+
+        FbxAnimCurve* curves[ 3 ] = {property.GetCurve( layer.layer, FBXSDK_CURVENODE_COMPONENT_X ),
+                                     property.GetCurve( layer.layer, FBXSDK_CURVENODE_COMPONENT_Y ),
+                                     property.GetCurve( layer.layer, FBXSDK_CURVENODE_COMPONENT_Z )};
+
+        uint32_t sourceKeyCount = 0;
+        for ( auto curve : curves ) {
+            if ( nullptr != curve )
+                sourceKeyCount += (uint32_t) curve->KeyGetCount( );
+        }
+
+        if ( 0 == sourceKeyCount )
+            return;
+
+        const FbxDouble3 value = property.Get( );
+
+        const float    duration    = stack.stopTime - stack.startTime;
+        const uint32_t sampleCount = 1 + (uint32_t) std::ceil( duration * s.animSampleRate - 0.001f );
+
+        std::vector< apemodefb::AnimKeyFb > samples;
+        samples.reserve( sampleCount );
+
+        FbxTime time;
+        int     lastKeyIndices[ 3 ] = {0, 0, 0};
+        for ( uint32_t i = 0; i < sampleCount; ++i ) {
+            /* The last sample is clamped to the stop time. */
+            const float sampleTime = std::min( float( i ) / s.animSampleRate, duration );
+            time.SetSecondDouble( stack.startTime + sampleTime );
+
+            float components[ 3 ];
+            for ( uint32_t c = 0; c < 3; ++c ) {
+                components[ c ] = curves[ c ] ? curves[ c ]->Evaluate( time, &lastKeyIndices[ c ] ) : static_cast< float >( value[ c ] );
+            }
+
+            samples.emplace_back( sampleTime, apemodefb::vec3( components[ 0 ], components[ 1 ], components[ 2 ] ) );
+        }
+
+        layer.sourceKeyCount += sourceKeyCount;
+        layer.sampledKeyCount += (uint32_t) samples.size( );
+
+        bool bConstant = true;
+        for ( auto& sample : samples ) {
+            if ( Distance( sample.value( ), samples.front( ).value( ) ) > maxError ) {
+                bConstant = false;
+                break;
+            }
+        }
+
+        const apemodefb::vec3 propertyValue( static_cast< float >( value[ 0 ] ), static_cast< float >( value[ 1 ] ), static_cast< float >( value[ 2 ] ) );
+        if ( bConstant && Distance( samples.front( ).value( ), propertyValue ) <= maxError )
+            return;
+
+        const uint32_t baseKey = (uint32_t) layer.keys.size( );
+        if ( bConstant ) {
+            layer.keys.push_back( samples.front( ) );
+        } else {
+            ReduceKeys( samples, maxError, layer.keys );
+        }
+
+        layer.tracks.emplace_back( nodeId, channel, baseKey, (uint32_t) layer.keys.size( ) - baseKey );
+    }
+}
 
-void ExportAnimation( FbxNode* node, apemode::Node& n ) {
-}
+/**
+ * Collects the animation stacks and their layers.
+ * The curves are resampled and reduced by the exporter (instead of FbxAnimCurveFilterResample
+ * and FbxAnimCurveFilterConstantKeyReducer, which modify the scene curves in place).
+ **/
+void PreprocessAnimation( FbxScene* scene ) {
+    auto& s = apemode::Get( );
+
+    s.animSampleRate = s.options.count( "f" ) ? s.options[ "f" ].as< float >( ) : 30.0f;
+    s.animMaxError   = s.options.count( "r" ) ? s.options[ "r" ].as< float >( ) : 0.001f;
+    if ( s.animSampleRate <= 0.0f ) {
+        s.console->warn( "Invalid animation sample rate {}, using 30.", s.animSampleRate );
+        s.animSampleRate = 30.0f;
+    }
+
+    const int stackCount = scene->GetSrcObjectCount< FbxAnimStack >( );
+    s.animStacks.reserve( (size_t) stackCount );
+
+    for ( int i = 0; i < stackCount; ++i ) {
+        auto stack = scene->GetSrcObject< FbxAnimStack >( i );
+
+        const uint32_t stackId = static_cast< uint32_t >( s.animStacks.size( ) );
+        s.animStacks.emplace_back( );
+
+        auto& animStack     = s.animStacks.back( );
+        animStack.id        = stackId;
+        animStack.nameId    = s.PushName( stack->GetName( ) );
+        animStack.stack     = stack;
+        animStack.startTime = static_cast< float >( stack->GetLocalTimeSpan( ).GetStart( ).GetSecondDouble( ) );
+        animStack.stopTime  = static_cast< float >( stack->GetLocalTimeSpan( ).GetStop( ).GetSecondDouble( ) );
+        if ( animStack.stopTime < animStack.startTime )
+            animStack.stopTime = animStack.startTime;
+
+        const int layerCount = stack->GetMemberCount< FbxAnimLayer >( );
+        for ( int j = 0; j < layerCount; ++j ) {
+            auto layer = stack->GetMember< FbxAnimLayer >( j );
+
+            const uint32_t layerId = static_cast< uint32_t >( s.animLayers.size( ) );
+            s.animLayers.emplace_back( );
+
+            auto& animLayer   = s.animLayers.back( );
+            animLayer.id      = layerId;
+            animLayer.nameId  = s.PushName( layer->GetName( ) );
+            animLayer.stackId = stackId;
+            animLayer.layer   = layer;
+            animStack.layerIds.push_back( layerId );
+        }
+
+        s.console->info( "Animation stack \"{}\": {} layer(s), {:.3f} .. {:.3f} s.",
+                         stack->GetName( ),
+                         layerCount,
+                         animStack.startTime,
+                         animStack.stopTime );
+    }
+}
+
+/**
+ * Exports the translation, rotation and scaling tracks of the node for all the layers.
+ * The nodes are exported in the order of their ids, so the tracks are sorted by nodes and channels.
+ **/
+void ExportAnimation( FbxNode* node, apemode::Node& n ) {
+    auto& s = apemode::Get( );
+
+    const float rotationMaxError = static_cast< float >( s.animMaxError * kRadiansToDegrees );
+
+    for ( auto& animLayer : s.animLayers ) {
+        auto& animStack = s.animStacks[ animLayer.stackId ];
+        ExportTrack( node->LclTranslation, apemodefb::EAnimChannelFb_Translation, n.id, animStack, animLayer, s.animMaxError );
+        ExportTrack( node->LclRotation, apemodefb::EAnimChannelFb_Rotation, n.id, animStack, animLayer, rotationMaxError );
+        ExportTrack( node->LclScaling, apemodefb::EAnimChannelFb_Scaling, n.id, animStack, animLayer, s.animMaxError );
+    }
+}
+
+/**
+ * Prints the key counts per stack: the keys of the FBX curves, the resampled keys and the exported keys.
+ **/
+void ReportAnimation( ) {
+    auto& s = apemode::Get( );
+
+    for ( auto& animStack : s.animStacks ) {
+        uint32_t trackCount      = 0;
+        uint32_t sourceKeyCount  = 0;
+        uint32_t sampledKeyCount = 0;
+        uint32_t keyCount        = 0;
+        for ( auto layerId : animStack.layerIds ) {
+            auto& animLayer = s.animLayers[ layerId ];
+            trackCount += (uint32_t) animLayer.tracks.size( );
+            sourceKeyCount += animLayer.sourceKeyCount;
+            sampledKeyCount += animLayer.sampledKeyCount;
+            keyCount += (uint32_t) animLayer.keys.size( );
+        }
+
+        s.console->info( "Animation stack \"{}\": {} track(s), {} source keys, {} sampled keys ({} fps), {} keys ({:.1f}x compression).",
+                         animStack.stack->GetName( ),
+                         trackCount,
+                         sourceKeyCount,
+                         sampledKeyCount,
+                         s.animSampleRate,
+                         keyCount,
+                         keyCount ? double( sampledKeyCount ) / double( keyCount ) : 1.0 );
+    }
+}
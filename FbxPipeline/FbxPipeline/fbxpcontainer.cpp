@@ -0,0 +1,67 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+
+bool apemode::ContainerWriter::Open( std::string const& filePath ) {
+    file.open( filePath, std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( false == file.is_open( ) ) {
+        return false;
+    }
+
+    /* Reserve the header, it is written once the scene offset is known. */
+    const apemodefb::ContainerHeaderFb header;
+    file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+    offset = sizeof( header );
+
+    return file.good( );
+}
+
+bool apemode::ContainerWriter::IsOpen( ) const {
+    return file.is_open( );
+}
+
+void apemode::ContainerWriter::Align( ) {
+    static const char zeros[ kAlignment ] = {0};
+
+    const uint64_t padding = ( kAlignment - offset % kAlignment ) % kAlignment;
+    file.write( zeros, (std::streamsize) padding );
+    offset += padding;
+}
+
+apemodefb::BlobFb apemode::ContainerWriter::Append( const void* data, size_t size ) {
+    assert( IsOpen( ) );
+
+    Align( );
+    const apemodefb::BlobFb blob( offset, size );
+
+    file.write( reinterpret_cast< const char* >( data ), (std::streamsize) size );
+    offset += size;
+
+    if ( false == file.good( ) ) {
+        apemode::Get( ).console->error( "Failed to write blob ({} bytes) at {}.", size, blob.offset( ) );
+        DebugBreak( );
+    }
+
+    return blob;
+}
+
+bool apemode::ContainerWriter::Finish( const void* scene, size_t sceneSize ) {
+    assert( IsOpen( ) );
+
+    /* Append the scene buffer and patch the header. */
+    const apemodefb::BlobFb sceneBlob = Append( scene, sceneSize );
+    const apemodefb::ContainerHeaderFb header( apemodefb::EContainerFb_Magic,
+                                               apemodefb::EVersion_Value,
+                                               sceneBlob.offset( ),
+                                               sceneBlob.size( ) );
+
+    file.seekp( 0 );
+    file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+
+    const bool succeeded = file.good( );
+    file.close( );
+    return succeeded;
+}
+
+uint64_t apemode::ContainerWriter::GetSize( ) const {
+    return offset;
+}
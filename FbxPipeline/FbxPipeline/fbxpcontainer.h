@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fbxppch.h>
+#include <scene_generated.h>
+#include <fstream>
+
+namespace apemode {
+
+    /**
+     * Writes the container file for the scenes that do not fit in memory (or exceed 2GB FlatBuffers limit).
+     * The layout is:
+     *     ContainerHeaderFb (patched in Finish)
+     *     blob #0, blob #1, ... (each is aligned, appended as soon as it is ready)
+     *     SceneFb buffer (references the blobs by offsets and sizes, see BlobFb)
+     * Not thread-safe.
+     **/
+    class ContainerWriter {
+    public:
+        static const uint64_t kAlignment = 16;
+
+        bool              Open( std::string const& filePath );
+        bool              IsOpen( ) const;
+        apemodefb::BlobFb Append( const void* data, size_t size );
+        bool              Finish( const void* scene, size_t sceneSize );
+        uint64_t          GetSize( ) const;
+
+    private:
+        void Align( );
+
+        std::ofstream file;
+        uint64_t      offset = 0;
+    };
+
+} // namespace apemode
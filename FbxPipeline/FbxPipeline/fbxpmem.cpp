@@ -1,5 +1,21 @@
 #include <fbxppch.h>
 #include <new>
+#include <Windows.h>
+#include <Psapi.h>
+
+#pragma comment( lib, "psapi.lib" )
+
+/**
+ * Returns the peak working set size of the process (bytes).
+ **/
+size_t GetPeakMemoryUsage( ) {
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( GetProcessMemoryInfo( GetCurrentProcess( ), &counters, sizeof( counters ) ) ) {
+        return (size_t) counters.PeakWorkingSetSize;
+    }
+
+    return 0;
+}
 
 #ifndef MALLOC_ALIGNMENT
 #define MALLOC_ALIGNMENT 16
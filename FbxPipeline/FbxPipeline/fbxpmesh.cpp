@@ -1,6 +1,9 @@
 #include <fbxppch.h>
 #include <fbxpstate.h>
 #include <fbxpnorm.h>
+#include <CityHash.h>
+#include <tbb/pipeline.h>
+#include <tbb/task_scheduler_init.h>
 
 /**
  * Helper function to calculate tangents when the tangent element layer is missing.
@@ -96,34 +99,32 @@ void CalculateFaceNormals( TVertex* vertices, size_t vertexCount ) {
 }
 
 /**
- * Produces mesh subsets and subset indices.
- * A subset is a structure for mapping material index to a polygon range to allow a single mesh to
- * be rendered using multiple materials.
- * The usage could be: 1) render polygon range [ 0, 12] with 1st material.
- *                     2) render polygon range [12, 64] with 2nd material.
- *                     * range is [base index; index count]
+ * Maps the polygons of the mesh to the materials of its node.
+ * Called on the main thread, since it reads the material element layers.
+ * If the mapping is trivial (no materials, single material, eAllSame mapping mode), the subset is resolved here,
+ * otherwise the (material index, polygon index) pairs are stored and turned into subsets with GetSubsets.
  *
- * @param indices The indices of the mesh that will be used to draw the mesh with multiple materials.
- * @param subsets The ranges of the vertex indices for each material of the node.
- * @param subsetPolies A mapping of material indices to polygon ranges (useful for knowing the basic structure).
- * @return True on success.
+ * @param src The mesh source to store the resolved subsets and the polygon material indices.
  **/
-template < typename TIndex >
-bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::SubsetFb >& subsets ) {
+void ExtractSubsets( FbxMesh* mesh, apemode::MeshSource& src ) {
     auto& s = apemode::Get( );
     s.console->info("Mesh \"{}\" has {} material(s) assigned.", mesh->GetNode( )->GetName( ), mesh->GetNode( )->GetMaterialCount( ) );
 
+    auto& subsets = src.subsets;
+    auto& items   = src.polygonMaterials;
+
     subsets.clear( );
+    items.clear( );
 
     /* No submeshes */
     if ( mesh->GetNode( )->GetMaterialCount( ) == 0 ) {
-        return false;
+        return;
     }
 
     /* Single submesh */
     if ( mesh->GetNode( )->GetMaterialCount( ) == 1 ) {
         subsets.emplace_back( 0, 0, mesh->GetPolygonCount( ) * 3 );
-        return true;
+        return;
     }
 
     /* Print materials attached to a node. */
@@ -131,11 +132,7 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
         s.console->info( "\t#{} - \"{}\".", k, mesh->GetNode( )->GetMaterial( k )->GetName( ) );
     }
 
-    std::vector< std::tuple< TIndex, TIndex > > items;
-    std::vector< apemodefb::SubsetFb > subsetPolies;
-
     subsets.reserve( mesh->GetNode( )->GetMaterialCount( ) );
-    subsetPolies.reserve( mesh->GetNode( )->GetMaterialCount( ) );
 
     /* Go though all the material elements and map them. */
     if ( const uint32_t mc = (uint32_t) mesh->GetElementMaterialCount( ) ) {
@@ -160,7 +157,7 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
                                     if ( mesh->GetNode( )->GetMaterial( k ) == directArray->GetAt( 0 ) ) {
                                         /* Since the mapping mode is eAllSame, return here. */
                                         subsets.emplace_back( k, 0, mesh->GetPolygonCount( ) * 3 );
-                                        return true;
+                                        return;
                                     }
                                 }
 
@@ -180,7 +177,7 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
 
                                 /* Since the mapping mode is eAllSame, return here. */
                                 subsets.emplace_back( indexArray->GetAt( 0 ), 0, mesh->GetPolygonCount( ) * 3 );
-                                return true;
+                                return;
                             } break;
 
                             default:
@@ -199,9 +196,9 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
                                     break;
                                 }
 
-                                std::map< const FbxSurfaceMaterial*, TIndex > mappingDirectToIndex;
+                                std::map< const FbxSurfaceMaterial*, uint32_t > mappingDirectToIndex;
                                 for ( auto k = 0; k < mesh->GetNode( )->GetMaterialCount( ); ++k ) {
-                                    mappingDirectToIndex[ mesh->GetNode( )->GetMaterial( k ) ] = (TIndex) k;
+                                    mappingDirectToIndex[ mesh->GetNode( )->GetMaterial( k ) ] = (uint32_t) k;
                                 }
 
                                 items.reserve( mesh->GetPolygonCount( ) );
@@ -220,7 +217,7 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
 
                                 items.reserve( mesh->GetPolygonCount( ) );
                                 for ( uint32_t i = 0; i < (uint32_t) mesh->GetPolygonCount( ); ++i )
-                                    items.emplace_back( (TIndex) indexArray->GetAt( i ), i );
+                                    items.emplace_back( (uint32_t) indexArray->GetAt( i ), i );
 
                             } break;
 
@@ -241,8 +238,34 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
     if ( items.empty( ) ) {
         s.console->error( "Mesh \"{}\" has no correctly mapped materials (fallback to first one).", mesh->GetNode( )->GetName( ) );
         // Splitted meshes per material case, do not issue a debug break.
-        return false;
     }
+}
+
+/**
+ * Produces mesh subsets and subset indices.
+ * A subset is a structure for mapping material index to a polygon range to allow a single mesh to
+ * be rendered using multiple materials.
+ * The usage could be: 1) render polygon range [ 0, 12] with 1st material.
+ *                     2) render polygon range [12, 64] with 2nd material.
+ *                     * range is [base index; index count]
+ * Does not access the FBX SDK, so it can be called from multiple threads.
+ *
+ * @param src The mesh source with the polygon material indices (see ExtractSubsets).
+ * @param subsets The ranges of the vertex indices for each material of the node.
+ * @return True on success.
+ **/
+bool GetSubsets( apemode::MeshSource& src, std::vector< apemodefb::SubsetFb >& subsets ) {
+    auto& s = apemode::Get( );
+
+    using TIndex = uint32_t;
+    auto& items = src.polygonMaterials;
+
+    subsets = src.subsets;
+    if ( items.empty( ) ) {
+        return false == subsets.empty( );
+    }
+
+    std::vector< apemodefb::SubsetFb > subsetPolies;
 
     //
     // The most important part:
@@ -350,7 +373,6 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
                          subsetLength );
     }
 
-    assert( subsets.size( ) <= ( size_t )( mesh->GetNode( )->GetMaterialCount( ) ) );
     std::sort( subsets.begin( ), subsets.end( ), [&]( apemodefb::SubsetFb const& a, apemodefb::SubsetFb const& b ) {
         return a.base_index( ) < b.base_index( );
     } );
@@ -366,24 +388,20 @@ bool GetSubsets( FbxMesh* mesh, apemode::Mesh& m, std::vector< apemodefb::Subset
 /**
  * Returns the value from the element layer by index with respect to reference mode.
  **/
-template < typename TElementLayer, typename TElementValue >
-TElementValue GetElementValue( const TElementLayer* elementLayer, uint32_t i ) {
-    assert( elementLayer );
-    switch ( const auto referenceMode = elementLayer->GetReferenceMode( ) ) {
+template < typename TElementValue >
+TElementValue GetElementValue( apemode::ElementLayer< TElementValue > const& elementLayer, uint32_t i ) {
+    assert( elementLayer.present );
+    switch ( const auto referenceMode = elementLayer.referenceMode ) {
         case FbxLayerElement::EReferenceMode::eDirect:
-            return elementLayer->GetDirectArray( ).GetAt( i );
+            return elementLayer.directArray[ i ];
         case FbxLayerElement::EReferenceMode::eIndex:
         case FbxLayerElement::EReferenceMode::eIndexToDirect: {
-            const int j = elementLayer->GetIndexArray( ).GetAt( i );
-            return elementLayer->GetDirectArray( ).GetAt( j );
+            const int j = elementLayer.indexArray[ i ];
+            return elementLayer.directArray[ j ];
         }
 
         default:
-            apemode::Get( ).console->error(
-                "Reference mode {} of layer \"{}\" "
-                "is not supported.",
-                referenceMode,
-                elementLayer->GetName( ) );
+            apemode::Get( ).console->error( "Reference mode {} is not supported.", referenceMode );
 
             DebugBreak( );
             return TElementValue( );
@@ -393,28 +411,24 @@ TElementValue GetElementValue( const TElementLayer* elementLayer, uint32_t i ) {
 /**
  * Returns the value from the element layer with respect to reference and mapping modes.
  **/
-template < typename TElementLayer, typename TElementValue >
-TElementValue GetElementValue( const TElementLayer* elementLayer,
-                               uint32_t             controlPointIndex,
-                               uint32_t             vertexIndex,
-                               uint32_t             polygonIndex ) {
-    if ( nullptr == elementLayer )
+template < typename TElementValue >
+TElementValue GetElementValue( apemode::ElementLayer< TElementValue > const& elementLayer,
+                               uint32_t                                      controlPointIndex,
+                               uint32_t                                      vertexIndex,
+                               uint32_t                                      polygonIndex ) {
+    if ( false == elementLayer.present )
         return TElementValue( );
 
-    switch ( const auto mappingMode = elementLayer->GetMappingMode( ) ) {
+    switch ( const auto mappingMode = elementLayer.mappingMode ) {
         case FbxLayerElement::EMappingMode::eByControlPoint:
-            return GetElementValue< TElementLayer, TElementValue >( elementLayer, controlPointIndex );
+            return GetElementValue( elementLayer, controlPointIndex );
         case FbxLayerElement::EMappingMode::eByPolygon:
-            return GetElementValue< TElementLayer, TElementValue >( elementLayer, polygonIndex );
+            return GetElementValue( elementLayer, polygonIndex );
         case FbxLayerElement::EMappingMode::eByPolygonVertex:
-            return GetElementValue< TElementLayer, TElementValue >( elementLayer, vertexIndex );
+            return GetElementValue( elementLayer, vertexIndex );
 
         default:
-            apemode::Get( ).console->error(
-                "Mapping mode {} of layer \"{}\" "
-                "is not supported.",
-                mappingMode,
-                elementLayer->GetName( ) );
+            apemode::Get( ).console->error( "Mapping mode {} is not supported.", mappingMode );
 
             DebugBreak( );
             return TElementValue( );
@@ -462,6 +476,35 @@ const TElementLayer* VerifyElementLayer( const TElementLayer* elementLayer ) {
     return elementLayer;
 }
 
+/**
+ * Copies the element layer arrays, so that the values can be accessed without the FBX SDK.
+ * The element layer is expected to be verified (or null).
+ **/
+template < typename TElementLayer, typename TElementValue >
+void ExtractElementLayer( const TElementLayer* elementLayer, apemode::ElementLayer< TElementValue >& dst ) {
+    dst.present = nullptr != elementLayer;
+    dst.directArray.clear( );
+    dst.indexArray.clear( );
+
+    if ( false == dst.present )
+        return;
+
+    dst.mappingMode   = elementLayer->GetMappingMode( );
+    dst.referenceMode = elementLayer->GetReferenceMode( );
+
+    const auto& directArray = elementLayer->GetDirectArray( );
+    dst.directArray.resize( (size_t) directArray.GetCount( ) );
+    for ( int i = 0; i < directArray.GetCount( ); ++i )
+        dst.directArray[ i ] = directArray.GetAt( i );
+
+    if ( FbxLayerElement::EReferenceMode::eDirect != dst.referenceMode ) {
+        const auto& indexArray = elementLayer->GetIndexArray( );
+        dst.indexArray.resize( (size_t) indexArray.GetCount( ) );
+        for ( int i = 0; i < indexArray.GetCount( ); ++i )
+            dst.indexArray[ i ] = indexArray.GetAt( i );
+    }
+}
+
 /**
  * Helper structure to assign vertex property values
  **/
@@ -478,26 +521,25 @@ struct StaticVertex {
 
 static_assert( sizeof( StaticVertex ) == sizeof( apemodefb::StaticVertexFb ), "Must match" );
 static_assert( sizeof( apemodefb::PackedVertexFb ) == sizeof( apemodefb::PackedVertexFb ), "Must match" );
+static_assert( sizeof( apemode::SkinInfluence ) * 2 == sizeof( apemodefb::SkinnedVertexFb ) - sizeof( apemodefb::PackedVertexFb ), "Must match" );
 
 /**
  * Initialize vertices with very basic properties like 'position', 'normal', 'tangent', 'texCoords'.
  * Calculate mesh position and texcoord min max values.
+ * The skinned meshes also get the influences of the control points (one per vertex, the mesh influences are resized).
+ * Does not access the FBX SDK, so it can be called from multiple threads.
  **/
 template < typename TVertex >
-void InitializeVertices( FbxMesh*       mesh,
-                         apemode::Mesh& m,
-                         TVertex*       vertices,
-                         size_t         vertexCount,
-                         mathfu::vec3&  positionMin,
-                         mathfu::vec3&  positionMax,
-                         mathfu::vec2&  texcoordMin,
-                         mathfu::vec2&  texcoordMax ) {
+void InitializeVertices( apemode::MeshSource const& src,
+                         apemode::Mesh&             m,
+                         TVertex*                   vertices,
+                         size_t                     vertexCount,
+                         mathfu::vec3&              positionMin,
+                         mathfu::vec3&              positionMax,
+                         mathfu::vec2&              texcoordMin,
+                         mathfu::vec2&              texcoordMax ) {
     auto& s = apemode::Get( );
-    const uint32_t cc = (uint32_t) mesh->GetControlPointsCount( );
-    const uint32_t pc = (uint32_t) mesh->GetPolygonCount( );
-
-    s.console->info( "Mesh \"{}\" has {} control points.", mesh->GetNode( )->GetName( ), cc );
-    s.console->info( "Mesh \"{}\" has {} polygons.", mesh->GetNode( )->GetName( ), pc );
+    const uint32_t pc = (uint32_t) src.polygonVertices.size( ) / 3;
 
     positionMin.x = std::numeric_limits< float >::max( );
     positionMin.y = std::numeric_limits< float >::max( );
@@ -511,24 +553,25 @@ void InitializeVertices( FbxMesh*       mesh,
     texcoordMax.x = std::numeric_limits< float >::min( );
     texcoordMax.y = std::numeric_limits< float >::min( );
 
-    const auto uve = VerifyElementLayer( mesh->GetElementUV( ) );
-    const auto ne  = VerifyElementLayer( mesh->GetElementNormal( ) );
-    const auto te  = VerifyElementLayer( mesh->GetElementTangent( ) );
+    const auto& uve = src.uvs;
+    const auto& ne  = src.normals;
+    const auto& te  = src.tangents;
+
+    const bool skinned = false == src.controlPointInfluences.empty( );
+    m.influences.resize( skinned ? vertexCount : 0 );
 
     uint32_t vi = 0;
     for ( uint32_t pi = 0; pi < pc; ++pi ) {
-        assert( 3 == mesh->GetPolygonSize( pi ) );
-
         // Having this array we can easily control polygon winding order.
         // Since mesh is triangular we can make it static [3] at compile-time.
         // for ( const uint32_t pvi : {0, 1, 2} ) {
         for ( const uint32_t pvi : {0, 2, 1} ) {
-            const uint32_t ci = (uint32_t) mesh->GetPolygonVertex( (int) pi, (int) pvi );
+            const uint32_t ci = src.polygonVertices[ pi * 3 + pvi ];
 
-            const auto cp = mesh->GetControlPointAt( ci );
-            const auto uv = GetElementValue< FbxGeometryElementUV, FbxVector2 >( uve, ci, vi, pi );
-            const auto n  = GetElementValue< FbxGeometryElementNormal, FbxVector4 >( ne, ci, vi, pi );
-            const auto t  = GetElementValue< FbxGeometryElementTangent, FbxVector4 >( te, ci, vi, pi );
+            const auto cp = src.controlPoints[ ci ];
+            const auto uv = GetElementValue( uve, ci, vi, pi );
+            const auto n  = GetElementValue( ne, ci, vi, pi );
+            const auto t  = GetElementValue( te, ci, vi, pi );
 
             auto& vvii          = vertices[ vi ];
             vvii.position[ 0 ]  = (float) cp[ 0 ];
@@ -544,6 +587,10 @@ void InitializeVertices( FbxMesh*       mesh,
             vvii.texCoords[ 0 ] = (float) uv[ 0 ];
             vvii.texCoords[ 1 ] = (float) uv[ 1 ];
 
+            if ( skinned ) {
+                m.influences[ vi ] = src.controlPointInfluences[ ci ];
+            }
+
             assert( !isnan( (float) cp[ 0 ] ) && !isnan( (float) cp[ 1 ] ) && !isnan( (float) cp[ 2 ] ) );
             assert( !isnan( (float) n[ 0 ] ) && !isnan( (float) n[ 1 ] ) && !isnan( (float) n[ 2 ] ) );
             assert( !isnan( (float) t[ 0 ] ) && !isnan( (float) t[ 1 ] ) && !isnan( (float) t[ 2 ] ) && !isnan( (float) t[ 3 ] ) );
@@ -570,23 +617,23 @@ void InitializeVertices( FbxMesh*       mesh,
     m.texcoordMin = apemodefb::vec2( texcoordMin.x, texcoordMin.y );
     m.texcoordMax = apemodefb::vec2( texcoordMax.x, texcoordMax.y );
 
-    if ( nullptr == uve ) {
+    if ( false == uve.present ) {
         s.console->error( "Mesh \"{}\" does not have texcoords geometry layer.",
-                          mesh->GetNode( )->GetName( ) );
+                          src.name );
     }
 
-    if ( nullptr == ne ) {
+    if ( false == ne.present ) {
         s.console->warn( "Mesh \"{}\" does not have normal geometry layer.",
-                          mesh->GetNode( )->GetName( ) );
+                          src.name );
 
         // Calculate face normals ourselves.
         // Usable but incorrect.
         CalculateFaceNormals( vertices, vertexCount );
     }
 
-    if ( nullptr == te && nullptr != uve ) {
+    if ( false == te.present && uve.present ) {
         s.console->warn( "Mesh \"{}\" does not have tangent geometry layer.",
-                         mesh->GetNode( )->GetName( ) );
+                         src.name );
 
         // Calculate tangents ourselves if UVs are available.
         CalculateTangents( vertices, vertexCount );
@@ -597,29 +644,110 @@ void InitializeVertices( FbxMesh*       mesh,
 // See implementation in fbxpmeshopt.cpp.
 //
 
-void Optimize32( apemode::Mesh& mesh, apemodefb::StaticVertexFb const* vertices, uint32_t & vertexCount, uint32_t vertexStride );
-void Optimize16( apemode::Mesh& mesh, apemodefb::StaticVertexFb const* vertices, uint32_t & vertexCount, uint32_t vertexStride );
+uint32_t WeldVertices( apemode::Mesh& m, std::vector< uint32_t >& indices, uint32_t vertexCount, float epsilon );
+void Optimize( apemode::Mesh& mesh, uint32_t vertexCount, apemode::EMeshOptimizer optimizer );
+
+//
+// See implementation in fbxpmeshchunks.cpp.
+//
+
+uint32_t SplitMesh( apemode::Mesh&                     m,
+                    std::vector< uint32_t >&           indices,
+                    const uint32_t                     vertexCount,
+                    const uint32_t                     positionBits,
+                    const float                        maxPositionStep,
+                    std::vector< apemode::MeshChunk >& chunks );
+
+//
+// See implementation in fbxpmeshlets.cpp.
+//
+
+void BuildMeshlets( apemode::Mesh& m, const uint32_t vertexCount );
+
+//
+// See implementation in fbxpmeshsimplify.cpp.
+//
+
+void SimplifyMesh( apemode::Mesh& m, const uint32_t vertexCount, const uint32_t lodCount, const float lodRatio, const float lodError );
 
 //
 // See implementation in fbxpmeshpacking.cpp.
 //
 
+apemodefb::VertexLayoutFb GetStaticVertexLayout( );
+apemodefb::VertexLayoutFb GetPackedVertexLayout( apemode::VertexPacking const& packing, const bool skinned, uint16_t& vertexStride );
+
 void Pack( const apemodefb::StaticVertexFb* vertices,
-           apemodefb::PackedVertexFb*       packed,
+           const apemode::SkinInfluence*    influences,
+           uint8_t*                         packed,
            const uint32_t                   vertexCount,
+           apemodefb::VertexLayoutFb const& layout,
+           const uint32_t                   vertexStride,
            const mathfu::vec3               positionMin,
            const mathfu::vec3               positionMax,
            const mathfu::vec2               texcoordsMin,
-           const mathfu::vec2               texcoordsMax );
+           const mathfu::vec2               texcoordsMax,
+           apemode::QuantizationError&      error );
+
+/**
+ * Returns true if the mesh with the given vertex count can use 16-bit indices.
+ **/
+bool UseUInt16Indices( uint32_t vertexCount ) {
+    return vertexCount <= std::numeric_limits< uint16_t >::max( );
+}
 
+/**
+ * Writes the welded indices into the mesh index buffer.
+ **/
 template < typename TIndex >
-void ExportMesh( FbxNode* node, FbxMesh* mesh, apemode::Node& n, apemode::Mesh& m, uint32_t vertexCount, bool pack, bool optimize ) {
+void ExportIndices( apemode::Mesh& m, std::vector< uint32_t > const& weldedIndices ) {
+    m.indices.resize( weldedIndices.size( ) * sizeof( TIndex ) );
+
+    auto indices = reinterpret_cast< TIndex* >( m.indices.data( ) );
+    for ( const uint32_t index : weldedIndices ) {
+        assert( index <= std::numeric_limits< TIndex >::max( ) );
+        *indices++ = (TIndex) index;
+    }
+
+    if ( std::is_same< TIndex, uint16_t >::value ) {
+        m.indexType = apemodefb::EIndexTypeFb_UInt16;
+    } else if ( std::is_same< TIndex, uint32_t >::value ) {
+        m.indexType = apemodefb::EIndexTypeFb_UInt32;
+    } else {
+        assert( false );
+    }
+}
+
+/**
+ * Processes the extracted mesh: initializes, welds, splits into chunks, optimizes, builds meshlets, simplifies and packs the vertices.
+ * Does not access the FBX SDK and writes only to its own mesh and mesh source,
+ * so the meshes can be processed in parallel.
+ * The skinned meshes are always packed (there is no unpacked skinned vertex format).
+ * The packed meshes get a submesh per chunk, each chunk is quantized in its own bounds.
+ **/
+void ExportMesh( apemode::MeshSource&          src,
+                 apemode::Mesh&                m,
+                 bool                          pack,
+                 apemode::VertexPacking const& packing,
+                 float                         weldEpsilon,
+                 apemode::EMeshOptimizer       optimizer,
+                 bool                          meshlets,
+                 uint32_t                      lodCount,
+                 float                         lodRatio,
+                 float                         lodError ) {
     auto& s = apemode::Get( );
 
-    const uint16_t vertexStride           = (uint16_t) sizeof( apemodefb::StaticVertexFb );
-    const uint32_t vertexBufferSize       = vertexCount * vertexStride;
-    const uint16_t packedVertexStride     = (uint16_t) sizeof( apemodefb::PackedVertexFb );
-    const uint32_t packedVertexBufferSize = vertexCount * packedVertexStride;
+    uint32_t vertexCount = (uint32_t) src.polygonVertices.size( );
+
+    uint16_t       packedVertexStride = 0;
+    const bool     skinned            = false == src.controlPointInfluences.empty( );
+    const uint16_t vertexStride       = (uint16_t) sizeof( apemodefb::StaticVertexFb );
+    const uint32_t vertexBufferSize   = vertexCount * vertexStride;
+    const auto     packedVertexLayout = GetPackedVertexLayout( packing, skinned, packedVertexStride );
+    const auto     packedVertexFormat = skinned ? apemodefb::EVertexFormat_Skinned : apemodefb::EVertexFormat_Packed;
+
+    pack     = pack || skinned;
+    m.skinId = src.skinId;
 
     m.vertices.resize( vertexBufferSize );
 
@@ -628,7 +756,7 @@ void ExportMesh( FbxNode* node, FbxMesh* mesh, apemode::Node& n, apemode::Mesh&
     mathfu::vec2 texcoordMin;
     mathfu::vec2 texcoordMax;
 
-    InitializeVertices( mesh,
+    InitializeVertices( src,
                         m,
                         reinterpret_cast< StaticVertex* >( m.vertices.data( ) ),
                         vertexCount,
@@ -637,82 +765,196 @@ void ExportMesh( FbxNode* node, FbxMesh* mesh, apemode::Node& n, apemode::Mesh&
                         texcoordMin,
                         texcoordMax );
 
-    GetSubsets< TIndex >( mesh, m, m.subsets );
+    GetSubsets( src, m.subsets );
 
     if ( m.subsets.empty( ) ) {
         m.subsets.push_back( apemodefb::SubsetFb( 0, 0, vertexCount ) );
     }
 
-    m.indices.resize( vertexCount * sizeof( TIndex ) );
-    auto indices = (TIndex*) m.indices.data( );
+    //
+    // Weld the vertices (one vertex per triangle corner so far) and
+    // choose the index type from the unique vertex count.
+    //
+
+    std::vector< uint32_t > weldedIndices;
+    const uint32_t indexCount    = vertexCount;
+    const uint32_t soupIndexSize = UseUInt16Indices( vertexCount ) ? sizeof( uint16_t ) : sizeof( uint32_t );
+    vertexCount = WeldVertices( m, weldedIndices, vertexCount, weldEpsilon );
+
+    /* The unpacked meshes are not split, they are not quantized. */
+    std::vector< apemode::MeshChunk > chunks;
+    const uint32_t weldedVertexCount = vertexCount;
+    vertexCount = SplitMesh( m, weldedIndices, vertexCount, packing.positionBits, pack ? packing.maxPositionStep : 0.0f, chunks );
+
+    if ( UseUInt16Indices( vertexCount ) )
+        ExportIndices< uint16_t >( m, weldedIndices );
+    else
+        ExportIndices< uint32_t >( m, weldedIndices );
+
+    const uint64_t soupVertexBytes   = uint64_t( indexCount ) * ( pack ? packedVertexStride : vertexStride );
+    const uint64_t soupIndexBytes    = uint64_t( indexCount ) * soupIndexSize;
+    const uint64_t weldedVertexBytes = uint64_t( weldedVertexCount ) * ( pack ? packedVertexStride : vertexStride );
+    const uint64_t weldedIndexBytes  = m.indices.size( );
+
+    src.vertexBytesBeforeWelding = soupVertexBytes;
+    src.indexBytesBeforeWelding  = soupIndexBytes;
+    src.vertexBytesAfterWelding  = weldedVertexBytes;
+    src.indexBytesAfterWelding   = weldedIndexBytes;
+
+    s.console->info( "Mesh \"{}\" has {} unique vertices out of {} ({} -> {} bytes of vertices, {} -> {} bytes of indices).",
+                     src.name,
+                     weldedVertexCount,
+                     indexCount,
+                     soupVertexBytes,
+                     weldedVertexBytes,
+                     soupIndexBytes,
+                     weldedIndexBytes );
+
+    if ( chunks.size( ) > 1 ) {
+        float maxChunkExtent = 0.0f;
+        for ( auto const& chunk : chunks ) {
+            const auto extent = chunk.positionMax - chunk.positionMin;
+            maxChunkExtent = std::max( maxChunkExtent, std::max( extent.x, std::max( extent.y, extent.z ) ) );
+        }
 
-    TIndex index = 0;
-    while ( index < vertexCount ) {
-        *indices++ = index++;
+        const auto  extent       = positionMax - positionMin;
+        const float maxQuantized = float( ( 1u << packing.positionBits ) - 1 );
+        s.console->info( "Mesh \"{}\" was split into {} chunks ({} -> {} vertices), position step {:.6f} -> {:.6f}.",
+                         src.name,
+                         chunks.size( ),
+                         weldedVertexCount,
+                         vertexCount,
+                         std::max( extent.x, std::max( extent.y, extent.z ) ) / maxQuantized,
+                         maxChunkExtent / maxQuantized );
     }
 
-    if ( std::is_same< TIndex, uint16_t >::value ) {
-        m.indexType = apemodefb::EIndexTypeFb_UInt16;
-    } else if ( std::is_same< TIndex, uint32_t >::value ) {
-        m.indexType = apemodefb::EIndexTypeFb_UInt32;
-    } else {
-        assert( false );
+    Optimize( m, vertexCount, optimizer );
+
+    /* The meshlet bounds are calculated from the unpacked positions and normals. */
+    if ( meshlets ) {
+        BuildMeshlets( m, vertexCount );
+
+        for ( auto const& meshlet : m.meshlets ) {
+            src.meshletTriangleCount += meshlet.triangle_count( );
+            src.meshletConeCount += meshlet.cone_cutoff( ) < 1.0f;
+        }
+
+        src.meshletCount = (uint32_t) m.meshlets.size( );
+        s.console->info( "Mesh \"{}\" has {} meshlets ({:.1f} vertices, {:.1f} triangles per meshlet, {} meshlets with normal cones).",
+                         src.name,
+                         src.meshletCount,
+                         src.meshletCount ? double( m.meshletVertexIndices.size( ) ) / src.meshletCount : 0.0,
+                         src.meshletCount ? double( src.meshletTriangleCount ) / src.meshletCount : 0.0,
+                         src.meshletConeCount );
     }
 
-    /*
-    if ( optimize ) {
-        auto initializedVertices = reinterpret_cast< const apemodefb::StaticVertexFb* >( m.vertices.data( ) );
+    /* The levels are simplified from the unpacked positions, they share the vertices (and the chunks) of the mesh. */
+    if ( lodCount ) {
+        SimplifyMesh( m, vertexCount, lodCount, lodRatio, lodError );
 
-        if ( std::is_same< TIndex, uint16_t >::value ) {
-            Optimize16( m, initializedVertices, vertexCount, vertexStride );
-        } else if ( std::is_same< TIndex, uint32_t >::value ) {
-            m.subsetIndexType = apemodefb::EIndexTypeFb_UInt32;
-            Optimize32( m, initializedVertices, vertexCount, vertexStride );
+        const auto getTriangleCount = [&]( const apemodefb::SubsetFb* subsets, size_t subsetCount ) {
+            uint32_t triangleCount = 0;
+            for ( size_t ss = 0; ss < subsetCount; ++ss ) {
+                triangleCount += subsets[ ss ].index_count( ) / 3;
+            }
+            return triangleCount;
+        };
+
+        src.lodCount             = (uint32_t) m.lods.size( );
+        src.lodBaseTriangleCount = getTriangleCount( m.subsets.data( ), m.subsets.size( ) );
+        src.lodTriangleCount     = src.lodBaseTriangleCount;
+
+        for ( uint32_t l = 0; l < src.lodCount; ++l ) {
+            auto const& lod = m.lods[ l ];
+            src.lodTriangleCount = getTriangleCount( m.lodSubsets.data( ) + lod.base_subset( ), lod.subset_count( ) );
+            s.console->info( "Mesh \"{}\" LOD {}: {} -> {} triangles ({:.1f}%), error {:.6f}.",
+                             src.name,
+                             l + 1,
+                             src.lodBaseTriangleCount,
+                             src.lodTriangleCount,
+                             src.lodBaseTriangleCount ? 100.0 * src.lodTriangleCount / src.lodBaseTriangleCount : 100.0,
+                             lod.error( ) );
+        }
+
+        if ( 0 == src.lodCount ) {
+            s.console->info( "Mesh \"{}\" was not simplified (locked or within the error).", src.name );
         }
     }
-    */
 
     if ( pack ) {
         std::vector< apemodefb::StaticVertexFb > tempBuffer;
         tempBuffer.resize( vertexCount );
         memcpy( tempBuffer.data( ), m.vertices.data( ), m.vertices.size( ) );
 
-        m.vertices.resize( packedVertexBufferSize );
-        Pack( reinterpret_cast< apemodefb::StaticVertexFb* >( tempBuffer.data( ) ),
-              reinterpret_cast< apemodefb::PackedVertexFb* >( m.vertices.data( ) ),
-              vertexCount,
-              positionMin,
-              positionMax,
-              texcoordMin,
-              texcoordMax );
+        m.vertices.resize( vertexCount * packedVertexStride );
+        for ( auto const& chunk : chunks ) {
+            Pack( tempBuffer.data( ) + chunk.baseVertex,
+                  skinned ? m.influences.data( ) + chunk.baseVertex : nullptr,
+                  m.vertices.data( ) + chunk.baseVertex * packedVertexStride,
+                  chunk.vertexCount,
+                  packedVertexLayout,
+                  packedVertexStride,
+                  chunk.positionMin,
+                  chunk.positionMax,
+                  chunk.texcoordMin,
+                  chunk.texcoordMax,
+                  src.quantizationError );
+        }
+
+        src.chunkCount = (uint32_t) chunks.size( );
+
+        std::vector< apemode::SkinInfluence >( ).swap( m.influences );
+
+        auto& error = src.quantizationError;
+        s.console->info( "Mesh \"{}\" quantization error (max / rms): position {:.6f} / {:.6f}, normal {:.4f} / {:.4f} deg, "
+                         "tangent {:.4f} / {:.4f} deg, texcoords {:.6f} / {:.6f}.",
+                         src.name,
+                         error.maxError[ apemode::eVertexAttribute_Position ],
+                         error.GetRms( apemode::eVertexAttribute_Position ),
+                         error.maxError[ apemode::eVertexAttribute_Normal ],
+                         error.GetRms( apemode::eVertexAttribute_Normal ),
+                         error.maxError[ apemode::eVertexAttribute_Tangent ],
+                         error.GetRms( apemode::eVertexAttribute_Tangent ),
+                         error.maxError[ apemode::eVertexAttribute_Texcoords ],
+                         error.GetRms( apemode::eVertexAttribute_Texcoords ) );
     }
 
     apemodefb::vec3 bboxMin( positionMin.x, positionMin.y, positionMin.z );
     apemodefb::vec3 bboxMax( positionMax.x, positionMax.y, positionMax.z );
-    apemodefb::vec2 uvMin( texcoordMin.x, texcoordMin.y );
-    apemodefb::vec2 uvMax( texcoordMax.x, texcoordMax.y );
 
     if ( pack ) {
-        auto const positionScale = positionMax - positionMin;
-        auto const texcoordScale = texcoordMax - texcoordMin;
-        apemodefb::vec3 bboxScale( positionScale.x, positionScale.y, positionScale.z );
-        apemodefb::vec2 uvScale( texcoordScale.x, texcoordScale.y );
-
-        m.submeshes.emplace_back( bboxMin,                         // bbox min
-                                  bboxMax,                         // bbox max
-                                  bboxMin,                         // position offset
-                                  bboxScale,                       // position scale
-                                  uvMin,                           // uv offset
-                                  uvScale,                         // uv scale
-                                  0,                               // base vertex
-                                  vertexCount,                     // vertex count
-                                  0,                               // base index
-                                  0,                               // index count
-                                  0,                               // base subset
-                                  (uint32_t) m.subsets.size( ),    // subset count
-                                  apemodefb::EVertexFormat_Packed, // vertex format
-                                  packedVertexStride               // vertex stride
-        );
+        for ( auto const& chunk : chunks ) {
+            auto const positionScale = chunk.positionMax - chunk.positionMin;
+            auto const texcoordScale = chunk.texcoordMax - chunk.texcoordMin;
+            apemodefb::vec3 chunkMin( chunk.positionMin.x, chunk.positionMin.y, chunk.positionMin.z );
+            apemodefb::vec3 chunkMax( chunk.positionMax.x, chunk.positionMax.y, chunk.positionMax.z );
+            apemodefb::vec3 chunkScale( positionScale.x, positionScale.y, positionScale.z );
+            apemodefb::vec2 uvOffset( chunk.texcoordMin.x, chunk.texcoordMin.y );
+            apemodefb::vec2 uvScale( texcoordScale.x, texcoordScale.y );
+
+            /* Half texcoords are stored as they are. */
+            if ( packing.halfTexcoords ) {
+                uvOffset = apemodefb::vec2( 0.0f, 0.0f );
+                uvScale  = apemodefb::vec2( 1.0f, 1.0f );
+            }
+
+            m.submeshes.emplace_back( chunkMin,                        // bbox min
+                                      chunkMax,                        // bbox max
+                                      chunkMin,                        // position offset
+                                      chunkScale,                      // position scale
+                                      uvOffset,                        // uv offset
+                                      uvScale,                         // uv scale
+                                      chunk.baseVertex,                // base vertex
+                                      chunk.vertexCount,               // vertex count
+                                      chunk.baseIndex,                 // base index
+                                      chunk.indexCount,                // index count
+                                      (uint16_t) chunk.baseSubset,     // base subset
+                                      (uint16_t) chunk.subsetCount,    // subset count
+                                      packedVertexFormat,              // vertex format
+                                      packedVertexStride,              // vertex stride
+                                      packedVertexLayout               // vertex layout
+            );
+        }
     } else {
         m.submeshes.emplace_back( bboxMin,                             // bbox min
                                   bboxMax,                             // bbox max
@@ -723,19 +965,91 @@ void ExportMesh( FbxNode* node, FbxMesh* mesh, apemode::Node& n, apemode::Mesh&
                                   0,                                   // base vertex
                                   vertexCount,                         // vertex count
                                   0,                                   // base index
-                                  0,                                   // index count
+                                  indexCount,                          // index count
                                   0,                                   // base subset
                                   (uint32_t) m.subsets.size( ),        // subset count
                                   apemodefb::EVertexFormat_Static,     // vertex format
-                                  vertexStride                         // vertex stride
+                                  vertexStride,                        // vertex stride
+                                  GetStaticVertexLayout( )             // vertex layout
         );
     }
 }
 
-void ExportMesh( FbxNode* node, apemode::Node& n, bool pack, bool optimize ) {
+template < typename T >
+uint64_t HashElements( uint64_t hash, std::vector< T > const& elements ) {
+    const uint64_t elementsHash = elements.empty( ) ? 0 : apemode::CityHash64( reinterpret_cast< const char* >( elements.data( ) ),
+                                                                               elements.size( ) * sizeof( T ) );
+    return apemode::CityHash128to64( hash, elementsHash );
+}
+
+template < typename T >
+bool IsSameElements( std::vector< T > const& a, std::vector< T > const& b ) {
+    return a.size( ) == b.size( ) && ( a.empty( ) || 0 == memcmp( a.data( ), b.data( ), a.size( ) * sizeof( T ) ) );
+}
+
+template < typename T >
+uint64_t HashElementLayer( uint64_t hash, apemode::ElementLayer< T > const& layer ) {
+    hash = apemode::CityHash128to64( hash, ( uint64_t( layer.present ) << 32 ) | ( uint64_t( layer.mappingMode ) << 16 ) | uint64_t( layer.referenceMode ) );
+    hash = HashElements( hash, layer.directArray );
+    return HashElements( hash, layer.indexArray );
+}
+
+template < typename T >
+bool IsSameElementLayer( apemode::ElementLayer< T > const& a, apemode::ElementLayer< T > const& b ) {
+    return a.present == b.present && a.mappingMode == b.mappingMode && a.referenceMode == b.referenceMode &&
+           IsSameElements( a.directArray, b.directArray ) && IsSameElements( a.indexArray, b.indexArray );
+}
+
+//
+// See implementation in fbxpskin.cpp.
+//
+
+void ExtractSkin( FbxMesh* mesh, apemode::MeshSource& src );
+
+/**
+ * Hashes everything the mesh is exported from (the name is excluded).
+ **/
+uint64_t HashMeshSource( apemode::MeshSource const& src ) {
+    uint64_t hash = HashElements( 0, src.controlPoints );
+    hash = HashElements( hash, src.polygonVertices );
+    hash = HashElementLayer( hash, src.uvs );
+    hash = HashElementLayer( hash, src.normals );
+    hash = HashElementLayer( hash, src.tangents );
+    hash = HashElements( hash, src.subsets );
+    return HashElements( hash, src.polygonMaterials );
+}
+
+/**
+ * Compares the extracted data, the meshes are exported the same if it matches (@see HashMeshSource).
+ **/
+bool IsSameMeshSource( apemode::MeshSource const& a, apemode::MeshSource const& b ) {
+    return IsSameElements( a.controlPoints, b.controlPoints ) && IsSameElements( a.polygonVertices, b.polygonVertices ) &&
+           IsSameElementLayer( a.uvs, b.uvs ) && IsSameElementLayer( a.normals, b.normals ) &&
+           IsSameElementLayer( a.tangents, b.tangents ) && IsSameElements( a.subsets, b.subsets ) &&
+           IsSameElements( a.polygonMaterials, b.polygonMaterials );
+}
+
+/**
+ * Extracts the mesh data of the node (main thread only, the FBX SDK is not thread-safe).
+ * The mesh is reserved in the node order and processed later in ExportMeshes.
+ * The nodes that reference the same FBX mesh, or the mesh with the same content, share the mesh id.
+ **/
+void ExportMesh( FbxNode* node, apemode::Node& n ) {
     auto& s = apemode::Get( );
     if ( auto mesh = node->GetMesh( ) ) {
         s.console->info( "Node \"{}\" has mesh.", node->GetName( ) );
+
+        auto meshIt = s.meshDict.find( mesh );
+        if ( meshIt != s.meshDict.end( ) ) {
+            s.console->info( "Mesh \"{}\" is shared, reusing mesh {}.", node->GetName( ), meshIt->second );
+            n.meshId = meshIt->second;
+            ++s.sharedMeshCount;
+            return;
+        }
+
+        /* The triangulated mesh replaces the original one in all the nodes, both are mapped. */
+        const FbxMesh* originalMesh = mesh;
+
         if ( !mesh->IsTriangleMesh( ) ) {
             s.console->warn( "Mesh \"{}\" is not triangular, processing...", node->GetName( ) );
             FbxGeometryConverter converter( mesh->GetNode( )->GetFbxManager( ) );
@@ -749,19 +1063,249 @@ void ExportMesh( FbxNode* node, apemode::Node& n, bool pack, bool optimize ) {
             s.console->warn( "Mesh \"{}\" was triangulated (success).", node->GetName( ) );
         }
 
-        if ( const auto deformerCount = mesh->GetDeformerCount( ) ) {
-            s.console->warn( "Mesh \"{}\" has {} deformers (ignored).", node->GetName( ), deformerCount );
-        }
-
         n.meshId = (uint32_t) s.meshes.size( );
         s.meshes.emplace_back( );
-        apemode::Mesh& m = s.meshes.back( );
+        s.meshSources.emplace_back( );
 
-        const uint32_t vertexCount = mesh->GetPolygonCount( ) * 3;
+        apemode::MeshSource& src = s.meshSources.back( );
+        src.meshId = n.meshId;
+        src.name   = node->GetName( );
 
-        if ( vertexCount < std::numeric_limits< uint16_t >::max( ) )
-            ExportMesh< uint16_t >( node, mesh, n, m, vertexCount, pack, optimize );
-        else
-            ExportMesh< uint32_t >( node, mesh, n, m, vertexCount, pack, optimize );
+        const uint32_t cc = (uint32_t) mesh->GetControlPointsCount( );
+        const uint32_t pc = (uint32_t) mesh->GetPolygonCount( );
+
+        s.console->info( "Mesh \"{}\" has {} control points.", node->GetName( ), cc );
+        s.console->info( "Mesh \"{}\" has {} polygons.", node->GetName( ), pc );
+
+        src.controlPoints.resize( cc );
+        for ( uint32_t ci = 0; ci < cc; ++ci ) {
+            src.controlPoints[ ci ] = mesh->GetControlPointAt( (int) ci );
+        }
+
+        src.polygonVertices.resize( pc * 3 );
+        for ( uint32_t pi = 0; pi < pc; ++pi ) {
+            assert( 3 == mesh->GetPolygonSize( pi ) );
+            for ( const uint32_t pvi : {0, 1, 2} ) {
+                src.polygonVertices[ pi * 3 + pvi ] = (uint32_t) mesh->GetPolygonVertex( (int) pi, (int) pvi );
+            }
+        }
+
+        ExtractElementLayer( VerifyElementLayer( mesh->GetElementUV( ) ), src.uvs );
+        ExtractElementLayer( VerifyElementLayer( mesh->GetElementNormal( ) ), src.normals );
+        ExtractElementLayer( VerifyElementLayer( mesh->GetElementTangent( ) ), src.tangents );
+        ExtractSubsets( mesh, src );
+        ExtractSkin( mesh, src );
+
+        //
+        // The copies of the same geometry (duplicated FBX meshes) are exported once.
+        // The skinned meshes are not compared, since every mesh has its own skin (joints and bind poses).
+        //
+
+        if ( src.skinId != (uint32_t) -1 ) {
+            s.meshDict[ originalMesh ] = n.meshId;
+            s.meshDict[ mesh ]         = n.meshId;
+            return;
+        }
+
+        const uint64_t contentHash  = HashMeshSource( src );
+        const auto     contentRange = s.meshContentDict.equal_range( contentHash );
+
+        auto contentIt = std::find_if( contentRange.first, contentRange.second, [&]( std::pair< const uint64_t, uint32_t > const& content ) {
+            return IsSameMeshSource( s.meshSources[ content.second ], src );
+        } );
+
+        if ( contentIt != contentRange.second ) {
+            s.console->info( "Mesh \"{}\" has the same content as mesh {}, reusing it.", node->GetName( ), contentIt->second );
+            n.meshId = contentIt->second;
+            s.meshes.pop_back( );
+            s.meshSources.pop_back( );
+            ++s.duplicateMeshCount;
+        } else {
+            s.meshContentDict.insert( std::make_pair( contentHash, n.meshId ) );
+        }
+
+        s.meshDict[ originalMesh ] = n.meshId;
+        s.meshDict[ mesh ]         = n.meshId;
+    }
+}
+
+/**
+ * Moves the mesh buffers to the end of the geometry buffer with the same vertex format and index type.
+ * The indices are not changed, the submeshes get the vertex and index offsets in the geometry buffer,
+ * the subsets (also of the simplified levels) and meshlets get the index offsets.
+ **/
+void MergeMesh( apemode::Mesh& m ) {
+    auto& s = apemode::Get( );
+
+    assert( false == m.submeshes.empty( ) );
+    const auto vertexFormat = m.submeshes.front( ).vertex_format( );
+    const auto vertexStride = m.submeshes.front( ).vertex_stride( );
+
+    auto geometryBufferIt = std::find_if( s.geometryBuffers.begin( ), s.geometryBuffers.end( ), [&]( const apemode::GeometryBuffer& gb ) {
+        return gb.vertexFormat == vertexFormat && gb.indexType == m.indexType;
+    } );
+
+    if ( geometryBufferIt == s.geometryBuffers.end( ) ) {
+        s.geometryBuffers.emplace_back( );
+        s.geometryBuffers.back( ).vertexFormat = vertexFormat;
+        s.geometryBuffers.back( ).vertexStride = vertexStride;
+        s.geometryBuffers.back( ).indexType    = m.indexType;
+        geometryBufferIt = s.geometryBuffers.end( ) - 1;
+    }
+
+    auto& gb = *geometryBufferIt;
+    assert( gb.vertexStride == vertexStride );
+
+    const uint32_t baseVertex = gb.vertexCount;
+    const uint32_t baseIndex  = gb.indexCount;
+
+    for ( auto& sm : m.submeshes ) {
+        sm = apemodefb::SubmeshFb( sm.bbox_min( ),
+                                   sm.bbox_max( ),
+                                   sm.position_offset( ),
+                                   sm.position_scale( ),
+                                   sm.uv_offset( ),
+                                   sm.uv_scale( ),
+                                   sm.base_vertex( ) + baseVertex,
+                                   sm.vertex_count( ),
+                                   sm.base_index( ) + baseIndex,
+                                   sm.index_count( ),
+                                   sm.base_subset( ),
+                                   sm.subset_count( ),
+                                   sm.vertex_format( ),
+                                   sm.vertex_stride( ),
+                                   sm.vertex_layout( ) );
+    }
+
+    for ( auto& ss : m.subsets ) {
+        ss = apemodefb::SubsetFb( ss.material_id( ), ss.base_index( ) + baseIndex, ss.index_count( ) );
+    }
+
+    for ( auto& ss : m.lodSubsets ) {
+        ss = apemodefb::SubsetFb( ss.material_id( ), ss.base_index( ) + baseIndex, ss.index_count( ) );
+    }
+
+    for ( auto& ml : m.meshlets ) {
+        ml = apemodefb::MeshletFb( ml.center( ),
+                                   ml.radius( ),
+                                   ml.cone_apex( ),
+                                   ml.cone_axis( ),
+                                   ml.cone_cutoff( ),
+                                   ml.base_index( ) + baseIndex,
+                                   ml.base_vertex_index( ),
+                                   ml.base_triangle( ),
+                                   ml.vertex_count( ),
+                                   ml.triangle_count( ),
+                                   ml.subset_index( ) );
+    }
+
+    const uint32_t indexSize = m.indexType == apemodefb::EIndexTypeFb_UInt32 ? sizeof( uint32_t ) : sizeof( uint16_t );
+    gb.vertexCount += (uint32_t) ( m.vertices.size( ) / vertexStride );
+    gb.indexCount += (uint32_t) ( m.indices.size( ) / indexSize );
+    gb.vertices.insert( gb.vertices.end( ), m.vertices.begin( ), m.vertices.end( ) );
+    gb.indices.insert( gb.indices.end( ), m.indices.begin( ), m.indices.end( ) );
+    ++gb.meshCount;
+
+    m.geometryBufferId = (uint32_t) std::distance( s.geometryBuffers.begin( ), geometryBufferIt );
+    std::vector< uint8_t >( ).swap( m.vertices );
+    std::vector< uint8_t >( ).swap( m.indices );
+}
+
+/**
+ * Processes the meshes extracted with ExportMesh on the TBB worker threads.
+ * Each mesh is written to the slot reserved in the node order, and the finished meshes are collected in the same order
+ * (statistics, container blobs), so the output does not depend on the thread count.
+ **/
+void ExportMeshes( bool pack, apemode::VertexPacking const& packing, apemode::EMeshOptimizer optimizer ) {
+    auto& s = apemode::Get( );
+
+    const float weldEpsilon = s.options[ "w" ].as< float >( );
+    const bool  merge       = s.options[ "g" ].as< bool >( );
+    const bool  meshlets    = s.options[ "l" ].as< bool >( );
+
+    const uint32_t lodCount = s.options.count( "d" ) ? (uint32_t) std::max( s.options[ "d" ].as< int >( ), 0 ) : 0;
+    const float    lodRatio = s.options.count( "j" ) ? std::min( std::max( s.options[ "j" ].as< float >( ), 0.01f ), 0.99f ) : 0.5f;
+    const float    lodError = s.options.count( "y" ) ? std::max( s.options[ "y" ].as< float >( ), 0.0f ) : 0.01f;
+    s.console->info( "Processing {} meshes ({} nodes share the meshes, {} copies of the same meshes were skipped)...",
+                     s.meshSources.size( ),
+                     s.sharedMeshCount,
+                     s.duplicateMeshCount );
+
+    size_t meshSourceIndex = 0;
+
+    /* Takes the extracted meshes in the node order. */
+    auto inputFilter = [&]( tbb::flow_control& fc ) -> apemode::MeshSource* {
+        if ( meshSourceIndex == s.meshSources.size( ) ) {
+            fc.stop( );
+            return nullptr;
+        }
+
+        return &s.meshSources[ meshSourceIndex++ ];
+    };
+
+    /* Processes the meshes in parallel. */
+    auto exportFilter = [&]( apemode::MeshSource* src ) {
+        ExportMesh( *src, s.meshes[ src->meshId ], pack, packing, weldEpsilon, optimizer, meshlets, lodCount, lodRatio, lodError );
+        return src;
+    };
+
+    /* Collects the finished meshes in the node order. */
+    auto outputFilter = [&]( apemode::MeshSource* src ) {
+        s.vertexBytesBeforeWelding += src->vertexBytesBeforeWelding;
+        s.indexBytesBeforeWelding += src->indexBytesBeforeWelding;
+        s.vertexBytesAfterWelding += src->vertexBytesAfterWelding;
+        s.indexBytesAfterWelding += src->indexBytesAfterWelding;
+        s.quantizationError.Add( src->quantizationError );
+        s.chunkCount += src->chunkCount;
+        s.meshletCount += src->meshletCount;
+        s.meshletTriangleCount += src->meshletTriangleCount;
+        s.meshletConeCount += src->meshletConeCount;
+        if ( src->lodCount ) {
+            ++s.lodMeshCount;
+            s.lodCount += src->lodCount;
+            s.lodBaseTriangleCount += src->lodBaseTriangleCount;
+            s.lodTriangleCount += src->lodTriangleCount;
+        }
+
+        // Merged meshes are written with the geometry buffers once all the meshes are ready.
+        // Otherwise, write the mesh buffers to the container as soon as the mesh is ready.
+        if ( merge ) {
+            MergeMesh( s.meshes[ src->meshId ] );
+        } else if ( s.container.IsOpen( ) ) {
+            apemode::Mesh& m = s.meshes[ src->meshId ];
+            m.verticesBlob   = s.container.Append( m.vertices.data( ), m.vertices.size( ) );
+            m.indicesBlob    = s.container.Append( m.indices.data( ), m.indices.size( ) );
+            std::vector< uint8_t >( ).swap( m.vertices );
+            std::vector< uint8_t >( ).swap( m.indices );
+        }
+
+        // Release the extracted data.
+        *src = apemode::MeshSource( );
+    };
+
+    tbb::parallel_pipeline( tbb::task_scheduler_init::default_num_threads( ) * 2,
+                            tbb::make_filter< void, apemode::MeshSource* >( tbb::filter::serial_in_order, inputFilter ) &
+                            tbb::make_filter< apemode::MeshSource*, apemode::MeshSource* >( tbb::filter::parallel, exportFilter ) &
+                            tbb::make_filter< apemode::MeshSource*, void >( tbb::filter::serial_in_order, outputFilter ) );
+
+    s.meshSources.clear( );
+    s.meshSources.shrink_to_fit( );
+
+    for ( auto& gb : s.geometryBuffers ) {
+        s.console->info( "Geometry buffer ({} format, {} indices) merged {} meshes: {} vertices ({} bytes), {} indices ({} bytes).",
+                         apemodefb::EnumNameEVertexFormat( gb.vertexFormat ),
+                         apemodefb::EnumNameEIndexTypeFb( gb.indexType ),
+                         gb.meshCount,
+                         gb.vertexCount,
+                         gb.vertices.size( ),
+                         gb.indexCount,
+                         gb.indices.size( ) );
+
+        if ( s.container.IsOpen( ) ) {
+            gb.verticesBlob = s.container.Append( gb.vertices.data( ), gb.vertices.size( ) );
+            gb.indicesBlob  = s.container.Append( gb.indices.data( ), gb.indices.size( ) );
+            std::vector< uint8_t >( ).swap( gb.vertices );
+            std::vector< uint8_t >( ).swap( gb.indices );
+        }
     }
 }
@@ -0,0 +1,217 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+
+using namespace apemode;
+using namespace apemodefb;
+
+namespace {
+    const uint32_t kEmpty                 = (uint32_t) -1;
+    const uint32_t kMinChunkTriangleCount = 64;   /* The chunks with fewer triangles are not split */
+    const uint32_t kMaxChunkCount         = 4096; /* SubmeshFb subset ranges are ushort, the viewer sort keys have 12 subset bits */
+
+    /**
+     * Triangles of the subset that are exported as a chunk, or split further.
+     **/
+    struct TriangleRange {
+        uint32_t subsetIndex;
+        uint32_t firstTriangle; /* Index in the triangle order */
+        uint32_t triangleCount;
+    };
+
+    inline mathfu::vec3 GetPosition( const StaticVertexFb& vertex ) {
+        return mathfu::vec3( vertex.position( ).x( ), vertex.position( ).y( ), vertex.position( ).z( ) );
+    }
+
+    /**
+     * The quantization step of the positions in the range (the largest extent over the max quantized value).
+     **/
+    inline float GetPositionStep( const mathfu::vec3 positionMin, const mathfu::vec3 positionMax, const uint32_t positionBits ) {
+        const mathfu::vec3 extent = positionMax - positionMin;
+        return std::max( extent.x, std::max( extent.y, extent.z ) ) / float( ( 1u << positionBits ) - 1 );
+    }
+
+    /**
+     * Calculates the position and texcoord bounds of the contiguous vertex range of the chunk.
+     **/
+    void CalculateChunkBounds( const StaticVertexFb* vertices, MeshChunk& chunk ) {
+        chunk.positionMin = mathfu::vec3( std::numeric_limits< float >::max( ) );
+        chunk.positionMax = mathfu::vec3( std::numeric_limits< float >::lowest( ) );
+        chunk.texcoordMin = mathfu::vec2( std::numeric_limits< float >::max( ) );
+        chunk.texcoordMax = mathfu::vec2( std::numeric_limits< float >::lowest( ) );
+
+        for ( uint32_t i = chunk.baseVertex; i < chunk.baseVertex + chunk.vertexCount; ++i ) {
+            const mathfu::vec3 position = GetPosition( vertices[ i ] );
+            const mathfu::vec2 texcoords( vertices[ i ].uv( ).x( ), vertices[ i ].uv( ).y( ) );
+
+            chunk.positionMin = mathfu::vec3::Min( chunk.positionMin, position );
+            chunk.positionMax = mathfu::vec3::Max( chunk.positionMax, position );
+            chunk.texcoordMin = mathfu::vec2::Min( chunk.texcoordMin, texcoords );
+            chunk.texcoordMax = mathfu::vec2::Max( chunk.texcoordMax, texcoords );
+        }
+    }
+}
+
+/**
+ * Splits the welded mesh into the spatial chunks, so that each chunk can be quantized in its own bounds.
+ * If the whole mesh fits the max position step, the mesh is exported as a single chunk (nothing changes).
+ * Otherwise the triangles of each subset are split at the median centroid along the longest axis (k-d split)
+ * until the chunk bounds fit the max position step, or the chunks get too small to be split.
+ * The vertices of each chunk are copied to its own contiguous range (the vertices on the chunk borders are duplicated),
+ * the indices stay relative to the first vertex of the mesh, and each chunk gets its own subset.
+ * @param m The mesh with the welded StaticVertexFb vertex buffer (the skin influences are duplicated with the vertices).
+ * @param indices The welded indices in the subset order, they are reordered and remapped.
+ * @param vertexCount The welded vertex count.
+ * @param positionBits The packed position bits per component.
+ * @param maxPositionStep The max position quantization step (zero disables splitting).
+ * @param chunks The chunks of the mesh.
+ * @return The vertex count of the split mesh.
+ **/
+uint32_t SplitMesh( apemode::Mesh&            m,
+                    std::vector< uint32_t >&  indices,
+                    const uint32_t            vertexCount,
+                    const uint32_t            positionBits,
+                    const float               maxPositionStep,
+                    std::vector< MeshChunk >& chunks ) {
+    auto vertices = reinterpret_cast< const StaticVertexFb* >( m.vertices.data( ) );
+
+    chunks.resize( 1 );
+    chunks[ 0 ].vertexCount = vertexCount;
+    chunks[ 0 ].indexCount  = (uint32_t) indices.size( );
+    chunks[ 0 ].subsetCount = (uint32_t) m.subsets.size( );
+    CalculateChunkBounds( vertices, chunks[ 0 ] );
+
+    if ( maxPositionStep <= 0.0f || GetPositionStep( chunks[ 0 ].positionMin, chunks[ 0 ].positionMax, positionBits ) <= maxPositionStep ) {
+        return vertexCount;
+    }
+
+    //
+    // Split the triangles of the subsets, the leaf ranges are collected in the depth-first order.
+    //
+
+    const uint32_t triangleCount = (uint32_t) indices.size( ) / 3;
+
+    std::vector< uint32_t >     triangles( triangleCount );
+    std::vector< mathfu::vec3 > centroids( triangleCount );
+    for ( uint32_t t = 0; t < triangleCount; ++t ) {
+        triangles[ t ] = t;
+        centroids[ t ] = ( GetPosition( vertices[ indices[ t * 3 + 0 ] ] ) +
+                           GetPosition( vertices[ indices[ t * 3 + 1 ] ] ) +
+                           GetPosition( vertices[ indices[ t * 3 + 2 ] ] ) ) / 3.0f;
+    }
+
+    std::vector< TriangleRange > ranges;
+    std::vector< TriangleRange > pendingRanges;
+    for ( uint32_t ss = (uint32_t) m.subsets.size( ); ss > 0; --ss ) {
+        const auto& subset = m.subsets[ ss - 1 ];
+        pendingRanges.push_back( TriangleRange{ss - 1, subset.base_index( ) / 3, subset.index_count( ) / 3} );
+    }
+
+    while ( false == pendingRanges.empty( ) ) {
+        const TriangleRange range = pendingRanges.back( );
+        pendingRanges.pop_back( );
+
+        mathfu::vec3 positionMin( std::numeric_limits< float >::max( ) );
+        mathfu::vec3 positionMax( std::numeric_limits< float >::lowest( ) );
+        mathfu::vec3 centroidMin( std::numeric_limits< float >::max( ) );
+        mathfu::vec3 centroidMax( std::numeric_limits< float >::lowest( ) );
+
+        for ( uint32_t t = range.firstTriangle; t < range.firstTriangle + range.triangleCount; ++t ) {
+            for ( uint32_t c = 0; c < 3; ++c ) {
+                const mathfu::vec3 position = GetPosition( vertices[ indices[ triangles[ t ] * 3 + c ] ] );
+                positionMin = mathfu::vec3::Min( positionMin, position );
+                positionMax = mathfu::vec3::Max( positionMax, position );
+            }
+
+            centroidMin = mathfu::vec3::Min( centroidMin, centroids[ triangles[ t ] ] );
+            centroidMax = mathfu::vec3::Max( centroidMax, centroids[ triangles[ t ] ] );
+        }
+
+        if ( range.triangleCount < kMinChunkTriangleCount * 2 ||
+             ranges.size( ) + pendingRanges.size( ) + 1 >= kMaxChunkCount ||
+             GetPositionStep( positionMin, positionMax, positionBits ) <= maxPositionStep ) {
+            ranges.push_back( range );
+            continue;
+        }
+
+        const mathfu::vec3 extent = centroidMax - centroidMin;
+        const uint32_t     axis   = extent.x >= extent.y && extent.x >= extent.z ? 0 : ( extent.y >= extent.z ? 1 : 2 );
+
+        const uint32_t halfCount = range.triangleCount / 2;
+        const auto     first     = triangles.begin( ) + range.firstTriangle;
+        std::nth_element( first, first + halfCount, first + range.triangleCount, [&]( uint32_t a, uint32_t b ) {
+            return centroids[ a ][ axis ] < centroids[ b ][ axis ];
+        } );
+
+        /* The first half is processed first. */
+        pendingRanges.push_back( TriangleRange{range.subsetIndex, range.firstTriangle + halfCount, range.triangleCount - halfCount} );
+        pendingRanges.push_back( TriangleRange{range.subsetIndex, range.firstTriangle, halfCount} );
+    }
+
+    //
+    // Copy the vertices of each chunk to its own range, and remap the indices.
+    //
+
+    std::vector< uint8_t >             chunkVertices;
+    std::vector< SkinInfluence >       chunkInfluences;
+    std::vector< uint32_t >            chunkIndices;
+    std::vector< apemodefb::SubsetFb > chunkSubsets;
+    std::vector< uint32_t >            remap( vertexCount, kEmpty );
+    std::vector< uint32_t >            remappedVertices;
+
+    chunkVertices.reserve( m.vertices.size( ) );
+    chunkIndices.reserve( indices.size( ) );
+    chunkSubsets.reserve( ranges.size( ) );
+    chunks.resize( ranges.size( ) );
+
+    uint32_t chunkVertexCount = 0;
+    for ( uint32_t i = 0; i < ranges.size( ); ++i ) {
+        auto& range = ranges[ i ];
+        auto& chunk = chunks[ i ];
+
+        chunk             = MeshChunk( );
+        chunk.baseVertex  = chunkVertexCount;
+        chunk.baseIndex   = (uint32_t) chunkIndices.size( );
+        chunk.indexCount  = range.triangleCount * 3;
+        chunk.baseSubset  = (uint32_t) chunkSubsets.size( );
+        chunk.subsetCount = 1;
+
+        for ( uint32_t t = range.firstTriangle; t < range.firstTriangle + range.triangleCount; ++t ) {
+            for ( uint32_t c = 0; c < 3; ++c ) {
+                const uint32_t index = indices[ triangles[ t ] * 3 + c ];
+                if ( kEmpty == remap[ index ] ) {
+                    remap[ index ] = chunkVertexCount++;
+                    remappedVertices.push_back( index );
+
+                    const uint8_t* vertex = m.vertices.data( ) + index * sizeof( StaticVertexFb );
+                    chunkVertices.insert( chunkVertices.end( ), vertex, vertex + sizeof( StaticVertexFb ) );
+                    if ( false == m.influences.empty( ) ) {
+                        chunkInfluences.push_back( m.influences[ index ] );
+                    }
+                }
+
+                chunkIndices.push_back( remap[ index ] );
+            }
+        }
+
+        /* The vertices of the next chunk are copied again. */
+        for ( const uint32_t index : remappedVertices ) {
+            remap[ index ] = kEmpty;
+        }
+
+        remappedVertices.clear( );
+        chunk.vertexCount = chunkVertexCount - chunk.baseVertex;
+        chunkSubsets.push_back( apemodefb::SubsetFb( m.subsets[ range.subsetIndex ].material_id( ), chunk.baseIndex, chunk.indexCount ) );
+    }
+
+    m.vertices.swap( chunkVertices );
+    m.influences.swap( chunkInfluences );
+    m.subsets.swap( chunkSubsets );
+    indices.swap( chunkIndices );
+
+    vertices = reinterpret_cast< const StaticVertexFb* >( m.vertices.data( ) );
+    for ( auto& chunk : chunks ) {
+        CalculateChunkBounds( vertices, chunk );
+    }
+
+    return chunkVertexCount;
+}
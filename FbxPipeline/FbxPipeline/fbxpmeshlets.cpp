@@ -0,0 +1,207 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+
+using namespace apemode;
+using namespace apemodefb;
+
+namespace {
+    const uint8_t  kEmpty                   = 0xff;
+    const uint32_t kMaxMeshletVertexCount   = 64;  /* The local indices are 8-bit */
+    const uint32_t kMaxMeshletTriangleCount = 124; /* 124 * 3 local indices are 4-byte aligned */
+    const float    kMinConeDot              = 0.1f; /* The wider cones are not stored (they would never cull) */
+
+    inline mathfu::vec3 GetPosition( const StaticVertexFb& vertex ) {
+        return mathfu::vec3( vertex.position( ).x( ), vertex.position( ).y( ), vertex.position( ).z( ) );
+    }
+
+    /**
+     * Meshlet that is being filled with the triangles.
+     **/
+    struct MeshletBuilder {
+        uint32_t baseIndex       = 0;
+        uint32_t baseVertexIndex = 0;
+        uint32_t baseTriangle    = 0;
+        uint32_t vertexCount     = 0;
+        uint32_t triangleCount   = 0;
+    };
+
+    /**
+     * Calculates the bounding sphere and the normal cone of the meshlet, and adds it to the mesh.
+     * The triangle normals follow the winding order the viewer culls by: the front faces are counter-clockwise
+     * in its left-handed view space (the polygon winding is reversed on export), so the front normal is (p2 - p0) x (p1 - p0).
+     * The cone apex is moved back along the axis until all the triangle planes are in front of it,
+     * so the test from the apex is conservative for any eye position.
+     **/
+    void FinishMeshlet( Mesh& m, const StaticVertexFb* vertices, const uint32_t subsetIndex, MeshletBuilder& meshlet ) {
+        if ( 0 == meshlet.triangleCount ) {
+            return;
+        }
+
+        const uint32_t* vertexIndices = m.meshletVertexIndices.data( ) + meshlet.baseVertexIndex;
+        const uint8_t*  triangles     = m.meshletTriangles.data( ) + meshlet.baseTriangle * 3;
+
+        mathfu::vec3 positionMin( std::numeric_limits< float >::max( ) );
+        mathfu::vec3 positionMax( std::numeric_limits< float >::lowest( ) );
+        for ( uint32_t i = 0; i < meshlet.vertexCount; ++i ) {
+            const mathfu::vec3 position = GetPosition( vertices[ vertexIndices[ i ] ] );
+            positionMin = mathfu::vec3::Min( positionMin, position );
+            positionMax = mathfu::vec3::Max( positionMax, position );
+        }
+
+        const mathfu::vec3 center = ( positionMin + positionMax ) * 0.5f;
+
+        float radius = 0.0f;
+        for ( uint32_t i = 0; i < meshlet.vertexCount; ++i ) {
+            radius = std::max( radius, ( GetPosition( vertices[ vertexIndices[ i ] ] ) - center ).Length( ) );
+        }
+
+        //
+        // Normal cone.
+        //
+
+        /* Zero for the degenerate triangles. */
+        mathfu::vec3 normals[ kMaxMeshletTriangleCount ];
+
+        mathfu::vec3 axis( 0.0f );
+        for ( uint32_t t = 0; t < meshlet.triangleCount; ++t ) {
+            const StaticVertexFb& v0 = vertices[ vertexIndices[ triangles[ t * 3 + 0 ] ] ];
+            const StaticVertexFb& v1 = vertices[ vertexIndices[ triangles[ t * 3 + 1 ] ] ];
+            const StaticVertexFb& v2 = vertices[ vertexIndices[ triangles[ t * 3 + 2 ] ] ];
+
+            mathfu::vec3 normal = mathfu::vec3::CrossProduct( GetPosition( v2 ) - GetPosition( v0 ), GetPosition( v1 ) - GetPosition( v0 ) );
+            const float  length = normal.Length( );
+            if ( length <= std::numeric_limits< float >::epsilon( ) ) {
+                normals[ t ] = mathfu::vec3( 0.0f ); /* Degenerate triangles are never visible */
+                continue;
+            }
+
+            normal /= length;
+            normals[ t ] = normal;
+            axis += normal;
+        }
+
+        mathfu::vec3 coneApex   = center;
+        mathfu::vec3 coneAxis   = mathfu::vec3( 0.0f, 0.0f, 1.0f );
+        float        coneCutoff = 1.0f; /* Never culls */
+
+        const float axisLength = axis.Length( );
+        if ( axisLength > std::numeric_limits< float >::epsilon( ) ) {
+            axis /= axisLength;
+
+            float minDot = 1.0f;
+            for ( uint32_t t = 0; t < meshlet.triangleCount; ++t ) {
+                if ( normals[ t ].LengthSquared( ) > 0.0f ) {
+                    minDot = std::min( minDot, mathfu::vec3::DotProduct( normals[ t ], axis ) );
+                }
+            }
+
+            if ( minDot > kMinConeDot ) {
+                /* The furthest triangle plane along the axis (from the center). */
+                float maxT = 0.0f;
+                for ( uint32_t t = 0; t < meshlet.triangleCount; ++t ) {
+                    if ( normals[ t ].LengthSquared( ) > 0.0f ) {
+                        const mathfu::vec3 p0 = GetPosition( vertices[ vertexIndices[ triangles[ t * 3 ] ] ] );
+                        const float        dc = mathfu::vec3::DotProduct( center - p0, normals[ t ] );
+                        const float        dn = mathfu::vec3::DotProduct( axis, normals[ t ] );
+                        maxT = std::max( maxT, dc / dn );
+                    }
+                }
+
+                coneApex   = center - axis * maxT;
+                coneAxis   = axis;
+                coneCutoff = std::sqrt( 1.0f - minDot * minDot );
+            }
+        }
+
+        m.meshlets.emplace_back( vec3( center.x, center.y, center.z ),
+                                 radius,
+                                 vec3( coneApex.x, coneApex.y, coneApex.z ),
+                                 vec3( coneAxis.x, coneAxis.y, coneAxis.z ),
+                                 coneCutoff,
+                                 meshlet.baseIndex,
+                                 meshlet.baseVertexIndex,
+                                 meshlet.baseTriangle,
+                                 (uint8_t) meshlet.vertexCount,
+                                 (uint8_t) meshlet.triangleCount,
+                                 (uint16_t) subsetIndex );
+    }
+
+    /**
+     * Fills the meshlets with the subset triangles in the index order (after the vertex cache optimization),
+     * so that each meshlet is also a contiguous range in the mesh indices.
+     **/
+    template < typename TIndex >
+    void BuildSubsetMeshlets( Mesh& m, const uint32_t subsetIndex, std::vector< uint8_t >& localIndices ) {
+        const auto  vertices = reinterpret_cast< const StaticVertexFb* >( m.vertices.data( ) );
+        const auto  indices  = reinterpret_cast< const TIndex* >( m.indices.data( ) );
+        const auto& subset   = m.subsets[ subsetIndex ];
+
+        MeshletBuilder meshlet;
+        meshlet.baseIndex       = subset.base_index( );
+        meshlet.baseVertexIndex = (uint32_t) m.meshletVertexIndices.size( );
+        meshlet.baseTriangle    = (uint32_t) m.meshletTriangles.size( ) / 3;
+
+        const auto restart = [&]( uint32_t baseIndex ) {
+            /* The local indices of the next meshlet start from the empty table. */
+            for ( uint32_t i = meshlet.baseVertexIndex; i < m.meshletVertexIndices.size( ); ++i ) {
+                localIndices[ m.meshletVertexIndices[ i ] ] = kEmpty;
+            }
+
+            meshlet                 = MeshletBuilder( );
+            meshlet.baseIndex       = baseIndex;
+            meshlet.baseVertexIndex = (uint32_t) m.meshletVertexIndices.size( );
+            meshlet.baseTriangle    = (uint32_t) m.meshletTriangles.size( ) / 3;
+        };
+
+        for ( uint32_t i = subset.base_index( ); i < subset.base_index( ) + subset.index_count( ); i += 3 ) {
+            const uint32_t newVertexCount = ( kEmpty == localIndices[ indices[ i + 0 ] ] ) +
+                                            ( kEmpty == localIndices[ indices[ i + 1 ] ] ) +
+                                            ( kEmpty == localIndices[ indices[ i + 2 ] ] );
+
+            if ( meshlet.vertexCount + newVertexCount > kMaxMeshletVertexCount || meshlet.triangleCount == kMaxMeshletTriangleCount ) {
+                FinishMeshlet( m, vertices, subsetIndex, meshlet );
+                restart( i );
+            }
+
+            for ( uint32_t c = 0; c < 3; ++c ) {
+                const uint32_t index = indices[ i + c ];
+                if ( kEmpty == localIndices[ index ] ) {
+                    localIndices[ index ] = (uint8_t) meshlet.vertexCount++;
+                    m.meshletVertexIndices.push_back( index );
+                }
+
+                m.meshletTriangles.push_back( localIndices[ index ] );
+            }
+
+            ++meshlet.triangleCount;
+        }
+
+        /* The local indices are cleared for the next subset. */
+        FinishMeshlet( m, vertices, subsetIndex, meshlet );
+        restart( 0 );
+    }
+}
+
+/**
+ * Splits the triangles of each subset into the meshlets (at most 64 vertices and 124 triangles),
+ * and calculates the bounding sphere and the normal cone of each meshlet for the cluster culling.
+ * Each meshlet stores its mesh vertex indices and the local 8-bit indices of its triangles,
+ * and it is also a contiguous range in the mesh indices, so the renderer can draw the visible meshlets from the mesh indices.
+ * @param m The mesh with the StaticVertexFb vertex buffer (before packing) and the optimized indices.
+ * @param vertexCount The vertex count of the mesh.
+ **/
+void BuildMeshlets( apemode::Mesh& m, const uint32_t vertexCount ) {
+    std::vector< uint8_t > localIndices( vertexCount, kEmpty );
+
+    m.meshlets.clear( );
+    m.meshletVertexIndices.clear( );
+    m.meshletTriangles.clear( );
+
+    for ( uint32_t ss = 0; ss < m.subsets.size( ); ++ss ) {
+        if ( m.indexType == EIndexTypeFb_UInt16 ) {
+            BuildSubsetMeshlets< uint16_t >( m, ss, localIndices );
+        } else {
+            BuildSubsetMeshlets< uint32_t >( m, ss, localIndices );
+        }
+    }
+}
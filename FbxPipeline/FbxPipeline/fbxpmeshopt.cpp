@@ -1,5 +1,6 @@
 #include <fbxppch.h>
 #include <fbxpstate.h>
+#include <CityHash.h>
 
 #pragma warning( push )
 #pragma warning( disable : 4244 ) // int64 to int32 conversion
@@ -7,6 +8,7 @@
 #pragma warning( pop )
 
 #include <meshoptimizer.hpp>
+#include <tbb/parallel_for.h>
 
 using namespace apemode;
 using namespace apemodefb;
@@ -139,117 +141,278 @@ void set_vertex( VcacheMesh< uint32_t >& m, uint32_t const& sm, uint32_t& index,
 
 #pragma endregion
 
-const bool bUseVcacheOptimizer = false;
+#pragma region Welding
 
-template < typename TIndex >
-void GenerateSubset( apemode::Mesh& m, uint32_t& vertexCount, uint32_t vertexStride ) {
-    if ( false == m.subsets.empty( ) )
-        return;
+/**
+ * Welding key: all the components of the vertex quantized to the epsilon grid.
+ * When the epsilon is zero the raw float bits are used (with -0 folded into +0),
+ * so only the exactly matching vertices are merged.
+ * The skin influences are compared exactly (they are already quantized), zeros for the static meshes.
+ **/
+struct WeldKey {
+    int32_t       components[ sizeof( Vertex ) / sizeof( float ) ];
+    SkinInfluence influence;
+
+    inline bool operator==( WeldKey const& other ) const {
+        return 0 == memcmp( this, &other, sizeof( WeldKey ) );
+    }
+};
+
+static_assert( sizeof( WeldKey ) == sizeof( Vertex ) + sizeof( SkinInfluence ), "Must match" );
+
+inline WeldKey MakeWeldKey( Vertex const& vertex, const SkinInfluence* influence, double invEpsilon ) {
+    const float* components = reinterpret_cast< const float* >( &vertex );
+    const size_t componentCount = sizeof( WeldKey::components ) / sizeof( WeldKey::components[ 0 ] );
+
+    WeldKey key;
+    key.influence = influence ? *influence : SkinInfluence( );
+    for ( size_t i = 0; i < componentCount; ++i ) {
+        if ( invEpsilon > 0.0 ) {
+            const double cell = floor( components[ i ] * invEpsilon + 0.5 );
+            key.components[ i ] = (int32_t) std::max( -2147483648.0, std::min( 2147483647.0, cell ) );
+        } else {
+            const float component = components[ i ] == 0.0f ? 0.0f : components[ i ];
+            memcpy( &key.components[ i ], &component, sizeof( float ) );
+        }
+    }
+
+    return key;
+}
+
+/**
+ * Merges the vertices with matching welding keys.
+ * The vertex buffer of the mesh is compacted in place (unique vertices keep the order of their first occurrence),
+ * the index buffer is filled with the remapped indices for each of the initial vertices, so the subset index ranges
+ * remain valid. The skin influences (if any) are compacted along with the vertices.
+ * @param m The mesh with an unindexed (one vertex per triangle corner) StaticVertexFb vertex buffer.
+ * @param indices The remapped indices, one per initial vertex.
+ * @param vertexCount The initial vertex count.
+ * @param epsilon The welding tolerance (zero means exact matching).
+ * @return The unique vertex count.
+ **/
+uint32_t WeldVertices( apemode::Mesh& m, std::vector< uint32_t >& indices, uint32_t vertexCount, float epsilon ) {
+    const uint32_t kEmpty     = (uint32_t) -1;
+    const double   invEpsilon = epsilon > 0.0f ? 1.0 / (double) epsilon : 0.0;
+
+    indices.resize( vertexCount );
+    if ( 0 == vertexCount ) {
+        return 0;
+    }
+
+    auto vertices   = reinterpret_cast< Vertex* >( m.vertices.data( ) );
+    auto influences = m.influences.empty( ) ? nullptr : m.influences.data( );
+
+    std::vector< WeldKey > keys;
+    keys.reserve( vertexCount );
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        keys.push_back( MakeWeldKey( vertices[ i ], influences ? &influences[ i ] : nullptr, invEpsilon ) );
+    }
+
+    // Open addressing with linear probing, the table is kept at most half full.
+    uint32_t bucketCount = 1;
+    while ( bucketCount < vertexCount * 2 ) {
+        bucketCount <<= 1;
+    }
+
+    std::vector< uint32_t > buckets( bucketCount, kEmpty );
+    const uint32_t bucketMask = bucketCount - 1;
+
+    uint32_t uniqueVertexCount = 0;
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        uint32_t b = (uint32_t) CityHash64( reinterpret_cast< const char* >( &keys[ i ] ), sizeof( WeldKey ) ) & bucketMask;
+
+        for ( ;; ) {
+            const uint32_t u = buckets[ b ];
+
+            if ( kEmpty == u ) {
+                // Since uniqueVertexCount <= i, the entries are moved backwards over the already processed ones.
+                buckets[ b ]                  = uniqueVertexCount;
+                keys[ uniqueVertexCount ]     = keys[ i ];
+                vertices[ uniqueVertexCount ] = vertices[ i ];
+                if ( influences ) {
+                    influences[ uniqueVertexCount ] = influences[ i ];
+                }
+                indices[ i ] = uniqueVertexCount++;
+                break;
+            }
+
+            if ( keys[ u ] == keys[ i ] ) {
+                indices[ i ] = u;
+                break;
+            }
+
+            b = ( b + 1 ) & bucketMask;
+        }
+    }
+
+    m.vertices.resize( uniqueVertexCount * sizeof( Vertex ) );
+    if ( influences ) {
+        m.influences.resize( uniqueVertexCount );
+    }
+
+    return uniqueVertexCount;
+}
+
+#pragma endregion
+
+#pragma region Vertex cache statistics
 
-    std::vector< uint32_t > indexBuffer;
-    indexBuffer.resize( vertexCount );
+/**
+ * Vertex cache statistics:
+ * ACMR (average cache miss ratio) is the number of transformed vertices per triangle (3 is the worst case),
+ * ATVR (average transformed vertex ratio) is the number of transformed vertices per unique vertex (1 is the best case).
+ **/
+struct VertexCacheStatistics {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+/**
+ * Simulates the FIFO post-transform vertex cache of the given size.
+ * A vertex is in the cache if it was transformed less than cacheSize misses ago.
+ **/
+template < typename TIndex >
+VertexCacheStatistics AnalyzeVertexCache( const TIndex* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize ) {
+    std::vector< uint32_t > timestamps( vertexCount, 0 );
 
-    const uint32_t vc = (uint32_t) generateIndexBuffer( indexBuffer.data( ), m.vertices.data( ), vertexCount, vertexStride );
+    uint32_t missCount         = 0;
+    uint32_t uniqueVertexCount = 0;
 
-    std::vector< uint8_t > vertexBuffer;
-    vertexBuffer.resize( vc * vertexStride );
-    generateVertexBuffer( vertexBuffer.data( ), indexBuffer.data( ), m.vertices.data( ), vertexCount, vertexStride );
+    for ( uint32_t i = 0; i < indexCount; ++i ) {
+        const uint32_t index = indices[ i ];
+        assert( index < vertexCount );
 
-    m.vertices.swap( vertexBuffer );
-    vertexCount = vc;
+        const uint32_t timestamp = timestamps[ index ];
+        if ( 0 == timestamp || ( missCount - timestamp ) >= cacheSize ) {
+            uniqueVertexCount += 0 == timestamp;
+            timestamps[ index ] = ++missCount;
+        }
+    }
 
-    m.indices.resize( sizeof( TIndex ) * vertexCount );
-    auto indices = reinterpret_cast< TIndex* >( m.indices.data( ) );
-    for ( uint32_t i = 0; i < vc; ++i ) {
-        indices[ i ] = (TIndex) indexBuffer[ i ];
+    VertexCacheStatistics statistics;
+    if ( indexCount ) {
+        statistics.acmr = float( missCount ) / float( indexCount / 3 );
+        statistics.atvr = float( missCount ) / float( uniqueVertexCount );
     }
 
-    m.subsets.emplace_back( (uint32_t) 0, (uint32_t) 0, (uint32_t) vc );
+    return statistics;
 }
 
+#pragma endregion
+
+#pragma region Optimization backends
+
+const uint32_t kCacheSize = 16;
+
 template < typename TIndex >
 void OptimizeSubsetVcache( apemode::Mesh& mesh, uint32_t subsetIndex ) {
     VcacheMesh< TIndex > meshWrapper;
     meshWrapper.m = &mesh;
 
+    // Vertices can be reordered only if they are not shared with other subsets.
+    // The skin influences are not reordered by the optimizer, so the vertices of the skinned meshes stay in place.
     vcache_optimizer::vcache_optimizer< VcacheMesh< TIndex > > optimizer;
-    optimizer( meshWrapper, subsetIndex, mesh.subsets.size( ) == 1 );
+    optimizer( meshWrapper, subsetIndex, mesh.subsets.size( ) == 1 && mesh.influences.empty( ) );
 }
 
 template < typename TIndex >
-void OptimizeSubset(apemode::Mesh& m, const Vertex * vertices, uint32_t& vertexCount, uint32_t vertexStride, uint32_t ss ) {
-    const uint32_t kCacheSize = 16;
-
-    std::vector< uint8_t > indexBuffer;
-    indexBuffer.resize( m.subsets[ ss ].index_count( ) * sizeof( TIndex ) );
+void OptimizeSubsetMeshOptimizer( apemode::Mesh& m, uint32_t vertexCount, uint32_t ss ) {
+    const auto vertices   = reinterpret_cast< const Vertex* >( m.vertices.data( ) );
+    const auto indices    = reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( );
+    const auto indexCount = m.subsets[ ss ].index_count( );
 
-#if 0
+    std::vector< TIndex > indexBuffer;
+    indexBuffer.resize( indexCount );
 
     std::vector< uint32_t > clusters;
-    optimizePostTransform( reinterpret_cast< TIndex* >( indexBuffer.data( ) ),
-                           reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( ),
-                           m.subsets[ ss ].index_count( ),
-                           vertexCount,
-                           kCacheSize,
-                           &clusters );
-
-    memcpy( reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( ),
-            indexBuffer.data( ),
-            m.subsets[ ss ].index_count( ) * sizeof( TIndex ) );
-
-    optimizeOverdraw( reinterpret_cast< TIndex* >( indexBuffer.data( ) ),
-                      reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( ),
-                      m.subsets[ ss ].index_count( ),
+    optimizePostTransform( indexBuffer.data( ), indices, indexCount, vertexCount, kCacheSize, &clusters );
+    memcpy( indices, indexBuffer.data( ), indexCount * sizeof( TIndex ) );
+
+    optimizeOverdraw( indexBuffer.data( ),
+                      indices,
+                      indexCount,
                       vertices,
-                      vertexStride,
+                      sizeof( Vertex ),
                       vertexCount,
                       clusters,
                       kCacheSize,
                       1.05f );
-
-    memcpy( reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( ),
-            indexBuffer.data( ),
-            m.subsets[ ss ].index_count( ) * sizeof( TIndex ) );
-
-#else
-
-    optimizePostTransform( reinterpret_cast< TIndex* >( indexBuffer.data( ) ),
-                           reinterpret_cast< TIndex* >( m.indices.data( ) ) + m.subsets[ ss ].base_index( ),
-                           m.subsets[ ss ].index_count( ),
-                           vertexCount,
-                           kCacheSize );
-
-#endif
+    memcpy( indices, indexBuffer.data( ), indexCount * sizeof( TIndex ) );
 }
 
+/**
+ * Optimizes the subsets of the mesh concurrently (they are independent index ranges).
+ * Logs ACMR/ATVR before and after the optimization for each subset.
+ **/
 template < typename TIndex >
-void Optimize( apemode::Mesh& m, const Vertex * vertices, uint32_t& vertexCount, uint32_t vertexStride ) {
-
+void Optimize( apemode::Mesh& m, uint32_t vertexCount, apemode::EMeshOptimizer optimizer ) {
     auto& s = apemode::Get( );
 
-    VcacheMesh< TIndex > mm;
-    mm.m = &m;
-
-    if ( m.subsets.empty( ) ) {
-        GenerateSubset< TIndex >( m, vertexCount, vertexStride );
-        // OptimizeSubset< TIndex >( m, vertices, vertexCount, vertexStride, 0 );
-    }
-
-    for ( uint32_t ss = 0; ss < m.subsets.size( ); ++ss ) {
-        // OptimizeSubset< TIndex >( m, vertices, vertexCount, vertexStride, ss );
-        OptimizeSubsetVcache< TIndex >( m, ss );
+    const uint32_t subsetCount = (uint32_t) m.subsets.size( );
+    std::vector< VertexCacheStatistics > statisticsBefore( subsetCount );
+    std::vector< VertexCacheStatistics > statisticsAfter( subsetCount );
+
+    tbb::parallel_for( uint32_t( 0 ), subsetCount, [&]( uint32_t ss ) {
+        const auto& subset = m.subsets[ ss ];
+        const auto analyze = [&]( ) {
+            return AnalyzeVertexCache( reinterpret_cast< const TIndex* >( m.indices.data( ) ) + subset.base_index( ),
+                                       subset.index_count( ),
+                                       vertexCount,
+                                       kCacheSize );
+        };
+
+        statisticsBefore[ ss ] = analyze( );
+
+        switch ( optimizer ) {
+            case apemode::eMeshOptimizer_Vcache:
+                OptimizeSubsetVcache< TIndex >( m, ss );
+                break;
+            case apemode::eMeshOptimizer_MeshOptimizer:
+                OptimizeSubsetMeshOptimizer< TIndex >( m, vertexCount, ss );
+                break;
+            default:
+                break;
+        }
+
+        statisticsAfter[ ss ] = analyze( );
+    } );
+
+    for ( uint32_t ss = 0; ss < subsetCount; ++ss ) {
+        s.console->info( "\tSubset #{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}.",
+                         ss,
+                         statisticsBefore[ ss ].acmr,
+                         statisticsAfter[ ss ].acmr,
+                         statisticsBefore[ ss ].atvr,
+                         statisticsAfter[ ss ].atvr );
     }
 }
 
+#pragma endregion
+
 // F:\Dev\Projects\ProjectFbxPipeline\ThirdParty\meshoptimizer\demo\bunny.obj
 // E:\Media\Models\Mercedes+Benz+A45+AMG.FBX
 // E:\Media\Models\m4a1-sopmod-overkill\source\M4A1 SOPMOD Overkill HIGH POLY.obj
 // E:\Media\Models\mech-m-6k\source\93d43cf18ad5406ba0176c9fae7d4927.fbx
 
-void Optimize32( apemode::Mesh& mesh, const Vertex* vertices, uint32_t& vertexCount, uint32_t vertexStride ) {
-    Optimize< uint32_t >( mesh, vertices, vertexCount, vertexStride );
+apemode::EMeshOptimizer GetMeshOptimizer( std::string const& name ) {
+    if ( name.empty( ) || name == "none" )
+        return apemode::eMeshOptimizer_None;
+    if ( name == "vcache" )
+        return apemode::eMeshOptimizer_Vcache;
+    if ( name == "meshopt" )
+        return apemode::eMeshOptimizer_MeshOptimizer;
+
+    apemode::Get( ).console->error( "Unknown mesh optimizer \"{}\" (expected vcache, meshopt or none).", name );
+    return apemode::eMeshOptimizer_None;
 }
 
-void Optimize16( apemode::Mesh& mesh, const Vertex* vertices, uint32_t& vertexCount, uint32_t vertexStride ) {
-    Optimize< uint16_t >( mesh, vertices, vertexCount, vertexStride );
-}
\ No newline at end of file
+void Optimize( apemode::Mesh& mesh, uint32_t vertexCount, apemode::EMeshOptimizer optimizer ) {
+    if ( apemode::eMeshOptimizer_None == optimizer )
+        return;
+
+    if ( mesh.indexType == apemodefb::EIndexTypeFb_UInt16 ) {
+        Optimize< uint16_t >( mesh, vertexCount, optimizer );
+    } else if ( mesh.indexType == apemodefb::EIndexTypeFb_UInt32 ) {
+        Optimize< uint32_t >( mesh, vertexCount, optimizer );
+    }
+}
@@ -0,0 +1,576 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+#include <CityHash.h>
+#include <tbb/parallel_for.h>
+
+using namespace apemode;
+using namespace apemodefb;
+
+namespace {
+    const uint32_t kEmpty           = (uint32_t) -1;
+    const float    kMinLodReduction = 0.1f; /* The next levels are dropped if the level removes fewer triangles */
+
+    inline mathfu::vec3 GetPosition( const StaticVertexFb& vertex ) {
+        return mathfu::vec3( vertex.position( ).x( ), vertex.position( ).y( ), vertex.position( ).z( ) );
+    }
+
+    /**
+     * Sum of the squared distances to the planes of the triangles (weighted by the triangle areas).
+     * The planes are stored as the symmetric 4x4 matrix (upper 3x3, the vector, and the constant).
+     **/
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        void AddPlane( const mathfu::vec3 normal, const mathfu::vec3 point, const double area ) {
+            const double nx = normal.x, ny = normal.y, nz = normal.z;
+            const double d  = -( nx * point.x + ny * point.y + nz * point.z );
+
+            a00 += area * nx * nx, a01 += area * nx * ny, a02 += area * nx * nz;
+            a11 += area * ny * ny, a12 += area * ny * nz, a22 += area * nz * nz;
+            b0 += area * nx * d, b1 += area * ny * d, b2 += area * nz * d;
+            c += area * d * d;
+            weight += area;
+        }
+
+        void Add( const Quadric& other ) {
+            a00 += other.a00, a01 += other.a01, a02 += other.a02;
+            a11 += other.a11, a12 += other.a12, a22 += other.a22;
+            b0 += other.b0, b1 += other.b1, b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+
+        /**
+         * The mean squared distance from the point to the planes.
+         **/
+        double GetError( const mathfu::vec3 point ) const {
+            const double x = point.x, y = point.y, z = point.z;
+            const double e = a00 * x * x + a11 * y * y + a22 * z * z +
+                             2.0 * ( a01 * x * y + a02 * x * z + a12 * y * z ) +
+                             2.0 * ( b0 * x + b1 * y + b2 * z ) + c;
+            return weight > 0.0 ? std::fabs( e ) / weight : 0.0;
+        }
+    };
+
+    /**
+     * Squared distance from the point to the triangle (the closest point is found by the Voronoi regions of the triangle).
+     **/
+    inline double GetTriangleDistanceSquared( const mathfu::vec3 p, const mathfu::vec3 a, const mathfu::vec3 b, const mathfu::vec3 c ) {
+        const mathfu::vec3 ab = b - a;
+        const mathfu::vec3 ac = c - a;
+        const mathfu::vec3 ap = p - a;
+
+        const float d1 = mathfu::vec3::DotProduct( ab, ap );
+        const float d2 = mathfu::vec3::DotProduct( ac, ap );
+        if ( d1 <= 0.0f && d2 <= 0.0f ) {
+            return ap.LengthSquared( ); /* Vertex a */
+        }
+
+        const mathfu::vec3 bp = p - b;
+        const float        d3 = mathfu::vec3::DotProduct( ab, bp );
+        const float        d4 = mathfu::vec3::DotProduct( ac, bp );
+        if ( d3 >= 0.0f && d4 <= d3 ) {
+            return bp.LengthSquared( ); /* Vertex b */
+        }
+
+        const mathfu::vec3 cp = p - c;
+        const float        d5 = mathfu::vec3::DotProduct( ab, cp );
+        const float        d6 = mathfu::vec3::DotProduct( ac, cp );
+        if ( d6 >= 0.0f && d5 <= d6 ) {
+            return cp.LengthSquared( ); /* Vertex c */
+        }
+
+        const float vc = d1 * d4 - d3 * d2;
+        if ( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f ) {
+            return ( ap - ab * ( d1 / ( d1 - d3 ) ) ).LengthSquared( ); /* Edge ab */
+        }
+
+        const float vb = d5 * d2 - d1 * d6;
+        if ( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f ) {
+            return ( ap - ac * ( d2 / ( d2 - d6 ) ) ).LengthSquared( ); /* Edge ac */
+        }
+
+        const float va = d3 * d6 - d5 * d4;
+        if ( va <= 0.0f && ( d4 - d3 ) >= 0.0f && ( d5 - d6 ) >= 0.0f ) {
+            return ( bp - ( c - b ) * ( ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ) ) ).LengthSquared( ); /* Edge bc */
+        }
+
+        /* Inside, degenerate triangles end up in the vertex or edge regions. */
+        const float denom = 1.0f / ( va + vb + vc );
+        return ( ap - ab * ( vb * denom ) - ac * ( vc * denom ) ).LengthSquared( );
+    }
+
+    /**
+     * Half-edge collapse: the vertex is moved into its neighbour.
+     **/
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double   error; /* Squared */
+    };
+
+    /**
+     * Target of the level of detail.
+     **/
+    struct LodTarget {
+        uint32_t triangleCount;
+        double   maxError; /* Squared */
+    };
+
+    /**
+     * Vertices that cannot be moved (the collapses into them are allowed).
+     * The vertex positions are compared exactly, so that the split vertices are found:
+     * the positions with several vertices (UV and normal seams, the chunk borders after splitting),
+     * the positions shared by several subsets (material borders), and the ends of the open and non-manifold edges.
+     **/
+    template < typename TIndex >
+    std::vector< uint8_t > GetLockedVertices( const Mesh& m, const uint32_t vertexCount, const uint32_t indexCount ) {
+        const auto vertices = reinterpret_cast< const StaticVertexFb* >( m.vertices.data( ) );
+        const auto indices  = reinterpret_cast< const TIndex* >( m.indices.data( ) );
+
+        std::vector< uint8_t > locked( vertexCount, 0 );
+
+        //
+        // Map the vertices to the first vertex with the same position (open addressing, linear probing).
+        //
+
+        uint32_t bucketCount = 1;
+        while ( bucketCount < vertexCount * 2 ) {
+            bucketCount <<= 1;
+        }
+
+        std::vector< uint32_t > buckets( bucketCount, kEmpty );
+        std::vector< uint32_t > positionIds( vertexCount );
+        const uint32_t          bucketMask = bucketCount - 1;
+
+        for ( uint32_t i = 0; i < vertexCount; ++i ) {
+            const vec3 position = vertices[ i ].position( );
+            uint32_t   b = (uint32_t) CityHash64( reinterpret_cast< const char* >( &position ), sizeof( vec3 ) ) & bucketMask;
+
+            for ( ;; ) {
+                const uint32_t u = buckets[ b ];
+                if ( kEmpty == u ) {
+                    buckets[ b ] = i;
+                    positionIds[ i ] = i;
+                    break;
+                }
+
+                if ( 0 == memcmp( &vertices[ u ].position( ), &position, sizeof( vec3 ) ) ) {
+                    positionIds[ i ] = u;
+                    locked[ i ] = 1;
+                    locked[ u ] = 1;
+                    break;
+                }
+
+                b = ( b + 1 ) & bucketMask;
+            }
+        }
+
+        //
+        // Lock the positions shared by the subsets.
+        //
+
+        std::vector< uint32_t > positionSubsets( vertexCount, kEmpty );
+        for ( uint32_t ss = 0; ss < m.subsets.size( ); ++ss ) {
+            const auto& subset = m.subsets[ ss ];
+            for ( uint32_t i = subset.base_index( ); i < subset.base_index( ) + subset.index_count( ); ++i ) {
+                const uint32_t positionId = positionIds[ indices[ i ] ];
+                if ( kEmpty == positionSubsets[ positionId ] ) {
+                    positionSubsets[ positionId ] = ss;
+                } else if ( positionSubsets[ positionId ] != ss ) {
+                    locked[ positionId ] = 1;
+                }
+            }
+        }
+
+        //
+        // Lock the ends of the edges that do not have exactly two triangles (open borders, non-manifold edges).
+        //
+
+        std::vector< uint64_t > edges;
+        edges.reserve( indexCount );
+        for ( uint32_t i = 0; i < indexCount; i += 3 ) {
+            for ( uint32_t e = 0; e < 3; ++e ) {
+                const uint32_t a = positionIds[ indices[ i + e ] ];
+                const uint32_t b = positionIds[ indices[ i + ( e + 1 ) % 3 ] ];
+                if ( a != b ) {
+                    edges.push_back( ( uint64_t( std::min( a, b ) ) << 32 ) | std::max( a, b ) );
+                }
+            }
+        }
+
+        std::sort( edges.begin( ), edges.end( ) );
+        for ( size_t i = 0; i < edges.size( ); ) {
+            size_t j = i + 1;
+            while ( j < edges.size( ) && edges[ j ] == edges[ i ] ) {
+                ++j;
+            }
+
+            if ( j - i != 2 ) {
+                locked[ uint32_t( edges[ i ] >> 32 ) ] = 1;
+                locked[ uint32_t( edges[ i ] & 0xffffffff ) ] = 1;
+            }
+
+            i = j;
+        }
+
+        /* All the vertices with the locked positions. */
+        for ( uint32_t i = 0; i < vertexCount; ++i ) {
+            locked[ i ] = locked[ i ] || locked[ positionIds[ i ] ];
+        }
+
+        return locked;
+    }
+
+    /**
+     * Simplifies the triangles of the subset down to each of the targets in turn (each level continues from the previous one).
+     * The vertices are collapsed into their neighbours (no new vertices), the cheapest collapses are applied first,
+     * the collapses that would flip or degenerate the remaining triangles are skipped.
+     * Each pass collapses the independent vertices (the neighbours of the collapsed vertices wait for the next pass).
+     * @param vertices The mesh vertices.
+     * @param locked The vertices that cannot be moved.
+     * @param subsetIndices The subset indices (the mesh vertex indices).
+     * @param targets The targets of the levels.
+     * @param lodIndices The indices of each level (the mesh vertex indices).
+     * @param lodErrors The max distance from the subset vertices to the triangles of each level.
+     *                  Each vertex is measured against the triangles around the vertex it was collapsed into,
+     *                  so the distance to the level surface at the vertices is not greater than that.
+     **/
+    void SimplifySubset( const StaticVertexFb*           vertices,
+                         std::vector< uint8_t > const&   locked,
+                         std::vector< uint32_t > const&  subsetIndices,
+                         std::vector< LodTarget > const& targets,
+                         std::vector< uint32_t >*        lodIndices,
+                         float*                          lodErrors ) {
+        //
+        // Local vertex ids.
+        //
+
+        std::vector< uint32_t > subsetVertices( subsetIndices );
+        std::sort( subsetVertices.begin( ), subsetVertices.end( ) );
+        subsetVertices.erase( std::unique( subsetVertices.begin( ), subsetVertices.end( ) ), subsetVertices.end( ) );
+
+        const uint32_t vertexCount = (uint32_t) subsetVertices.size( );
+
+        std::vector< uint32_t > indices( subsetIndices.size( ) );
+        for ( size_t i = 0; i < indices.size( ); ++i ) {
+            indices[ i ] = (uint32_t) std::distance( subsetVertices.begin( ),
+                                                     std::lower_bound( subsetVertices.begin( ), subsetVertices.end( ), subsetIndices[ i ] ) );
+        }
+
+        std::vector< mathfu::vec3 > positions( vertexCount );
+        std::vector< uint8_t >      isLocked( vertexCount );
+        std::vector< Quadric >      quadrics( vertexCount );
+        std::vector< uint32_t >     remainingVertices( vertexCount ); /* The vertex each vertex was collapsed into */
+        for ( uint32_t v = 0; v < vertexCount; ++v ) {
+            positions[ v ]         = GetPosition( vertices[ subsetVertices[ v ] ] );
+            isLocked[ v ]          = locked[ subsetVertices[ v ] ];
+            remainingVertices[ v ] = v;
+        }
+
+        for ( size_t i = 0; i < indices.size( ); i += 3 ) {
+            const mathfu::vec3 p0     = positions[ indices[ i + 0 ] ];
+            const mathfu::vec3 normal = mathfu::vec3::CrossProduct( positions[ indices[ i + 1 ] ] - p0, positions[ indices[ i + 2 ] ] - p0 );
+            const float        length = normal.Length( );
+            if ( length > 0.0f ) {
+                for ( uint32_t c = 0; c < 3; ++c ) {
+                    quadrics[ indices[ i + c ] ].AddPlane( normal / length, p0, length * 0.5 );
+                }
+            }
+        }
+
+        //
+        // Collapse passes.
+        //
+
+        std::vector< uint32_t > vertexTriangleOffsets( vertexCount + 1 );
+        std::vector< uint32_t > vertexTriangles;
+        std::vector< Collapse > bestCollapses( vertexCount );
+        std::vector< Collapse > collapses;
+        std::vector< uint32_t > collapseTargets( vertexCount );
+        std::vector< uint8_t >  dirty( vertexCount );
+
+        /* Checks the triangles around the vertex that remain after the collapse. */
+        const auto isValidCollapse = [&]( const Collapse& collapse ) {
+            for ( uint32_t k = vertexTriangleOffsets[ collapse.from ]; k < vertexTriangleOffsets[ collapse.from + 1 ]; ++k ) {
+                const uint32_t* triangle = &indices[ vertexTriangles[ k ] * 3 ];
+                if ( triangle[ 0 ] == collapse.to || triangle[ 1 ] == collapse.to || triangle[ 2 ] == collapse.to ) {
+                    continue; /* Removed */
+                }
+
+                mathfu::vec3 p[ 3 ];
+                mathfu::vec3 q[ 3 ];
+                for ( uint32_t c = 0; c < 3; ++c ) {
+                    p[ c ] = positions[ triangle[ c ] ];
+                    q[ c ] = triangle[ c ] == collapse.from ? positions[ collapse.to ] : p[ c ];
+                }
+
+                const mathfu::vec3 n0 = mathfu::vec3::CrossProduct( p[ 1 ] - p[ 0 ], p[ 2 ] - p[ 0 ] );
+                const mathfu::vec3 n1 = mathfu::vec3::CrossProduct( q[ 1 ] - q[ 0 ], q[ 2 ] - q[ 0 ] );
+                if ( mathfu::vec3::DotProduct( n0, n1 ) <= 0.0f ) {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        /* Triangles around the vertices of the current indices. */
+        const auto updateVertexTriangles = [&]( ) {
+            std::fill( vertexTriangleOffsets.begin( ), vertexTriangleOffsets.end( ), 0 );
+            for ( const uint32_t index : indices ) {
+                ++vertexTriangleOffsets[ index + 1 ];
+            }
+
+            for ( uint32_t v = 0; v < vertexCount; ++v ) {
+                vertexTriangleOffsets[ v + 1 ] += vertexTriangleOffsets[ v ];
+            }
+
+            vertexTriangles.resize( indices.size( ) );
+            std::vector< uint32_t > vertexTriangleCounts( vertexTriangleOffsets.begin( ), vertexTriangleOffsets.end( ) - 1 );
+            for ( uint32_t t = 0; t < indices.size( ) / 3; ++t ) {
+                for ( uint32_t c = 0; c < 3; ++c ) {
+                    vertexTriangles[ vertexTriangleCounts[ indices[ t * 3 + c ] ]++ ] = t;
+                }
+            }
+        };
+
+        /* The levels continue from each other, so the error of the level is at least the error of the previous one. */
+        double maxDistanceSquared = 0.0;
+        for ( size_t l = 0; l < targets.size( ); ++l ) {
+            const LodTarget& target = targets[ l ];
+
+            while ( indices.size( ) / 3 > target.triangleCount ) {
+                const uint32_t triangleCount = (uint32_t) indices.size( ) / 3;
+
+                updateVertexTriangles( );
+
+                /* The cheapest collapse of each vertex. */
+                for ( uint32_t v = 0; v < vertexCount; ++v ) {
+                    bestCollapses[ v ] = Collapse{v, kEmpty, std::numeric_limits< double >::max( )};
+                }
+
+                const auto addCollapse = [&]( const uint32_t from, const uint32_t to ) {
+                    if ( false == isLocked[ from ] ) {
+                        const double error = quadrics[ from ].GetError( positions[ to ] );
+                        if ( error < bestCollapses[ from ].error ) {
+                            bestCollapses[ from ] = Collapse{from, to, error};
+                        }
+                    }
+                };
+
+                for ( uint32_t t = 0; t < triangleCount; ++t ) {
+                    for ( uint32_t e = 0; e < 3; ++e ) {
+                        const uint32_t a = indices[ t * 3 + e ];
+                        const uint32_t b = indices[ t * 3 + ( e + 1 ) % 3 ];
+                        addCollapse( a, b );
+                        addCollapse( b, a );
+                    }
+                }
+
+                collapses.clear( );
+                for ( const auto& collapse : bestCollapses ) {
+                    if ( kEmpty != collapse.to && collapse.error <= target.maxError ) {
+                        collapses.push_back( collapse );
+                    }
+                }
+
+                std::sort( collapses.begin( ), collapses.end( ), []( const Collapse& a, const Collapse& b ) {
+                    return a.error < b.error;
+                } );
+
+                //
+                // Apply the independent collapses until the target is reached.
+                //
+
+                for ( uint32_t v = 0; v < vertexCount; ++v ) {
+                    collapseTargets[ v ] = v;
+                }
+
+                std::fill( dirty.begin( ), dirty.end( ), 0 );
+
+                uint32_t removedTriangleCount = 0;
+                for ( const auto& collapse : collapses ) {
+                    if ( triangleCount - removedTriangleCount <= target.triangleCount ) {
+                        break;
+                    }
+
+                    if ( dirty[ collapse.from ] || dirty[ collapse.to ] || false == isValidCollapse( collapse ) ) {
+                        continue;
+                    }
+
+                    for ( uint32_t k = vertexTriangleOffsets[ collapse.from ]; k < vertexTriangleOffsets[ collapse.from + 1 ]; ++k ) {
+                        const uint32_t* triangle = &indices[ vertexTriangles[ k ] * 3 ];
+                        dirty[ triangle[ 0 ] ] = dirty[ triangle[ 1 ] ] = dirty[ triangle[ 2 ] ] = 1;
+                        removedTriangleCount += triangle[ 0 ] == collapse.to || triangle[ 1 ] == collapse.to || triangle[ 2 ] == collapse.to;
+                    }
+
+                    collapseTargets[ collapse.from ] = collapse.to;
+                    quadrics[ collapse.to ].Add( quadrics[ collapse.from ] );
+                }
+
+                if ( 0 == removedTriangleCount ) {
+                    break;
+                }
+
+                /* The targets are not collapsed in the same pass (they are dirty). */
+                for ( auto& remainingVertex : remainingVertices ) {
+                    remainingVertex = collapseTargets[ remainingVertex ];
+                }
+
+                /* Remap the indices and remove the degenerate triangles. */
+                size_t indexCount = 0;
+                for ( size_t i = 0; i < indices.size( ); i += 3 ) {
+                    const uint32_t a = collapseTargets[ indices[ i + 0 ] ];
+                    const uint32_t b = collapseTargets[ indices[ i + 1 ] ];
+                    const uint32_t c = collapseTargets[ indices[ i + 2 ] ];
+                    if ( a != b && b != c && a != c ) {
+                        indices[ indexCount++ ] = a;
+                        indices[ indexCount++ ] = b;
+                        indices[ indexCount++ ] = c;
+                    }
+                }
+
+                indices.resize( indexCount );
+            }
+
+            lodIndices[ l ].resize( indices.size( ) );
+            for ( size_t i = 0; i < indices.size( ); ++i ) {
+                lodIndices[ l ][ i ] = subsetVertices[ indices[ i ] ];
+            }
+
+            //
+            // The distances from the subset vertices to the level triangles around their remaining vertices.
+            //
+
+            updateVertexTriangles( );
+            for ( uint32_t v = 0; v < vertexCount; ++v ) {
+                const uint32_t r = remainingVertices[ v ];
+                if ( r == v ) {
+                    continue; /* The vertex of the level triangles */
+                }
+
+                /* The vertices of the collapsed away parts are measured to the point they were collapsed into. */
+                double distanceSquared = ( positions[ v ] - positions[ r ] ).LengthSquared( );
+                for ( uint32_t k = vertexTriangleOffsets[ r ]; k < vertexTriangleOffsets[ r + 1 ]; ++k ) {
+                    const uint32_t* triangle = &indices[ vertexTriangles[ k ] * 3 ];
+                    distanceSquared          = std::min( distanceSquared,
+                                                GetTriangleDistanceSquared( positions[ v ],
+                                                                            positions[ triangle[ 0 ] ],
+                                                                            positions[ triangle[ 1 ] ],
+                                                                            positions[ triangle[ 2 ] ] ) );
+                }
+
+                maxDistanceSquared = std::max( maxDistanceSquared, distanceSquared );
+            }
+
+            lodErrors[ l ] = (float) std::sqrt( maxDistanceSquared );
+        }
+    }
+
+    template < typename TIndex >
+    void SimplifySubsets( Mesh& m, const uint32_t vertexCount, const uint32_t lodCount, const float lodRatio, const float lodError ) {
+        const auto     vertices    = reinterpret_cast< const StaticVertexFb* >( m.vertices.data( ) );
+        const uint32_t indexCount  = (uint32_t) ( m.indices.size( ) / sizeof( TIndex ) );
+        const uint32_t subsetCount = (uint32_t) m.subsets.size( );
+
+        const std::vector< uint8_t > locked = GetLockedVertices< TIndex >( m, vertexCount, indexCount );
+
+        /* The max error is relative to the mesh size. */
+        mathfu::vec3 positionMin( std::numeric_limits< float >::max( ) );
+        mathfu::vec3 positionMax( std::numeric_limits< float >::lowest( ) );
+        for ( uint32_t i = 0; i < vertexCount; ++i ) {
+            positionMin = mathfu::vec3::Min( positionMin, GetPosition( vertices[ i ] ) );
+            positionMax = mathfu::vec3::Max( positionMax, GetPosition( vertices[ i ] ) );
+        }
+
+        const mathfu::vec3 extent     = positionMax - positionMin;
+        const double       meshExtent = std::max( extent.x, std::max( extent.y, extent.z ) );
+
+        //
+        // Simplify the subsets in parallel, the levels of each subset are built one after another.
+        //
+
+        std::vector< std::vector< uint32_t > > lodIndices( subsetCount * lodCount );
+        std::vector< float >                   lodErrors( subsetCount * lodCount, 0.0f );
+
+        tbb::parallel_for( uint32_t( 0 ), subsetCount, [&]( uint32_t ss ) {
+            const auto& subset  = m.subsets[ ss ];
+            const auto  indices = reinterpret_cast< const TIndex* >( m.indices.data( ) ) + subset.base_index( );
+
+            std::vector< LodTarget > targets( lodCount );
+            for ( uint32_t l = 0; l < lodCount; ++l ) {
+                const double triangleRatio = std::pow( double( lodRatio ), double( l + 1 ) );
+                const double maxError      = double( lodError ) * meshExtent * double( 1u << l );
+                targets[ l ].triangleCount = uint32_t( subset.index_count( ) / 3 * triangleRatio );
+                targets[ l ].maxError      = maxError * maxError;
+            }
+
+            const std::vector< uint32_t > subsetIndices( indices, indices + subset.index_count( ) );
+            SimplifySubset( vertices, locked, subsetIndices, targets, &lodIndices[ ss * lodCount ], &lodErrors[ ss * lodCount ] );
+        } );
+
+        //
+        // Append the levels to the mesh indices, a subset per mesh subset (possibly empty) for each level.
+        //
+
+        m.lods.clear( );
+        m.lodSubsets.clear( );
+
+        std::vector< TIndex > indices;
+        uint32_t previousTriangleCount = indexCount / 3;
+        for ( uint32_t l = 0; l < lodCount; ++l ) {
+            const uint32_t baseIndex  = indexCount + (uint32_t) indices.size( );
+            const uint32_t baseSubset = (uint32_t) m.lodSubsets.size( );
+
+            float error = 0.0f;
+            for ( uint32_t ss = 0; ss < subsetCount; ++ss ) {
+                auto const& subsetIndices = lodIndices[ ss * lodCount + l ];
+                m.lodSubsets.emplace_back( m.subsets[ ss ].material_id( ),
+                                           indexCount + (uint32_t) indices.size( ),
+                                           (uint32_t) subsetIndices.size( ) );
+                indices.insert( indices.end( ), subsetIndices.begin( ), subsetIndices.end( ) );
+                error = std::max( error, lodErrors[ ss * lodCount + l ] );
+            }
+
+            const uint32_t triangleCount = ( indexCount + (uint32_t) indices.size( ) - baseIndex ) / 3;
+            if ( triangleCount > previousTriangleCount * ( 1.0f - kMinLodReduction ) ) {
+                /* Does not pay off, the next levels are even closer. */
+                m.lodSubsets.resize( baseSubset );
+                indices.resize( baseIndex - indexCount );
+                break;
+            }
+
+            m.lods.emplace_back( error, baseSubset, subsetCount );
+            previousTriangleCount = triangleCount;
+        }
+
+        const uint8_t* lodIndexBytes = reinterpret_cast< const uint8_t* >( indices.data( ) );
+        m.indices.insert( m.indices.end( ), lodIndexBytes, lodIndexBytes + indices.size( ) * sizeof( TIndex ) );
+    }
+}
+
+/**
+ * Generates the simplified levels of detail of the mesh (quadric error metric, half-edge collapses).
+ * The levels reuse the vertices of the mesh, each level is a set of subsets (one per mesh subset, with the same material),
+ * the level indices are appended to the mesh indices. Each level targets the ratio of the triangles of the previous level,
+ * and stops when the next collapse exceeds its max error (doubled for each next level).
+ * The seams, subset borders, chunk borders and open borders stay in place, so the subsets and chunks of the levels
+ * keep the vertex ranges and quantization bounds of the full mesh.
+ * The levels that would remove too few triangles are not generated.
+ * @param m The mesh with the StaticVertexFb vertex buffer (before packing) and the indices.
+ * @param vertexCount The vertex count of the mesh.
+ * @param lodCount The max number of the simplified levels.
+ * @param lodRatio The target triangle ratio of each level to the previous one.
+ * @param lodError The max error of the first level, relative to the mesh size.
+ **/
+void SimplifyMesh( apemode::Mesh& m, const uint32_t vertexCount, const uint32_t lodCount, const float lodRatio, const float lodError ) {
+    if ( m.indexType == EIndexTypeFb_UInt16 ) {
+        SimplifySubsets< uint16_t >( m, vertexCount, lodCount, lodRatio, lodError );
+    } else {
+        SimplifySubsets< uint32_t >( m, vertexCount, lodCount, lodRatio, lodError );
+    }
+}
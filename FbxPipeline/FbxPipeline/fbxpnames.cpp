@@ -0,0 +1,201 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+#include <CityHash.h>
+#include <chrono>
+#include <tbb/parallel_for.h>
+
+apemode::NameTable::NameTable( ) : collisionCount( 0 ) {
+}
+
+const char* apemode::NameTable::Shard::Store( const char* name, size_t length ) {
+    const size_t size = length + 1;
+
+    /* Long names get their own blocks, the current block remains active. */
+    if ( size > kArenaBlockSize ) {
+        arenaBlocks.emplace( arenaBlocks.begin( ), new char[ size ] );
+        char* value = arenaBlocks.front( ).get( );
+        memcpy( value, name, length );
+        value[ length ] = '\0';
+        return value;
+    }
+
+    if ( arenaOffset + size > kArenaBlockSize ) {
+        arenaBlocks.emplace_back( new char[ kArenaBlockSize ] );
+        arenaOffset = 0;
+    }
+
+    char* value = arenaBlocks.back( ).get( ) + arenaOffset;
+    memcpy( value, name, length );
+    value[ length ] = '\0';
+    arenaOffset += size;
+    return value;
+}
+
+void apemode::NameTable::Shard::Grow( ) {
+    std::vector< Entry > grownSlots( std::max< size_t >( kMinShardCapacity, slots.size( ) * 2 ) );
+    const size_t mask = grownSlots.size( ) - 1;
+
+    for ( Entry const& entry : slots ) {
+        if ( nullptr != entry.value ) {
+            size_t slot = size_t( entry.hash ) & mask;
+            while ( nullptr != grownSlots[ slot ].value ) {
+                slot = ( slot + 1 ) & mask;
+            }
+
+            grownSlots[ slot ] = entry;
+        }
+    }
+
+    slots.swap( grownSlots );
+}
+
+uint64_t apemode::NameTable::Push( const char* name, size_t length, const char** collision ) {
+    const uint64_t hash = CityHash64( name, length );
+
+    Shard& shard = shards[ hash >> ( 64 - kShardCountLog2 ) ];
+    std::lock_guard< std::mutex > guard( shard.lock );
+
+    /* Keep the load factor under 0.5. */
+    if ( ( shard.count + 1 ) * 2 > shard.slots.size( ) ) {
+        shard.Grow( );
+    }
+
+    const size_t mask = shard.slots.size( ) - 1;
+    size_t       slot = size_t( hash ) & mask;
+
+    for ( ;; ) {
+        Entry& entry = shard.slots[ slot ];
+
+        if ( nullptr == entry.value ) {
+            entry.hash   = hash;
+            entry.value  = shard.Store( name, length );
+            entry.length = (uint32_t) length;
+            ++shard.count;
+            return hash;
+        }
+
+        if ( entry.hash == hash ) {
+            if ( entry.length != length || 0 != memcmp( entry.value, name, length ) ) {
+                collisionCount.fetch_add( 1 );
+                if ( collision ) {
+                    *collision = entry.value;
+                }
+            }
+
+            return hash;
+        }
+
+        slot = ( slot + 1 ) & mask;
+    }
+}
+
+uint64_t apemode::NameTable::Push( std::string const& name, const char** collision ) {
+    return Push( name.data( ), name.size( ), collision );
+}
+
+void apemode::NameTable::GetSortedEntries( std::vector< Entry >& entries ) const {
+    entries.clear( );
+    entries.reserve( GetCount( ) );
+
+    for ( Shard const& shard : shards ) {
+        for ( Entry const& entry : shard.slots ) {
+            if ( nullptr != entry.value ) {
+                entries.push_back( entry );
+            }
+        }
+    }
+
+    std::sort( entries.begin( ), entries.end( ), []( Entry const& a, Entry const& b ) { return a.hash < b.hash; } );
+}
+
+size_t apemode::NameTable::GetCount( ) const {
+    size_t count = 0;
+    for ( Shard const& shard : shards ) {
+        count += shard.count;
+    }
+
+    return count;
+}
+
+size_t apemode::NameTable::GetTotalLength( ) const {
+    size_t length = 0;
+    for ( Shard const& shard : shards ) {
+        for ( Entry const& entry : shard.slots ) {
+            length += entry.length; /* Zero for empty slots */
+        }
+    }
+
+    return length;
+}
+
+uint32_t apemode::NameTable::GetCollisionCount( ) const {
+    return collisionCount.load( );
+}
+
+/**
+ * Interns the generated names with std::map (the previous implementation),
+ * and with the name table from a single thread and from the TBB worker threads.
+ * About a quarter of the names are duplicates, like the material property names in real scenes.
+ **/
+void BenchmarkNames( uint32_t nameCount ) {
+    auto& s = apemode::Get( );
+
+    using Clock = std::chrono::high_resolution_clock;
+    const auto elapsedMs = []( Clock::time_point start ) {
+        return std::chrono::duration< double, std::milli >( Clock::now( ) - start ).count( );
+    };
+
+    const uint32_t uniqueNameCount = std::max< uint32_t >( 1, nameCount - nameCount / 4 );
+
+    std::vector< std::string > generatedNames;
+    generatedNames.reserve( nameCount );
+    for ( uint32_t i = 0; i < nameCount; ++i ) {
+        generatedNames.push_back( "Node_" + std::to_string( i % uniqueNameCount ) + "_Material_" + std::to_string( ( i % uniqueNameCount ) % 97 ) );
+    }
+
+    s.console->info( "Interning {} names ({} unique)...", nameCount, uniqueNameCount );
+
+    {
+        auto start = Clock::now( );
+        std::map< uint64_t, std::string > names;
+        for ( auto const& name : generatedNames ) {
+            names.insert( std::make_pair( apemode::CityHash64( name.data( ), name.size( ) ), name ) );
+        }
+
+        s.console->info( "\tstd::map: {:.1f} ms ({} names).", elapsedMs( start ), names.size( ) );
+    }
+
+    {
+        auto start = Clock::now( );
+        apemode::NameTable names;
+        for ( auto const& name : generatedNames ) {
+            names.Push( name );
+        }
+
+        const double pushMs = elapsedMs( start );
+        std::vector< apemode::NameTable::Entry > entries;
+        names.GetSortedEntries( entries );
+
+        s.console->info( "\tNameTable, single thread: {:.1f} ms, sorting: {:.1f} ms ({} names, {} collisions).",
+                         pushMs,
+                         elapsedMs( start ) - pushMs,
+                         names.GetCount( ),
+                         names.GetCollisionCount( ) );
+    }
+
+    {
+        auto start = Clock::now( );
+        apemode::NameTable names;
+        tbb::parallel_for( size_t( 0 ), generatedNames.size( ), [&]( size_t i ) { names.Push( generatedNames[ i ] ); } );
+
+        const double pushMs = elapsedMs( start );
+        std::vector< apemode::NameTable::Entry > entries;
+        names.GetSortedEntries( entries );
+
+        s.console->info( "\tNameTable, TBB workers: {:.1f} ms, sorting: {:.1f} ms ({} names, {} collisions).",
+                         pushMs,
+                         elapsedMs( start ) - pushMs,
+                         names.GetCount( ),
+                         names.GetCollisionCount( ) );
+    }
+}
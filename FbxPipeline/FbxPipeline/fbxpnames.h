@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fbxppch.h>
+#include <atomic>
+#include <mutex>
+
+namespace apemode {
+
+    /**
+     * Thread-safe name interning table.
+     * The names are identified by their 64-bit CityHash values (the scene references names by hashes).
+     * The table is split into shards (selected by the high bits of the hash) with separate locks,
+     * each shard is an open addressing hash table (linear probing, indexed by the low bits of the hash)
+     * that keeps the strings in its own arena.
+     * Different strings with the same hash are detected and counted as collisions.
+     **/
+    class NameTable {
+    public:
+        struct Entry {
+            uint64_t    hash   = 0;
+            const char* value  = nullptr; /* Null-terminated, points into the arena of the shard, nullptr for empty slots */
+            uint32_t    length = 0;
+        };
+
+        NameTable( );
+
+        /**
+         * Interns the name and returns its hash.
+         * @param collision Receives the previously interned string if it has the same hash, but differs from the name.
+         **/
+        uint64_t Push( const char* name, size_t length, const char** collision = nullptr );
+        uint64_t Push( std::string const& name, const char** collision = nullptr );
+
+        /**
+         * Collects all the interned names sorted by their hashes.
+         * Not thread-safe, should be called once all the names are pushed.
+         **/
+        void GetSortedEntries( std::vector< Entry >& entries ) const;
+
+        size_t   GetCount( ) const;
+        size_t   GetTotalLength( ) const; /* All the interned names, without the null terminators (not sorted) */
+        uint32_t GetCollisionCount( ) const;
+
+    private:
+        static const uint32_t kShardCountLog2   = 6;
+        static const uint32_t kShardCount       = 1 << kShardCountLog2;
+        static const uint32_t kMinShardCapacity = 64;
+        static const size_t   kArenaBlockSize   = 64 * 1024;
+
+        struct Shard {
+            std::mutex                                lock;
+            std::vector< Entry >                      slots;
+            size_t                                    count       = 0;
+            size_t                                    arenaOffset = kArenaBlockSize;
+            std::vector< std::unique_ptr< char[] > > arenaBlocks;
+
+            const char* Store( const char* name, size_t length );
+            void        Grow( );
+        };
+
+        Shard                   shards[ kShardCount ];
+        std::atomic< uint32_t > collisionCount;
+    };
+
+} // namespace apemode
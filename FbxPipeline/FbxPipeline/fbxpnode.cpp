@@ -2,11 +2,16 @@
 #include <fbxpstate.h>
 #include <queue>
 
-void ExportMesh( FbxNode* node, apemode::Node& n, bool pack, bool optimize );
+void ExportMesh( FbxNode* node, apemode::Node& n );
+void ExportMeshes( bool pack, apemode::VertexPacking const& packing, apemode::EMeshOptimizer optimizer );
+apemode::EMeshOptimizer GetMeshOptimizer( std::string const& name );
 void ExportMaterials( FbxScene* scene );
 void ExportMaterials( FbxNode* node, apemode::Node& n );
 void ExportTransform( FbxNode* node, apemode::Node& n );
 void ExportAnimation( FbxNode* node, apemode::Node& n );
+void PreprocessAnimation( FbxScene* scene );
+void ReportAnimation( );
+void ResolveSkins( );
 
 void ExportNodeAttributes( FbxNode* node, apemode::Node& n ) {
     auto& s = apemode::Get( );
@@ -16,7 +21,7 @@ void ExportNodeAttributes( FbxNode* node, apemode::Node& n ) {
 
     ExportTransform( node, n );
     ExportAnimation( node, n );
-    ExportMesh( node, n, s.options[ "p" ].as< bool >( ), s.options[ "t" ].as< bool >( ) );
+    ExportMesh( node, n );
     ExportMaterials( node, n );
 }
 
@@ -29,6 +34,7 @@ uint32_t ExportNode( FbxNode* node ) {
     auto& n = s.nodes.back( );
     n.id = nodeId;
     n.nameId = s.PushName( node->GetName( ) );
+    s.nodeDict[ node ] = nodeId;
 
     ExportNodeAttributes( node, n );
     if ( auto c = node->GetChildCount( ) ) {
@@ -85,27 +91,97 @@ void PreprocessMeshes( FbxScene* scene ) {
     }
 }
 
-void PreprocessAnimation( FbxScene* scene ) {
-    auto& s = apemode::Get( );
-    FbxAnimCurveFilterConstantKeyReducer;
-    FbxAnimCurveFilterResample;
-
-}
-
 void ExportScene( FbxScene* scene ) {
     auto& s = apemode::Get( );
 
     PreprocessMeshes( scene );
     PreprocessAnimation( scene );
 
+    s.meshOptimizer = GetMeshOptimizer( s.options[ "t" ].as< std::string >( ) );
+
+    s.vertexPacking.positionBits    = s.options.count( "n" ) ? (uint32_t) s.options[ "n" ].as< int >( ) : 10;
+    s.vertexPacking.octahedral      = s.options[ "x" ].as< bool >( );
+    s.vertexPacking.halfTexcoords   = s.options[ "u" ].as< bool >( );
+    s.vertexPacking.maxPositionStep = s.options.count( "q" ) ? std::max( s.options[ "q" ].as< float >( ), 0.0f ) : 0.0f;
+    if ( 10 != s.vertexPacking.positionBits && 16 != s.vertexPacking.positionBits ) {
+        s.console->warn( "Invalid position bits {} (expected 10 or 16), using 10.", s.vertexPacking.positionBits );
+        s.vertexPacking.positionBits = 10;
+    }
+
     // Pre-allocate nodes and attributes.
     s.nodes.reserve( (size_t) scene->GetNodeCount( ) );
     s.meshes.reserve( (size_t) scene->GetNodeCount( ) );
+    s.meshSources.reserve( (size_t) scene->GetNodeCount( ) );
 
     // We want shared materials, so export all the scene material first
     // and reference them from the node scope by their indices.
     ExportMaterials( scene );
 
     // Export nodes recursively.
+    // Meshes are only extracted here, since the FBX SDK is not thread-safe.
     ExportNode( scene->GetRootNode( ) );
+    ReportAnimation( );
+
+    // The skin joints can be exported after the skinned meshes.
+    ResolveSkins( );
+
+    // In container mode the meshes are written to the output file as soon as they are processed.
+    if ( s.options[ "a" ].as< bool >( ) ) {
+        const std::string output = s.GetOutputFile( );
+        if ( false == s.container.Open( output ) ) {
+            s.console->error( "Failed to open container {} (meshes will be embedded).", output );
+        }
+    }
+
+    // Process the extracted meshes in parallel.
+    ExportMeshes( s.options[ "p" ].as< bool >( ), s.vertexPacking, s.meshOptimizer );
+
+    const auto percentage = []( uint64_t after, uint64_t before ) {
+        return before ? 100.0 * double( after ) / double( before ) : 100.0;
+    };
+
+    s.console->info( "Welding reduced vertices from {} to {} bytes ({:.1f}%), indices from {} to {} bytes ({:.1f}%).",
+                     s.vertexBytesBeforeWelding,
+                     s.vertexBytesAfterWelding,
+                     percentage( s.vertexBytesAfterWelding, s.vertexBytesBeforeWelding ),
+                     s.indexBytesBeforeWelding,
+                     s.indexBytesAfterWelding,
+                     percentage( s.indexBytesAfterWelding, s.indexBytesBeforeWelding ) );
+
+    auto& error = s.quantizationError;
+    if ( error.vertexCount ) {
+        s.console->info( "Packed {} vertices in {} chunks ({}-bit positions, {} normals and tangents, {} texcoords).",
+                         error.vertexCount,
+                         s.chunkCount,
+                         s.vertexPacking.positionBits,
+                         s.vertexPacking.octahedral ? "octahedral" : "unorm",
+                         s.vertexPacking.halfTexcoords ? "half" : "unorm" );
+        s.console->info( "Quantization error (max / rms): position {:.6f} / {:.6f}, normal {:.4f} / {:.4f} deg, "
+                         "tangent {:.4f} / {:.4f} deg, texcoords {:.6f} / {:.6f}.",
+                         error.maxError[ apemode::eVertexAttribute_Position ],
+                         error.GetRms( apemode::eVertexAttribute_Position ),
+                         error.maxError[ apemode::eVertexAttribute_Normal ],
+                         error.GetRms( apemode::eVertexAttribute_Normal ),
+                         error.maxError[ apemode::eVertexAttribute_Tangent ],
+                         error.GetRms( apemode::eVertexAttribute_Tangent ),
+                         error.maxError[ apemode::eVertexAttribute_Texcoords ],
+                         error.GetRms( apemode::eVertexAttribute_Texcoords ) );
+    }
+
+    if ( s.meshletCount ) {
+        s.console->info( "Built {} meshlets ({:.1f} triangles per meshlet), {} meshlets ({:.1f}%) have normal cones.",
+                         s.meshletCount,
+                         double( s.meshletTriangleCount ) / s.meshletCount,
+                         s.meshletConeCount,
+                         percentage( s.meshletConeCount, s.meshletCount ) );
+    }
+
+    if ( s.lodCount ) {
+        s.console->info( "Generated {} LODs for {} meshes, the coarsest LODs have {} of {} triangles ({:.1f}%).",
+                         s.lodCount,
+                         s.lodMeshCount,
+                         s.lodTriangleCount,
+                         s.lodBaseTriangleCount,
+                         percentage( s.lodTriangleCount, s.lodBaseTriangleCount ) );
+    }
 }
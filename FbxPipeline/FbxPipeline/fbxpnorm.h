@@ -276,16 +276,22 @@ namespace apemode {
             f.q.s = h.q.s;
 
             if ( h.q.e == 0 ) {
-                uint32_t Mantissa = h.q.m;
-                if ( Mantissa == 0 ) {
+                uint32_t mantissa = h.q.m;
+                if ( mantissa == 0 ) {
                     // Zero.
-                    f.q.Exponent = 0;
-                    f.q.Mantissa = 0;
+                    f.q.e = 0;
+                    f.q.m = 0;
                 } else {
-                    // Denormal.
-                    uint32_t MantissaShift = 10 - (uint32) FMath::TruncToInt( FMath::Log2( Mantissa ) );
-                    f.q.e = 127 - ( 15 - 1 ) - MantissaShift;
-                    f.q.m = Mantissa << ( MantissaShift + 23 - 10 );
+                    // Denormal, normalized for the float.
+                    // Shifted until the implicit bit is set (1-15+127 for the smallest normal exponent).
+                    int32_t exponent = 1 - 15 + 127;
+                    while ( 0 == ( mantissa & 0x400 ) ) {
+                        mantissa <<= 1;
+                        --exponent;
+                    }
+
+                    f.q.e = uint32_t( exponent );
+                    f.q.m = ( mantissa & 0x3ff ) << 13;
                 }
             } else if ( h.q.e == 31 ) {
                 // Infinity or NaN. Set to 65504.0
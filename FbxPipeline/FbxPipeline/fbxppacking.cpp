@@ -40,173 +40,309 @@ struct PackedVertex {
     uint32_t texcoords;
 };
 
-union UIntPack_16_16 {
-    uint32_t u;
-    struct {
-        uint32_t x : 16;
-        uint32_t y : 16;
-    } q;
-};
-
-union UIntPack_10_10_10_2 {
-    uint32_t u;
-    struct {
-        uint32_t x : 10;
-        uint32_t y : 10;
-        uint32_t z : 10;
-        uint32_t w : 2;
-    } q;
-};
-
-union UIntPack_8_8_8_8 {
-    uint32_t u;
-    struct {
-        uint32_t x : 8;
-        uint32_t y : 8;
-        uint32_t z : 8;
-        uint32_t w : 8;
-    } q;
-};
-
 static_assert( sizeof( Half< true > ) == sizeof( uint16_t ), "Must match" );
 static_assert( sizeof( Half< false > ) == sizeof( uint16_t ), "Must match" );
-static_assert( sizeof( UIntPack_8_8_8_8 ) == sizeof( uint32_t ), "Must match" );
-static_assert( sizeof( UIntPack_10_10_10_2 ) == sizeof( uint32_t ), "Must match" );
-static_assert( sizeof( UIntPack_16_16 ) == sizeof( uint32_t ), "Must match" );
-
-uint32_t PackPosition_10_10_10_2( const mathfu::vec3 position,
-                                  const mathfu::vec3 positionMin,
-                                  const mathfu::vec3 positionMax ) {
-    const mathfu::vec3 positionSize  = positionMax - positionMin;
-    const mathfu::vec3 positionScale = ( position - positionMin ) / positionSize;
-    AssertInRange( positionScale );
 
-    UIntPack_10_10_10_2 packed;
-    packed.q.w = 0;
+namespace {
+    const double kRadiansToDegrees = 180.0 / 3.14159265358979323846;
 
-    /*
-
-    Matches GL_UNSIGNED_INT_2_10_10_10_REV format + GL_RGBA token (OpenGL):
-    10-bit R component in bits   0..9
-    10-bit G component in bits 10..19
-    10-bit B component in bits 20..29
-    2-bit  A component in bits 30..31
+    inline uint32_t GetMask( const uint32_t bitCount ) {
+        return bitCount >= 32 ? ~0u : ( 1u << bitCount ) - 1;
+    }
 
-    https://stackoverflow.com/questions/17726676/what-does-rev-suffix-mean-in-opengl
+    inline float Clamp( const float value, const float minValue, const float maxValue ) {
+        return std::min( std::max( value, minValue ), maxValue );
+    }
 
-    */
+    inline float SignNotZero( const float value ) {
+        return value < 0.0f ? -1.0f : 1.0f;
+    }
 
-    packed.q.x = Unorm< 10 >( positionScale.x ).Bits( );
-    packed.q.y = Unorm< 10 >( positionScale.y ).Bits( );
-    packed.q.z = Unorm< 10 >( positionScale.z ).Bits( );
+    /**
+     * The octahedral vectors are stored as 2 components, the other attributes store all their components.
+     **/
+    inline uint32_t GetStoredComponentCount( VertexAttributeFb const& attribute ) {
+        return attribute.encoding( ) == EVertexAttributeEncodingFb_Octahedral ? 2 : attribute.component_count( );
+    }
 
-    /*
+    /**
+     * The components do not cross the 32-bit words, the last component of the 10-bit attributes is 2-bit wide (10_10_10_2).
+     **/
+    inline uint32_t GetComponentBitCount( VertexAttributeFb const& attribute, const uint32_t component ) {
+        return std::min< uint32_t >( attribute.bit_width( ), 32 - component * attribute.bit_width( ) % 32 );
+    }
 
-    Matches VK_FORMAT_A2R10G10B10_UNORM_PACK32 format (Vulkan):
-    10-bit B component in bits   0..9
-    10-bit G component in bits 10..19
-    10-bit R component in bits 20..29
-    2-bit  A component in bits 30..31
+    /**
+     * The size in bytes (whole 32-bit words).
+     **/
+    inline uint32_t GetAttributeSize( VertexAttributeFb const& attribute ) {
+        const uint32_t lastComponent = GetStoredComponentCount( attribute ) - 1;
+        const uint32_t bitCount      = lastComponent * attribute.bit_width( ) + GetComponentBitCount( attribute, lastComponent );
+        return ( bitCount + 31 ) / 32 * 4;
+    }
 
-    https://www.khronos.org/registry/vulkan/specs/1.0/man/html/VkFormat.html
+    void WriteComponent( uint8_t* vertex, VertexAttributeFb const& attribute, const uint32_t component, const uint32_t bits ) {
+        const uint32_t bitOffset = component * attribute.bit_width( );
+        uint32_t*      word      = reinterpret_cast< uint32_t* >( vertex + attribute.offset( ) ) + bitOffset / 32;
+        *word |= ( bits & GetMask( GetComponentBitCount( attribute, component ) ) ) << ( bitOffset % 32 );
+    }
 
-    packed.q.z = Unorm< 10 >( positionScale.x ).Bits( );
-    packed.q.y = Unorm< 10 >( positionScale.y ).Bits( );
-    packed.q.x = Unorm< 10 >( positionScale.z ).Bits( );
+    uint32_t ReadComponent( const uint8_t* vertex, VertexAttributeFb const& attribute, const uint32_t component ) {
+        const uint32_t  bitOffset = component * attribute.bit_width( );
+        const uint32_t* word      = reinterpret_cast< const uint32_t* >( vertex + attribute.offset( ) ) + bitOffset / 32;
+        return ( *word >> ( bitOffset % 32 ) ) & GetMask( GetComponentBitCount( attribute, component ) );
+    }
 
-    */
+    uint32_t EncodeUnorm( const float value, const uint32_t bitCount ) {
+        return (uint32_t) std::round( Clamp( value, 0.0f, 1.0f ) * float( GetMask( bitCount ) ) );
+    }
 
-    return packed.u;
-}
+    float DecodeUnorm( const uint32_t bits, const uint32_t bitCount ) {
+        return float( bits ) / float( GetMask( bitCount ) );
+    }
 
-uint32_t PackTexcoord_16_16_fixed( const mathfu::vec2 texcoord,
-                                   const mathfu::vec2 texcoordMin,
-                                   const mathfu::vec2 texcoordMax ) {
-    const mathfu::vec2 texcoordSize  = texcoordMax - texcoordMin;
-    const mathfu::vec2 texcoordScale = ( texcoord - texcoordMin ) / texcoordSize;
-    AssertInRange( texcoordScale );
+    /* Two's complement, matches VK_FORMAT_*_SNORM. */
+    uint32_t EncodeSnorm( const int32_t value, const uint32_t bitCount ) {
+        return uint32_t( value ) & GetMask( bitCount );
+    }
 
-    UIntPack_16_16 packed;
-    packed.q.x = Unorm< 16 >( texcoordScale.x ).Bits( );
-    packed.q.y = Unorm< 16 >( texcoordScale.y ).Bits( );
+    float DecodeSnorm( const uint32_t bits, const uint32_t bitCount ) {
+        const int32_t value = int32_t( bits << ( 32 - bitCount ) ) >> ( 32 - bitCount );
+        return std::max( float( value ) / float( GetMask( bitCount - 1 ) ), -1.0f );
+    }
 
-    return packed.u;
-}
+    /**
+     * Octahedral mapping of the unit vector to [-1, 1]^2, the lower hemisphere is folded over the diagonals.
+     **/
+    mathfu::vec2 EncodeOctahedral( mathfu::vec3 n ) {
+        n /= std::abs( n.x ) + std::abs( n.y ) + std::abs( n.z );
+        if ( n.z >= 0.0f )
+            return mathfu::vec2( n.x, n.y );
 
-uint32_t PackTexcoord_16_16_half( const mathfu::vec2 texcoord,
-                                  const mathfu::vec2 texcoordMin,
-                                  const mathfu::vec2 texcoordMax ) {
-    const bool sOverflowCheck = FBXP_DEBUG;
+        return mathfu::vec2( ( 1.0f - std::abs( n.y ) ) * SignNotZero( n.x ), ( 1.0f - std::abs( n.x ) ) * SignNotZero( n.y ) );
+    }
 
-    UIntPack_16_16 packed;
-    packed.q.x = Half< sOverflowCheck >( texcoord.x ).Bits( );
-    packed.q.y = Half< sOverflowCheck >( texcoord.y ).Bits( );
+    mathfu::vec3 DecodeOctahedral( const mathfu::vec2 e ) {
+        mathfu::vec3 n( e.x, e.y, 1.0f - std::abs( e.x ) - std::abs( e.y ) );
+        if ( n.z < 0.0f ) {
+            n.x = ( 1.0f - std::abs( e.y ) ) * SignNotZero( e.x );
+            n.y = ( 1.0f - std::abs( e.x ) ) * SignNotZero( e.y );
+        }
 
-    return packed.u;
-}
+        return n.Normalized( );
+    }
 
-uint32_t PackNormal_10_10_10_2( const mathfu::vec3 normal ) {
-    AssertInRange( normal.Length( ) );
+    /**
+     * Quantizes the octahedral coordinates of the unit vector. The rounding direction of each component is chosen
+     * to minimize the angle to the vector (the nearest coordinates are not always the closest directions).
+     * If the tangent sign is stored (0 or 1), it takes the least significant bit of the second component.
+     **/
+    void EncodeOctahedral( const mathfu::vec3 n, const uint32_t bitCount, const int32_t signBit, int32_t ( &quantized )[ 2 ] ) {
+        const int32_t      maxValue = (int32_t) GetMask( bitCount - 1 );
+        const mathfu::vec2 e        = EncodeOctahedral( n ) * float( maxValue );
+        const int32_t      x0       = (int32_t) std::floor( e.x );
+        const int32_t      y0       = (int32_t) std::floor( e.y );
+
+        float bestDot = -2.0f;
+        for ( int32_t x = x0; x <= x0 + 1; ++x ) {
+            for ( int32_t y = y0 - 1; y <= y0 + 2; ++y ) {
+                const bool bOutOfRange = x < -maxValue || x > maxValue || y < -maxValue || y > maxValue;
+                const bool bSkipped    = signBit < 0 ? ( y < y0 || y > y0 + 1 ) : ( y & 1 ) != signBit;
+                if ( bOutOfRange || bSkipped )
+                    continue;
+
+                const float dot = mathfu::vec3::DotProduct( DecodeOctahedral( mathfu::vec2( float( x ), float( y ) ) / float( maxValue ) ), n );
+                if ( dot > bestDot ) {
+                    bestDot        = dot;
+                    quantized[ 0 ] = x;
+                    quantized[ 1 ] = y;
+                }
+            }
+        }
+    }
 
-    const mathfu::vec3 n = normal * 0.5f + 0.5f;
-    AssertInRange( n );
+    /**
+     * Packs the vector according to the attribute encoding and returns the dequantized vector.
+     * The unorm values are mapped from [minValue, minValue + range] (the components with zero ranges are zeros).
+     * The octahedral attributes are the unit vectors, w is the tangent sign (if the component count is 4).
+     **/
+    mathfu::vec4 PackAttribute( uint8_t*                 vertex,
+                                VertexAttributeFb const& attribute,
+                                const mathfu::vec4       value,
+                                const mathfu::vec4       minValue,
+                                const mathfu::vec4       range ) {
+        const uint32_t bitWidth = attribute.bit_width( );
+        mathfu::vec4   decoded( 0.0f, 0.0f, 0.0f, 0.0f );
+
+        if ( attribute.encoding( ) == EVertexAttributeEncodingFb_Octahedral ) {
+            const bool    bSigned = attribute.component_count( ) == 4;
+            const int32_t signBit = bSigned ? int32_t( value.w < 0.0f ) : -1;
+
+            int32_t quantized[ 2 ] = {0, 0};
+            EncodeOctahedral( mathfu::vec3( value.x, value.y, value.z ).Normalized( ), bitWidth, signBit, quantized );
+            WriteComponent( vertex, attribute, 0, EncodeSnorm( quantized[ 0 ], bitWidth ) );
+            WriteComponent( vertex, attribute, 1, EncodeSnorm( quantized[ 1 ], bitWidth ) );
+
+            const uint32_t bits[ 2 ] = {ReadComponent( vertex, attribute, 0 ), ReadComponent( vertex, attribute, 1 )};
+            const auto     n = DecodeOctahedral( mathfu::vec2( DecodeSnorm( bits[ 0 ], bitWidth ), DecodeSnorm( bits[ 1 ], bitWidth ) ) );
+            return mathfu::vec4( n, bSigned ? ( bits[ 1 ] & 1 ? -1.0f : 1.0f ) : 0.0f );
+        }
+
+        for ( uint32_t c = 0; c < attribute.component_count( ); ++c ) {
+            const uint32_t bitCount = GetComponentBitCount( attribute, c );
+
+            switch ( attribute.encoding( ) ) {
+                case EVertexAttributeEncodingFb_Float: {
+                    uint32_t bits;
+                    memcpy( &bits, &value[ c ], sizeof( bits ) );
+                    WriteComponent( vertex, attribute, c, bits );
+                    decoded[ c ] = value[ c ];
+                } break;
+
+                case EVertexAttributeEncodingFb_Unorm: {
+                    const float normalized = range[ c ] > 0.0f ? ( value[ c ] - minValue[ c ] ) / range[ c ] : 0.0f;
+                    WriteComponent( vertex, attribute, c, EncodeUnorm( normalized, bitCount ) );
+                    decoded[ c ] = minValue[ c ] + DecodeUnorm( ReadComponent( vertex, attribute, c ), bitCount ) * range[ c ];
+                } break;
+
+                case EVertexAttributeEncodingFb_Snorm: {
+                    const int32_t maxValue = (int32_t) GetMask( bitCount - 1 );
+                    WriteComponent( vertex, attribute, c, EncodeSnorm( (int32_t) std::round( Clamp( value[ c ], -1.0f, 1.0f ) * maxValue ), bitCount ) );
+                    decoded[ c ] = DecodeSnorm( ReadComponent( vertex, attribute, c ), bitCount );
+                } break;
+
+                case EVertexAttributeEncodingFb_UInt: {
+                    WriteComponent( vertex, attribute, c, (uint32_t) value[ c ] );
+                    decoded[ c ] = float( ReadComponent( vertex, attribute, c ) );
+                } break;
+
+                case EVertexAttributeEncodingFb_Half: {
+                    const bool sOverflowCheck = FBXP_DEBUG;
+                    WriteComponent( vertex, attribute, c, Half< sOverflowCheck >( value[ c ] ).Bits( ) );
+                    decoded[ c ] = float( Half< false >::FromBits( (uint16_t) ReadComponent( vertex, attribute, c ) ) );
+                } break;
+
+                default:
+                    break;
+            }
+        }
+
+        return decoded;
+    }
 
-    UIntPack_10_10_10_2 packed;
-    packed.q.x = Unorm< 10 >( n.x ).Bits( );
-    packed.q.y = Unorm< 10 >( n.y ).Bits( );
-    packed.q.z = Unorm< 10 >( n.z ).Bits( );
-    packed.q.w = 0;
+    /**
+     * The angle between the directions in degrees (zero if any of them is degenerate).
+     **/
+    double GetAngle( const mathfu::vec3 a, const mathfu::vec3 b ) {
+        const float lengths = a.Length( ) * b.Length( );
+        if ( false == ( lengths > 0.0f ) )
+            return 0.0;
 
-    return packed.u;
-}
+        return std::acos( Clamp( mathfu::vec3::DotProduct( a, b ) / lengths, -1.0f, 1.0f ) ) * kRadiansToDegrees;
+    }
 
-uint32_t PackTangent_10_10_10_2( const mathfu::vec4 tangent ) {
-    AssertInRange( tangent.w, -1.f, +1.f );
-    UIntPack_10_10_10_2 packed;
-    packed.u = PackNormal_10_10_10_2( mathfu::vec3( tangent.x, tangent.y, tangent.z ).Normalized( ) );
-    packed.q.w = Unorm< 2 >( tangent.w * 0.5f + 0.5f ).Bits( );
-    return packed.u;
+    VertexAttributeFb MakeAttribute( EVertexAttributeEncodingFb encoding, uint32_t componentCount, uint32_t bitWidth, uint32_t& offset ) {
+        const VertexAttributeFb attribute( encoding, (uint8_t) componentCount, (uint8_t) bitWidth, (uint8_t) offset );
+        offset += GetAttributeSize( attribute );
+        return attribute;
+    }
 }
 
-uint32_t PackNormal_8_8_8_8( const mathfu::vec3 normal ) {
-    AssertInRange( normal.Length( ) );
-
-    const mathfu::vec3 n = normal * 0.5f + 0.5f;
-    AssertInRange( n );
+/**
+ * Layout of StaticVertexFb.
+ **/
+VertexLayoutFb GetStaticVertexLayout( ) {
+    uint32_t offset = 0;
 
-    UIntPack_8_8_8_8 packedPosition;
-    packedPosition.q.x = Unorm< 8 >( n.x ).Bits( );
-    packedPosition.q.y = Unorm< 8 >( n.y ).Bits( );
-    packedPosition.q.z = Unorm< 8 >( n.z ).Bits( );
-    packedPosition.q.w = 0;
+    const auto position = MakeAttribute( EVertexAttributeEncodingFb_Float, 3, 32, offset );
+    const auto normal   = MakeAttribute( EVertexAttributeEncodingFb_Float, 3, 32, offset );
+    const auto tangent  = MakeAttribute( EVertexAttributeEncodingFb_Float, 4, 32, offset );
+    const auto uv       = MakeAttribute( EVertexAttributeEncodingFb_Float, 2, 32, offset );
+    assert( offset == sizeof( StaticVertexFb ) );
 
-    return packedPosition.u;
+    return VertexLayoutFb( position, normal, tangent, uv, VertexAttributeFb( ), VertexAttributeFb( ) );
 }
 
-uint32_t PackTangent_8_8_8_8( const mathfu::vec4 tangent ) {
-    AssertInRange( tangent.w, -1.f, +1.f );
-    UIntPack_8_8_8_8 packed;
-    packed.u = PackNormal_8_8_8_8( mathfu::vec3( tangent.x, tangent.y, tangent.z ).Normalized( ) );
-    packed.q.w = Unorm< 8 >( tangent.w * 0.5f + 0.5f ).Bits( );
-    return packed.u;
+/**
+ * Layout of the packed vertices: 10_10_10_2 or 16_16_16_16 unorm positions (in the mesh bounds),
+ * 10_10_10_2 unorm or 16_16 octahedral normals and tangents, 16_16 unorm or half texcoords,
+ * and the 8_8_8_8 joint indices and weights of the skinned vertices.
+ * With the default packing it matches PackedVertexFb and SkinnedVertexFb.
+ **/
+VertexLayoutFb GetPackedVertexLayout( VertexPacking const& packing, const bool skinned, uint16_t& vertexStride ) {
+    const auto directionEncoding = packing.octahedral ? EVertexAttributeEncodingFb_Octahedral : EVertexAttributeEncodingFb_Unorm;
+    const auto directionBitWidth = packing.octahedral ? 16 : 10;
+    const auto uvEncoding        = packing.halfTexcoords ? EVertexAttributeEncodingFb_Half : EVertexAttributeEncodingFb_Unorm;
+
+    uint32_t offset = 0;
+
+    const auto position     = MakeAttribute( EVertexAttributeEncodingFb_Unorm, 3, packing.positionBits, offset );
+    const auto normal       = MakeAttribute( directionEncoding, 3, directionBitWidth, offset );
+    const auto tangent      = MakeAttribute( directionEncoding, 4, directionBitWidth, offset );
+    const auto uv           = MakeAttribute( uvEncoding, 2, 16, offset );
+    const auto jointIndices = skinned ? MakeAttribute( EVertexAttributeEncodingFb_UInt, 4, 8, offset ) : VertexAttributeFb( );
+    const auto jointWeights = skinned ? MakeAttribute( EVertexAttributeEncodingFb_Unorm, 4, 8, offset ) : VertexAttributeFb( );
+
+    vertexStride = (uint16_t) offset;
+    return VertexLayoutFb( position, normal, tangent, uv, jointIndices, jointWeights );
 }
 
+/**
+ * Packs the vertices according to the layout (see GetPackedVertexLayout), the joint influences are already quantized.
+ * The positions are mapped from the mesh bounds, the unorm texcoords are mapped from the mesh texcoord range.
+ * The differences between the dequantized and the source attributes are added to the error.
+ **/
 void Pack( const StaticVertexFb* vertices,
-           PackedVertexFb*       packed,
+           const SkinInfluence*  influences,
+           uint8_t*              packed,
            const uint32_t        vertexCount,
+           VertexLayoutFb const& layout,
+           const uint32_t        vertexStride,
            const mathfu::vec3    positionMin,
            const mathfu::vec3    positionMax,
            const mathfu::vec2    texcoordsMin,
-           const mathfu::vec2    texcoordsMax ) {
-    for ( uint32_t i = 0; i < vertexCount; ++i ) {
-        const auto position  = Cast< mathfu::vec3 >( vertices[ i ].position( ) );
-        const auto texcoords = Cast< mathfu::vec2 >( vertices[ i ].uv( ) );
-        const auto normal    = Cast< mathfu::vec3 >( vertices[ i ].normal( ) );
-        const auto tangent   = Cast< mathfu::vec4 >( vertices[ i ].tangent( ) );
+           const mathfu::vec2    texcoordsMax,
+           QuantizationError&    error ) {
+    const mathfu::vec4 positionOffset( positionMin, 0.0f );
+    const mathfu::vec4 positionRange( positionMax - positionMin, 0.0f );
+    const mathfu::vec4 texcoordOffset( texcoordsMin.x, texcoordsMin.y, 0.0f, 0.0f );
+    const mathfu::vec4 texcoordRange( texcoordsMax.x - texcoordsMin.x, texcoordsMax.y - texcoordsMin.y, 0.0f, 0.0f );
+    const mathfu::vec4 directionOffset( -1.0f, -1.0f, -1.0f, -1.0f );
+    const mathfu::vec4 directionRange( 2.0f, 2.0f, 2.0f, 2.0f );
+    const mathfu::vec4 weightRange( 255.0f, 255.0f, 255.0f, 255.0f );
+    const mathfu::vec4 zero( 0.0f, 0.0f, 0.0f, 0.0f );
+
+    memset( packed, 0, size_t( vertexCount ) * vertexStride );
 
-        packed[ i ] = PackedVertexFb( PackPosition_10_10_10_2( position, positionMin, positionMax ),
-                                      PackNormal_10_10_10_2( normal.Normalized( ) ),
-                                      PackTangent_10_10_10_2( tangent ),
-                                      PackTexcoord_16_16_fixed( texcoords, texcoordsMin, texcoordsMax ) );
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        const auto position      = Cast< mathfu::vec3 >( vertices[ i ].position( ) );
+        const auto texcoords     = Cast< mathfu::vec2 >( vertices[ i ].uv( ) );
+        const auto normal        = Cast< mathfu::vec3 >( vertices[ i ].normal( ) ).Normalized( );
+        const auto sourceTangent = Cast< mathfu::vec4 >( vertices[ i ].tangent( ) );
+        const auto tangent       = mathfu::vec4( sourceTangent.xyz( ).Normalized( ), sourceTangent.w );
+
+        uint8_t* vertex = packed + size_t( i ) * vertexStride;
+
+        const auto p = PackAttribute( vertex, layout.position( ), mathfu::vec4( position, 1.0f ), positionOffset, positionRange );
+        const auto n = PackAttribute( vertex, layout.normal( ), mathfu::vec4( normal, 0.0f ), directionOffset, directionRange );
+        const auto t = PackAttribute( vertex, layout.tangent( ), tangent, directionOffset, directionRange );
+        const auto u = PackAttribute( vertex, layout.uv( ), mathfu::vec4( texcoords.x, texcoords.y, 0.0f, 0.0f ), texcoordOffset, texcoordRange );
+
+        if ( nullptr != influences ) {
+            const auto& influence = influences[ i ];
+            const mathfu::vec4 jointIndices( influence.jointIndices[ 0 ], influence.jointIndices[ 1 ], influence.jointIndices[ 2 ], influence.jointIndices[ 3 ] );
+            const mathfu::vec4 jointWeights( influence.jointWeights[ 0 ], influence.jointWeights[ 1 ], influence.jointWeights[ 2 ], influence.jointWeights[ 3 ] );
+
+            /* Already quantized, the weights are packed as they are. */
+            PackAttribute( vertex, layout.joint_indices( ), jointIndices, zero, zero );
+            PackAttribute( vertex, layout.joint_weights( ), jointWeights, zero, weightRange );
+        }
+
+        error.Add( eVertexAttribute_Position, ( p.xyz( ) - position ).Length( ) );
+        error.Add( eVertexAttribute_Normal, GetAngle( n.xyz( ), normal ) );
+        error.Add( eVertexAttribute_Tangent, GetAngle( t.xyz( ), tangent.xyz( ) ) );
+        error.Add( eVertexAttribute_Texcoords, ( mathfu::vec2( u.x, u.y ) - texcoords ).Length( ) );
     }
-}
\ No newline at end of file
+
+    error.vertexCount += vertexCount;
+}
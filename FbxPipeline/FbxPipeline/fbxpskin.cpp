@@ -0,0 +1,208 @@
+#include <fbxppch.h>
+#include <fbxpstate.h>
+
+namespace {
+    const uint32_t kMaxJointCount     = 256; /* 8-bit joint indices */
+    const uint32_t kMaxInfluenceCount = 4;
+
+    /**
+     * The strongest influences of the control point, sorted by weight (descending).
+     **/
+    struct InfluenceCandidates {
+        float    weights[ kMaxInfluenceCount ]      = {0.0f, 0.0f, 0.0f, 0.0f};
+        uint32_t jointIndices[ kMaxInfluenceCount ] = {0, 0, 0, 0};
+        uint32_t influenceCount                     = 0; /* All the influences, including the dropped ones */
+
+        void Add( uint32_t jointIndex, float weight ) {
+            ++influenceCount;
+            if ( weight <= weights[ kMaxInfluenceCount - 1 ] )
+                return;
+
+            uint32_t i = kMaxInfluenceCount - 1;
+            for ( ; i > 0 && weights[ i - 1 ] < weight; --i ) {
+                weights[ i ]      = weights[ i - 1 ];
+                jointIndices[ i ] = jointIndices[ i - 1 ];
+            }
+
+            weights[ i ]      = weight;
+            jointIndices[ i ] = jointIndex;
+        }
+    };
+
+    /**
+     * Normalizes the weights and quantizes them to 8 bits, the rounding error goes to the strongest influence,
+     * so that the weights always sum up to 255.
+     **/
+    apemode::SkinInfluence Quantize( InfluenceCandidates const& candidates ) {
+        apemode::SkinInfluence influence = {};
+
+        float weightSum = 0.0f;
+        for ( auto weight : candidates.weights )
+            weightSum += weight;
+
+        if ( weightSum <= 0.0f ) {
+            /* Not influenced by any joint, attached to the first one. */
+            influence.jointWeights[ 0 ] = 255;
+            return influence;
+        }
+
+        uint32_t quantizedSum = 0;
+        for ( uint32_t i = 0; i < kMaxInfluenceCount; ++i ) {
+            influence.jointIndices[ i ] = (uint8_t) candidates.jointIndices[ i ];
+            influence.jointWeights[ i ] = (uint8_t) std::round( candidates.weights[ i ] / weightSum * 255.0f );
+            quantizedSum += influence.jointWeights[ i ];
+        }
+
+        influence.jointWeights[ 0 ] = (uint8_t) ( int( influence.jointWeights[ 0 ] ) + 255 - int( quantizedSum ) );
+        return influence;
+    }
+
+    /**
+     * FbxAMatrix rows are the basis vectors (row-vector convention), they are the columns of mat4.
+     **/
+    apemodefb::mat4 Cast( FbxAMatrix const& m ) {
+        const auto column = [&]( int i ) {
+            return apemodefb::vec4( (float) m.Get( i, 0 ), (float) m.Get( i, 1 ), (float) m.Get( i, 2 ), (float) m.Get( i, 3 ) );
+        };
+
+        return apemodefb::mat4( column( 0 ), column( 1 ), column( 2 ), column( 3 ) );
+    }
+
+    FbxAMatrix GetGeometricMatrix( const FbxNode* node ) {
+        return FbxAMatrix( node->GetGeometricTranslation( FbxNode::eSourcePivot ),
+                           node->GetGeometricRotation( FbxNode::eSourcePivot ),
+                           node->GetGeometricScaling( FbxNode::eSourcePivot ) );
+    }
+}
+
+/**
+ * Extracts the joints, the inverse bind matrices and the control point influences of the mesh skin.
+ * Only the first FbxSkin deformer is exported (linear blending), the other deformers are ignored.
+ * The influences are limited to the 4 strongest ones, the skins are limited to 256 joints.
+ * Called on the main thread, the skin is added to the state and referenced by the mesh source.
+ **/
+void ExtractSkin( FbxMesh* mesh, apemode::MeshSource& src ) {
+    auto& s = apemode::Get( );
+
+    FbxSkin*  skin          = nullptr;
+    const int deformerCount = mesh->GetDeformerCount( );
+    for ( int i = 0; i < deformerCount; ++i ) {
+        auto deformer = mesh->GetDeformer( i );
+        if ( nullptr == skin && FbxDeformer::eSkin == deformer->GetDeformerType( ) ) {
+            skin = static_cast< FbxSkin* >( deformer );
+        } else {
+            s.console->warn( "Mesh \"{}\" has deformer \"{}\" (ignored).", src.name, deformer->GetName( ) );
+        }
+    }
+
+    if ( nullptr == skin )
+        return;
+
+    if ( FbxSkin::eLinear != skin->GetSkinningType( ) && FbxSkin::eRigid != skin->GetSkinningType( ) ) {
+        s.console->warn( "Mesh \"{}\" has unsupported skinning type {} (exported as linear).", src.name, skin->GetSkinningType( ) );
+    }
+
+    src.skinId = (uint32_t) s.skins.size( );
+    s.skins.emplace_back( );
+
+    auto& sk  = s.skins.back( );
+    sk.id     = src.skinId;
+    sk.nameId = s.PushName( skin->GetName( ) );
+
+    const FbxAMatrix geometricMatrix = GetGeometricMatrix( mesh->GetNode( ) );
+    const uint32_t   cc              = (uint32_t) mesh->GetControlPointsCount( );
+    const int        clusterCount    = skin->GetClusterCount( );
+
+    std::vector< InfluenceCandidates > candidates( cc );
+
+    uint32_t droppedClusterCount = 0;
+    for ( int i = 0; i < clusterCount; ++i ) {
+        auto cluster = skin->GetCluster( i );
+        auto link    = cluster->GetLink( );
+        if ( nullptr == link || 0 == cluster->GetControlPointIndicesCount( ) )
+            continue;
+
+        if ( sk.jointNodes.size( ) == kMaxJointCount ) {
+            ++droppedClusterCount;
+            continue;
+        }
+
+        if ( FbxCluster::eNormalize != cluster->GetLinkMode( ) ) {
+            s.console->warn( "Cluster \"{}\" has unsupported link mode {} (exported as normalized).", link->GetName( ), cluster->GetLinkMode( ) );
+        }
+
+        const uint32_t jointIndex = (uint32_t) sk.jointNodes.size( );
+
+        FbxAMatrix meshBindMatrix;
+        FbxAMatrix linkBindMatrix;
+        cluster->GetTransformMatrix( meshBindMatrix );
+        cluster->GetTransformLinkMatrix( linkBindMatrix );
+
+        /* Maps the vertices as they are exported (without the geometric transform) into the joint space. */
+        sk.jointNodes.push_back( link );
+        sk.inverseBindMatrices.push_back( Cast( linkBindMatrix.Inverse( ) * meshBindMatrix * geometricMatrix ) );
+
+        const int     indexCount = cluster->GetControlPointIndicesCount( );
+        const int*    indices    = cluster->GetControlPointIndices( );
+        const double* weights    = cluster->GetControlPointWeights( );
+        for ( int j = 0; j < indexCount; ++j ) {
+            if ( indices[ j ] >= 0 && (uint32_t) indices[ j ] < cc && weights[ j ] > 0.0 ) {
+                candidates[ indices[ j ] ].Add( jointIndex, (float) weights[ j ] );
+            }
+        }
+    }
+
+    if ( droppedClusterCount ) {
+        s.console->warn( "Mesh \"{}\" skin has more than {} joints, {} clusters were dropped.", src.name, kMaxJointCount, droppedClusterCount );
+    }
+
+    uint32_t limitedCount = 0;
+    src.controlPointInfluences.resize( cc );
+    for ( uint32_t ci = 0; ci < cc; ++ci ) {
+        limitedCount += candidates[ ci ].influenceCount > kMaxInfluenceCount;
+        src.controlPointInfluences[ ci ] = Quantize( candidates[ ci ] );
+    }
+
+    s.console->info( "Mesh \"{}\" has skin \"{}\": {} joints, {} control points have more than {} influences (dropped).",
+                     src.name,
+                     skin->GetName( ),
+                     sk.jointNodes.size( ),
+                     limitedCount,
+                     kMaxInfluenceCount );
+}
+
+/**
+ * Maps the joints to the exported nodes, and finds the parent joints (the nearest ancestor nodes that are the skin joints).
+ * Called once all the nodes are exported.
+ **/
+void ResolveSkins( ) {
+    auto& s = apemode::Get( );
+
+    for ( auto& sk : s.skins ) {
+        const uint32_t jointCount = (uint32_t) sk.jointNodes.size( );
+        sk.jointNodeIds.assign( jointCount, (uint32_t) -1 );
+        sk.jointParentIndices.assign( jointCount, (uint32_t) -1 );
+
+        std::map< const FbxNode*, uint32_t > jointDict;
+        for ( uint32_t j = 0; j < jointCount; ++j ) {
+            jointDict[ sk.jointNodes[ j ] ] = j;
+
+            auto nodeIt = s.nodeDict.find( sk.jointNodes[ j ] );
+            if ( nodeIt != s.nodeDict.end( ) ) {
+                sk.jointNodeIds[ j ] = nodeIt->second;
+            } else {
+                s.console->error( "Joint \"{}\" is not in the scene hierarchy.", sk.jointNodes[ j ]->GetName( ) );
+            }
+        }
+
+        for ( uint32_t j = 0; j < jointCount; ++j ) {
+            for ( auto parent = sk.jointNodes[ j ]->GetParent( ); nullptr != parent; parent = parent->GetParent( ) ) {
+                auto jointIt = jointDict.find( parent );
+                if ( jointIt != jointDict.end( ) ) {
+                    sk.jointParentIndices[ j ] = jointIt->second;
+                    break;
+                }
+            }
+        }
+    }
+}
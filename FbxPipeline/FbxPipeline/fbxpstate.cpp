@@ -24,9 +24,23 @@ apemode::State::State( ) : console( spdlog::stdout_color_mt( "apemode" ) ), opti
     options.add_options( "input" )( "c,compress", "Compress", cxxopts::value< bool >( ) );
     options.add_options( "input" )( "p,pack-meshes", "Pack meshes", cxxopts::value< bool >( ) );
     options.add_options( "input" )( "s,split-meshes-per-material", "Split meshes per material", cxxopts::value< bool >( ) );
-    options.add_options( "input" )( "t,optimize-meshes", "Optimize meshes", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "t,optimize-meshes", "Optimize meshes (vcache, meshopt or none)", cxxopts::value< std::string >( ) );
+    options.add_options( "input" )( "w,weld-epsilon", "Vertex welding epsilon (zero means exact matching)", cxxopts::value< float >( ) );
     options.add_options( "input" )( "e,search-location", "Add search location", cxxopts::value< std::vector< std::string > >( ) );
     options.add_options( "input" )( "m,embed-file", "Embed file", cxxopts::value< std::vector< std::string > >( ) );
+    options.add_options( "input" )( "a,container", "Write meshes to the blobs appended to the output file", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "g,merge-meshes", "Merge meshes with the same vertex format into the scene-wide buffers", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "b,benchmark-names", "Benchmark name interning with the given name count and exit", cxxopts::value< int >( ) );
+    options.add_options( "input" )( "f,anim-sample-rate", "Animation sample rate (keys per second, 30 by default)", cxxopts::value< float >( ) );
+    options.add_options( "input" )( "r,anim-error", "Animation key reduction error (units and radians, 0.001 by default)", cxxopts::value< float >( ) );
+    options.add_options( "input" )( "n,position-bits", "Packed position bits per component (10 or 16, 10 by default)", cxxopts::value< int >( ) );
+    options.add_options( "input" )( "x,octahedral", "Pack normals and tangents with the octahedral encoding (16 bits per component)", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "u,half-texcoords", "Pack texcoords as half floats (instead of unorm in the mesh texcoord range)", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "q,max-position-step", "Split the packed meshes into chunks until the position quantization step fits (units, zero by default)", cxxopts::value< float >( ) );
+    options.add_options( "input" )( "l,meshlets", "Split the mesh subsets into meshlets with the bounding spheres and normal cones (for the cluster culling)", cxxopts::value< bool >( ) );
+    options.add_options( "input" )( "d,lod-count", "Generate the given number of simplified LODs per mesh (zero by default)", cxxopts::value< int >( ) );
+    options.add_options( "input" )( "j,lod-ratio", "Target triangle ratio of each LOD to the previous one (0.5 by default)", cxxopts::value< float >( ) );
+    options.add_options( "input" )( "y,lod-error", "Max simplification error of the first LOD, relative to the mesh size (0.01 by default, doubled for each next LOD)", cxxopts::value< float >( ) );
 }
 
 apemode::State::~State( ) {
@@ -59,19 +73,82 @@ bool apemode::State::Load( ) {
 
 std::vector< uint8_t > ReadFile( const char* filepath );
 
+/**
+ * Returns the upper bound of the output file size.
+ * Used to allocate the builder once, since growing it reallocates and copies the whole buffer.
+ **/
+size_t apemode::State::EstimateSceneSize( ) const {
+    size_t size = 1024;
+
+    size += names.GetCount( ) * ( sizeof( uint64_t ) + 32 + 1 );
+    size += names.GetTotalLength( );
+
+    size += transforms.size( ) * sizeof( apemodefb::TransformFb );
+    size += textures.size( ) * sizeof( apemodefb::TextureFb );
+
+    for ( auto& node : nodes ) {
+        size += 64 + ( node.childIds.size( ) + node.materialIds.size( ) ) * sizeof( uint32_t );
+    }
+
+    for ( auto& material : materials ) {
+        size += 64 + material.props.size( ) * sizeof( apemodefb::MaterialPropFb );
+    }
+
+    for ( auto& mesh : meshes ) {
+        size += 64 + mesh.vertices.size( ) + mesh.indices.size( );
+        size += mesh.submeshes.size( ) * sizeof( apemodefb::SubmeshFb );
+        size += mesh.subsets.size( ) * sizeof( apemodefb::SubsetFb );
+        size += mesh.meshlets.size( ) * sizeof( apemodefb::MeshletFb );
+        size += mesh.meshletVertexIndices.size( ) * sizeof( uint32_t ) + mesh.meshletTriangles.size( );
+        size += mesh.lods.size( ) * sizeof( apemodefb::MeshLodFb ) + mesh.lodSubsets.size( ) * sizeof( apemodefb::SubsetFb );
+    }
+
+    for ( auto& geometryBuffer : geometryBuffers ) {
+        size += 64 + geometryBuffer.vertices.size( ) + geometryBuffer.indices.size( );
+    }
+
+    size += animStacks.size( ) * 64;
+    for ( auto& animStack : animStacks ) {
+        size += animStack.layerIds.size( ) * sizeof( uint32_t );
+    }
+
+    for ( auto& animLayer : animLayers ) {
+        size += 64 + animLayer.tracks.size( ) * sizeof( apemodefb::AnimTrackFb );
+        size += animLayer.keys.size( ) * sizeof( apemodefb::AnimKeyFb );
+    }
+
+    for ( auto& skin : skins ) {
+        size += 64 + skin.jointNodeIds.size( ) * sizeof( uint32_t ) * 2;
+        size += skin.inverseBindMatrices.size( ) * sizeof( apemodefb::mat4 );
+    }
+
+    return size;
+}
+
 bool apemode::State::Finish( ) {
 
+    const size_t estimatedSize = EstimateSceneSize( );
+    console->info( "Estimated output size: {} bytes.", estimatedSize );
+
+    flatbuffers::FlatBufferBuilder builder( (flatbuffers::uoffset_t) std::min< size_t >( estimatedSize, size_t( FLATBUFFERS_MAX_BUFFER_SIZE ) ) );
+
     //
     // Finalize names
     //
 
     std::vector< flatbuffers::Offset<apemodefb::NameFb > > nameOffsets; {
-        nameOffsets.reserve( names.size( ) );
-        for ( auto& namePair : names ) {
-            const auto valueOffset = builder.CreateString( namePair.second );
+        // The names are sorted by their hashes only once here.
+        std::vector< NameTable::Entry > nameEntries;
+        names.GetSortedEntries( nameEntries );
+
+        console->info( "Names: {} unique, {} hash collision(s).", nameEntries.size( ), names.GetCollisionCount( ) );
+
+        nameOffsets.reserve( nameEntries.size( ) );
+        for ( auto& nameEntry : nameEntries ) {
+            const auto valueOffset = builder.CreateString( nameEntry.value, nameEntry.length );
 
            apemodefb::NameFbBuilder nameBuilder( builder );
-            nameBuilder.add_h( namePair.first );
+            nameBuilder.add_h( nameEntry.hash );
             nameBuilder.add_v( valueOffset );
             nameOffsets.push_back( nameBuilder.Finish( ) );
         }
@@ -129,13 +206,77 @@ bool apemode::State::Finish( ) {
     // Finalize meshes
     //
 
+    // The geometry is copied into the builder storage mesh by mesh, and the intermediate buffers
+    // are released right away, so that the peak memory does not reach twice the geometry size.
+    const auto createVectorAndRelease = [&]( std::vector< uint8_t >& bytes ) {
+        uint8_t* dst = nullptr;
+        const auto offset = builder.CreateUninitializedVector( bytes.size( ), sizeof( uint8_t ), &dst );
+        if ( false == bytes.empty( ) ) {
+            memcpy( dst, bytes.data( ), bytes.size( ) );
+        }
+
+        std::vector< uint8_t >( ).swap( bytes );
+        return flatbuffers::Offset< flatbuffers::Vector< uint8_t > >( offset );
+    };
+
+    std::vector< flatbuffers::Offset<apemodefb::GeometryBufferFb > > geometryBufferOffsets; {
+        geometryBufferOffsets.reserve( geometryBuffers.size( ) );
+        for ( auto& geometryBuffer : geometryBuffers ) {
+            // In container mode the vertices and indices are already written to the blobs.
+            flatbuffers::Offset< flatbuffers::Vector< uint8_t > > vsOffset;
+            flatbuffers::Offset< flatbuffers::Vector< uint8_t > > siOffset;
+            if ( false == container.IsOpen( ) ) {
+                vsOffset = createVectorAndRelease( geometryBuffer.vertices );
+                siOffset = createVectorAndRelease( geometryBuffer.indices );
+            }
+
+            apemodefb::GeometryBufferFbBuilder geometryBufferBuilder( builder );
+            geometryBufferBuilder.add_vertex_format( geometryBuffer.vertexFormat );
+            geometryBufferBuilder.add_vertex_stride( geometryBuffer.vertexStride );
+            geometryBufferBuilder.add_index_type( geometryBuffer.indexType );
+            geometryBufferBuilder.add_vertices( vsOffset );
+            geometryBufferBuilder.add_indices( siOffset );
+            if ( container.IsOpen( ) ) {
+                geometryBufferBuilder.add_vertices_blob( &geometryBuffer.verticesBlob );
+                geometryBufferBuilder.add_indices_blob( &geometryBuffer.indicesBlob );
+            }
+            geometryBufferOffsets.push_back( geometryBufferBuilder.Finish( ) );
+        }
+    }
+
     std::vector< flatbuffers::Offset<apemodefb::MeshFb > > meshOffsets; {
-        materialOffsets.reserve( meshes.size( ) );
+        meshOffsets.reserve( meshes.size( ) );
         for ( auto& mesh : meshes ) {
-            auto vsOffset = builder.CreateVector( mesh.vertices );
+            // In container mode the vertices and indices are already written to the blobs,
+            // in merge mode they are moved to the geometry buffers.
+            const bool bInline = false == container.IsOpen( ) && mesh.geometryBufferId == (uint32_t) -1;
+
+            flatbuffers::Offset< flatbuffers::Vector< uint8_t > > vsOffset;
+            flatbuffers::Offset< flatbuffers::Vector< uint8_t > > siOffset;
+            if ( bInline ) {
+                vsOffset = createVectorAndRelease( mesh.vertices );
+            }
+
             auto smOffset = builder.CreateVectorOfStructs( mesh.submeshes );
             auto ssOffset = builder.CreateVectorOfStructs( mesh.subsets );
-            auto siOffset = builder.CreateVector( mesh.indices );
+            if ( bInline ) {
+                siOffset = createVectorAndRelease( mesh.indices );
+            }
+
+            flatbuffers::Offset< apemodefb::MeshletsFb > mlOffset;
+            if ( false == mesh.meshlets.empty( ) ) {
+                mlOffset = apemodefb::CreateMeshletsFb( builder,
+                                                        builder.CreateVectorOfStructs( mesh.meshlets ),
+                                                        builder.CreateVector( mesh.meshletVertexIndices ),
+                                                        createVectorAndRelease( mesh.meshletTriangles ) );
+            }
+
+            flatbuffers::Offset< flatbuffers::Vector< const apemodefb::MeshLodFb * > > lodOffset;
+            flatbuffers::Offset< flatbuffers::Vector< const apemodefb::SubsetFb * > > lodSubsetOffset;
+            if ( false == mesh.lods.empty( ) ) {
+                lodOffset       = builder.CreateVectorOfStructs( mesh.lods );
+                lodSubsetOffset = builder.CreateVectorOfStructs( mesh.lodSubsets );
+            }
 
             apemodefb::MeshFbBuilder meshBuilder( builder );
             meshBuilder.add_vertices( vsOffset );
@@ -143,6 +284,22 @@ bool apemode::State::Finish( ) {
             meshBuilder.add_subsets( ssOffset );
             meshBuilder.add_indices( siOffset );
             meshBuilder.add_index_type( mesh.indexType );
+            if ( mesh.geometryBufferId != (uint32_t) -1 ) {
+                meshBuilder.add_geometry_buffer_id( mesh.geometryBufferId );
+            } else if ( container.IsOpen( ) ) {
+                meshBuilder.add_vertices_blob( &mesh.verticesBlob );
+                meshBuilder.add_indices_blob( &mesh.indicesBlob );
+            }
+            if ( mesh.skinId != (uint32_t) -1 ) {
+                meshBuilder.add_skin_id( mesh.skinId );
+            }
+            if ( false == mesh.meshlets.empty( ) ) {
+                meshBuilder.add_meshlets( mlOffset );
+            }
+            if ( false == mesh.lods.empty( ) ) {
+                meshBuilder.add_lods( lodOffset );
+                meshBuilder.add_lod_subsets( lodSubsetOffset );
+            }
             meshOffsets.push_back( meshBuilder.Finish( ) );
         }
     }
@@ -166,6 +323,7 @@ bool apemode::State::Finish( ) {
     }*/
 
     const auto meshesOffset = builder.CreateVector( meshOffsets );
+    const auto geometryBuffersOffset = builder.CreateVector( geometryBufferOffsets );
 
     //
     // Finalize Materials
@@ -185,6 +343,68 @@ bool apemode::State::Finish( ) {
 
     //const auto filesOffset = builder.CreateVector( fileOffsets );
 
+    //
+    // Finalize animation
+    //
+
+    std::vector< flatbuffers::Offset< apemodefb::AnimStackFb > > animStackOffsets; {
+        animStackOffsets.reserve( animStacks.size( ) );
+        for ( auto& animStack : animStacks ) {
+            const auto layerIdsOffset = builder.CreateVector( animStack.layerIds );
+
+            apemodefb::AnimStackFbBuilder animStackBuilder( builder );
+            animStackBuilder.add_id( animStack.id );
+            animStackBuilder.add_name_id( animStack.nameId );
+            animStackBuilder.add_start_time( animStack.startTime );
+            animStackBuilder.add_stop_time( animStack.stopTime );
+            animStackBuilder.add_sample_rate( animSampleRate );
+            animStackBuilder.add_layer_ids( layerIdsOffset );
+            animStackOffsets.push_back( animStackBuilder.Finish( ) );
+        }
+    }
+
+    std::vector< flatbuffers::Offset< apemodefb::AnimLayerFb > > animLayerOffsets; {
+        animLayerOffsets.reserve( animLayers.size( ) );
+        for ( auto& animLayer : animLayers ) {
+            const auto tracksOffset = builder.CreateVectorOfStructs( animLayer.tracks );
+            const auto keysOffset   = builder.CreateVectorOfStructs( animLayer.keys );
+
+            apemodefb::AnimLayerFbBuilder animLayerBuilder( builder );
+            animLayerBuilder.add_id( animLayer.id );
+            animLayerBuilder.add_name_id( animLayer.nameId );
+            animLayerBuilder.add_stack_id( animLayer.stackId );
+            animLayerBuilder.add_tracks( tracksOffset );
+            animLayerBuilder.add_keys( keysOffset );
+            animLayerOffsets.push_back( animLayerBuilder.Finish( ) );
+        }
+    }
+
+    const auto animStacksOffset = builder.CreateVector( animStackOffsets );
+    const auto animLayersOffset = builder.CreateVector( animLayerOffsets );
+
+    //
+    // Finalize skins
+    //
+
+    std::vector< flatbuffers::Offset< apemodefb::SkinFb > > skinOffsets; {
+        skinOffsets.reserve( skins.size( ) );
+        for ( auto& skin : skins ) {
+            const auto jointNodeIdsOffset        = builder.CreateVector( skin.jointNodeIds );
+            const auto jointParentIndicesOffset  = builder.CreateVector( skin.jointParentIndices );
+            const auto inverseBindMatricesOffset = builder.CreateVectorOfStructs( skin.inverseBindMatrices );
+
+            apemodefb::SkinFbBuilder skinBuilder( builder );
+            skinBuilder.add_id( skin.id );
+            skinBuilder.add_name_id( skin.nameId );
+            skinBuilder.add_joint_node_ids( jointNodeIdsOffset );
+            skinBuilder.add_joint_parent_indices( jointParentIndicesOffset );
+            skinBuilder.add_inverse_bind_matrices( inverseBindMatricesOffset );
+            skinOffsets.push_back( skinBuilder.Finish( ) );
+        }
+    }
+
+    const auto skinsOffset = builder.CreateVector( skinOffsets );
+
     //
     // Finalize scene
     //
@@ -194,8 +414,12 @@ bool apemode::State::Finish( ) {
     sceneBuilder.add_names( namesOffset );
     sceneBuilder.add_nodes( nodesOffset );
     sceneBuilder.add_meshes( meshesOffset );
+    sceneBuilder.add_geometry_buffers( geometryBuffersOffset );
     sceneBuilder.add_textures( texturesOffset );
     sceneBuilder.add_materials( materialsOffset );
+    sceneBuilder.add_anim_stacks( animStacksOffset );
+    sceneBuilder.add_anim_layers( animLayersOffset );
+    sceneBuilder.add_skins( skinsOffset );
     //sceneBuilder.add_files( filesOffset );
 
     apemodefb::FinishSceneFbBuffer( builder, sceneBuilder.Finish( ) );
@@ -207,6 +431,34 @@ bool apemode::State::Finish( ) {
     flatbuffers::Verifier v( builder.GetBufferPointer( ), builder.GetSize( ) );
     assert( apemodefb::VerifySceneFbBuffer( v ) );
 
+    console->info( "Output size: {} bytes (estimated {} bytes).", builder.GetSize( ), estimatedSize );
+
+    if ( container.IsOpen( ) ) {
+        const uint64_t blobsSize = container.GetSize( );
+        if ( container.Finish( builder.GetBufferPointer( ), (size_t) builder.GetSize( ) ) ) {
+            console->info( "Container: {} bytes of blobs, {} bytes of scene.", blobsSize, builder.GetSize( ) );
+            return true;
+        }
+
+        console->error( "Failed to finish the container." );
+        DebugBreak( );
+        return false;
+    }
+
+    const std::string output = GetOutputFile( );
+    if ( flatbuffers::SaveFile(output.c_str( ), (const char*) builder.GetBufferPointer( ), (size_t) builder.GetSize( ), true ) ) {
+        return true;
+    }
+
+    console->error( "Failed to write to output to {}", output );
+    DebugBreak( );
+    return false;
+}
+
+/**
+ * Returns the output file path (creates the output folder if needed).
+ **/
+std::string apemode::State::GetOutputFile( ) {
     std::string output = options[ "o" ].as< std::string >( );
     if ( output.empty( ) ) {
         output = folderPath + fileName + "." +apemodefb::SceneFbExtension( );
@@ -217,18 +469,17 @@ bool apemode::State::Finish( ) {
         CreateDirectoryA( outputFolder.c_str( ), 0 );
     }
 
-    if ( flatbuffers::SaveFile(output.c_str( ), (const char*) builder.GetBufferPointer( ), (size_t) builder.GetSize( ), true ) ) {
-        return true;
-    }
-
-    console->error( "Failed to write to output to {}", output );
-    DebugBreak( );
-    return false;
+    return output;
 }
 
 uint64_t apemode::State::PushName( std::string const& name ) {
-    const uint64_t hash = CityHash64( name.data( ), name.size( ) );
-    names.insert( std::make_pair( hash, name ) );
+    const char*    collision = nullptr;
+    const uint64_t hash      = names.Push( name, &collision );
+
+    if ( nullptr != collision ) {
+        console->error( "Name \"{}\" has the same hash as \"{}\" ({}), the first one is kept.", name, collision, hash );
+    }
+
     return hash;
 }
 
@@ -2,9 +2,83 @@
 
 #include <fbxppch.h>
 #include <scene_generated.h>
+#include <fbxpnames.h>
+#include <fbxpcontainer.h>
 
 namespace apemode {
 
+    /**
+     * Up to 4 joint influences of the vertex (the unused ones have zero weights).
+     * The weights are 8-bit unorm values that sum up to 255.
+     **/
+    struct SkinInfluence {
+        uint8_t jointIndices[ 4 ];
+        uint8_t jointWeights[ 4 ];
+    };
+
+    /**
+     * Quantization of the packed vertex attributes (see VertexLayoutFb).
+     **/
+    struct VertexPacking {
+        uint32_t positionBits    = 10;    /* 10 (10_10_10_2) or 16 (16_16_16_16) unorm bits per component */
+        bool     octahedral      = false; /* Octahedral 16_16 snorm normals and tangents instead of 10_10_10_2 unorm */
+        bool     halfTexcoords   = false; /* Half texcoords instead of 16_16 unorm in the mesh texcoord range */
+        float    maxPositionStep = 0.0f;  /* Max position quantization step of the chunks (units, zero disables splitting) */
+    };
+
+    enum EVertexAttribute {
+        eVertexAttribute_Position,
+        eVertexAttribute_Normal,
+        eVertexAttribute_Tangent,
+        eVertexAttribute_Texcoords,
+        eVertexAttribute_Count
+    };
+
+    /**
+     * Differences between the packed (dequantized) and the source vertex attributes.
+     * Positions and texcoords are in their units, normals and tangents are in degrees.
+     **/
+    struct QuantizationError {
+        double   maxError[ eVertexAttribute_Count ]        = {0, 0, 0, 0};
+        double   sumSquaredError[ eVertexAttribute_Count ] = {0, 0, 0, 0};
+        uint64_t vertexCount                               = 0;
+
+        void Add( EVertexAttribute attribute, double error ) {
+            maxError[ attribute ] = std::max( maxError[ attribute ], error );
+            sumSquaredError[ attribute ] += error * error;
+        }
+
+        void Add( QuantizationError const& other ) {
+            for ( uint32_t i = 0; i < eVertexAttribute_Count; ++i ) {
+                maxError[ i ] = std::max( maxError[ i ], other.maxError[ i ] );
+                sumSquaredError[ i ] += other.sumSquaredError[ i ];
+            }
+
+            vertexCount += other.vertexCount;
+        }
+
+        double GetRms( EVertexAttribute attribute ) const {
+            return vertexCount ? std::sqrt( sumSquaredError[ attribute ] / double( vertexCount ) ) : 0.0;
+        }
+    };
+
+    /**
+     * Spatial chunk of the packed mesh with its own quantization frame (exported as SubmeshFb).
+     * The chunks own contiguous vertex, index and subset ranges of the mesh.
+     **/
+    struct MeshChunk {
+        mathfu::vec3 positionMin;
+        mathfu::vec3 positionMax;
+        mathfu::vec2 texcoordMin;
+        mathfu::vec2 texcoordMax;
+        uint32_t     baseVertex  = 0;
+        uint32_t     vertexCount = 0;
+        uint32_t     baseIndex   = 0;
+        uint32_t     indexCount  = 0;
+        uint32_t     baseSubset  = 0;
+        uint32_t     subsetCount = 0;
+    };
+
     struct Mesh {
         bool                                hasTexcoords = false;
         apemodefb::vec3                     positionMin;
@@ -19,7 +93,34 @@ namespace apemode {
         std::vector< apemodefb::SubsetFb >  subsets;
         std::vector< uint8_t >              indices;
         std::vector< uint8_t >              vertices;
+        std::vector< SkinInfluence >        influences; /* Skinned meshes only, one per vertex (released after packing) */
+        std::vector< apemodefb::MeshletFb > meshlets;   /* Meshlet option only (see BuildMeshlets) */
+        std::vector< uint32_t >             meshletVertexIndices;
+        std::vector< uint8_t >              meshletTriangles;
+        std::vector< apemodefb::MeshLodFb > lods;       /* LOD option only, the simplified levels (see SimplifyMesh) */
+        std::vector< apemodefb::SubsetFb >  lodSubsets; /* LOD option only, the subsets of the simplified levels */
         apemodefb::EIndexTypeFb             indexType;
+        apemodefb::BlobFb                   verticesBlob; /* Container mode only (vertices are released) */
+        apemodefb::BlobFb                   indicesBlob;  /* Container mode only (indices are released) */
+        uint32_t                            geometryBufferId = (uint32_t) -1; /* Merge mode only (vertices and indices are moved) */
+        uint32_t                            skinId           = (uint32_t) -1;
+    };
+
+    /**
+     * Scene-wide vertex and index buffers of the meshes with the same vertex format and index type.
+     * The indices stay local to the meshes, the submeshes and subsets are offset to the ranges in these buffers.
+     **/
+    struct GeometryBuffer {
+        apemodefb::EVertexFormat vertexFormat = apemodefb::EVertexFormat_Static;
+        uint32_t                 vertexStride = 0;
+        apemodefb::EIndexTypeFb  indexType    = apemodefb::EIndexTypeFb_UInt16;
+        uint32_t                 vertexCount  = 0;
+        uint32_t                 indexCount   = 0;
+        uint32_t                 meshCount    = 0;
+        std::vector< uint8_t >   vertices;
+        std::vector< uint8_t >   indices;
+        apemodefb::BlobFb        verticesBlob; /* Container mode only (vertices are released) */
+        apemodefb::BlobFb        indicesBlob;  /* Container mode only (indices are released) */
     };
 
     struct Node {
@@ -37,14 +138,100 @@ namespace apemode {
         std::vector<apemodefb::MaterialPropFb > props;
     };
 
+    /**
+     * Animation layer with the resampled and reduced tracks of all the nodes.
+     * The tracks are sorted by nodes and channels, the keys of each track are contiguous.
+     **/
+    struct AnimLayer {
+        uint32_t                              id              = (uint32_t) -1;
+        uint64_t                              nameId          = (uint64_t) 0;
+        uint32_t                              stackId         = (uint32_t) -1;
+        fbxsdk::FbxAnimLayer*                 layer           = nullptr;
+        std::vector< apemodefb::AnimTrackFb > tracks;
+        std::vector< apemodefb::AnimKeyFb >   keys;
+        uint32_t                              sourceKeyCount  = 0; /* Keys of the FBX curves */
+        uint32_t                              sampledKeyCount = 0; /* Keys after resampling (before reduction) */
+    };
+
+    /**
+     * Joints of the FbxSkin of the mesh with the inverse bind matrices.
+     * The joint nodes are mapped to the node ids and parent joints once all the nodes are exported (see ResolveSkins).
+     **/
+    struct Skin {
+        uint32_t                              id     = (uint32_t) -1;
+        uint64_t                              nameId = (uint64_t) 0;
+        std::vector< const fbxsdk::FbxNode* > jointNodes;
+        std::vector< uint32_t >               jointNodeIds;
+        std::vector< uint32_t >               jointParentIndices;
+        std::vector< apemodefb::mat4 >        inverseBindMatrices;
+    };
+
+    struct AnimStack {
+        uint32_t                id        = (uint32_t) -1;
+        uint64_t                nameId    = (uint64_t) 0;
+        fbxsdk::FbxAnimStack*   stack     = nullptr;
+        float                   startTime = 0; /* Seconds */
+        float                   stopTime  = 0; /* Seconds */
+        std::vector< uint32_t > layerIds;
+    };
+
     using TupleUintUint = std::tuple< uint32_t, uint32_t >;
 
+    enum EMeshOptimizer {
+        eMeshOptimizer_None,
+        eMeshOptimizer_Vcache,        /* vcache_optimizer (Forsyth) */
+        eMeshOptimizer_MeshOptimizer, /* meshoptimizer (post-transform + overdraw) */
+    };
+
+    /**
+     * Geometry element layer copied out of the FBX SDK.
+     **/
+    template < typename TValue >
+    struct ElementLayer {
+        bool                                    present       = false;
+        fbxsdk::FbxLayerElement::EMappingMode   mappingMode   = fbxsdk::FbxLayerElement::eNone;
+        fbxsdk::FbxLayerElement::EReferenceMode referenceMode = fbxsdk::FbxLayerElement::eDirect;
+        std::vector< TValue >                   directArray;
+        std::vector< int >                      indexArray;
+    };
+
+    /**
+     * Raw mesh data extracted on the main thread (the FBX SDK is not thread-safe).
+     * It contains everything needed to process the mesh in the worker threads.
+     **/
+    struct MeshSource {
+        uint32_t                             meshId = (uint32_t) -1;
+        std::string                          name;
+        std::vector< fbxsdk::FbxVector4 >    controlPoints;
+        std::vector< uint32_t >              polygonVertices;  /* Control point indices, 3 per polygon */
+        ElementLayer< fbxsdk::FbxVector2 >   uvs;
+        ElementLayer< fbxsdk::FbxVector4 >   normals;
+        ElementLayer< fbxsdk::FbxVector4 >   tangents;
+        std::vector< apemodefb::SubsetFb >   subsets;          /* Subsets that were resolved while extracting */
+        std::vector< TupleUintUint >         polygonMaterials; /* Material and polygon indices to sort into subsets */
+        std::vector< SkinInfluence >         controlPointInfluences; /* Skinned meshes only */
+        uint32_t                             skinId = (uint32_t) -1;
+        QuantizationError                    quantizationError; /* Packed meshes only */
+        uint32_t                             chunkCount = 0;    /* Packed meshes only */
+        uint32_t                             meshletCount = 0;
+        uint32_t                             meshletTriangleCount = 0;
+        uint32_t                             meshletConeCount = 0;
+        uint32_t                             lodCount = 0;
+        uint32_t                             lodBaseTriangleCount = 0; /* Triangles of the full mesh */
+        uint32_t                             lodTriangleCount = 0;     /* Triangles of the coarsest level */
+        uint64_t                             vertexBytesBeforeWelding = 0;
+        uint64_t                             vertexBytesAfterWelding  = 0;
+        uint64_t                             indexBytesBeforeWelding  = 0;
+        uint64_t                             indexBytesAfterWelding   = 0;
+    };
+
     struct State {
         bool                              legacyTriangulationSdk = false;
+        EMeshOptimizer                    meshOptimizer          = eMeshOptimizer_None;
+        VertexPacking                     vertexPacking;
         fbxsdk::FbxManager*               manager                = nullptr;
         fbxsdk::FbxScene*                 scene                  = nullptr;
         std::shared_ptr< spdlog::logger > console;
-        flatbuffers::FlatBufferBuilder    builder;
         cxxopts::Options                  options;
         std::string                       fileName;
         std::string                       folderPath;
@@ -52,12 +239,38 @@ namespace apemode {
         std::vector< Material >           materials;
         std::map< uint64_t, uint32_t >    textureDict;
         std::map< uint64_t, uint32_t >    materialDict;
-        std::map< uint64_t, std::string > names;
+        NameTable                         names;
+        ContainerWriter                   container;
         std::vector<apemodefb::TransformFb >    transforms;
         std::vector<apemodefb::TextureFb >      textures;
         std::vector< Mesh >               meshes;
+        std::vector< GeometryBuffer >     geometryBuffers;
+        std::vector< AnimStack >          animStacks;
+        std::vector< AnimLayer >          animLayers;
+        std::vector< Skin >               skins;
+        std::map< const fbxsdk::FbxNode*, uint32_t > nodeDict; /* Node ids of the FBX nodes (for the skin joints) */
+        float                             animSampleRate = 30.0f;  /* Keys per second */
+        float                             animMaxError   = 0.001f; /* Units for translation and scaling, radians for rotation */
+        std::vector< MeshSource >         meshSources;
+        std::map< const fbxsdk::FbxMesh*, uint32_t > meshDict;        /* FBX meshes shared by multiple nodes */
+        std::multimap< uint64_t, uint32_t >          meshContentDict; /* Content hashes of the extracted meshes */
+        uint32_t                          sharedMeshCount    = 0; /* Nodes that reuse the mesh of another node */
+        uint32_t                          duplicateMeshCount = 0; /* Meshes with the same content as the exported ones */
         std::vector< std::string >        searchLocations;
         std::set< std::string >        embedQueue;
+        uint64_t                          vertexBytesBeforeWelding = 0;
+        uint64_t                          vertexBytesAfterWelding  = 0;
+        uint64_t                          indexBytesBeforeWelding  = 0;
+        uint64_t                          indexBytesAfterWelding   = 0;
+        QuantizationError                 quantizationError; /* All the packed meshes */
+        uint32_t                          chunkCount = 0;    /* All the packed meshes */
+        uint32_t                          meshletCount         = 0;
+        uint32_t                          meshletTriangleCount = 0;
+        uint32_t                          meshletConeCount     = 0; /* Meshlets with the normal cones (that can be backface culled) */
+        uint32_t                          lodMeshCount         = 0; /* Meshes with the simplified levels */
+        uint32_t                          lodCount             = 0;
+        uint32_t                          lodBaseTriangleCount = 0;
+        uint32_t                          lodTriangleCount     = 0;
 
         State( );
         ~State( );
@@ -66,6 +279,8 @@ namespace apemode {
         void     Release( );
         bool     Load( );
         bool     Finish( );
+        size_t   EstimateSceneSize( ) const;
+        std::string GetOutputFile( );
         uint64_t PushName( std::string const& name );
 
         friend State& Get( );
@@ -3,20 +3,30 @@
 
 void ExportScene( FbxScene* pScene );
 void ConvertScene( FbxManager* lSdkManager, FbxScene* lScene, FbxString lFilePath );
+void BenchmarkNames( uint32_t nameCount );
+size_t GetPeakMemoryUsage( );
 
 int main( int argc, char** argv ) {
     auto& s = apemode::Get( );
 
     bool convert = false;
+    int  benchmarkNameCount = 0;
 
     try {
         s.options.parse( argc, argv );
         convert = s.options[ "k" ].as< bool >( );
+        if ( s.options.count( "b" ) )
+            benchmarkNameCount = s.options[ "b" ].as< int >( );
     } catch ( const cxxopts::OptionException& e ) {
         s.console->critical( "error parsing options: {0}", e.what( ) );
         std::exit( 1 );
     }
 
+    if ( benchmarkNameCount > 0 ) {
+        BenchmarkNames( (uint32_t) benchmarkNameCount );
+        return 0;
+    }
+
     if ( s.Initialize( ) ) {
         if ( s.Load( ) ) {
             if ( convert )
@@ -25,6 +35,8 @@ int main( int argc, char** argv ) {
                 ExportScene( s.scene );
                 s.Finish( );
             }
+
+            s.console->info( "Peak memory usage: {:.1f} MB.", GetPeakMemoryUsage( ) / ( 1024.0 * 1024.0 ) );
         }
     }
 
@@ -4,6 +4,10 @@
 #include <AppState.h>
 #include <Input.h>
 #include <Scene.h>
+#include <SceneCulling.h>
+#include <SceneBvh.h>
+#include <SceneDrawList.h>
+#include <SceneSkinning.h>
 #include <Camera.h>
 #include <FileTracker.h>
 #include <CameraControllerInputMouseKeyboard.h>
@@ -13,6 +17,7 @@
 
 #include <Swapchain.Vulkan.h>
 #include <ShaderCompiler.Vulkan.h>
+#include <DescriptorPool.Vulkan.h>
 
 #include <AppSurfaceSdlVk.h>
 #include <NuklearSdlVk.h>
@@ -72,6 +77,12 @@ public:
     NuklearRendererSdlBase*     pNkRenderer        = nullptr;
     DebugRendererVk*            pDebugRenderer     = nullptr;
     SceneRendererBase*          pSceneRendererBase = nullptr;
+    SceneCullingStats           CullingStats;
+    SceneClusterCullingStats    ClusterCullingStats;
+    SceneDrawListStats          DrawListStats;
+    SceneRenderStatsVk          RenderStats;
+    bool                        bRecordSceneInline = false;
+    float                       LodErrorPixels     = 1;
 
     uint32_t FrameCount = 0;
     uint32_t FrameIndex = 0;
@@ -82,6 +93,7 @@ public:
     DescriptorPool                         DescPool;
     TDispatchableHandle< VkCommandPool >   hCmdPool[ kMaxFrames ];
     TDispatchableHandle< VkCommandBuffer > hCmdBuffers[ kMaxFrames ];
+    TDispatchableHandle< VkCommandBuffer > hOverlayCmdBuffers[ kMaxFrames ]; /* Secondary, the debug and UI draws after the scene draws */
     //TDispatchableHandle< VkFence >         hFences[ kMaxFrames ];
     TDispatchableHandle< VkSemaphore >     hPresentCompleteSemaphores[ kMaxFrames ];
     TDispatchableHandle< VkSemaphore >     hRenderCompleteSemaphores[ kMaxFrames ];
@@ -109,7 +121,17 @@ App::App( ) : appState(new AppState()) {
         appState->appOptions->add_options( "vk" )
             ( "renderdoc", "Adds renderdoc layer to device layers" )
             ( "vkapidump", "Adds api dump layer to vk device layers" )
-            ( "vktrace", "Adds vktrace layer to vk device layers" );
+            ( "vktrace", "Adds vktrace layer to vk device layers" )
+            ( "benchmark-transforms", "Benchmarks the scene transform updates with the given node count", cxxopts::value< int >( ) )
+            ( "benchmark-culling", "Benchmarks the scene frustum culling with the given node count", cxxopts::value< int >( ) )
+            ( "benchmark-clusters", "Benchmarks the cluster frustum and backface culling with the given node count", cxxopts::value< int >( ) )
+            ( "benchmark-bvh", "Benchmarks the scene BVH build, refit and queries up to the given node count", cxxopts::value< int >( ) )
+            ( "benchmark-drawlist", "Benchmarks the scene draw list sorting with the given packet count", cxxopts::value< int >( ) )
+            ( "benchmark-skinning", "Benchmarks the CPU skinning with the given vertex count", cxxopts::value< int >( ) )
+            ( "validate-skinning", "Validates the skinned meshes of the loaded scene with the CPU skinning" )
+            ( "test-descsets", "Tests the descriptor set cache (hits, misses, evictions and collisions) without the device" )
+            ( "record-inline", "Records the scene draws on the main thread (no secondary command buffers)" )
+            ( "lod-error", "Max projected error of the mesh LODs in pixels (1 by default, zero draws the full meshes)", cxxopts::value< float >( ) );
 }
 
 App::~App( ) {
@@ -134,6 +156,46 @@ bool App::Initialize( int Args, char* ppArgs[] ) {
         if ( nullptr == appContent )
             appContent = new AppContent( );
 
+        if ( ( *appState->appOptions )[ "benchmark-transforms" ].count( ) ) {
+            const int nodeCount = ( *appState->appOptions )[ "benchmark-transforms" ].as< int >( );
+            apemode::BenchmarkSceneTransforms( nodeCount > 0 ? uint32_t( nodeCount ) : 100000 );
+        }
+
+        if ( ( *appState->appOptions )[ "benchmark-culling" ].count( ) ) {
+            const int nodeCount = ( *appState->appOptions )[ "benchmark-culling" ].as< int >( );
+            apemode::BenchmarkSceneCulling( nodeCount > 0 ? uint32_t( nodeCount ) : 100000 );
+        }
+
+        if ( ( *appState->appOptions )[ "benchmark-clusters" ].count( ) ) {
+            const int nodeCount = ( *appState->appOptions )[ "benchmark-clusters" ].as< int >( );
+            apemode::BenchmarkSceneClusterCulling( nodeCount > 0 ? uint32_t( nodeCount ) : 10000 );
+        }
+
+        if ( ( *appState->appOptions )[ "benchmark-bvh" ].count( ) ) {
+            const int nodeCount = ( *appState->appOptions )[ "benchmark-bvh" ].as< int >( );
+            apemode::BenchmarkSceneBvh( nodeCount > 0 ? uint32_t( nodeCount ) : 1000000 );
+        }
+
+        if ( ( *appState->appOptions )[ "benchmark-drawlist" ].count( ) ) {
+            const int packetCount = ( *appState->appOptions )[ "benchmark-drawlist" ].as< int >( );
+            apemode::BenchmarkSceneDrawList( packetCount > 0 ? uint32_t( packetCount ) : 100000 );
+        }
+
+        if ( ( *appState->appOptions )[ "benchmark-skinning" ].count( ) ) {
+            const int vertexCount = ( *appState->appOptions )[ "benchmark-skinning" ].as< int >( );
+            apemode::BenchmarkSceneSkinning( vertexCount > 0 ? uint32_t( vertexCount ) : 100000 );
+        }
+
+        if ( ( *appState->appOptions )[ "test-descsets" ].count( ) ) {
+            const bool bPassed = apemodevk::TestDescriptorSetPool( );
+            appState->consoleLogger->info( "DescriptorSetPool: Test {}.", bPassed ? "passed" : "failed" );
+        }
+
+        appContent->bRecordSceneInline = 0 != ( *appState->appOptions )[ "record-inline" ].count( );
+        if ( ( *appState->appOptions )[ "lod-error" ].count( ) ) {
+            appContent->LodErrorPixels = std::max( ( *appState->appOptions )[ "lod-error" ].as< float >( ), 0.0f );
+        }
+
         appContent->FileTracker.FilePatterns.push_back( ".*\\.(vert|frag|comp|geom|tesc|tese|h|hpp|inl|inc|fx)$" );
         appContent->FileTracker.ScanDirectory( "./shaders/**", true );
 
@@ -177,6 +239,13 @@ bool App::Initialize( int Args, char* ppArgs[] ) {
                     return false;
                 }
 
+                cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+                if ( false == appContent->hOverlayCmdBuffers[ i ].Recreate( *appSurface->pNode, cmdBufferAllocInfo ) ) {
+                    DebugBreak( );
+                    return false;
+                }
+
                 VkSemaphoreCreateInfo semaphoreCreateInfo;
                 InitializeStruct( semaphoreCreateInfo );
                 if ( false == appContent->hPresentCompleteSemaphores[ i ].Recreate( *appSurface->pNode, semaphoreCreateInfo ) ||
@@ -221,6 +290,7 @@ bool App::Initialize( int Args, char* ppArgs[] ) {
         initParamsDbg.pAlloc          = nullptr;
         initParamsDbg.pDevice         = *appSurface->pNode;
         initParamsDbg.pPhysicalDevice = *appSurface->pNode;
+        initParamsDbg.pNode           = appSurface->pNode;
         initParamsDbg.pRenderPass     = appContent->hDbgRenderPass;
         initParamsDbg.pDescPool       = appContent->DescPool;
         initParamsDbg.FrameCount      = appContent->FrameCount;
@@ -234,6 +304,7 @@ bool App::Initialize( int Args, char* ppArgs[] ) {
         updateParams.pRenderPass     = appContent->hDbgRenderPass;
         updateParams.pDescPool       = appContent->DescPool;
         updateParams.FrameCount      = appContent->FrameCount;
+        updateParams.QueueFamilyId   = appSurface->PresentQueueFamilyIds[ 0 ];
 
         // -i "C:\Users\vladyslav.serhiienko\Downloads\blood-and-fire\source\DragonMain.fbx" -o "$(SolutionDir)assets\DragonMainp.fbxp" -p
         // -i "E:\Media\Models\knight-artorias\source\Artorias.fbx.fbx" -o "$(SolutionDir)assets\Artoriasp.fbxp" -p
@@ -261,6 +332,10 @@ bool App::Initialize( int Args, char* ppArgs[] ) {
         // appContent->Scenes.push_back( LoadSceneFromFile( "F:/Dev/Projects/ProjectFbxPipeline/FbxPipeline/assets/Mech6kv4p.fbxp" ));
         updateParams.pSceneSrc = appContent->Scenes.back( )->sourceScene;
 
+        if ( ( *appState->appOptions )[ "validate-skinning" ].count( ) ) {
+            apemode::ValidateSceneSkinning( appContent->Scenes.back( ) );
+        }
+
         appContent->pSceneRendererBase->UpdateScene( appContent->Scenes.back( ), &updateParams );
 
         apemodeos::FileManager imgFileManager;
@@ -534,13 +609,56 @@ void App::Update( float deltaSecs, Input const& inputState ) {
     }
     nk_end(ctx);
 
+    /* The stats are from the previous frame. */
+    if ( nk_begin( ctx, "Scene", nk_rect( 10, 270, 220, 470 ), windowFlags | NK_WINDOW_TITLE ) ) {
+        auto& cullingStats = appContent->CullingStats;
+
+        nk_layout_row_dynamic( ctx, 20, 1 );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Tested nodes: %u", cullingStats.testedNodeCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Visible nodes: %u", cullingStats.visibleNodeCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Culled nodes: %u", cullingStats.culledNodeCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Culling: %.3f ms", cullingStats.elapsedMs );
+
+        auto& clusterCullingStats = appContent->ClusterCullingStats;
+        nk_labelf( ctx, NK_TEXT_LEFT, "Culled clusters: %u / %u", clusterCullingStats.frustumCulledClusterCount + clusterCullingStats.backfaceCulledClusterCount, clusterCullingStats.testedClusterCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Culled triangles: %u / %u", clusterCullingStats.culledTriangleCount, clusterCullingStats.testedTriangleCount );
+
+        auto& drawListStats = appContent->DrawListStats;
+        nk_labelf( ctx, NK_TEXT_LEFT, "Draws: %u", drawListStats.packetCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Instanced draws: %u", drawListStats.drawCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Buffer binds: %u", drawListStats.bufferBindCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Material binds: %u", drawListStats.materialBindCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Saved binds: %u", drawListStats.savedBindCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Sorting: %.3f ms", drawListStats.sortElapsedMs );
+
+        auto& renderStats = appContent->RenderStats;
+        nk_labelf( ctx, NK_TEXT_LEFT, "Simplified nodes: %u", renderStats.simplifiedNodeCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Uploaded: %u bytes", renderStats.uploadedByteCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Desc sets: %u hits, %u misses", renderStats.descSetHitCount, renderStats.descSetMissCount );
+        nk_labelf( ctx, NK_TEXT_LEFT, "Recording: %.3f ms (%u chunks)", renderStats.recordElapsedMs, renderStats.recordingChunkCount );
+    }
+    nk_end( ctx );
+
     appContent->pCamInput->Update( deltaSecs, inputState, {(float) appContent->width, (float) appContent->height} );
     appContent->pCamController->Orbit( appContent->pCamInput->OrbitDelta );
     appContent->pCamController->Dolly( appContent->pCamInput->DollyDelta );
     appContent->pCamController->Update( deltaSecs );
 
+    /* Only the dirty nodes (and their subtrees) are updated, static scenes cost nothing here. */
+    for ( auto pScene : appContent->Scenes ) {
+        pScene->UpdateMatrices( );
+        pScene->bvh.Refit( pScene );
+    }
+
     if ( auto appSurfaceVk = (AppSurfaceSdlVk*) GetSurface( ) ) {
 
+        /* Submits the next scene upload batches (before the present queue is acquired, it can be the same queue). */
+        SceneRendererVk::SceneUpdateParametersVk updateParams;
+        updateParams.pNode         = appSurfaceVk->pNode;
+        updateParams.pSceneSrc     = appContent->Scenes[ 0 ]->sourceScene;
+        updateParams.QueueFamilyId = appSurfaceVk->PresentQueueFamilyIds[ 0 ];
+        appContent->pSceneRendererBase->UpdateScene( appContent->Scenes[ 0 ], &updateParams );
+
         auto queueFamilyPool = appSurfaceVk->pNode->GetQueuePool()->GetPool(appSurfaceVk->PresentQueueFamilyIds[0]);
         auto acquiredQueue = queueFamilyPool->Acquire(true);
         while (acquiredQueue.pQueue == nullptr) {
@@ -593,6 +711,9 @@ void App::Update( float deltaSecs, Input const& inputState ) {
         commandBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         CheckedCall( vkBeginCommandBuffer( cmdBuffer, &commandBufferBeginInfo ) );
 
+        /* The uploaded mesh buffers are acquired outside of the render pass. */
+        ( (SceneRendererVk*) appContent->pSceneRendererBase )->AcquireUploads( appContent->Scenes[ 0 ], cmdBuffer );
+
         VkClearValue clearValue[2];
         clearValue[0].color.float32[ 0 ] = clearColor[ 0 ];
         clearValue[0].color.float32[ 1 ] = clearColor[ 1 ];
@@ -610,7 +731,28 @@ void App::Update( float deltaSecs, Input const& inputState ) {
         renderPassBeginInfo.clearValueCount          = 2;
         renderPassBeginInfo.pClearValues             = clearValue;
 
-        vkCmdBeginRenderPass( cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+        /* The scene draws are recorded in parallel into the secondary buffers, so the rest of the draws go to the overlay buffer. */
+        VkCommandBuffer overlayCmdBuffer = cmdBuffer;
+
+        if ( appContent->bRecordSceneInline ) {
+            vkCmdBeginRenderPass( cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+        } else {
+            vkCmdBeginRenderPass( cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+
+            VkCommandBufferInheritanceInfo inheritanceInfo;
+            InitializeStruct( inheritanceInfo );
+            inheritanceInfo.renderPass  = appContent->hDbgRenderPass;
+            inheritanceInfo.subpass     = 0;
+            inheritanceInfo.framebuffer = appContent->hDbgFramebuffers[ appContent->FrameIndex ];
+
+            VkCommandBufferBeginInfo overlayBeginInfo;
+            InitializeStruct( overlayBeginInfo );
+            overlayBeginInfo.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            overlayBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+            overlayCmdBuffer = appContent->hOverlayCmdBuffers[ appContent->FrameIndex ];
+            CheckedCall( vkBeginCommandBuffer( overlayCmdBuffer, &overlayBeginInfo ) );
+        }
 
         DebugRendererVk::FrameUniformBuffer frameData;
         frameData.projectionMatrix = appContent->CamProjController.ProjMatrix(55.0f, (float)width, (float)height, 0.1f, 1000.0f);
@@ -626,7 +768,7 @@ void App::Update( float deltaSecs, Input const& inputState ) {
         renderParamsDbg.scale[ 0 ] = 1;
         renderParamsDbg.scale[ 1 ] = 1;
         renderParamsDbg.FrameIndex = appContent->FrameIndex;
-        renderParamsDbg.pCmdBuffer = cmdBuffer;
+        renderParamsDbg.pCmdBuffer = overlayCmdBuffer;
         renderParamsDbg.pFrameData = &frameData;
 
         const float scale = 0.5f;
@@ -662,6 +804,17 @@ void App::Update( float deltaSecs, Input const& inputState ) {
         sceneRenderParameters.pNode      = appSurfaceVk->pNode;
         sceneRenderParameters.ViewMatrix = frameData.viewMatrix;
         sceneRenderParameters.ProjMatrix = frameData.projectionMatrix;
+        sceneRenderParameters.pCullingStats = &appContent->CullingStats;
+        sceneRenderParameters.pClusterCullingStats = &appContent->ClusterCullingStats;
+        sceneRenderParameters.pDrawListStats = &appContent->DrawListStats;
+        sceneRenderParameters.pRenderStats   = &appContent->RenderStats;
+        sceneRenderParameters.LodErrorPixels = appContent->LodErrorPixels;
+
+        if ( false == appContent->bRecordSceneInline ) {
+            sceneRenderParameters.pRenderPass   = appContent->hDbgRenderPass;
+            sceneRenderParameters.pFramebuffer  = appContent->hDbgFramebuffers[ appContent->FrameIndex ];
+            sceneRenderParameters.QueueFamilyId = appSurfaceVk->PresentQueueFamilyIds[ 0 ];
+        }
 
         appContent->pSceneRendererBase->RenderScene(appContent->Scenes[0], &sceneRenderParameters);
 
@@ -674,11 +827,16 @@ void App::Update( float deltaSecs, Input const& inputState ) {
         renderParamsNk.max_vertex_buffer  = 64 * 1024;
         renderParamsNk.max_element_buffer = 64 * 1024;
         renderParamsNk.FrameIndex         = appContent->FrameIndex;
-        renderParamsNk.pCmdBuffer         = cmdBuffer;
+        renderParamsNk.pCmdBuffer         = overlayCmdBuffer;
 
         appContent->pNkRenderer->Render( &renderParamsNk );
         nk_clear( &appContent->pNkRenderer->Context );
 
+        if ( overlayCmdBuffer != cmdBuffer ) {
+            CheckedCall( vkEndCommandBuffer( overlayCmdBuffer ) );
+            vkCmdExecuteCommands( cmdBuffer, 1, &overlayCmdBuffer );
+        }
+
         vkCmdEndRenderPass( cmdBuffer );
 
         appContent->pDebugRenderer->Flush( appContent->FrameIndex );
@@ -7,6 +7,13 @@ namespace apemode {
     using namespace apemodevk;
 }
 
+apemode::DebugRendererVk::~DebugRendererVk( ) {
+    hVertexBuffer.Destroy( );
+    if ( nullptr != pMemoryAllocator ) {
+        pMemoryAllocator->Free( VertexBufferMemory );
+    }
+}
+
 bool apemode::DebugRendererVk::RecreateResources( InitParametersVk* initParams ) {
     if ( nullptr == initParams )
         return false;
@@ -353,31 +360,21 @@ bool apemode::DebugRendererVk::RecreateResources( InitParametersVk* initParams )
             return false;
         }
 
-        auto memoryAllocateInfo = hVertexBuffer.GetMemoryAllocateInfo( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-        if ( false == hVertexBufferMemory.Recreate( initParams->pDevice, memoryAllocateInfo ) ) {
-            DebugBreak( );
-            return false;
+        /* Persistently mapped sub-range of the host visible block. */
+        if ( nullptr != pMemoryAllocator ) {
+            pMemoryAllocator->Free( VertexBufferMemory );
         }
 
-        if ( false == hVertexBuffer.BindMemory( hVertexBufferMemory, 0 ) ) {
+        pMemoryAllocator = initParams->pNode->GetMemoryAllocator( );
+        if ( false == pMemoryAllocator->AllocateAndBind( hVertexBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VertexBufferMemory ) ) {
             DebugBreak( );
             return false;
         }
 
-        if ( auto mappedData = hVertexBufferMemory.Map( 0, vertexBufferSize, 0 ) ) {
-            memcpy( mappedData, g_vertex_buffer_data, vertexBufferSize );
-
-            VkMappedMemoryRange range;
-            InitializeStruct( range );
-            range.memory = hVertexBufferMemory;
-            range.size   = VK_WHOLE_SIZE;
-
-            if ( VK_SUCCESS != CheckedCall( vkFlushMappedMemoryRanges( initParams->pDevice, 1, &range ) ) ) {
-                DebugBreak( );
-                return false;
-            }
-
-            hVertexBufferMemory.Unmap();
+        memcpy( VertexBufferMemory.pMapped, g_vertex_buffer_data, vertexBufferSize );
+        if ( false == pMemoryAllocator->Flush( VertexBufferMemory ) ) {
+            DebugBreak( );
+            return false;
         }
     }
 
@@ -438,6 +435,7 @@ bool apemode::DebugRendererVk::RecreateResources( InitParametersVk* initParams )
 
 void apemode::DebugRendererVk::Reset( uint32_t FrameIndex ) {
     BufferPools[ FrameIndex ].Reset( );
+    DescSetPools[ FrameIndex ].Reset( );
 }
 
 bool apemode::DebugRendererVk::Render( RenderParametersVk* renderParams ) {
@@ -4,6 +4,7 @@
 #include <GraphicsDevice.Vulkan.h>
 #include <DescriptorPool.Vulkan.h>
 #include <BufferPools.Vulkan.h>
+#include <MemoryAllocator.Vulkan.h>
 
 namespace apemode {
 
@@ -20,12 +21,13 @@ namespace apemode {
         };
 
         struct InitParametersVk {
-            VkAllocationCallbacks *pAlloc          = nullptr;        /* Null is ok */
-            VkDevice               pDevice         = VK_NULL_HANDLE; /* Required */
-            VkPhysicalDevice       pPhysicalDevice = VK_NULL_HANDLE; /* Required */
-            VkDescriptorPool       pDescPool       = VK_NULL_HANDLE; /* Required */
-            VkRenderPass           pRenderPass     = VK_NULL_HANDLE; /* Required */
-            uint32_t               FrameCount      = 0;              /* Required, swapchain img count typically */
+            VkAllocationCallbacks *    pAlloc          = nullptr;        /* Null is ok */
+            VkDevice                   pDevice         = VK_NULL_HANDLE; /* Required */
+            VkPhysicalDevice           pPhysicalDevice = VK_NULL_HANDLE; /* Required */
+            apemodevk::GraphicsDevice *pNode           = nullptr;        /* Required, owns the memory allocator */
+            VkDescriptorPool           pDescPool       = VK_NULL_HANDLE; /* Required */
+            VkRenderPass               pRenderPass     = VK_NULL_HANDLE; /* Required */
+            uint32_t                   FrameCount      = 0;              /* Required, swapchain img count typically */
         };
 
         struct RenderParametersVk {
@@ -45,7 +47,8 @@ namespace apemode {
         apemodevk::TDispatchableHandle< VkPipelineCache >       hPipelineCache;
         apemodevk::TDispatchableHandle< VkPipeline >            hPipeline;
         apemodevk::TDispatchableHandle< VkBuffer >              hVertexBuffer;
-        apemodevk::TDispatchableHandle< VkDeviceMemory >        hVertexBufferMemory;
+        apemodevk::MemoryAllocation                             VertexBufferMemory;
+        apemodevk::MemoryAllocator*                             pMemoryAllocator = nullptr;
 
 #if 1
         apemodevk::HostBufferPool                               BufferPools[ kMaxFrameCount ];
@@ -56,6 +59,8 @@ namespace apemode {
 #endif
 
 
+        ~DebugRendererVk( );
+
         bool RecreateResources( InitParametersVk *initParams );
 
         void Reset( uint32_t FrameIndex );
@@ -3,6 +3,22 @@
 #include <new>
 
 #include <time.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define MSPACES 1
 #define USE_DL_PREFIX 1
 #define ONLY_MSPACES 1
@@ -44,6 +60,120 @@ namespace apemode {
         mspace_free(tlms, p);
     }
 
+#ifdef _WIN32
+
+    MappedFile::MappedFile( ) : pData( nullptr ), dataSize( 0 ), hFile( INVALID_HANDLE_VALUE ), hMapping( nullptr ) {
+    }
+
+    bool MappedFile::Open( const char *filePath ) {
+        Close( );
+
+        hFile = CreateFileA( filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+        if ( INVALID_HANDLE_VALUE == hFile ) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if ( FALSE == GetFileSizeEx( hFile, &fileSize ) || 0 == fileSize.QuadPart ) {
+            Close( );
+            return false;
+        }
+
+        hMapping = CreateFileMappingA( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if ( nullptr == hMapping ) {
+            Close( );
+            return false;
+        }
+
+        pData = reinterpret_cast< const uint8_t * >( MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 ) );
+        if ( nullptr == pData ) {
+            Close( );
+            return false;
+        }
+
+        dataSize = (size_t) fileSize.QuadPart;
+        return true;
+    }
+
+    void MappedFile::Close( ) {
+        if ( nullptr != pData ) {
+            UnmapViewOfFile( pData );
+            pData = nullptr;
+        }
+
+        if ( nullptr != hMapping ) {
+            CloseHandle( hMapping );
+            hMapping = nullptr;
+        }
+
+        if ( INVALID_HANDLE_VALUE != hFile ) {
+            CloseHandle( hFile );
+            hFile = INVALID_HANDLE_VALUE;
+        }
+
+        dataSize = 0;
+    }
+
+#else
+
+    MappedFile::MappedFile( ) : pData( nullptr ), dataSize( 0 ), fd( -1 ) {
+    }
+
+    bool MappedFile::Open( const char *filePath ) {
+        Close( );
+
+        fd = open( filePath, O_RDONLY );
+        if ( -1 == fd ) {
+            return false;
+        }
+
+        struct stat fileStat;
+        if ( -1 == fstat( fd, &fileStat ) || 0 == fileStat.st_size ) {
+            Close( );
+            return false;
+        }
+
+        void *pMapped = mmap( nullptr, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( MAP_FAILED == pMapped ) {
+            Close( );
+            return false;
+        }
+
+        madvise( pMapped, (size_t) fileStat.st_size, MADV_SEQUENTIAL );
+
+        pData    = reinterpret_cast< const uint8_t * >( pMapped );
+        dataSize = (size_t) fileStat.st_size;
+        return true;
+    }
+
+    void MappedFile::Close( ) {
+        if ( nullptr != pData ) {
+            munmap( const_cast< uint8_t * >( pData ), dataSize );
+            pData = nullptr;
+        }
+
+        if ( -1 != fd ) {
+            close( fd );
+            fd = -1;
+        }
+
+        dataSize = 0;
+    }
+
+#endif
+
+    MappedFile::~MappedFile( ) {
+        Close( );
+    }
+
+    const uint8_t *MappedFile::GetData( ) const {
+        return pData;
+    }
+
+    size_t MappedFile::GetSize( ) const {
+        return dataSize;
+    }
+
 }
 
 void *operator new( size_t size ) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
 
 namespace apemode {
     /**
@@ -83,4 +84,42 @@ namespace apemode {
     template <typename TDerived, bool bThreadLocal = false>
     struct TNewOf : TNew< alignof (TDerived), bThreadLocal> {
     };
+
+    /**
+     * Read-only memory mapped file.
+     * The pages are loaded on demand and are shared with the file cache,
+     * so the file contents do not occupy the heap.
+     */
+    class MappedFile {
+    public:
+        MappedFile( );
+        ~MappedFile( );
+        MappedFile( const MappedFile & ) = delete;
+        MappedFile &operator=( const MappedFile & ) = delete;
+
+        /**
+         * Maps the whole file.
+         * @param filePath The path of the file to map.
+         * @return True on success.
+         */
+        bool Open( const char *filePath );
+
+        /**
+         * Unmaps the file (the pointers to its data become invalid).
+         */
+        void Close( );
+
+        const uint8_t *GetData( ) const;
+        size_t         GetSize( ) const;
+
+    private:
+        const uint8_t *pData;
+        size_t         dataSize;
+#ifdef _WIN32
+        void *hFile;
+        void *hMapping;
+#else
+        int fd;
+#endif
+    };
 }
@@ -231,12 +231,11 @@ std::unique_ptr< apemodevk::LoadedImage > apemodevk::ImageLoader::LoadImageFromD
         return nullptr;
     }
 
-    auto fontImgAllocInfo = loadedImage->hImg.GetMemoryAllocateInfo( VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    if ( false == loadedImage->hImgMemory.Recreate( *pNode, fontImgAllocInfo ) ) {
-        return nullptr;
-    }
-
-    if ( false == loadedImage->hImg.BindMemory( loadedImage->hImgMemory, 0 ) ) {
+    loadedImage->pMemoryAllocator = pNode->GetMemoryAllocator( );
+    if ( false == loadedImage->pMemoryAllocator->AllocateAndBind( loadedImage->hImg,
+                                                                  loadedImage->imageCreateInfo.tiling,
+                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                                  loadedImage->imgMemory ) ) {
         return nullptr;
     }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <GraphicsDevice.Vulkan.h>
+#include <MemoryAllocator.Vulkan.h>
 
 namespace apemodevk {
     class GraphicsDevice;
@@ -11,9 +12,18 @@ namespace apemodevk {
         uint32_t                                         queueFamilyId = 0;
         apemodevk::TDispatchableHandle< VkImage >        hImg;
         apemodevk::TDispatchableHandle< VkImageView >    hImgView;
-        apemodevk::TDispatchableHandle< VkDeviceMemory > hImgMemory;
+        apemodevk::MemoryAllocation                      imgMemory;
+        apemodevk::MemoryAllocator*                      pMemoryAllocator = nullptr; /* Owns the image memory */
         VkImageCreateInfo                                imageCreateInfo;
         VkImageViewCreateInfo                            imageViewCreateInfo;
+
+        ~LoadedImage( ) {
+            hImgView.Destroy( );
+            hImg.Destroy( );
+            if ( nullptr != pMemoryAllocator ) {
+                pMemoryAllocator->Free( imgMemory );
+            }
+        }
     };
 
     class ImageLoader {
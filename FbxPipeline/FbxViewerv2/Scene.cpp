@@ -0,0 +1,358 @@
+#include <fbxvpch.h>
+
+#include <Scene.h>
+#include <AppState.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __SSE__ )
+#include <xmmintrin.h>
+#define APEMODE_SCENE_SSE 1
+#endif
+
+static_assert( sizeof( mathfu::mat4 ) == sizeof( float ) * 16, "Matrices are accessed as column-major float arrays." );
+
+uint32_t apemode::SceneTransformChannels::GetCount( ) const {
+    return uint32_t( translation.size( ) );
+}
+
+void apemode::SceneTransformChannels::Resize( uint32_t count ) {
+    translation.resize( count, mathfu::vec3( 0.0f ) );
+    rotationOffset.resize( count, mathfu::vec3( 0.0f ) );
+    rotationPivot.resize( count, mathfu::vec3( 0.0f ) );
+    preRotation.resize( count, mathfu::vec3( 0.0f ) );
+    postRotation.resize( count, mathfu::vec3( 0.0f ) );
+    rotation.resize( count, mathfu::vec3( 0.0f ) );
+    scalingOffset.resize( count, mathfu::vec3( 0.0f ) );
+    scalingPivot.resize( count, mathfu::vec3( 0.0f ) );
+    scaling.resize( count, mathfu::vec3( 1.0f ) );
+    geometricTranslation.resize( count, mathfu::vec3( 0.0f ) );
+    geometricRotation.resize( count, mathfu::vec3( 0.0f ) );
+    geometricScaling.resize( count, mathfu::vec3( 1.0f ) );
+    rotationQuat.resize( count, mathfu::quat( 1, 0, 0, 0 ) );
+    geometricRotationQuat.resize( count, mathfu::quat( 1, 0, 0, 0 ) );
+}
+
+apemode::SceneNodeTransform apemode::SceneTransformChannels::Get( uint32_t nodeId ) const {
+    SceneNodeTransform transform;
+    transform.translation          = translation[ nodeId ];
+    transform.rotationOffset       = rotationOffset[ nodeId ];
+    transform.rotationPivot        = rotationPivot[ nodeId ];
+    transform.preRotation          = preRotation[ nodeId ];
+    transform.postRotation         = postRotation[ nodeId ];
+    transform.rotation             = rotation[ nodeId ];
+    transform.scalingOffset        = scalingOffset[ nodeId ];
+    transform.scalingPivot         = scalingPivot[ nodeId ];
+    transform.scaling              = scaling[ nodeId ];
+    transform.geometricTranslation = geometricTranslation[ nodeId ];
+    transform.geometricRotation    = geometricRotation[ nodeId ];
+    transform.geometricScaling     = geometricScaling[ nodeId ];
+    return transform;
+}
+
+void apemode::SceneTransformChannels::Set( uint32_t nodeId, SceneNodeTransform const &transform ) {
+    translation[ nodeId ]          = transform.translation;
+    rotationOffset[ nodeId ]       = transform.rotationOffset;
+    rotationPivot[ nodeId ]        = transform.rotationPivot;
+    preRotation[ nodeId ]          = transform.preRotation;
+    postRotation[ nodeId ]         = transform.postRotation;
+    rotation[ nodeId ]             = transform.rotation;
+    scalingOffset[ nodeId ]        = transform.scalingOffset;
+    scalingPivot[ nodeId ]         = transform.scalingPivot;
+    scaling[ nodeId ]              = transform.scaling;
+    geometricTranslation[ nodeId ] = transform.geometricTranslation;
+    geometricRotation[ nodeId ]    = transform.geometricRotation;
+    geometricScaling[ nodeId ]     = transform.geometricScaling;
+
+    /* Same order as in SceneNodeTransform::CalculateLocalMatrix(). */
+    rotationQuat[ nodeId ] = mathfu::quat::FromEulerAngles( transform.preRotation ) *
+                             mathfu::quat::FromEulerAngles( transform.rotation ) *
+                             mathfu::quat::FromEulerAngles( transform.postRotation );
+    geometricRotationQuat[ nodeId ] = mathfu::quat::FromEulerAngles( transform.geometricRotation );
+}
+
+namespace {
+
+    /**
+     * Writes the affine matrix (3x3 rotation-scale and translation) as column-major 4x4 matrix.
+     **/
+    inline void StoreAffine( float *m, mathfu::mat3 const &r, mathfu::vec3 const &s, mathfu::vec3 const &t ) {
+        m[ 0 ]  = r( 0, 0 ) * s.x; m[ 1 ]  = r( 1, 0 ) * s.x; m[ 2 ]  = r( 2, 0 ) * s.x; m[ 3 ]  = 0;
+        m[ 4 ]  = r( 0, 1 ) * s.y; m[ 5 ]  = r( 1, 1 ) * s.y; m[ 6 ]  = r( 2, 1 ) * s.y; m[ 7 ]  = 0;
+        m[ 8 ]  = r( 0, 2 ) * s.z; m[ 9 ]  = r( 1, 2 ) * s.z; m[ 10 ] = r( 2, 2 ) * s.z; m[ 11 ] = 0;
+        m[ 12 ] = t.x;             m[ 13 ] = t.y;             m[ 14 ] = t.z;             m[ 15 ] = 1;
+    }
+
+    /**
+     * Multiplies the affine column-major matrices (the last rows are assumed to be [0 0 0 1]): c = a * b.
+     * @note c may not alias a or b.
+     **/
+    inline void MultiplyAffine( float *c, const float *a, const float *b ) {
+#ifdef APEMODE_SCENE_SSE
+        const __m128 a0 = _mm_loadu_ps( a + 0 );
+        const __m128 a1 = _mm_loadu_ps( a + 4 );
+        const __m128 a2 = _mm_loadu_ps( a + 8 );
+        const __m128 a3 = _mm_loadu_ps( a + 12 );
+
+        for ( uint32_t j = 0; j < 4; ++j ) {
+            const float *bj = b + j * 4;
+            __m128 cj = _mm_add_ps( _mm_add_ps( _mm_mul_ps( a0, _mm_set1_ps( bj[ 0 ] ) ),
+                                                _mm_mul_ps( a1, _mm_set1_ps( bj[ 1 ] ) ) ),
+                                    _mm_mul_ps( a2, _mm_set1_ps( bj[ 2 ] ) ) );
+            if ( j == 3 )
+                cj = _mm_add_ps( cj, a3 );
+            _mm_storeu_ps( c + j * 4, cj );
+        }
+#else
+        for ( uint32_t j = 0; j < 4; ++j ) {
+            const float *bj = b + j * 4;
+            for ( uint32_t i = 0; i < 4; ++i ) {
+                c[ j * 4 + i ] = a[ i ] * bj[ 0 ] + a[ 4 + i ] * bj[ 1 ] + a[ 8 + i ] * bj[ 2 ] + ( j == 3 ? a[ 12 + i ] : 0.0f );
+            }
+        }
+#endif
+    }
+}
+
+void apemode::Scene::MarkAllDirty( ) {
+    ResizeMatrices( );
+
+    const uint32_t nodeCount = transforms.GetCount( );
+    std::fill( dirtyFlags.begin( ), dirtyFlags.begin( ) + nodeCount, uint8_t( eDirtyFlag_Local | eDirtyFlag_Geometric ) );
+    firstDirtyNodeId = nodeCount ? 0 : uint32_t( -1 );
+    dirtyNodeCount   = nodeCount;
+}
+
+void apemode::Scene::SetTransform( uint32_t nodeId, SceneNodeTransform const &transform ) {
+    ResizeMatrices( );
+
+    auto equal = []( mathfu::vec3 const &a, mathfu::vec3 const &b ) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+    const bool geometricChanged = false == equal( transforms.geometricTranslation[ nodeId ], transform.geometricTranslation ) ||
+                                  false == equal( transforms.geometricRotation[ nodeId ], transform.geometricRotation ) ||
+                                  false == equal( transforms.geometricScaling[ nodeId ], transform.geometricScaling );
+
+    transforms.Set( nodeId, transform );
+    MarkDirty( nodeId, geometricChanged ? eDirtyFlag_Local | eDirtyFlag_Geometric : eDirtyFlag_Local );
+}
+
+void apemode::Scene::UpdateMatrices( ) {
+    ResizeMatrices( );
+
+    updateStats                = SceneUpdateStats( );
+    updateStats.dirtyNodeCount = dirtyNodeCount;
+
+    const uint32_t nodeCount = transforms.GetCount( );
+    if ( 0 == dirtyNodeCount || nodeCount == 0 || nodes.empty( ) )
+        return;
+
+    /* Zero stamp is reserved for the nodes that were never updated. */
+    if ( 0 == ++updateStamp ) {
+        std::fill( updateStamps.begin( ), updateStamps.end( ), 0 );
+        updateStamp = 1;
+    }
+
+    auto localMatricesPtr        = reinterpret_cast< float * >( localMatrices.data( ) );
+    auto geometricMatricesPtr    = reinterpret_cast< float * >( geometricMatrices.data( ) );
+    auto hierarchicalMatricesPtr = reinterpret_cast< float * >( hierarchicalMatrices.data( ) );
+    auto worldMatricesPtr        = reinterpret_cast< float * >( worldMatrices.data( ) );
+
+    //
+    // The parents go before the children, so the node should be updated if it is dirty
+    // or if its parent was updated earlier in this pass (the geometric-only changes are rare,
+    // the hierarchical matrices of the children are recalculated for them too).
+    //
+
+    for ( uint32_t nodeId = firstDirtyNodeId; nodeId < nodeCount; ++nodeId ) {
+        const uint32_t flags         = dirtyFlags[ nodeId ];
+        const uint32_t parentId      = parentIds[ nodeId ];
+        const bool     parentUpdated = parentId != uint32_t( -1 ) && updateStamps[ parentId ] == updateStamp;
+        if ( 0 == flags && false == parentUpdated )
+            continue;
+
+        float *local        = localMatricesPtr + nodeId * 16;
+        float *geometric    = geometricMatricesPtr + nodeId * 16;
+        float *hierarchical = hierarchicalMatricesPtr + nodeId * 16;
+        float *world        = worldMatricesPtr + nodeId * 16;
+
+        if ( flags & eDirtyFlag_Local ) {
+
+            //
+            // T * Roff * Rp * R * Rp^-1 * Soff * Sp * S * Sp^-1 (see SceneNodeTransform::CalculateLocalMatrix())
+            // collapses into the rotation-scale R * S and the translation T + Roff + Rp + R * (Soff + Sp - S * Sp - Rp).
+            //
+
+            const mathfu::mat3  r  = transforms.rotationQuat[ nodeId ].ToMatrix( );
+            const mathfu::vec3 &s  = transforms.scaling[ nodeId ];
+            const mathfu::vec3 &sp = transforms.scalingPivot[ nodeId ];
+            const mathfu::vec3 &rp = transforms.rotationPivot[ nodeId ];
+            const mathfu::vec3  v  = transforms.scalingOffset[ nodeId ] + sp - s * sp - rp;
+            const mathfu::vec3  t  = transforms.translation[ nodeId ] + transforms.rotationOffset[ nodeId ] + rp + r * v;
+
+            StoreAffine( local, r, s, t );
+            ++updateStats.localMatrixCount;
+        }
+
+        if ( flags & eDirtyFlag_Geometric ) {
+            StoreAffine( geometric,
+                         transforms.geometricRotationQuat[ nodeId ].ToMatrix( ),
+                         transforms.geometricScaling[ nodeId ],
+                         transforms.geometricTranslation[ nodeId ] );
+            ++updateStats.geometricMatrixCount;
+        }
+
+        if ( ( flags & eDirtyFlag_Local ) || parentUpdated ) {
+            if ( parentId == uint32_t( -1 ) ) {
+                memcpy( hierarchical, local, sizeof( float ) * 16 );
+            } else {
+                assert( parentId < nodeId );
+                MultiplyAffine( hierarchical, hierarchicalMatricesPtr + parentId * 16, local );
+            }
+        }
+
+        MultiplyAffine( world, hierarchical, geometric );
+        updateStamps[ nodeId ] = updateStamp;
+        dirtyFlags[ nodeId ]   = 0;
+        ++updateStats.touchedNodeCount;
+    }
+
+    firstDirtyNodeId = uint32_t( -1 );
+    dirtyNodeCount   = 0;
+}
+
+void apemode::BenchmarkSceneTransforms( uint32_t nodeCount, uint32_t animatedPercentage, uint32_t iterationCount ) {
+    if ( 0 == nodeCount || 0 == iterationCount )
+        return;
+
+    //
+    // Synthetic scene: the parent of each node is one of the previous nodes,
+    // so the nodes are in valid order and the depth is random.
+    //
+
+    std::mt19937                            rng( 42 );
+    std::uniform_real_distribution< float > offsetDistribution( -10.0f, 10.0f );
+    std::uniform_real_distribution< float > angleDistribution( -float( M_PI ), float( M_PI ) );
+    std::uniform_real_distribution< float > scaleDistribution( 0.5f, 1.5f );
+
+    auto randomVec3 = [&]( std::uniform_real_distribution< float > &distribution ) {
+        return mathfu::vec3( distribution( rng ), distribution( rng ), distribution( rng ) );
+    };
+
+    Scene scene;
+    scene.sourceScene = nullptr;
+    scene.deviceAsset = nullptr;
+    scene.nodes.resize( nodeCount );
+    scene.parentIds.assign( nodeCount, uint32_t( -1 ) );
+    scene.transforms.Resize( nodeCount );
+
+    for ( uint32_t nodeId = 0; nodeId < nodeCount; ++nodeId ) {
+        auto &node = scene.nodes[ nodeId ];
+        node.id    = nodeId;
+        node.scene = &scene;
+
+        if ( nodeId ) {
+            const uint32_t parentId = std::uniform_int_distribution< uint32_t >( 0, nodeId - 1 )( rng );
+            node.parentId             = parentId;
+            scene.parentIds[ nodeId ] = parentId;
+            scene.nodes[ parentId ].childIds.push_back( nodeId );
+        }
+
+        SceneNodeTransform transform;
+        transform.translation          = randomVec3( offsetDistribution );
+        transform.rotationOffset       = randomVec3( offsetDistribution );
+        transform.rotationPivot        = randomVec3( offsetDistribution );
+        transform.preRotation          = randomVec3( angleDistribution );
+        transform.rotation             = randomVec3( angleDistribution );
+        transform.postRotation         = randomVec3( angleDistribution );
+        transform.scalingOffset        = randomVec3( offsetDistribution );
+        transform.scalingPivot         = randomVec3( offsetDistribution );
+        transform.scaling              = randomVec3( scaleDistribution );
+        transform.geometricTranslation = randomVec3( offsetDistribution );
+        transform.geometricRotation    = randomVec3( angleDistribution );
+        transform.geometricScaling     = randomVec3( scaleDistribution );
+        scene.transforms.Set( nodeId, transform );
+    }
+
+    auto measure = [&]( void ( Scene::*pUpdateMatrices )( ) ) {
+        double elapsedMs = 0;
+        for ( uint32_t i = 0; i <= iterationCount; ++i ) {
+            scene.MarkAllDirty( );
+            auto start = std::chrono::high_resolution_clock::now( );
+            ( scene.*pUpdateMatrices )( );
+            std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - start;
+            elapsedMs += i ? elapsed.count( ) : 0.0; /* Warm up */
+        }
+        return elapsedMs / iterationCount;
+    };
+
+    /* Relative to the magnitude, the deep chains have large translations. */
+    auto measureError = [&]( std::vector< mathfu::mat4 > const &referenceMatrices ) {
+        float maxError = 0;
+        for ( uint32_t nodeId = 0; nodeId < nodeCount; ++nodeId ) {
+            const float *a = reinterpret_cast< const float * >( &referenceMatrices[ nodeId ] );
+            const float *b = reinterpret_cast< const float * >( &scene.worldMatrices[ nodeId ] );
+            for ( uint32_t i = 0; i < 16; ++i ) {
+                const float magnitude = fabsf( a[ i ] ) > 1.0f ? fabsf( a[ i ] ) : 1.0f;
+                const float error     = fabsf( a[ i ] - b[ i ] ) / magnitude;
+                maxError = error > maxError ? error : maxError;
+            }
+        }
+        return maxError;
+    };
+
+    const double recursiveMs = measure( &Scene::UpdateMatricesRecursive );
+    std::vector< mathfu::mat4 > referenceMatrices = scene.worldMatrices;
+    const double linearMs = measure( &Scene::UpdateMatrices );
+    const float  maxError = measureError( referenceMatrices );
+
+    //
+    // Incremental updates: the same random nodes are animated each iteration, the rest are static.
+    //
+
+    const uint32_t animatedNodeCount = std::max< uint32_t >( 1, uint32_t( uint64_t( nodeCount ) * animatedPercentage / 100 ) );
+    std::vector< uint32_t > animatedNodeIds( animatedNodeCount );
+    for ( auto &nodeId : animatedNodeIds )
+        nodeId = std::uniform_int_distribution< uint32_t >( 0, nodeCount - 1 )( rng );
+
+    double   incrementalMs    = 0;
+    uint64_t touchedNodeCount = 0;
+    for ( uint32_t i = 0; i < iterationCount; ++i ) {
+        for ( auto nodeId : animatedNodeIds ) {
+            SceneNodeTransform transform = scene.transforms.Get( nodeId );
+            transform.rotation.y += 0.01f;
+            scene.SetTransform( nodeId, transform );
+        }
+
+        auto start = std::chrono::high_resolution_clock::now( );
+        scene.UpdateMatrices( );
+        std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - start;
+
+        incrementalMs += elapsed.count( );
+        touchedNodeCount += scene.updateStats.touchedNodeCount;
+    }
+
+    incrementalMs /= iterationCount;
+    touchedNodeCount /= iterationCount;
+
+    referenceMatrices = scene.worldMatrices;
+    scene.UpdateMatricesRecursive( );
+    const float incrementalMaxError = measureError( referenceMatrices );
+
+    if ( auto appState = apemode::AppState::GetCurrentState( ) ) {
+        if ( appState->consoleLogger ) {
+            appState->consoleLogger->info( "Transforms: {} nodes, {} iterations", nodeCount, iterationCount );
+            appState->consoleLogger->info( "Transforms: recursive {:.3f} ms, linear {:.3f} ms ({:.2f}x), max error {}",
+                                           recursiveMs,
+                                           linearMs,
+                                           linearMs > 0 ? recursiveMs / linearMs : 0.0,
+                                           maxError );
+            appState->consoleLogger->info( "Transforms: incremental {:.3f} ms ({}% animated, {} nodes), {} nodes touched, max error {}",
+                                           incrementalMs,
+                                           animatedPercentage,
+                                           animatedNodeCount,
+                                           touchedNodeCount,
+                                           incrementalMaxError );
+        }
+    }
+}
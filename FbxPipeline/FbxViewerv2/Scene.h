@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fbxvpch.h>
+#include <SceneBvh.h>
 
 namespace apemode {
     void *Malloc( size_t bytes );
@@ -16,18 +17,103 @@ namespace apemode {
     };
 
     struct SceneMeshSubset {
-        uint32_t materialId = -1;
-        uint32_t baseIndex  = 0;
-        uint32_t indexCount = 0;
+        uint32_t materialId   = -1;
+        uint32_t baseIndex    = 0;
+        uint32_t indexCount   = 0;
+        uint32_t submeshIndex = 0; /* The submesh with the quantization frame of the subset */
+        uint32_t baseCluster  = 0; /* Index in SceneMesh::clusters */
+        uint32_t clusterCount = 0; /* Zero if the meshlets were not exported */
+    };
+
+    /**
+     * Meshlet of the subset (see MeshletFb), the triangles are the contiguous index range of the subset.
+     * The clusters are culled against the frustum and with the normal cones, see SceneClusterCuller.
+     **/
+    struct SceneMeshCluster {
+        mathfu::vec3 center; /* Object space bounding sphere */
+        float        radius = 0;
+        mathfu::vec3 coneApex;
+        mathfu::vec3 coneAxis;
+        float        coneCutoff = 1; /* Never backfacing if it is 1 */
+        uint32_t     baseIndex  = 0; /* In the geometry buffer if it is shared */
+        uint32_t     indexCount = 0;
+    };
+
+    /**
+     * Simplified level of the mesh (see MeshLodFb), the subsets of the level are the contiguous range in SceneMesh::subsets.
+     * The first level is the full mesh, the levels share the vertices (and the submeshes) of the mesh.
+     **/
+    struct SceneMeshLod {
+        float    error       = 0; /* Object space, the max distance from the full mesh vertices to the level */
+        uint32_t baseSubset  = 0;
+        uint32_t subsetCount = 0;
+    };
+
+    /**
+     * Spatial chunk of the mesh with its own quantization frame (see SubmeshFb).
+     * The indices of all the submeshes are relative to the first vertex of the mesh.
+     **/
+    struct SceneMeshSubmesh {
+        mathfu::vec3 positionOffset;
+        mathfu::vec3 positionScale;
+        mathfu::vec2 texcoordOffset;
+        mathfu::vec2 texcoordScale;
+        mathfu::vec3 bboxMin;
+        mathfu::vec3 bboxMax;
+        uint32_t     baseVertex  = 0; /* Vertex offset in the mesh */
+        uint32_t     vertexCount = 0;
+    };
+
+    /**
+     * Scene-wide vertex and index buffers shared by the meshes (see GeometryBufferFb).
+     **/
+    struct SceneGeometryBuffer {
+        void *         deviceAsset  = nullptr;
+        const uint8_t *vertices     = nullptr; /* Points to the vector in the scene or to the container blob */
+        const uint8_t *indices      = nullptr; /* Points to the vector in the scene or to the container blob */
+        uint32_t       verticesSize = 0;
+        uint32_t       indicesSize  = 0;
+        uint32_t       vertexStride = 0;
+        uint32_t       indexType    = apemodefb::EIndexTypeFb_UInt16;
+    };
+
+    /**
+     * Distinct vertex layout of the meshes (see VertexLayoutFb), the renderers create a pipeline per layout.
+     **/
+    struct SceneVertexLayout {
+        apemodefb::VertexLayoutFb layout;
+        uint32_t                  vertexStride = 0;
     };
 
     struct SceneMesh {
-        void *                         deviceAsset;
-        std::vector< SceneMeshSubset > subsets;
-        mathfu::vec3                   positionOffset;
-        mathfu::vec3                   positionScale;
-        mathfu::vec2                   texcoordOffset;
-        mathfu::vec2                   texcoordScale;
+        void *                          deviceAsset;
+        const uint8_t *                 vertices         = nullptr; /* Points to the vector in the scene or to the container blob */
+        const uint8_t *                 indices          = nullptr; /* Points to the vector in the scene or to the container blob */
+        uint32_t                        verticesSize     = 0;
+        uint32_t                        indicesSize      = 0;
+        uint32_t                        geometryBufferId = -1; /* Set if the buffers are shared, the vertices and indices are null then */
+        uint32_t                        baseVertex       = 0;  /* Vertex offset in the geometry buffer */
+        uint32_t                        vertexCount      = 0;
+        uint32_t                        vertexStride     = 0;
+        uint32_t                        vertexFormat     = apemodefb::EVertexFormat_Packed;
+        uint32_t                        vertexLayoutId   = 0;  /* Index in Scene::vertexLayouts */
+        uint32_t                        skinId           = -1; /* Set if the vertex format is Skinned */
+        std::vector< SceneMeshSubset >  subsets;         /* Index ranges in the geometry buffer if it is shared */
+        std::vector< SceneMeshSubmesh > submeshes;       /* At least one, the spatial chunks of the mesh */
+        std::vector< SceneMeshCluster > clusters;        /* In the subset order, empty if the meshlets were not exported */
+        std::vector< SceneMeshLod >     lods;            /* Empty if the levels were not exported, all the subsets are the full mesh then */
+        mathfu::vec3                    bboxMin; /* Object space, all the submeshes, see SceneCuller */
+        mathfu::vec3                    bboxMax;
+    };
+
+    /**
+     * Joints of the skinned meshes (see SkinFb), the joint node ids are remapped to the scene node ids.
+     * The skinned vertex is sum( weight * hierarchical matrix of the joint * inverse bind matrix * vertex ).
+     **/
+    struct SceneSkin {
+        std::vector< uint32_t >     jointNodeIds;       /* -1 if the joint node is missing */
+        std::vector< uint32_t >     jointParentIndices; /* -1 for the root joints */
+        std::vector< mathfu::mat4 > inverseBindMatrices;
     };
 
     /**
@@ -103,6 +189,43 @@ namespace apemode {
         }
     };
 
+    /**
+     * Transform properties of the nodes in SoA layout (one array per property, indexed by node id).
+     * The rotations are also stored as quaternions (pre-rotation, rotation and post-rotation are combined),
+     * they are converted from Euler angles once the transform is set, so that the matrix updates do not need trigonometry.
+     **/
+    struct SceneTransformChannels {
+        std::vector< mathfu::vec3 > translation;
+        std::vector< mathfu::vec3 > rotationOffset;
+        std::vector< mathfu::vec3 > rotationPivot;
+        std::vector< mathfu::vec3 > preRotation;
+        std::vector< mathfu::vec3 > postRotation;
+        std::vector< mathfu::vec3 > rotation;
+        std::vector< mathfu::vec3 > scalingOffset;
+        std::vector< mathfu::vec3 > scalingPivot;
+        std::vector< mathfu::vec3 > scaling;
+        std::vector< mathfu::vec3 > geometricTranslation;
+        std::vector< mathfu::vec3 > geometricRotation;
+        std::vector< mathfu::vec3 > geometricScaling;
+        std::vector< mathfu::quat > rotationQuat;          /* Pre-rotation * rotation * post-rotation */
+        std::vector< mathfu::quat > geometricRotationQuat;
+
+        uint32_t           GetCount( ) const;
+        void               Resize( uint32_t count );
+        SceneNodeTransform Get( uint32_t nodeId ) const;
+        void               Set( uint32_t nodeId, SceneNodeTransform const &transform );
+    };
+
+    /**
+     * Counters of the last Scene::UpdateMatrices() call.
+     **/
+    struct SceneUpdateStats {
+        uint32_t dirtyNodeCount       = 0; /* Nodes marked dirty */
+        uint32_t touchedNodeCount     = 0; /* Nodes with the recalculated world matrices */
+        uint32_t localMatrixCount     = 0; /* Recalculated local matrices */
+        uint32_t geometricMatrixCount = 0; /* Recalculated geometric matrices */
+    };
+
     class Scene;
     struct SceneNode {
         void *                  deviceAsset;
@@ -120,13 +243,17 @@ namespace apemode {
         // Scene components
         //
 
-        std::string sourceData;
+        MappedFile                sourceFile;  /* Read-only mapping, the scene and the mesh buffers point into it */
         const apemodefb::SceneFb *sourceScene;
 
-        std::vector< SceneNode >          nodes;
-        std::vector< SceneNodeTransform > transforms;
-        std::vector< SceneMesh >          meshes;
-        std::vector< SceneMaterial >      materials;
+        std::vector< SceneNode >           nodes;     /* Breadth-first order (parents go before children), ids are the indices */
+        std::vector< uint32_t >            parentIds; /* Parent node ids, -1 for the roots */
+        SceneTransformChannels             transforms;
+        std::vector< SceneMesh >           meshes;
+        std::vector< SceneGeometryBuffer > geometryBuffers;
+        std::vector< SceneMaterial >       materials;
+        std::vector< SceneSkin >           skins;
+        std::vector< SceneVertexLayout >   vertexLayouts;
 
         //
         // Transform matrices storage.
@@ -139,51 +266,117 @@ namespace apemode {
 
         void *deviceAsset;
 
+        //
+        // Incremental updates.
+        //
+
+        enum EDirtyFlags {
+            eDirtyFlag_Local     = 1, /* Local matrix, propagates to the hierarchical matrices of the subtree */
+            eDirtyFlag_Geometric = 2, /* Geometric matrix, stays cached after the load otherwise */
+        };
+
+        std::vector< uint8_t >  dirtyFlags;            /* EDirtyFlags per node */
+        std::vector< uint32_t > updateStamps;          /* Last update the world matrix was recalculated in, @see SceneBvh::Refit() */
+        uint32_t                updateStamp      = 0;
+        uint32_t                firstDirtyNodeId = -1; /* Nothing before it needs updates (parents go before children) */
+        uint32_t                dirtyNodeCount   = 0;
+        SceneUpdateStats        updateStats;           /* Last UpdateMatrices() call */
+
+        //
+        // Spatial queries.
+        //
+
+        SceneBvh bvh; /* Built on load, refit after the updates (@see SceneBvh::Refit()) */
+
+        /**
+         * Resizes matrices storage if needed, the new nodes are marked dirty.
+         **/
+        inline void ResizeMatrices( ) {
+            const uint32_t nodeCount = transforms.GetCount( );
+            if ( localMatrices.size( ) < nodeCount ) {
+                const uint32_t prevNodeCount = uint32_t( localMatrices.size( ) );
+
+                localMatrices.resize( nodeCount );
+                worldMatrices.resize( nodeCount );
+                geometricMatrices.resize( nodeCount );
+                hierarchicalMatrices.resize( nodeCount );
+                dirtyFlags.resize( nodeCount, 0 );
+                updateStamps.resize( nodeCount, 0 );
+
+                for ( uint32_t nodeId = prevNodeCount; nodeId < nodeCount; ++nodeId )
+                    MarkDirty( nodeId, eDirtyFlag_Local | eDirtyFlag_Geometric );
+            }
+        }
+
+        /**
+         * Schedules the matrices of the node (and the hierarchical and world matrices of its subtree) for the next update.
+         * @note Use it after changing the transforms with SceneTransformChannels::Set(), @see SetTransform().
+         **/
+        inline void MarkDirty( uint32_t nodeId, uint32_t flags = eDirtyFlag_Local ) {
+            assert( nodeId < dirtyFlags.size( ) );
+            if ( 0 == dirtyFlags[ nodeId ] )
+                ++dirtyNodeCount;
+
+            dirtyFlags[ nodeId ] |= uint8_t( flags );
+            firstDirtyNodeId = nodeId < firstDirtyNodeId ? nodeId : firstDirtyNodeId;
+        }
+
+        /**
+         * Schedules the full update (all the nodes are dirty).
+         **/
+        void MarkAllDirty( );
+
+        /**
+         * Sets the transform and marks the node dirty (the geometric matrix only if the geometric transform has changed).
+         **/
+        void SetTransform( uint32_t nodeId, SceneNodeTransform const &transform );
+
+        /**
+         * Update matrices storage with up-to-date values.
+         * The nodes are processed in one linear pass in their order (no recursion),
+         * the parent matrices are always ready since the parents go before the children.
+         * Only the dirty nodes and their subtrees are recalculated, the call is almost free if nothing has moved.
+         * @see MarkDirty(), updateStats.
+         **/
+        void UpdateMatrices( );
+
         /**
          * Internal usage only.
-         * @see UpdateMatrices().
-         * @todo Safety assertions.
+         * @see UpdateMatricesRecursive().
          **/
-        inline void UpdateChildWorldMatrices( uint32_t nodeId ) {
+        inline void UpdateChildWorldMatricesRecursive( uint32_t nodeId ) {
             for ( auto& childId : nodes[ nodeId ].childIds ) {
+                const SceneNodeTransform transform = transforms.Get( childId );
 
-                localMatrices[ childId ]        = transforms[ childId ].CalculateLocalMatrix( );
-                geometricMatrices[ childId ]    = transforms[ childId ].CalculateGeometricMatrix( );
+                localMatrices[ childId ]        = transform.CalculateLocalMatrix( );
+                geometricMatrices[ childId ]    = transform.CalculateGeometricMatrix( );
                 hierarchicalMatrices[ childId ] = hierarchicalMatrices[ nodes[ childId ].parentId ] * localMatrices[ childId ];
                 worldMatrices[ childId ]        = hierarchicalMatrices[ childId ] * geometricMatrices[ childId ];
 
                 if ( false == nodes[ childId ].childIds.empty( ) )
-                    UpdateChildWorldMatrices( childId );
+                    UpdateChildWorldMatricesRecursive( childId );
             }
         }
 
         /**
-         * Update matrices storage with up-to-date values.
-         * @todo Non-recursive, no dynamic memory?
-         *       Currently, I tried to avoid any stack memory pollution,
-         *       tried to avoid any local variable but kept it clean.
+         * Reference implementation of UpdateMatrices(), walks the hierarchy recursively from the root node.
+         * Recalculates all the matrices, the dirty flags are ignored.
+         * @see BenchmarkSceneTransforms().
          **/
-        inline void UpdateMatrices() {
-            if ( transforms.empty( ) || nodes.empty( ) )
+        inline void UpdateMatricesRecursive( ) {
+            if ( transforms.GetCount( ) == 0 || nodes.empty( ) )
                 return;
 
-            //
-            // Resize matrices storage if needed
-            //
-
-            if ( localMatrices.size( ) < transforms.size( ) ) {
-                localMatrices.resize( transforms.size( ) );
-                worldMatrices.resize( transforms.size( ) );
-                geometricMatrices.resize( transforms.size( ) );
-                hierarchicalMatrices.resize( transforms.size( ) );
-            }
+            ResizeMatrices( );
 
             //
             // Implicit world calculations for the root node.
             //
 
-            localMatrices[ 0 ]        = transforms[ 0 ].CalculateLocalMatrix( );
-            geometricMatrices[ 0 ]    = transforms[ 0 ].CalculateGeometricMatrix( );
+            const SceneNodeTransform rootTransform = transforms.Get( 0 );
+
+            localMatrices[ 0 ]        = rootTransform.CalculateLocalMatrix( );
+            geometricMatrices[ 0 ]    = rootTransform.CalculateGeometricMatrix( );
             hierarchicalMatrices[ 0 ] = localMatrices[ 0 ];
             worldMatrices[ 0 ]        = localMatrices[ 0 ] * geometricMatrices[ 0 ];
 
@@ -191,7 +384,7 @@ namespace apemode {
             // Start recursive updates from root node.
             //
 
-            UpdateChildWorldMatrices( 0 );
+            UpdateChildWorldMatricesRecursive( 0 );
         }
 
         template < typename TNodeIdCallback >
@@ -208,10 +401,53 @@ namespace apemode {
         }
     };
 
+    /**
+     * Builds the synthetic hierarchy of random transforms and compares UpdateMatricesRecursive()
+     * and the full UpdateMatrices() pass, then measures the incremental updates with the given percentage
+     * of the animated nodes (timings, touched nodes and the max relative error of the world matrices go to the console).
+     **/
+    void BenchmarkSceneTransforms( uint32_t nodeCount, uint32_t animatedPercentage = 1, uint32_t iterationCount = 16 );
+
+    /**
+     * Checks that the range is inside the mapped file (the offset plus the size is not calculated, it can overflow).
+     **/
+    inline bool IsFileRangeValid( MappedFile const &file, uint64_t offset, uint64_t size ) {
+        const uint64_t fileSize = file.GetSize( );
+        return size <= fileSize && offset <= fileSize - size;
+    }
+
+    /**
+     * Returns the verified scene buffer of the mapped file.
+     * The file is either the scene buffer itself or the container (see ContainerHeaderFb)
+     * with the scene buffer after the blobs.
+     **/
+    inline const apemodefb::SceneFb *GetSceneFromFile( MappedFile const &file ) {
+        const uint8_t *sceneData = file.GetData( );
+        size_t         sceneSize = file.GetSize( );
+
+        auto header = reinterpret_cast< const apemodefb::ContainerHeaderFb * >( file.GetData( ) );
+        if ( file.GetSize( ) >= sizeof( apemodefb::ContainerHeaderFb ) && header->magic( ) == apemodefb::EContainerFb_Magic ) {
+            if ( false == IsFileRangeValid( file, header->scene_offset( ), header->scene_size( ) ) ) {
+                return nullptr;
+            }
+
+            sceneData = file.GetData( ) + header->scene_offset( );
+            sceneSize = (size_t) header->scene_size( );
+        }
+
+        /* The verifier only reads the tables, the mesh buffers are not touched. */
+        flatbuffers::Verifier verifier( sceneData, sceneSize, 64, 100000000 );
+        if ( false == apemodefb::VerifySceneFbBuffer( verifier ) ) {
+            return nullptr;
+        }
+
+        return apemodefb::GetSceneFb( sceneData );
+    }
+
     inline Scene * LoadSceneFromFile(const char * filename) {
         std::unique_ptr< Scene > scene( new Scene( ) );
-        if ( flatbuffers::LoadFile( filename, true, &scene->sourceData ) ) {
-            if ( scene->sourceScene = apemodefb::GetSceneFb( scene->sourceData.c_str( ) ) ) {
+        if ( scene->sourceFile.Open( filename ) ) {
+            if ( scene->sourceScene = GetSceneFromFile( scene->sourceFile ) ) {
 
 
                 //
@@ -220,18 +456,62 @@ namespace apemode {
                 // the viewer stable to scene generated header changes.
                 //
 
+                std::vector< uint32_t > nodeIds; /* File node id -> node id */
+
                 if ( auto nodesFb = scene->sourceScene->nodes( ) ) {
-                    scene->nodes.resize( nodesFb->size( ) );
-                    scene->transforms.resize( nodesFb->size( ) );
+                    const uint32_t nodeCount = nodesFb->size( );
 
-                    const float toRadsFactor = float( M_PI ) / 180.0f;
+                    //
+                    // The nodes are stored in breadth-first order, so that the parents always go before
+                    // their children and the matrices can be updated in a single linear pass.
+                    // File node ids are remapped to the positions in this order.
+                    //
+
+                    std::vector< const apemodefb::NodeFb* > nodesFbById( nodeCount, nullptr );
+                    std::vector< uint32_t >                 sourceIds; /* Node id -> file node id */
+                    std::vector< bool >                     hasParent( nodeCount, false );
+
+                    nodeIds.assign( nodeCount, uint32_t( -1 ) );
 
                     for ( auto nodeFb : *nodesFb ) {
-                        assert( nodeFb );
+                        assert( nodeFb && nodeFb->id( ) < nodeCount );
+                        nodesFbById[ nodeFb->id( ) ] = nodeFb;
+                        if ( auto childIdsFb = nodeFb->child_ids( ) )
+                            for ( auto childId : *childIdsFb )
+                                if ( childId < nodeCount )
+                                    hasParent[ childId ] = true;
+                    }
+
+                    sourceIds.reserve( nodeCount );
+                    for ( uint32_t rootId = 0; rootId < nodeCount; ++rootId ) {
+                        if ( hasParent[ rootId ] || nullptr == nodesFbById[ rootId ] )
+                            continue;
+
+                        nodeIds[ rootId ] = uint32_t( sourceIds.size( ) );
+                        sourceIds.push_back( rootId );
+
+                        for ( size_t head = sourceIds.size( ) - 1; head < sourceIds.size( ); ++head ) {
+                            if ( auto childIdsFb = nodesFbById[ sourceIds[ head ] ]->child_ids( ) )
+                                for ( auto childId : *childIdsFb ) {
+                                    if ( childId < nodeCount && nodesFbById[ childId ] && uint32_t( -1 ) == nodeIds[ childId ] ) {
+                                        nodeIds[ childId ] = uint32_t( sourceIds.size( ) );
+                                        sourceIds.push_back( childId );
+                                    }
+                                }
+                        }
+                    }
+
+                    scene->nodes.resize( sourceIds.size( ) );
+                    scene->parentIds.assign( sourceIds.size( ), uint32_t( -1 ) );
+                    scene->transforms.Resize( uint32_t( sourceIds.size( ) ) );
+
+                    const float toRadsFactor = float( M_PI ) / 180.0f;
 
-                        auto& node = scene->nodes[ nodeFb->id( ) ];
+                    for ( uint32_t nodeId = 0; nodeId < sourceIds.size( ); ++nodeId ) {
+                        auto nodeFb = nodesFbById[ sourceIds[ nodeId ] ];
+                        auto& node  = scene->nodes[ nodeId ];
 
-                        node.id     = nodeFb->id( );
+                        node.id     = nodeId;
                         node.scene  = scene.get( );
                         node.meshId = nodeFb->mesh_id( );
 
@@ -246,13 +526,21 @@ namespace apemode {
                         // We can set them with no additional effort or data at this stage.
                         //
 
-                        auto childIdsIt = nodeFb->child_ids( )->data( );
-                        auto childIdsEndIt = childIdsIt + nodeFb->child_ids( )->size( );
-                        std::transform( childIdsIt, childIdsEndIt, std::back_inserter( node.childIds ), [&]( auto id ) {
-                            auto& childNode = scene->nodes[ id ];
-                            childNode.parentId = node.id;
-                            return id;
-                        } );
+                        if ( auto childIdsFb = nodeFb->child_ids( ) ) {
+                            for ( auto childId : *childIdsFb ) {
+                                if ( childId >= nodeCount || uint32_t( -1 ) == nodeIds[ childId ] )
+                                    continue;
+
+                                /* The node could be listed as a child by multiple parents, the first one is kept. */
+                                const uint32_t sceneChildId = nodeIds[ childId ];
+                                if ( scene->parentIds[ sceneChildId ] != uint32_t( -1 ) || sceneChildId <= nodeId )
+                                    continue;
+
+                                scene->nodes[ sceneChildId ].parentId = nodeId;
+                                scene->parentIds[ sceneChildId ]      = nodeId;
+                                node.childIds.push_back( sceneChildId );
+                            }
+                        }
 
                         if (nodeFb->material_ids() && nodeFb->material_ids()->size()) {
                             auto matIdsIt    = nodeFb->material_ids( )->data( );
@@ -260,8 +548,8 @@ namespace apemode {
                             std::transform( matIdsIt, matIdsEndIt, std::back_inserter( node.materialIds ), [&]( auto id ) { return id; } );
                         }
 
-                        auto& transform   = scene->transforms[ nodeFb->id( ) ];
-                        auto  transformFb = ( *scene->sourceScene->transforms( ) )[ nodeFb->id( ) ];
+                        SceneNodeTransform transform;
+                        auto transformFb = ( *scene->sourceScene->transforms( ) )[ nodeFb->id( ) ];
 
                         transform.translation.x          = transformFb->translation( ).x( );
                         transform.translation.y          = transformFb->translation( ).y( );
@@ -301,38 +589,179 @@ namespace apemode {
                         transform.geometricScaling.z     = transformFb->geometric_scaling( ).z( );
 
                         assert( transform.Validate( ) );
+                        scene->transforms.Set( nodeId, transform );
                     }
 
                     scene->UpdateMatrices( );
                 }
 
+                if ( auto geometryBuffersFb = scene->sourceScene->geometry_buffers( ) ) {
+                    scene->geometryBuffers.reserve( geometryBuffersFb->size( ) );
+
+                    for ( auto geometryBufferFb : *geometryBuffersFb ) {
+                        assert( geometryBufferFb );
+
+                        scene->geometryBuffers.emplace_back( );
+                        auto &geometryBuffer = scene->geometryBuffers.back( );
+
+                        geometryBuffer.vertexStride = geometryBufferFb->vertex_stride( );
+                        geometryBuffer.indexType    = geometryBufferFb->index_type( );
+
+                        auto fileData = scene->sourceFile.GetData( );
+                        if ( geometryBufferFb->vertices( ) ) {
+                            geometryBuffer.vertices     = geometryBufferFb->vertices( )->Data( );
+                            geometryBuffer.verticesSize = geometryBufferFb->vertices( )->size( );
+                        } else if ( auto blobFb = geometryBufferFb->vertices_blob( ) ) {
+                            if ( false == IsFileRangeValid( scene->sourceFile, blobFb->offset( ), blobFb->size( ) ) )
+                                return nullptr;
+                            geometryBuffer.vertices     = fileData + blobFb->offset( );
+                            geometryBuffer.verticesSize = (uint32_t) blobFb->size( );
+                        }
+
+                        if ( geometryBufferFb->indices( ) ) {
+                            geometryBuffer.indices     = geometryBufferFb->indices( )->Data( );
+                            geometryBuffer.indicesSize = geometryBufferFb->indices( )->size( );
+                        } else if ( auto blobFb = geometryBufferFb->indices_blob( ) ) {
+                            if ( false == IsFileRangeValid( scene->sourceFile, blobFb->offset( ), blobFb->size( ) ) )
+                                return nullptr;
+                            geometryBuffer.indices     = fileData + blobFb->offset( );
+                            geometryBuffer.indicesSize = (uint32_t) blobFb->size( );
+                        }
+
+                        if ( nullptr == geometryBuffer.vertices || 0 == geometryBuffer.verticesSize ||
+                             nullptr == geometryBuffer.indices || 0 == geometryBuffer.indicesSize )
+                            return nullptr;
+                    }
+                }
+
                 if ( auto meshesFb = scene->sourceScene->meshes( ) ) {
                     //PackedVertex::InitializeOnce( );
                     scene->meshes.reserve( meshesFb->size( ) );
 
                     for ( auto meshFb : *meshesFb ) {
                         assert( meshFb );
-                        assert( meshFb->vertices( ) && meshFb->vertices( )->size( ) );
-                        assert( meshFb->submeshes( ) && meshFb->submeshes( )->size( ) == 1 );
+                        if ( nullptr == meshFb->submeshes( ) || 0 == meshFb->submeshes( )->size( ) )
+                            return nullptr;
 
                         scene->meshes.emplace_back( );
                         auto &mesh = scene->meshes.back( );
 
+                        //
+                        // The mesh buffers are either stored inline or appended to the container.
+                        //
+
+                        auto fileData = scene->sourceFile.GetData( );
+                        if ( meshFb->vertices( ) ) {
+                            mesh.vertices     = meshFb->vertices( )->Data( );
+                            mesh.verticesSize = meshFb->vertices( )->size( );
+                        } else if ( auto blobFb = meshFb->vertices_blob( ) ) {
+                            if ( false == IsFileRangeValid( scene->sourceFile, blobFb->offset( ), blobFb->size( ) ) )
+                                return nullptr;
+                            mesh.vertices     = fileData + blobFb->offset( );
+                            mesh.verticesSize = (uint32_t) blobFb->size( );
+                        }
+
+                        if ( meshFb->indices( ) ) {
+                            mesh.indices     = meshFb->indices( )->Data( );
+                            mesh.indicesSize = meshFb->indices( )->size( );
+                        } else if ( auto blobFb = meshFb->indices_blob( ) ) {
+                            if ( false == IsFileRangeValid( scene->sourceFile, blobFb->offset( ), blobFb->size( ) ) )
+                                return nullptr;
+                            mesh.indices     = fileData + blobFb->offset( );
+                            mesh.indicesSize = (uint32_t) blobFb->size( );
+                        }
+
+                        //
+                        // The merged mesh draws from the shared buffers with the vertex offset.
+                        //
+
+                        if ( meshFb->geometry_buffer_id( ) < scene->geometryBuffers.size( ) ) {
+                            mesh.geometryBufferId = meshFb->geometry_buffer_id( );
+                        }
+
+                        if ( scene->sourceScene->skins( ) && meshFb->skin_id( ) < scene->sourceScene->skins( )->size( ) ) {
+                            mesh.skinId = meshFb->skin_id( );
+                        }
+
+                        /* Either the own buffers or the shared ones. */
+                        if ( mesh.geometryBufferId == uint32_t( -1 ) && ( nullptr == mesh.vertices || 0 == mesh.verticesSize ||
+                                                                          nullptr == mesh.indices || 0 == mesh.indicesSize ) )
+                            return nullptr;
+
                         if ( auto submeshesFb = meshFb->submeshes( ) ) {
                             auto submeshFb = (const apemodefb::SubmeshFb *) submeshesFb->Data( );
 
-                            mesh.positionOffset.x = submeshFb->position_offset( ).x( );
-                            mesh.positionOffset.y = submeshFb->position_offset( ).y( );
-                            mesh.positionOffset.z = submeshFb->position_offset( ).z( );
-                            mesh.positionScale.x  = submeshFb->position_scale( ).x( );
-                            mesh.positionScale.y  = submeshFb->position_scale( ).y( );
-                            mesh.positionScale.z  = submeshFb->position_scale( ).z( );
-                            mesh.texcoordOffset.x = submeshFb->uv_offset( ).x( );
-                            mesh.texcoordOffset.y = submeshFb->uv_offset( ).y( );
-                            mesh.texcoordScale.x  = submeshFb->uv_scale( ).x( );
-                            mesh.texcoordScale.y  = submeshFb->uv_scale( ).y( );
+                            /* The submeshes share the vertex format, they differ in the vertex ranges and the quantization frames. */
+                            mesh.baseVertex   = mesh.geometryBufferId != uint32_t( -1 ) ? submeshFb->base_vertex( ) : 0;
+                            mesh.vertexCount  = submeshFb->vertex_count( );
+                            mesh.vertexStride = submeshFb->vertex_stride( );
+                            mesh.vertexFormat = submeshFb->vertex_format( );
+
+                            auto layoutIt = std::find_if( scene->vertexLayouts.begin( ),
+                                                          scene->vertexLayouts.end( ),
+                                                          [&]( const SceneVertexLayout &vertexLayout ) {
+                                                              return vertexLayout.vertexStride == mesh.vertexStride &&
+                                                                     0 == memcmp( &vertexLayout.layout,
+                                                                                  &submeshFb->vertex_layout( ),
+                                                                                  sizeof( apemodefb::VertexLayoutFb ) );
+                                                          } );
+
+                            mesh.vertexLayoutId = (uint32_t) std::distance( scene->vertexLayouts.begin( ), layoutIt );
+                            if ( layoutIt == scene->vertexLayouts.end( ) ) {
+                                scene->vertexLayouts.emplace_back( );
+                                scene->vertexLayouts.back( ).layout       = submeshFb->vertex_layout( );
+                                scene->vertexLayouts.back( ).vertexStride = mesh.vertexStride;
+                            }
+
+                            mesh.submeshes.reserve( submeshesFb->size( ) );
+
+                            for ( uint32_t i = 0; i < submeshesFb->size( ); ++i ) {
+                                auto chunkFb = submeshFb + i;
+
+                                mesh.submeshes.emplace_back( );
+                                auto &submesh = mesh.submeshes.back( );
+
+                                submesh.positionOffset.x = chunkFb->position_offset( ).x( );
+                                submesh.positionOffset.y = chunkFb->position_offset( ).y( );
+                                submesh.positionOffset.z = chunkFb->position_offset( ).z( );
+                                submesh.positionScale.x  = chunkFb->position_scale( ).x( );
+                                submesh.positionScale.y  = chunkFb->position_scale( ).y( );
+                                submesh.positionScale.z  = chunkFb->position_scale( ).z( );
+                                submesh.bboxMin.x        = chunkFb->bbox_min( ).x( );
+                                submesh.bboxMin.y        = chunkFb->bbox_min( ).y( );
+                                submesh.bboxMin.z        = chunkFb->bbox_min( ).z( );
+                                submesh.bboxMax.x        = chunkFb->bbox_max( ).x( );
+                                submesh.bboxMax.y        = chunkFb->bbox_max( ).y( );
+                                submesh.bboxMax.z        = chunkFb->bbox_max( ).z( );
+                                submesh.texcoordOffset.x = chunkFb->uv_offset( ).x( );
+                                submesh.texcoordOffset.y = chunkFb->uv_offset( ).y( );
+                                submesh.texcoordScale.x  = chunkFb->uv_scale( ).x( );
+                                submesh.texcoordScale.y  = chunkFb->uv_scale( ).y( );
+                                submesh.baseVertex       = chunkFb->base_vertex( ) - submeshFb->base_vertex( );
+                                submesh.vertexCount      = chunkFb->vertex_count( );
+
+                                mesh.bboxMin     = i ? mathfu::vec3::Min( mesh.bboxMin, submesh.bboxMin ) : submesh.bboxMin;
+                                mesh.bboxMax     = i ? mathfu::vec3::Max( mesh.bboxMax, submesh.bboxMax ) : submesh.bboxMax;
+                                mesh.vertexCount = std::max( mesh.vertexCount, submesh.baseVertex + submesh.vertexCount );
+                            }
                         }
 
+                        if ( nullptr == meshFb->subsets( ) )
+                            return nullptr;
+
+                        /* The index ranges are checked against the own or the shared index buffer (merged mesh). */
+                        uint32_t indexCount = 0;
+                        if ( mesh.geometryBufferId != uint32_t( -1 ) ) {
+                            auto &geometryBuffer = scene->geometryBuffers[ mesh.geometryBufferId ];
+                            indexCount = geometryBuffer.indicesSize / ( geometryBuffer.indexType == apemodefb::EIndexTypeFb_UInt32 ? 4 : 2 );
+                        } else {
+                            indexCount = mesh.indicesSize / ( meshFb->index_type( ) == apemodefb::EIndexTypeFb_UInt32 ? 4 : 2 );
+                        }
+
+                        const auto isIndexRangeValid = [indexCount]( uint64_t baseIndex, uint64_t rangeIndexCount ) {
+                            return rangeIndexCount <= indexCount && baseIndex <= indexCount - rangeIndexCount;
+                        };
+
                         mesh.subsets.reserve( meshFb->subsets( )->size( ) );
 
                         auto subsetIt    = (const apemodefb::SubsetFb *) meshFb->subsets( )->Data( );
@@ -350,6 +779,120 @@ namespace apemode {
 
                                             return subset;
                                         } );
+
+                        for ( auto &subset : mesh.subsets ) {
+                            if ( false == isIndexRangeValid( subset.baseIndex, subset.indexCount ) )
+                                return nullptr;
+                        }
+
+                        /* The subsets of the submeshes are the contiguous ranges. */
+                        if ( auto submeshesFb = meshFb->submeshes( ) ) {
+                            for ( uint32_t i = 0; i < submeshesFb->size( ); ++i ) {
+                                auto submeshFb = submeshesFb->Get( i );
+                                for ( uint32_t j = submeshFb->base_subset( ); j < submeshFb->base_subset( ) + submeshFb->subset_count( ); ++j ) {
+                                    if ( j < mesh.subsets.size( ) )
+                                        mesh.subsets[ j ].submeshIndex = i;
+                                }
+                            }
+                        }
+
+                        /* The meshlets of each subset are the contiguous ranges, the local indices are not needed for the culling. */
+                        if ( auto meshletsFb = meshFb->meshlets( ) ? meshFb->meshlets( )->meshlets( ) : nullptr ) {
+                            mesh.clusters.reserve( meshletsFb->size( ) );
+
+                            for ( auto meshletFb : *meshletsFb ) {
+                                if ( meshletFb->subset_index( ) >= mesh.subsets.size( ) )
+                                    continue;
+                                if ( false == isIndexRangeValid( meshletFb->base_index( ), uint64_t( meshletFb->triangle_count( ) ) * 3 ) )
+                                    return nullptr;
+
+                                auto &subset = mesh.subsets[ meshletFb->subset_index( ) ];
+                                if ( 0 == subset.clusterCount )
+                                    subset.baseCluster = (uint32_t) mesh.clusters.size( );
+                                ++subset.clusterCount;
+
+                                mesh.clusters.emplace_back( );
+                                auto &cluster = mesh.clusters.back( );
+
+                                cluster.center     = mathfu::vec3( meshletFb->center( ).x( ), meshletFb->center( ).y( ), meshletFb->center( ).z( ) );
+                                cluster.radius     = meshletFb->radius( );
+                                cluster.coneApex   = mathfu::vec3( meshletFb->cone_apex( ).x( ), meshletFb->cone_apex( ).y( ), meshletFb->cone_apex( ).z( ) );
+                                cluster.coneAxis   = mathfu::vec3( meshletFb->cone_axis( ).x( ), meshletFb->cone_axis( ).y( ), meshletFb->cone_axis( ).z( ) );
+                                cluster.coneCutoff = meshletFb->cone_cutoff( );
+                                cluster.baseIndex  = meshletFb->base_index( );
+                                cluster.indexCount = meshletFb->triangle_count( ) * 3;
+                            }
+                        }
+
+                        /* The subsets of the simplified levels go after the subsets of the full mesh,
+                         * each level has a subset per full mesh subset (in the same order, possibly empty). */
+                        if ( meshFb->lods( ) && meshFb->lod_subsets( ) && false == mesh.subsets.empty( ) ) {
+                            const uint32_t subsetCount = (uint32_t) mesh.subsets.size( );
+
+                            mesh.lods.reserve( meshFb->lods( )->size( ) + 1 );
+                            mesh.lods.emplace_back( );
+                            mesh.lods.back( ).subsetCount = subsetCount;
+
+                            for ( auto lodFb : *meshFb->lods( ) ) {
+                                if ( lodFb->subset_count( ) != subsetCount || lodFb->base_subset( ) + subsetCount > meshFb->lod_subsets( )->size( ) )
+                                    continue;
+
+                                mesh.lods.emplace_back( );
+                                auto &lod = mesh.lods.back( );
+
+                                lod.error       = lodFb->error( );
+                                lod.baseSubset  = subsetCount + lodFb->base_subset( );
+                                lod.subsetCount = subsetCount;
+                            }
+
+                            mesh.subsets.reserve( subsetCount + meshFb->lod_subsets( )->size( ) );
+                            for ( uint32_t i = 0; i < meshFb->lod_subsets( )->size( ); ++i ) {
+                                auto subsetFb = meshFb->lod_subsets( )->Get( i );
+                                if ( false == isIndexRangeValid( subsetFb->base_index( ), subsetFb->index_count( ) ) )
+                                    return nullptr;
+
+                                SceneMeshSubset subset;
+                                subset.materialId   = subsetFb->material_id( );
+                                subset.baseIndex    = subsetFb->base_index( );
+                                subset.indexCount   = subsetFb->index_count( );
+                                subset.submeshIndex = mesh.subsets[ i % subsetCount ].submeshIndex;
+                                mesh.subsets.push_back( subset );
+                            }
+                        }
+                    }
+                }
+
+                if ( auto skinsFb = scene->sourceScene->skins( ) ) {
+                    scene->skins.reserve( skinsFb->size( ) );
+
+                    for ( auto skinFb : *skinsFb ) {
+                        assert( skinFb );
+
+                        scene->skins.emplace_back( );
+                        auto &skin = scene->skins.back( );
+
+                        if ( auto jointNodeIdsFb = skinFb->joint_node_ids( ) ) {
+                            skin.jointNodeIds.reserve( jointNodeIdsFb->size( ) );
+                            for ( auto jointNodeId : *jointNodeIdsFb )
+                                skin.jointNodeIds.push_back( jointNodeId < nodeIds.size( ) ? nodeIds[ jointNodeId ] : uint32_t( -1 ) );
+                        }
+
+                        if ( auto jointParentIndicesFb = skinFb->joint_parent_indices( ) ) {
+                            skin.jointParentIndices.assign( jointParentIndicesFb->begin( ), jointParentIndicesFb->end( ) );
+                        }
+
+                        if ( auto inverseBindMatricesFb = skinFb->inverse_bind_matrices( ) ) {
+                            skin.inverseBindMatrices.reserve( inverseBindMatricesFb->size( ) );
+                            for ( auto matrixFb : *inverseBindMatricesFb ) {
+                                const auto column = [&]( apemodefb::vec4 const &v ) { return mathfu::vec4( v.x( ), v.y( ), v.z( ), v.w( ) ); };
+                                skin.inverseBindMatrices.emplace_back( column( matrixFb->x( ) ),
+                                                                       column( matrixFb->y( ) ),
+                                                                       column( matrixFb->z( ) ),
+                                                                       column( matrixFb->w( ) ) );
+                            }
+                        }
+
+                        assert( skin.jointNodeIds.size( ) == skin.inverseBindMatrices.size( ) );
                     }
                 }
 
@@ -367,6 +910,10 @@ namespace apemode {
                     }
                 }
 
+                /* The tree is built over the world-space boxes. */
+                scene->UpdateMatrices( );
+                scene->bvh.Build( scene.get( ) );
+
                 return scene.release( );
             }
         }
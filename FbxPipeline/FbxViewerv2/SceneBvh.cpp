@@ -0,0 +1,672 @@
+#include <fbxvpch.h>
+
+#include <SceneBvh.h>
+#include <Scene.h>
+#include <AppState.h>
+#include <CameraControllerProjection.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+
+namespace {
+    using Bounds = apemode::SceneBvh::Bounds;
+
+    struct BuildTask {
+        uint32_t nodeIndex;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    struct Bin {
+        Bounds   bounds;
+        uint32_t count;
+    };
+
+    inline void ResetBounds( Bounds &bounds ) {
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            bounds.boundsMin[ i ] = std::numeric_limits< float >::max( );
+            bounds.boundsMax[ i ] = -std::numeric_limits< float >::max( );
+        }
+    }
+
+    inline void GrowBounds( Bounds &bounds, Bounds const &other ) {
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            bounds.boundsMin[ i ] = other.boundsMin[ i ] < bounds.boundsMin[ i ] ? other.boundsMin[ i ] : bounds.boundsMin[ i ];
+            bounds.boundsMax[ i ] = other.boundsMax[ i ] > bounds.boundsMax[ i ] ? other.boundsMax[ i ] : bounds.boundsMax[ i ];
+        }
+    }
+
+    inline void GrowBounds( Bounds &bounds, const float *point ) {
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            bounds.boundsMin[ i ] = point[ i ] < bounds.boundsMin[ i ] ? point[ i ] : bounds.boundsMin[ i ];
+            bounds.boundsMax[ i ] = point[ i ] > bounds.boundsMax[ i ] ? point[ i ] : bounds.boundsMax[ i ];
+        }
+    }
+
+    /* Half of the surface area, the empty bounds have zero area. */
+    inline float GetHalfArea( Bounds const &bounds ) {
+        float d[ 3 ];
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            d[ i ] = bounds.boundsMax[ i ] - bounds.boundsMin[ i ];
+            d[ i ] = d[ i ] > 0 ? d[ i ] : 0;
+        }
+
+        return d[ 0 ] * d[ 1 ] + d[ 1 ] * d[ 2 ] + d[ 2 ] * d[ 0 ];
+    }
+
+    inline bool Equals( Bounds const &a, Bounds const &b ) {
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            if ( a.boundsMin[ i ] != b.boundsMin[ i ] || a.boundsMax[ i ] != b.boundsMax[ i ] )
+                return false;
+        }
+
+        return true;
+    }
+
+    inline bool Overlaps( Bounds const &a, Bounds const &b ) {
+        return a.boundsMin[ 0 ] <= b.boundsMax[ 0 ] && b.boundsMin[ 0 ] <= a.boundsMax[ 0 ] &&
+               a.boundsMin[ 1 ] <= b.boundsMax[ 1 ] && b.boundsMin[ 1 ] <= a.boundsMax[ 1 ] &&
+               a.boundsMin[ 2 ] <= b.boundsMax[ 2 ] && b.boundsMin[ 2 ] <= a.boundsMax[ 2 ];
+    }
+
+    inline void CalculateItemBounds( const apemode::Scene *scene, uint32_t nodeId, Bounds &bounds ) {
+        float center[ 3 ], extents[ 3 ];
+        apemode::CalculateWorldBounds( scene, nodeId, center, extents );
+
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            bounds.boundsMin[ i ] = center[ i ] - extents[ i ];
+            bounds.boundsMax[ i ] = center[ i ] + extents[ i ];
+        }
+    }
+
+    /**
+     * Tests the box against the frustum planes from the mask.
+     * The planes the box is completely inside are removed from the mask (they are not tested for the subtree).
+     * @return False if the box is outside, true otherwise.
+     **/
+    inline bool TestFrustum( apemode::SceneFrustum const &frustum, Bounds const &bounds, uint32_t &planeMask ) {
+        float c[ 3 ], e[ 3 ];
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            c[ i ] = ( bounds.boundsMax[ i ] + bounds.boundsMin[ i ] ) * 0.5f;
+            e[ i ] = ( bounds.boundsMax[ i ] - bounds.boundsMin[ i ] ) * 0.5f;
+        }
+
+        for ( uint32_t planeIndex = 0; planeIndex < apemode::SceneFrustum::ePlaneCount; ++planeIndex ) {
+            if ( 0 == ( planeMask & ( 1u << planeIndex ) ) )
+                continue;
+
+            auto &plane = frustum.planes[ planeIndex ];
+
+            const float distance = plane[ 0 ] * c[ 0 ] + plane[ 1 ] * c[ 1 ] + plane[ 2 ] * c[ 2 ] + plane[ 3 ];
+            const float radius   = fabsf( plane[ 0 ] ) * e[ 0 ] + fabsf( plane[ 1 ] ) * e[ 1 ] + fabsf( plane[ 2 ] ) * e[ 2 ];
+            if ( distance + radius < 0 )
+                return false;
+            if ( distance - radius >= 0 )
+                planeMask &= ~( 1u << planeIndex );
+        }
+
+        return true;
+    }
+
+    /**
+     * Slab test, the ray starts at the origin (the intersections behind it are ignored).
+     * @return True if the ray hits the box closer than the max distance, false otherwise.
+     **/
+    inline bool TestRay( Bounds const &bounds, const float *origin, const float *invDirection, float maxDistance, float &distance ) {
+        float tmin = 0;
+        float tmax = maxDistance;
+        for ( uint32_t i = 0; i < 3; ++i ) {
+            float t0 = ( bounds.boundsMin[ i ] - origin[ i ] ) * invDirection[ i ];
+            float t1 = ( bounds.boundsMax[ i ] - origin[ i ] ) * invDirection[ i ];
+            if ( t0 > t1 )
+                std::swap( t0, t1 );
+
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+        }
+
+        distance = tmin;
+        return tmin <= tmax;
+    }
+}
+
+void apemode::SceneBvh::Build( const Scene *scene ) {
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    nodes.clear( );
+    itemBounds.clear( );
+    itemNodeIds.clear( );
+    stats = SceneBvhStats( );
+
+    if ( nullptr == scene || scene->worldMatrices.size( ) < scene->nodes.size( ) )
+        return;
+
+    for ( auto &node : scene->nodes ) {
+        if ( node.meshId < scene->meshes.size( ) ) {
+            itemNodeIds.push_back( node.id );
+            itemBounds.emplace_back( );
+            CalculateItemBounds( scene, node.id, itemBounds.back( ) );
+        }
+    }
+
+    const uint32_t itemCount = uint32_t( itemNodeIds.size( ) );
+    if ( 0 == itemCount )
+        return;
+
+    std::vector< float > centers( itemCount * 3 );
+    for ( uint32_t i = 0; i < itemCount; ++i ) {
+        for ( uint32_t j = 0; j < 3; ++j )
+            centers[ i * 3 + j ] = ( itemBounds[ i ].boundsMin[ j ] + itemBounds[ i ].boundsMax[ j ] ) * 0.5f;
+    }
+
+    /* Items are sorted into the leaves by partitioning the index ranges. */
+    std::vector< uint32_t > items( itemCount );
+    for ( uint32_t i = 0; i < itemCount; ++i )
+        items[ i ] = i;
+
+    nodes.reserve( itemCount / kMaxLeafItemCount * 2 + 1 );
+    nodes.emplace_back( );
+
+    std::vector< BuildTask > tasks;
+    tasks.push_back( {0, 0, itemCount, 1} );
+
+    while ( false == tasks.empty( ) ) {
+        const BuildTask task = tasks.back( );
+        tasks.pop_back( );
+
+        Bounds bounds, centerBounds;
+        ResetBounds( bounds );
+        ResetBounds( centerBounds );
+        for ( uint32_t i = task.begin; i < task.end; ++i ) {
+            GrowBounds( bounds, itemBounds[ items[ i ] ] );
+            GrowBounds( centerBounds, &centers[ items[ i ] * 3 ] );
+        }
+
+        nodes[ task.nodeIndex ].bounds = bounds;
+        stats.depth = task.depth > stats.depth ? task.depth : stats.depth;
+
+        const uint32_t count = task.end - task.begin;
+        if ( count <= kMaxLeafItemCount ) {
+            nodes[ task.nodeIndex ].firstChildOrItem = task.begin;
+            nodes[ task.nodeIndex ].itemCount        = count;
+            ++stats.leafCount;
+            continue;
+        }
+
+        //
+        // Binned SAH: the centers are sorted into the bins along each axis,
+        // the split between the bins with the lowest cost (area * item count for both sides) is selected.
+        //
+
+        float    bestCost  = std::numeric_limits< float >::max( );
+        uint32_t bestAxis  = uint32_t( -1 );
+        uint32_t bestSplit = 0;
+        float    bestScale = 0;
+
+        for ( uint32_t axis = 0; axis < 3; ++axis ) {
+            const float centerMin    = centerBounds.boundsMin[ axis ];
+            const float centerExtent = centerBounds.boundsMax[ axis ] - centerMin;
+            if ( centerExtent <= 0 )
+                continue;
+
+            const float scale = kBinCount / centerExtent;
+
+            Bin bins[ kBinCount ];
+            for ( auto &bin : bins ) {
+                ResetBounds( bin.bounds );
+                bin.count = 0;
+            }
+
+            for ( uint32_t i = task.begin; i < task.end; ++i ) {
+                const uint32_t binIndex = uint32_t( ( centers[ items[ i ] * 3 + axis ] - centerMin ) * scale );
+                auto &         bin      = bins[ binIndex < kBinCount ? binIndex : kBinCount - 1 ];
+                GrowBounds( bin.bounds, itemBounds[ items[ i ] ] );
+                ++bin.count;
+            }
+
+            float  rightCosts[ kBinCount ];
+            Bounds rightBounds;
+            ResetBounds( rightBounds );
+            uint32_t rightCount = 0;
+            for ( uint32_t binIndex = kBinCount - 1; binIndex > 0; --binIndex ) {
+                GrowBounds( rightBounds, bins[ binIndex ].bounds );
+                rightCount += bins[ binIndex ].count;
+                rightCosts[ binIndex ] = rightCount ? GetHalfArea( rightBounds ) * rightCount : 0;
+            }
+
+            Bounds leftBounds;
+            ResetBounds( leftBounds );
+            uint32_t leftCount = 0;
+            for ( uint32_t binIndex = 0; binIndex < kBinCount - 1; ++binIndex ) {
+                GrowBounds( leftBounds, bins[ binIndex ].bounds );
+                leftCount += bins[ binIndex ].count;
+
+                /* Both sides should have items. */
+                if ( 0 == leftCount || leftCount == count )
+                    continue;
+
+                const float cost = GetHalfArea( leftBounds ) * leftCount + rightCosts[ binIndex + 1 ];
+                if ( cost < bestCost ) {
+                    bestCost  = cost;
+                    bestAxis  = axis;
+                    bestSplit = binIndex + 1;
+                    bestScale = scale;
+                }
+            }
+        }
+
+        uint32_t middle = task.begin + count / 2;
+        if ( bestAxis != uint32_t( -1 ) ) {
+            const float centerMin = centerBounds.boundsMin[ bestAxis ];
+            auto        middleIt  = std::partition( items.begin( ) + task.begin, items.begin( ) + task.end, [&]( uint32_t item ) {
+                const uint32_t binIndex = uint32_t( ( centers[ item * 3 + bestAxis ] - centerMin ) * bestScale );
+                return ( binIndex < kBinCount ? binIndex : kBinCount - 1 ) < bestSplit;
+            } );
+
+            middle = uint32_t( middleIt - items.begin( ) );
+        }
+
+        /* All the centers are in the same place, the items are split in halves. */
+        if ( middle == task.begin || middle == task.end )
+            middle = task.begin + count / 2;
+
+        const uint32_t childIndex = uint32_t( nodes.size( ) );
+        nodes.emplace_back( );
+        nodes.emplace_back( );
+
+        nodes[ task.nodeIndex ].firstChildOrItem = childIndex;
+        nodes[ task.nodeIndex ].itemCount        = 0;
+
+        tasks.push_back( {childIndex, task.begin, middle, task.depth + 1} );
+        tasks.push_back( {childIndex + 1, middle, task.end, task.depth + 1} );
+    }
+
+    /* Put the items in leaf order. */
+    std::vector< Bounds >   sortedItemBounds( itemCount );
+    std::vector< uint32_t > sortedItemNodeIds( itemCount );
+    for ( uint32_t i = 0; i < itemCount; ++i ) {
+        sortedItemBounds[ i ]  = itemBounds[ items[ i ] ];
+        sortedItemNodeIds[ i ] = itemNodeIds[ items[ i ] ];
+    }
+
+    itemBounds.swap( sortedItemBounds );
+    itemNodeIds.swap( sortedItemNodeIds );
+    refitStamp = scene->updateStamp;
+
+    std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+
+    stats.nodeCount      = uint32_t( nodes.size( ) );
+    stats.itemCount      = itemCount;
+    stats.buildElapsedMs = elapsed.count( );
+}
+
+void apemode::SceneBvh::Refit( const Scene *scene ) {
+    stats.refitItemCount = 0;
+    stats.refitElapsedMs = 0;
+
+    if ( nodes.empty( ) || nullptr == scene || scene->updateStamp == refitStamp )
+        return;
+
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    /* The stamps were reset (wrapped around), all the items are refitted. */
+    const bool bAllItems = scene->updateStamp < refitStamp;
+
+    //
+    // The children go after their parents, so the bounds are updated bottom-up in the reverse order.
+    //
+
+    refitFlags.assign( nodes.size( ), 0 );
+    for ( uint32_t nodeIndex = uint32_t( nodes.size( ) ); nodeIndex-- > 0; ) {
+        auto &node = nodes[ nodeIndex ];
+
+        if ( node.itemCount ) {
+            for ( uint32_t i = node.firstChildOrItem; i < node.firstChildOrItem + node.itemCount; ++i ) {
+                if ( bAllItems || scene->updateStamps[ itemNodeIds[ i ] ] > refitStamp ) {
+                    CalculateItemBounds( scene, itemNodeIds[ i ], itemBounds[ i ] );
+                    refitFlags[ nodeIndex ] = 1;
+                    ++stats.refitItemCount;
+                }
+            }
+
+            if ( refitFlags[ nodeIndex ] ) {
+                ResetBounds( node.bounds );
+                for ( uint32_t i = node.firstChildOrItem; i < node.firstChildOrItem + node.itemCount; ++i )
+                    GrowBounds( node.bounds, itemBounds[ i ] );
+            }
+        } else if ( refitFlags[ node.firstChildOrItem ] || refitFlags[ node.firstChildOrItem + 1 ] ) {
+            node.bounds = nodes[ node.firstChildOrItem ].bounds;
+            GrowBounds( node.bounds, nodes[ node.firstChildOrItem + 1 ].bounds );
+            refitFlags[ nodeIndex ] = 1;
+        }
+    }
+
+    refitStamp = scene->updateStamp;
+
+    std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+    stats.refitElapsedMs = elapsed.count( );
+}
+
+void apemode::SceneBvh::QueryFrustum( SceneFrustum const &frustum, std::vector< uint32_t > &nodeIds ) const {
+    if ( nodes.empty( ) )
+        return;
+
+    struct StackEntry {
+        uint32_t nodeIndex;
+        uint32_t planeMask;
+    };
+
+    std::vector< StackEntry > stack;
+    stack.reserve( 64 );
+    stack.push_back( {0, ( 1u << SceneFrustum::ePlaneCount ) - 1} );
+
+    while ( false == stack.empty( ) ) {
+        StackEntry entry = stack.back( );
+        stack.pop_back( );
+
+        auto &node = nodes[ entry.nodeIndex ];
+        if ( entry.planeMask && false == TestFrustum( frustum, node.bounds, entry.planeMask ) )
+            continue;
+
+        if ( node.itemCount ) {
+            for ( uint32_t i = node.firstChildOrItem; i < node.firstChildOrItem + node.itemCount; ++i ) {
+                uint32_t planeMask = entry.planeMask;
+                if ( 0 == planeMask || TestFrustum( frustum, itemBounds[ i ], planeMask ) )
+                    nodeIds.push_back( itemNodeIds[ i ] );
+            }
+        } else {
+            stack.push_back( {node.firstChildOrItem + 1, entry.planeMask} );
+            stack.push_back( {node.firstChildOrItem, entry.planeMask} );
+        }
+    }
+}
+
+void apemode::SceneBvh::QueryBounds( mathfu::vec3 const &boundsMin, mathfu::vec3 const &boundsMax, std::vector< uint32_t > &nodeIds ) const {
+    if ( nodes.empty( ) )
+        return;
+
+    const Bounds bounds = {{boundsMin.x, boundsMin.y, boundsMin.z}, {boundsMax.x, boundsMax.y, boundsMax.z}};
+
+    std::vector< uint32_t > stack;
+    stack.reserve( 64 );
+    stack.push_back( 0 );
+
+    while ( false == stack.empty( ) ) {
+        auto &node = nodes[ stack.back( ) ];
+        stack.pop_back( );
+
+        if ( false == Overlaps( node.bounds, bounds ) )
+            continue;
+
+        if ( node.itemCount ) {
+            for ( uint32_t i = node.firstChildOrItem; i < node.firstChildOrItem + node.itemCount; ++i ) {
+                if ( Overlaps( itemBounds[ i ], bounds ) )
+                    nodeIds.push_back( itemNodeIds[ i ] );
+            }
+        } else {
+            stack.push_back( node.firstChildOrItem + 1 );
+            stack.push_back( node.firstChildOrItem );
+        }
+    }
+}
+
+bool apemode::SceneBvh::RayCast( mathfu::vec3 const &origin, mathfu::vec3 const &direction, SceneBvhHit &hit ) const {
+    if ( nodes.empty( ) )
+        return false;
+
+    /* Zero components give infinities, the slab test handles them. */
+    const float o[ 3 ]            = {origin.x, origin.y, origin.z};
+    const float invDirection[ 3 ] = {1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z};
+
+    float    closestDistance = std::numeric_limits< float >::max( );
+    uint32_t closestNodeId   = uint32_t( -1 );
+    float    distance        = 0;
+
+    std::vector< uint32_t > stack;
+    stack.reserve( 64 );
+
+    if ( TestRay( nodes[ 0 ].bounds, o, invDirection, closestDistance, distance ) )
+        stack.push_back( 0 );
+
+    while ( false == stack.empty( ) ) {
+        auto &node = nodes[ stack.back( ) ];
+        stack.pop_back( );
+
+        if ( node.itemCount ) {
+            for ( uint32_t i = node.firstChildOrItem; i < node.firstChildOrItem + node.itemCount; ++i ) {
+                if ( TestRay( itemBounds[ i ], o, invDirection, closestDistance, distance ) && distance < closestDistance ) {
+                    closestDistance = distance;
+                    closestNodeId   = itemNodeIds[ i ];
+                }
+            }
+        } else {
+            /* The closer child is visited first, the farther one is likely to be skipped then. */
+            float distances[ 2 ];
+            bool  bHits[ 2 ] = {TestRay( nodes[ node.firstChildOrItem ].bounds, o, invDirection, closestDistance, distances[ 0 ] ),
+                               TestRay( nodes[ node.firstChildOrItem + 1 ].bounds, o, invDirection, closestDistance, distances[ 1 ] )};
+
+            const uint32_t first = bHits[ 0 ] && bHits[ 1 ] && distances[ 1 ] < distances[ 0 ] ? 1 : 0;
+            if ( bHits[ 1 - first ] )
+                stack.push_back( node.firstChildOrItem + 1 - first );
+            if ( bHits[ first ] )
+                stack.push_back( node.firstChildOrItem + first );
+        }
+    }
+
+    if ( closestNodeId == uint32_t( -1 ) )
+        return false;
+
+    hit.nodeId   = closestNodeId;
+    hit.distance = closestDistance;
+    return true;
+}
+
+void apemode::BenchmarkSceneBvh( uint32_t maxNodeCount, uint32_t iterationCount ) {
+    if ( 0 == iterationCount )
+        return;
+
+    auto appState = apemode::AppState::GetCurrentState( );
+    if ( nullptr == appState || nullptr == appState->consoleLogger )
+        return;
+
+    using Clock    = std::chrono::high_resolution_clock;
+    using Duration = std::chrono::duration< double, std::milli >;
+
+    const uint32_t queryCount = 1000;
+
+    for ( uint32_t nodeCount = 1000; nodeCount <= maxNodeCount; nodeCount *= 10 ) {
+
+        /* The density of the boxes is the same for all the scenes. */
+        const float sceneSize = 1000.0f * powf( nodeCount / 100000.0f, 1.0f / 3.0f );
+
+        Scene scene;
+        GenerateSceneBoxes( scene, nodeCount, sceneSize );
+
+        auto &bvh = scene.bvh;
+        bvh.Build( &scene );
+
+        //
+        // Refit: 1% of the nodes are moved each iteration.
+        //
+
+        std::mt19937                            rng( 7 );
+        std::uniform_real_distribution< float > unitDistribution( -1.0f, 1.0f );
+        std::uniform_int_distribution< uint32_t > nodeDistribution( 0, nodeCount - 1 );
+
+        double   refitMs        = 0;
+        uint64_t refitItemCount = 0;
+        for ( uint32_t i = 0; i < iterationCount; ++i ) {
+            for ( uint32_t j = 0; j < nodeCount / 100 + 1; ++j ) {
+                const uint32_t     nodeId    = nodeDistribution( rng );
+                SceneNodeTransform transform = scene.transforms.Get( nodeId );
+                transform.translation.x += unitDistribution( rng );
+                scene.SetTransform( nodeId, transform );
+            }
+
+            scene.UpdateMatrices( );
+            bvh.Refit( &scene );
+            refitMs += bvh.stats.refitElapsedMs;
+            refitItemCount += bvh.stats.refitItemCount;
+        }
+
+        //
+        // Refit validation: the topology differs from the fresh build over the moved boxes,
+        // so the items and the root are compared against it, and the nodes are checked to enclose their subtrees exactly.
+        //
+
+        SceneBvh referenceBvh;
+        referenceBvh.Build( &scene );
+
+        uint32_t refitMismatchCount = referenceBvh.stats.itemCount != bvh.stats.itemCount;
+        refitMismatchCount += false == Equals( referenceBvh.nodes[ 0 ].bounds, bvh.nodes[ 0 ].bounds );
+
+        std::vector< Bounds > referenceItemBounds( scene.nodes.size( ) );
+        for ( uint32_t j = 0; j < referenceBvh.stats.itemCount; ++j )
+            referenceItemBounds[ referenceBvh.itemNodeIds[ j ] ] = referenceBvh.itemBounds[ j ];
+        for ( uint32_t j = 0; j < bvh.stats.itemCount; ++j )
+            refitMismatchCount += false == Equals( referenceItemBounds[ bvh.itemNodeIds[ j ] ], bvh.itemBounds[ j ] );
+
+        for ( auto const &node : bvh.nodes ) {
+            Bounds subtreeBounds;
+            ResetBounds( subtreeBounds );
+            if ( node.itemCount ) {
+                for ( uint32_t j = node.firstChildOrItem; j < node.firstChildOrItem + node.itemCount; ++j )
+                    GrowBounds( subtreeBounds, bvh.itemBounds[ j ] );
+            } else {
+                GrowBounds( subtreeBounds, bvh.nodes[ node.firstChildOrItem ].bounds );
+                GrowBounds( subtreeBounds, bvh.nodes[ node.firstChildOrItem + 1 ].bounds );
+            }
+
+            refitMismatchCount += false == Equals( subtreeBounds, node.bounds );
+        }
+
+        //
+        // Frustum: the eye is in the center, looking at (0, 0, 1) along +z (mathfu::mat4::LookAt takes the target first, then the eye).
+        //
+
+        const mathfu::mat4 viewMatrix = mathfu::mat4::LookAt( mathfu::vec3( 0, 0, 1 ), mathfu::vec3( 0, 0, 0 ), mathfu::vec3( 0, 1, 0 ), -1 );
+        const mathfu::mat4 projMatrix = CameraProjectionController( ).ProjMatrix( 55.0f, 1280.0f, 720.0f, 0.1f, sceneSize );
+
+        SceneFrustum frustum;
+        frustum.SetViewProjMatrix( projMatrix * viewMatrix );
+
+        std::vector< uint32_t > nodeIds;
+        std::vector< uint32_t > referenceNodeIds;
+        uint32_t                mismatchCount = 0;
+
+        auto compareNodeIds = [&]( ) {
+            std::sort( nodeIds.begin( ), nodeIds.end( ) );
+            std::sort( referenceNodeIds.begin( ), referenceNodeIds.end( ) );
+            mismatchCount += nodeIds != referenceNodeIds;
+        };
+
+        auto startTime = Clock::now( );
+        for ( uint32_t i = 0; i < iterationCount; ++i ) {
+            nodeIds.clear( );
+            bvh.QueryFrustum( frustum, nodeIds );
+        }
+        const double frustumMs = Duration( Clock::now( ) - startTime ).count( ) / iterationCount;
+
+        startTime = Clock::now( );
+        for ( uint32_t i = 0; i < iterationCount; ++i ) {
+            referenceNodeIds.clear( );
+            for ( uint32_t j = 0; j < bvh.stats.itemCount; ++j ) {
+                uint32_t planeMask = ( 1u << SceneFrustum::ePlaneCount ) - 1;
+                if ( TestFrustum( frustum, bvh.itemBounds[ j ], planeMask ) )
+                    referenceNodeIds.push_back( bvh.itemNodeIds[ j ] );
+            }
+        }
+        const double linearFrustumMs = Duration( Clock::now( ) - startTime ).count( ) / iterationCount;
+        const size_t visibleNodeCount = nodeIds.size( );
+        compareNodeIds( );
+
+        //
+        // Rays and boxes: random origins and directions, random boxes.
+        //
+
+        std::vector< mathfu::vec3 > queryPoints( queryCount );
+        std::vector< mathfu::vec3 > queryDirections( queryCount );
+        for ( uint32_t i = 0; i < queryCount; ++i ) {
+            queryPoints[ i ]     = mathfu::vec3( unitDistribution( rng ), unitDistribution( rng ), unitDistribution( rng ) ) * ( sceneSize * 0.5f );
+            queryDirections[ i ] = mathfu::vec3( unitDistribution( rng ), unitDistribution( rng ), unitDistribution( rng ) );
+        }
+
+        std::vector< SceneBvhHit > hits( queryCount );
+        startTime = Clock::now( );
+        for ( uint32_t i = 0; i < queryCount; ++i ) {
+            if ( false == bvh.RayCast( queryPoints[ i ], queryDirections[ i ], hits[ i ] ) )
+                hits[ i ] = SceneBvhHit( );
+        }
+        const double rayUs = Duration( Clock::now( ) - startTime ).count( ) * 1000.0 / queryCount;
+
+        startTime = Clock::now( );
+        for ( uint32_t i = 0; i < queryCount; ++i ) {
+            const float o[ 3 ]            = {queryPoints[ i ].x, queryPoints[ i ].y, queryPoints[ i ].z};
+            const float invDirection[ 3 ] = {1.0f / queryDirections[ i ].x, 1.0f / queryDirections[ i ].y, 1.0f / queryDirections[ i ].z};
+
+            SceneBvhHit closestHit;
+            closestHit.distance = std::numeric_limits< float >::max( );
+            for ( uint32_t j = 0; j < bvh.stats.itemCount; ++j ) {
+                float distance = 0;
+                if ( TestRay( bvh.itemBounds[ j ], o, invDirection, closestHit.distance, distance ) && distance < closestHit.distance ) {
+                    closestHit.distance = distance;
+                    closestHit.nodeId   = bvh.itemNodeIds[ j ];
+                }
+            }
+
+            /* The same distances are fine (the boxes overlap). */
+            const bool bHit = closestHit.nodeId != uint32_t( -1 );
+            mismatchCount += bHit != ( hits[ i ].nodeId != uint32_t( -1 ) ) || ( bHit && closestHit.distance != hits[ i ].distance );
+        }
+        const double linearRayUs = Duration( Clock::now( ) - startTime ).count( ) * 1000.0 / queryCount;
+
+        startTime = Clock::now( );
+        size_t overlapCount = 0;
+        for ( uint32_t i = 0; i < queryCount; ++i ) {
+            nodeIds.clear( );
+            bvh.QueryBounds( queryPoints[ i ] - mathfu::vec3( 10.0f ), queryPoints[ i ] + mathfu::vec3( 10.0f ), nodeIds );
+            overlapCount += nodeIds.size( );
+        }
+        const double boundsUs = Duration( Clock::now( ) - startTime ).count( ) * 1000.0 / queryCount;
+
+        /* Validated separately, the queries are repeated. */
+        for ( uint32_t i = 0; i < queryCount; ++i ) {
+            nodeIds.clear( );
+            bvh.QueryBounds( queryPoints[ i ] - mathfu::vec3( 10.0f ), queryPoints[ i ] + mathfu::vec3( 10.0f ), nodeIds );
+
+            referenceNodeIds.clear( );
+            const Bounds bounds = {{queryPoints[ i ].x - 10.0f, queryPoints[ i ].y - 10.0f, queryPoints[ i ].z - 10.0f},
+                                   {queryPoints[ i ].x + 10.0f, queryPoints[ i ].y + 10.0f, queryPoints[ i ].z + 10.0f}};
+            for ( uint32_t j = 0; j < bvh.stats.itemCount; ++j ) {
+                if ( Overlaps( bvh.itemBounds[ j ], bounds ) )
+                    referenceNodeIds.push_back( bvh.itemNodeIds[ j ] );
+            }
+
+            compareNodeIds( );
+        }
+
+        appState->consoleLogger->info( "BVH: {} nodes, build {:.2f} ms ({} nodes, {} leaves, depth {}), refit {:.3f} ms ({} items, {} mismatches)",
+                                       nodeCount,
+                                       bvh.stats.buildElapsedMs,
+                                       bvh.stats.nodeCount,
+                                       bvh.stats.leafCount,
+                                       bvh.stats.depth,
+                                       refitMs / iterationCount,
+                                       refitItemCount / iterationCount,
+                                       refitMismatchCount );
+        appState->consoleLogger->info( "BVH: {} nodes, frustum {:.3f} ms (linear {:.3f} ms, {} visible), ray {:.2f} us (linear {:.2f} us), "
+                                       "box {:.2f} us ({:.1f} overlaps), {} mismatches",
+                                       nodeCount,
+                                       frustumMs,
+                                       linearFrustumMs,
+                                       visibleNodeCount,
+                                       rayUs,
+                                       linearRayUs,
+                                       boundsUs,
+                                       double( overlapCount ) / queryCount,
+                                       mismatchCount );
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <SceneCulling.h>
+
+namespace apemode {
+
+    class Scene;
+
+    /**
+     * Counters of the last SceneBvh::Build() and SceneBvh::Refit() calls.
+     **/
+    struct SceneBvhStats {
+        uint32_t nodeCount      = 0;
+        uint32_t leafCount      = 0;
+        uint32_t itemCount      = 0; /* Scene nodes with meshes */
+        uint32_t depth          = 0;
+        uint32_t refitItemCount = 0; /* Items with the recalculated bounds */
+        double   buildElapsedMs = 0;
+        double   refitElapsedMs = 0;
+    };
+
+    struct SceneBvhHit {
+        uint32_t nodeId   = -1; /* Scene node id */
+        float    distance = 0;  /* Along the ray, in direction lengths */
+    };
+
+    /**
+     * Bounding volume hierarchy over the world-space boxes of the scene nodes with meshes.
+     * The tree is built with binned SAH, the leaves contain up to kMaxLeafItemCount items.
+     * The node children are allocated in pairs after their parents, the items of each subtree are contiguous.
+     * The tree is not rebuilt when the nodes move, the bounds are refitted (@see Refit()),
+     * so the quality degrades if the nodes move far from their original places, rebuild it in this case.
+     **/
+    class SceneBvh {
+    public:
+        static const uint32_t kMaxLeafItemCount = 4;
+        static const uint32_t kBinCount         = 12;
+
+        struct Bounds {
+            float boundsMin[ 3 ];
+            float boundsMax[ 3 ];
+        };
+
+        struct Node {
+            Bounds   bounds;
+            uint32_t firstChildOrItem = 0; /* The left child for the inner nodes (the right one follows it), the first item for the leaves */
+            uint32_t itemCount        = 0; /* Zero for the inner nodes */
+        };
+
+        std::vector< Node >     nodes;       /* The root goes first */
+        std::vector< Bounds >   itemBounds;  /* World-space, in leaf order */
+        std::vector< uint32_t > itemNodeIds; /* Scene node ids, in leaf order */
+        SceneBvhStats           stats;
+
+        inline bool IsEmpty( ) const {
+            return nodes.empty( );
+        }
+
+        /**
+         * Builds the tree over the nodes with meshes, the world matrices should be up-to-date.
+         **/
+        void Build( const Scene *scene );
+
+        /**
+         * Recalculates the bounds of the items with world matrices updated since the last refit (@see Scene::updateStamps)
+         * and the bounds of their ancestors. It costs nothing if the scene was not updated.
+         **/
+        void Refit( const Scene *scene );
+
+        /**
+         * Adds the ids of the scene nodes with the boxes that intersect the frustum.
+         * The subtrees that are completely inside the planes are not tested against them.
+         **/
+        void QueryFrustum( SceneFrustum const &frustum, std::vector< uint32_t > &nodeIds ) const;
+
+        /**
+         * Adds the ids of the scene nodes with the boxes that overlap the box.
+         **/
+        void QueryBounds( mathfu::vec3 const &boundsMin, mathfu::vec3 const &boundsMax, std::vector< uint32_t > &nodeIds ) const;
+
+        /**
+         * Finds the closest box hit by the ray (the boxes are hit from the inside too, the distance is zero then).
+         * @return True if hit, false otherwise.
+         **/
+        bool RayCast( mathfu::vec3 const &origin, mathfu::vec3 const &direction, SceneBvhHit &hit ) const;
+
+    private:
+        std::vector< uint8_t > refitFlags;     /* Per node, the bounds were updated in the current refit */
+        uint32_t               refitStamp = 0; /* Scene update stamp at the last build or refit */
+    };
+
+    /**
+     * Builds the synthetic scenes of the randomly placed boxes (1k nodes and up to the given node count, 10 times more each step),
+     * and measures the tree build, refit (1% of the nodes are moved) and queries against the linear scans (the results are validated, the refitted tree against the fresh build).
+     **/
+    void BenchmarkSceneBvh( uint32_t maxNodeCount, uint32_t iterationCount = 16 );
+}
@@ -0,0 +1,586 @@
+#include <fbxvpch.h>
+
+#include <SceneCulling.h>
+#include <Scene.h>
+#include <AppState.h>
+#include <CameraControllerProjection.h>
+
+#include <chrono>
+#include <limits>
+#include <random>
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __SSE__ )
+#include <xmmintrin.h>
+#define APEMODE_CULLING_SSE 1
+#endif
+
+namespace {
+    const uint32_t kBatchSize = 4;
+
+    enum EBoundsChannel {
+        eBoundsChannel_CenterX,
+        eBoundsChannel_CenterY,
+        eBoundsChannel_CenterZ,
+        eBoundsChannel_ExtentsX,
+        eBoundsChannel_ExtentsY,
+        eBoundsChannel_ExtentsZ,
+        eBoundsChannelCount
+    };
+
+    /**
+     * The largest axis scale of the world matrix, the spheres stay spheres only with the uniform scale.
+     **/
+    float GetWorldScale( mathfu::mat4 const &worldMatrix ) {
+        auto  m     = reinterpret_cast< const float * >( &worldMatrix );
+        float scale = 0;
+        for ( uint32_t i = 0; i < 3; ++i )
+            scale = std::max( scale, m[ i * 4 ] * m[ i * 4 ] + m[ i * 4 + 1 ] * m[ i * 4 + 1 ] + m[ i * 4 + 2 ] * m[ i * 4 + 2 ] );
+        return sqrtf( scale );
+    }
+}
+
+void apemode::CalculateWorldBounds( const Scene *scene, uint32_t nodeId, float *center, float *extents ) {
+    auto &mesh = scene->meshes[ scene->nodes[ nodeId ].meshId ];
+    auto  m    = reinterpret_cast< const float * >( &scene->worldMatrices[ nodeId ] );
+
+    const mathfu::vec3 c = ( mesh.bboxMin + mesh.bboxMax ) * 0.5f;
+    const mathfu::vec3 e = ( mesh.bboxMax - mesh.bboxMin ) * 0.5f;
+
+    /* Arvo: the box stays axis-aligned and encloses the transformed one. */
+    for ( uint32_t i = 0; i < 3; ++i ) {
+        center[ i ]  = m[ i ] * c.x + m[ 4 + i ] * c.y + m[ 8 + i ] * c.z + m[ 12 + i ];
+        extents[ i ] = fabsf( m[ i ] ) * e.x + fabsf( m[ 4 + i ] ) * e.y + fabsf( m[ 8 + i ] ) * e.z;
+    }
+}
+
+void apemode::SceneFrustum::SetViewProjMatrix( mathfu::mat4 const &viewProjMatrix ) {
+    /* Gribb-Hartmann: the planes are the sums and differences of the matrix rows. */
+    const mathfu::mat4 &m = viewProjMatrix;
+    for ( uint32_t j = 0; j < 4; ++j ) {
+        planes[ ePlane_Left ][ j ]   = m( 3, j ) + m( 0, j );
+        planes[ ePlane_Right ][ j ]  = m( 3, j ) - m( 0, j );
+        planes[ ePlane_Bottom ][ j ] = m( 3, j ) + m( 1, j );
+        planes[ ePlane_Top ][ j ]    = m( 3, j ) - m( 1, j );
+        planes[ ePlane_Near ][ j ]   = m( 2, j ); /* 0 <= z */
+        planes[ ePlane_Far ][ j ]    = m( 3, j ) - m( 2, j );
+    }
+
+    for ( auto &plane : planes ) {
+        const float length = sqrtf( plane[ 0 ] * plane[ 0 ] + plane[ 1 ] * plane[ 1 ] + plane[ 2 ] * plane[ 2 ] );
+        if ( length > 0 ) {
+            const float invLength = 1.0f / length;
+            for ( auto &component : plane )
+                component *= invLength;
+        }
+    }
+}
+
+bool apemode::SceneFrustum::IsVisible( mathfu::vec3 const &boundsCenter, mathfu::vec3 const &boundsExtents ) const {
+    for ( auto &plane : planes ) {
+        const float distance = plane[ 0 ] * boundsCenter.x + plane[ 1 ] * boundsCenter.y + plane[ 2 ] * boundsCenter.z + plane[ 3 ];
+        const float radius   = fabsf( plane[ 0 ] ) * boundsExtents.x + fabsf( plane[ 1 ] ) * boundsExtents.y + fabsf( plane[ 2 ] ) * boundsExtents.z;
+        if ( distance + radius < 0 )
+            return false;
+    }
+
+    return true;
+}
+
+bool apemode::SceneFrustum::IsVisible( mathfu::vec3 const &sphereCenter, float sphereRadius ) const {
+    for ( auto &plane : planes ) {
+        const float distance = plane[ 0 ] * sphereCenter.x + plane[ 1 ] * sphereCenter.y + plane[ 2 ] * sphereCenter.z + plane[ 3 ];
+        if ( distance + sphereRadius < 0 )
+            return false;
+    }
+
+    return true;
+}
+
+void apemode::SceneCuller::Cull( const Scene *scene, mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix ) {
+    SceneFrustum frustum;
+    frustum.SetViewProjMatrix( projMatrix * viewMatrix );
+    Cull( scene, frustum );
+}
+
+void apemode::SceneCuller::Cull( const Scene *scene, SceneFrustum const &frustum ) {
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    stats = SceneCullingStats( );
+    nodeVisibility.assign( scene ? scene->nodes.size( ) : 0, 1 );
+    if ( nullptr == scene || scene->worldMatrices.size( ) < scene->nodes.size( ) )
+        return;
+
+    //
+    // The tree is available (and refitted), the subtrees outside the frustum are skipped at once.
+    //
+
+    if ( false == scene->bvh.IsEmpty( ) ) {
+        nodeIds.clear( );
+        scene->bvh.QueryFrustum( frustum, nodeIds );
+
+        for ( auto nodeId : scene->bvh.itemNodeIds )
+            nodeVisibility[ nodeId ] = 0;
+        for ( auto nodeId : nodeIds )
+            nodeVisibility[ nodeId ] = 1;
+
+        std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+
+        stats.testedNodeCount  = scene->bvh.stats.itemCount;
+        stats.visibleNodeCount = uint32_t( nodeIds.size( ) );
+        stats.culledNodeCount  = stats.testedNodeCount - stats.visibleNodeCount;
+        stats.elapsedMs        = elapsed.count( );
+        return;
+    }
+
+    //
+    // Gather the world-space boxes of the nodes with meshes into the channels.
+    //
+
+    nodeIds.clear( );
+    for ( auto &node : scene->nodes ) {
+        if ( node.meshId < scene->meshes.size( ) )
+            nodeIds.push_back( node.id );
+    }
+
+    const uint32_t testedNodeCount = uint32_t( nodeIds.size( ) );
+    const uint32_t channelSize     = ( testedNodeCount + kBatchSize - 1 ) / kBatchSize * kBatchSize;
+
+    /* Padding boxes are empty and placed at the origin, their results are ignored. */
+    boundsChannels.assign( channelSize * eBoundsChannelCount, 0.0f );
+
+    float *channels[ eBoundsChannelCount ];
+    for ( uint32_t c = 0; c < eBoundsChannelCount; ++c )
+        channels[ c ] = boundsChannels.data( ) + c * channelSize;
+
+    for ( uint32_t i = 0; i < testedNodeCount; ++i ) {
+        float center[ 3 ], extents[ 3 ];
+        CalculateWorldBounds( scene, nodeIds[ i ], center, extents );
+
+        channels[ eBoundsChannel_CenterX ][ i ]  = center[ 0 ];
+        channels[ eBoundsChannel_CenterY ][ i ]  = center[ 1 ];
+        channels[ eBoundsChannel_CenterZ ][ i ]  = center[ 2 ];
+        channels[ eBoundsChannel_ExtentsX ][ i ] = extents[ 0 ];
+        channels[ eBoundsChannel_ExtentsY ][ i ] = extents[ 1 ];
+        channels[ eBoundsChannel_ExtentsZ ][ i ] = extents[ 2 ];
+    }
+
+    //
+    // Test 4 boxes against each plane at once, the box is outside if it is completely behind any of the planes.
+    //
+
+    for ( uint32_t i = 0; i < channelSize; i += kBatchSize ) {
+        uint32_t visibleMask = 0;
+
+#ifdef APEMODE_CULLING_SSE
+        const __m128 signMask = _mm_set1_ps( -0.0f );
+        const __m128 cx       = _mm_loadu_ps( channels[ eBoundsChannel_CenterX ] + i );
+        const __m128 cy       = _mm_loadu_ps( channels[ eBoundsChannel_CenterY ] + i );
+        const __m128 cz       = _mm_loadu_ps( channels[ eBoundsChannel_CenterZ ] + i );
+        const __m128 ex       = _mm_loadu_ps( channels[ eBoundsChannel_ExtentsX ] + i );
+        const __m128 ey       = _mm_loadu_ps( channels[ eBoundsChannel_ExtentsY ] + i );
+        const __m128 ez       = _mm_loadu_ps( channels[ eBoundsChannel_ExtentsZ ] + i );
+        __m128       visible  = _mm_cmpeq_ps( cx, cx ); /* All set */
+
+        for ( auto &plane : frustum.planes ) {
+            const __m128 px = _mm_set1_ps( plane[ 0 ] );
+            const __m128 py = _mm_set1_ps( plane[ 1 ] );
+            const __m128 pz = _mm_set1_ps( plane[ 2 ] );
+            const __m128 pw = _mm_set1_ps( plane[ 3 ] );
+
+            const __m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( px, cx ), _mm_mul_ps( py, cy ) ),
+                                                _mm_add_ps( _mm_mul_ps( pz, cz ), pw ) );
+            const __m128 radius   = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_andnot_ps( signMask, px ), ex ),
+                                                            _mm_mul_ps( _mm_andnot_ps( signMask, py ), ey ) ),
+                                                _mm_mul_ps( _mm_andnot_ps( signMask, pz ), ez ) );
+
+            visible = _mm_and_ps( visible, _mm_cmpge_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps( ) ) );
+        }
+
+        visibleMask = uint32_t( _mm_movemask_ps( visible ) );
+#else
+        for ( uint32_t j = 0; j < kBatchSize; ++j ) {
+            const mathfu::vec3 center( channels[ eBoundsChannel_CenterX ][ i + j ],
+                                       channels[ eBoundsChannel_CenterY ][ i + j ],
+                                       channels[ eBoundsChannel_CenterZ ][ i + j ] );
+            const mathfu::vec3 extents( channels[ eBoundsChannel_ExtentsX ][ i + j ],
+                                        channels[ eBoundsChannel_ExtentsY ][ i + j ],
+                                        channels[ eBoundsChannel_ExtentsZ ][ i + j ] );
+            visibleMask |= frustum.IsVisible( center, extents ) ? 1u << j : 0u;
+        }
+#endif
+
+        const uint32_t batchSize = testedNodeCount - i < kBatchSize ? testedNodeCount - i : kBatchSize;
+        for ( uint32_t j = 0; j < batchSize; ++j ) {
+            const uint8_t isVisible = uint8_t( ( visibleMask >> j ) & 1 );
+            nodeVisibility[ nodeIds[ i + j ] ] = isVisible;
+            stats.visibleNodeCount += isVisible;
+        }
+    }
+
+    std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+
+    stats.testedNodeCount = testedNodeCount;
+    stats.culledNodeCount = testedNodeCount - stats.visibleNodeCount;
+    stats.elapsedMs       = elapsed.count( );
+}
+
+void apemode::SceneClusterCuller::Begin( mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix ) {
+    frustum.SetViewProjMatrix( projMatrix * viewMatrix );
+    eyePosition = viewMatrix.Inverse( ) * mathfu::vec3( 0, 0, 0 );
+    nodeId      = uint32_t( -1 );
+    stats       = SceneClusterCullingStats( );
+}
+
+bool apemode::SceneClusterCuller::Cull( const Scene *scene, uint32_t nodeId, uint32_t subsetIndex, std::vector< SceneIndexRange > &ranges ) {
+    auto &mesh   = scene->meshes[ scene->nodes[ nodeId ].meshId ];
+    auto &subset = mesh.subsets[ subsetIndex ];
+    if ( 0 == subset.clusterCount || mesh.skinId != uint32_t( -1 ) )
+        return true;
+
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    auto &worldMatrix = scene->worldMatrices[ nodeId ];
+    if ( this->nodeId != nodeId ) {
+        this->nodeId      = nodeId;
+        objectEyePosition = worldMatrix.Inverse( ) * eyePosition;
+        worldScale        = GetWorldScale( worldMatrix );
+    }
+
+    const uint32_t firstRange = uint32_t( ranges.size( ) );
+    for ( uint32_t c = subset.baseCluster; c < subset.baseCluster + subset.clusterCount; ++c ) {
+        auto &cluster = mesh.clusters[ c ];
+
+        const uint32_t triangleCount = cluster.indexCount / 3;
+        ++stats.testedClusterCount;
+        stats.testedTriangleCount += triangleCount;
+
+        if ( false == frustum.IsVisible( worldMatrix * cluster.center, cluster.radius * worldScale ) ) {
+            ++stats.frustumCulledClusterCount;
+            stats.culledTriangleCount += triangleCount;
+            continue;
+        }
+
+        /* The eye is behind all the triangle planes. */
+        if ( cluster.coneCutoff < 1 &&
+             mathfu::vec3::DotProduct( ( cluster.coneApex - objectEyePosition ).Normalized( ), cluster.coneAxis ) >= cluster.coneCutoff ) {
+            ++stats.backfaceCulledClusterCount;
+            stats.culledTriangleCount += triangleCount;
+            continue;
+        }
+
+        if ( ranges.size( ) > firstRange && ranges.back( ).baseIndex + ranges.back( ).indexCount == cluster.baseIndex ) {
+            ranges.back( ).indexCount += cluster.indexCount;
+        } else {
+            ranges.emplace_back( );
+            ranges.back( ).baseIndex  = cluster.baseIndex;
+            ranges.back( ).indexCount = cluster.indexCount;
+        }
+    }
+
+    const uint32_t rangeCount = uint32_t( ranges.size( ) ) - firstRange;
+
+    /* The single range that covers the whole subset is not needed. */
+    if ( 1 == rangeCount && ranges.back( ).baseIndex == subset.baseIndex && ranges.back( ).indexCount == subset.indexCount ) {
+        ranges.pop_back( );
+    } else {
+        stats.rangeCount += rangeCount;
+    }
+
+    std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+    stats.elapsedMs += elapsed.count( );
+    return 0 != rangeCount;
+}
+
+void apemode::SceneLodSelector::Begin( mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix, float viewportHeight, float maxErrorPixels ) {
+    eyePosition          = viewMatrix.Inverse( ) * mathfu::vec3( 0, 0, 0 );
+    pixelsPerUnit        = fabsf( projMatrix( 1, 1 ) ) * viewportHeight * 0.5f;
+    this->maxErrorPixels = maxErrorPixels;
+    simplifiedNodeCount  = 0;
+}
+
+uint32_t apemode::SceneLodSelector::Select( const Scene *scene, uint32_t nodeId ) {
+    auto &mesh = scene->meshes[ scene->nodes[ nodeId ].meshId ];
+    if ( mesh.lods.size( ) < 2 || maxErrorPixels <= 0 )
+        return 0;
+
+    float center[ 3 ];
+    float extents[ 3 ];
+    CalculateWorldBounds( scene, nodeId, center, extents );
+
+    /* The distance to the sphere around the world-space box. */
+    const mathfu::vec3 worldCenter( center[ 0 ], center[ 1 ], center[ 2 ] );
+    const mathfu::vec3 worldExtents( extents[ 0 ], extents[ 1 ], extents[ 2 ] );
+    const float        distance = ( worldCenter - eyePosition ).Length( ) - worldExtents.Length( );
+    if ( distance <= 0 )
+        return 0;
+
+    /* Pixels per object space unit at the distance. */
+    const float errorScale = GetWorldScale( scene->worldMatrices[ nodeId ] ) * pixelsPerUnit / distance;
+
+    uint32_t lodIndex = 0;
+    for ( uint32_t l = 1; l < mesh.lods.size( ) && mesh.lods[ l ].error * errorScale <= maxErrorPixels; ++l )
+        lodIndex = l;
+
+    simplifiedNodeCount += 0 != lodIndex;
+    return lodIndex;
+}
+
+void apemode::GenerateSceneBoxes( Scene &scene, uint32_t nodeCount, float sceneSize, uint32_t seed ) {
+
+    //
+    // The boxes of random sizes are scattered in the cube around the origin,
+    // some of the nodes are parents for the others, so the boxes are also rotated and scaled.
+    //
+
+    std::mt19937                            rng( seed );
+    std::uniform_real_distribution< float > offsetDistribution( -sceneSize * 0.5f, sceneSize * 0.5f );
+    std::uniform_real_distribution< float > angleDistribution( -float( M_PI ), float( M_PI ) );
+    std::uniform_real_distribution< float > sizeDistribution( 0.5f, 10.0f );
+
+    auto randomVec3 = [&]( std::uniform_real_distribution< float > &distribution ) {
+        return mathfu::vec3( distribution( rng ), distribution( rng ), distribution( rng ) );
+    };
+
+    const uint32_t meshCount = 64;
+
+    scene.sourceScene = nullptr;
+    scene.deviceAsset = nullptr;
+    scene.meshes.resize( meshCount );
+    scene.nodes.resize( nodeCount );
+    scene.parentIds.assign( nodeCount, uint32_t( -1 ) );
+    scene.transforms.Resize( nodeCount );
+
+    for ( auto &mesh : scene.meshes ) {
+        mesh.deviceAsset = nullptr;
+        mesh.bboxMax     = randomVec3( sizeDistribution );
+        mesh.bboxMin     = -mesh.bboxMax;
+    }
+
+    for ( uint32_t nodeId = 0; nodeId < nodeCount; ++nodeId ) {
+        auto &node  = scene.nodes[ nodeId ];
+        node.id     = nodeId;
+        node.scene  = &scene;
+        node.meshId = nodeId % meshCount;
+
+        /* Every 8th node has a parent. */
+        if ( nodeId && 0 == ( nodeId % 8 ) ) {
+            const uint32_t parentId = std::uniform_int_distribution< uint32_t >( 0, nodeId - 1 )( rng );
+            node.parentId             = parentId;
+            scene.parentIds[ nodeId ] = parentId;
+            scene.nodes[ parentId ].childIds.push_back( nodeId );
+        }
+
+        SceneNodeTransform transform = scene.transforms.Get( nodeId ); /* Identity */
+        transform.translation = node.parentId != uint32_t( -1 ) ? randomVec3( sizeDistribution ) : randomVec3( offsetDistribution );
+        transform.rotation    = randomVec3( angleDistribution );
+        scene.transforms.Set( nodeId, transform );
+    }
+
+    scene.UpdateMatrices( );
+}
+
+void apemode::BenchmarkSceneCulling( uint32_t nodeCount, uint32_t iterationCount ) {
+    if ( 0 == nodeCount || 0 == iterationCount )
+        return;
+
+    Scene scene;
+    GenerateSceneBoxes( scene, nodeCount );
+
+    /* The eye is in the center, looking at (0, 0, 1) along +z (mathfu::mat4::LookAt takes the target first, then the eye). */
+    const mathfu::mat4 viewMatrix = mathfu::mat4::LookAt( mathfu::vec3( 0, 0, 1 ), mathfu::vec3( 0, 0, 0 ), mathfu::vec3( 0, 1, 0 ), -1 );
+    const mathfu::mat4 projMatrix = CameraProjectionController( ).ProjMatrix( 55.0f, 1280.0f, 720.0f, 0.1f, 1000.0f );
+
+    SceneCuller culler;
+    culler.Cull( &scene, viewMatrix, projMatrix ); /* Warm up */
+
+    double elapsedMs = 0;
+    for ( uint32_t i = 0; i < iterationCount; ++i ) {
+        culler.Cull( &scene, viewMatrix, projMatrix );
+        elapsedMs += culler.stats.elapsedMs;
+    }
+
+    //
+    // Reference results with the scalar test, transforms the corners of the boxes.
+    //
+
+    SceneFrustum frustum;
+    frustum.SetViewProjMatrix( projMatrix * viewMatrix );
+
+    uint32_t mismatchCount = 0;
+    for ( auto &node : scene.nodes ) {
+        auto &mesh  = scene.meshes[ node.meshId ];
+        auto &world = scene.worldMatrices[ node.id ];
+
+        mathfu::vec3 boundsMin( std::numeric_limits< float >::max( ) );
+        mathfu::vec3 boundsMax( -std::numeric_limits< float >::max( ) );
+        for ( uint32_t corner = 0; corner < 8; ++corner ) {
+            const mathfu::vec3 p( corner & 1 ? mesh.bboxMax.x : mesh.bboxMin.x,
+                                  corner & 2 ? mesh.bboxMax.y : mesh.bboxMin.y,
+                                  corner & 4 ? mesh.bboxMax.z : mesh.bboxMin.z );
+            const mathfu::vec3 q = world * p;
+            boundsMin = mathfu::vec3::Min( boundsMin, q );
+            boundsMax = mathfu::vec3::Max( boundsMax, q );
+        }
+
+        const bool isVisible = frustum.IsVisible( ( boundsMin + boundsMax ) * 0.5f, ( boundsMax - boundsMin ) * 0.5f );
+        mismatchCount += isVisible != culler.IsVisible( node.id );
+    }
+
+    if ( auto appState = apemode::AppState::GetCurrentState( ) ) {
+        if ( appState->consoleLogger ) {
+            appState->consoleLogger->info( "Culling: {} nodes, {} iterations", nodeCount, iterationCount );
+            appState->consoleLogger->info( "Culling: {:.3f} ms, {} tested, {} visible, {} culled, {} mismatches",
+                                           elapsedMs / iterationCount,
+                                           culler.stats.testedNodeCount,
+                                           culler.stats.visibleNodeCount,
+                                           culler.stats.culledNodeCount,
+                                           mismatchCount );
+        }
+    }
+}
+
+void apemode::BenchmarkSceneClusterCulling( uint32_t nodeCount, uint32_t iterationCount ) {
+    if ( 0 == nodeCount || 0 == iterationCount )
+        return;
+
+    Scene scene;
+    GenerateSceneBoxes( scene, nodeCount );
+
+    //
+    // The meshes are the spheres inside their boxes, split into the latitude-longitude patches.
+    // The patch normals are within the angle from the patch center direction, all the triangle planes are in front of the sphere center,
+    // so the cone apex is the sphere center.
+    //
+
+    const uint32_t kLatitudeCount  = 8;
+    const uint32_t kLongitudeCount = 16;
+    const uint32_t kTriangleCount  = 124; /* Per cluster */
+    const uint32_t kSampleCount    = 5;   /* The patch center and corners */
+
+    const auto direction = []( float latitude, float longitude ) {
+        return mathfu::vec3( sinf( latitude ) * cosf( longitude ), cosf( latitude ), sinf( latitude ) * sinf( longitude ) );
+    };
+
+    /* The normals of the patches (object space, unit sphere), to validate the backface culling. */
+    std::vector< mathfu::vec3 > patchSamples( kLatitudeCount * kLongitudeCount * kSampleCount );
+
+    for ( auto &mesh : scene.meshes ) {
+        const float radius = std::min( mesh.bboxMax.x, std::min( mesh.bboxMax.y, mesh.bboxMax.z ) );
+
+        mesh.subsets.resize( 1 );
+        mesh.subsets[ 0 ].clusterCount = kLatitudeCount * kLongitudeCount;
+        mesh.subsets[ 0 ].indexCount   = kLatitudeCount * kLongitudeCount * kTriangleCount * 3;
+        mesh.clusters.resize( kLatitudeCount * kLongitudeCount );
+
+        for ( uint32_t i = 0; i < kLatitudeCount; ++i ) {
+            for ( uint32_t j = 0; j < kLongitudeCount; ++j ) {
+                const uint32_t c = i * kLongitudeCount + j;
+
+                const float latitudes[ 2 ]  = {float( M_PI ) * i / kLatitudeCount, float( M_PI ) * ( i + 1 ) / kLatitudeCount};
+                const float longitudes[ 2 ] = {2 * float( M_PI ) * j / kLongitudeCount, 2 * float( M_PI ) * ( j + 1 ) / kLongitudeCount};
+
+                mathfu::vec3 *samples = &patchSamples[ c * kSampleCount ];
+                samples[ 0 ] = direction( ( latitudes[ 0 ] + latitudes[ 1 ] ) * 0.5f, ( longitudes[ 0 ] + longitudes[ 1 ] ) * 0.5f );
+                samples[ 1 ] = direction( latitudes[ 0 ], longitudes[ 0 ] );
+                samples[ 2 ] = direction( latitudes[ 0 ], longitudes[ 1 ] );
+                samples[ 3 ] = direction( latitudes[ 1 ], longitudes[ 0 ] );
+                samples[ 4 ] = direction( latitudes[ 1 ], longitudes[ 1 ] );
+
+                float minDot = 1;
+                for ( uint32_t s = 1; s < kSampleCount; ++s )
+                    minDot = std::min( minDot, mathfu::vec3::DotProduct( samples[ 0 ], samples[ s ] ) );
+
+                auto &cluster      = mesh.clusters[ c ];
+                cluster.center     = samples[ 0 ] * radius;
+                cluster.radius     = radius * sqrtf( std::max( 2 - 2 * minDot, 0.0f ) );
+                cluster.coneApex   = mathfu::vec3( 0, 0, 0 );
+                cluster.coneAxis   = samples[ 0 ];
+                cluster.coneCutoff = minDot > 0.1f ? sqrtf( 1 - minDot * minDot ) : 1;
+                cluster.baseIndex  = c * kTriangleCount * 3;
+                cluster.indexCount = kTriangleCount * 3;
+            }
+        }
+    }
+
+    /* The eye is in the center, looking at (0, 0, 1) along +z (mathfu::mat4::LookAt takes the target first, then the eye). */
+    const mathfu::mat4 viewMatrix = mathfu::mat4::LookAt( mathfu::vec3( 0, 0, 1 ), mathfu::vec3( 0, 0, 0 ), mathfu::vec3( 0, 1, 0 ), -1 );
+    const mathfu::mat4 projMatrix = CameraProjectionController( ).ProjMatrix( 55.0f, 1280.0f, 720.0f, 0.1f, 1000.0f );
+
+    SceneCuller culler;
+    culler.Cull( &scene, viewMatrix, projMatrix );
+
+    SceneClusterCuller             clusterCuller;
+    std::vector< SceneIndexRange > ranges;
+
+    /* The clusters of the visible nodes, like in the renderer. */
+    const auto cullClusters = [&]( ) {
+        ranges.clear( );
+        clusterCuller.Begin( viewMatrix, projMatrix );
+        for ( auto &node : scene.nodes ) {
+            if ( culler.IsVisible( node.id ) )
+                clusterCuller.Cull( &scene, node.id, 0, ranges );
+        }
+    };
+
+    cullClusters( ); /* Warm up */
+
+    double elapsedMs = 0;
+    for ( uint32_t i = 0; i < iterationCount; ++i ) {
+        cullClusters( );
+        elapsedMs += clusterCuller.stats.elapsedMs;
+    }
+
+    //
+    // The backface culling must be conservative: the culled clusters must not have the samples that face the eye.
+    //
+
+    const mathfu::vec3 eyePosition = viewMatrix.Inverse( ) * mathfu::vec3( 0, 0, 0 );
+
+    uint32_t wrongCullCount = 0;
+    for ( auto &node : scene.nodes ) {
+        if ( false == culler.IsVisible( node.id ) )
+            continue;
+
+        auto &mesh  = scene.meshes[ node.meshId ];
+        auto &world = scene.worldMatrices[ node.id ];
+
+        const mathfu::vec3 objectEyePosition = world.Inverse( ) * eyePosition;
+        const float        radius            = std::min( mesh.bboxMax.x, std::min( mesh.bboxMax.y, mesh.bboxMax.z ) );
+
+        for ( uint32_t c = 0; c < mesh.clusters.size( ); ++c ) {
+            auto &cluster = mesh.clusters[ c ];
+            if ( cluster.coneCutoff >= 1 ||
+                 mathfu::vec3::DotProduct( ( cluster.coneApex - objectEyePosition ).Normalized( ), cluster.coneAxis ) < cluster.coneCutoff )
+                continue;
+
+            for ( uint32_t s = 0; s < kSampleCount; ++s ) {
+                const mathfu::vec3 &normal = patchSamples[ c * kSampleCount + s ];
+                if ( mathfu::vec3::DotProduct( normal, objectEyePosition - normal * radius ) > 0 ) {
+                    ++wrongCullCount;
+                    break;
+                }
+            }
+        }
+    }
+
+    if ( auto appState = apemode::AppState::GetCurrentState( ) ) {
+        if ( appState->consoleLogger ) {
+            auto &stats = clusterCuller.stats;
+            appState->consoleLogger->info( "ClusterCulling: {} nodes, {} clusters per mesh, {} iterations",
+                                           nodeCount,
+                                           kLatitudeCount * kLongitudeCount,
+                                           iterationCount );
+            appState->consoleLogger->info( "ClusterCulling: {:.3f} ms, {} tested, {} frustum culled, {} backface culled, {} ranges, {} wrong culls",
+                                           elapsedMs / iterationCount,
+                                           stats.testedClusterCount,
+                                           stats.frustumCulledClusterCount,
+                                           stats.backfaceCulledClusterCount,
+                                           stats.rangeCount,
+                                           wrongCullCount );
+            appState->consoleLogger->info( "ClusterCulling: {} of {} triangles culled ({:.1f}%)",
+                                           stats.culledTriangleCount,
+                                           stats.testedTriangleCount,
+                                           stats.testedTriangleCount ? 100.0 * stats.culledTriangleCount / stats.testedTriangleCount : 0.0 );
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <fbxvpch.h>
+#include <SceneDrawList.h>
+
+namespace apemode {
+
+    class Scene;
+
+    /**
+     * Counters of the last SceneCuller::Cull() call.
+     **/
+    struct SceneCullingStats {
+        uint32_t testedNodeCount  = 0; /* Nodes with meshes */
+        uint32_t visibleNodeCount = 0;
+        uint32_t culledNodeCount  = 0;
+        double   elapsedMs        = 0;
+    };
+
+    /**
+     * Counters of the SceneClusterCuller::Cull() calls since the last SceneClusterCuller::Begin() call.
+     **/
+    struct SceneClusterCullingStats {
+        uint32_t testedClusterCount         = 0;
+        uint32_t frustumCulledClusterCount  = 0;
+        uint32_t backfaceCulledClusterCount = 0;
+        uint32_t testedTriangleCount        = 0;
+        uint32_t culledTriangleCount        = 0;
+        uint32_t rangeCount                 = 0; /* Visible index ranges (the adjacent visible clusters are merged) */
+        double   elapsedMs                  = 0;
+    };
+
+    /**
+     * World-space box of the node with mesh (the mesh bounding box is transformed with the world matrix).
+     **/
+    void CalculateWorldBounds( const Scene *scene, uint32_t nodeId, float *center, float *extents );
+
+    /**
+     * Frustum planes in world space, the normals point inside, the planes are normalized.
+     * The planes are extracted from the view-projection matrix, Vulkan clip space is assumed (0 <= z <= w).
+     **/
+    struct SceneFrustum {
+        enum EPlane { ePlane_Left, ePlane_Right, ePlane_Bottom, ePlane_Top, ePlane_Near, ePlane_Far, ePlaneCount };
+
+        float planes[ ePlaneCount ][ 4 ]; /* Normal and distance: dot(n, p) + d >= 0 for the inner points */
+
+        void SetViewProjMatrix( mathfu::mat4 const &viewProjMatrix );
+
+        /* Reference test (scalar, no batching). */
+        bool IsVisible( mathfu::vec3 const &boundsCenter, mathfu::vec3 const &boundsExtents ) const;
+        bool IsVisible( mathfu::vec3 const &sphereCenter, float sphereRadius ) const;
+    };
+
+    /**
+     * Culls the nodes with meshes against the view frustum.
+     * The world-space boxes are calculated from the mesh bounding boxes (see SceneMesh) and the world matrices,
+     * the boxes are tested against the frustum planes in batches of 4 (SSE).
+     * If the scene has the tree built (@see SceneBvh), it is queried instead, it should be refitted before.
+     * The nodes without meshes are always visible.
+     **/
+    class SceneCuller {
+    public:
+        std::vector< uint8_t > nodeVisibility; /* Per node, non-zero if visible */
+        SceneCullingStats      stats;
+
+        void Cull( const Scene *scene, mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix );
+        void Cull( const Scene *scene, SceneFrustum const &frustum );
+
+        inline bool IsVisible( uint32_t nodeId ) const {
+            return nodeId >= nodeVisibility.size( ) || 0 != nodeVisibility[ nodeId ];
+        }
+
+    private:
+        std::vector< uint32_t > nodeIds;        /* Tested nodes, padded to the batch size */
+        std::vector< float >    boundsChannels; /* World-space box centers and extents (x, y, z), one channel after another */
+    };
+
+    /**
+     * Culls the clusters of the visible subsets (see SceneMeshCluster), the subsets of the meshes without clusters are always visible.
+     * The bounding spheres are tested against the frustum in world space (the radius is scaled with the largest axis scale),
+     * the normal cones are tested in object space (the eye is transformed with the inverse world matrix).
+     * The skinned meshes are not culled per cluster, the clusters are in the bind pose.
+     **/
+    class SceneClusterCuller {
+    public:
+        SceneClusterCullingStats stats;
+
+        void Begin( mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix );
+
+        /**
+         * Appends the visible index ranges of the subset to the ranges (the adjacent visible clusters are merged).
+         * Nothing is appended if all the clusters are visible, the whole subset is drawn then.
+         * @return False if all the clusters are culled.
+         **/
+        bool Cull( const Scene *scene, uint32_t nodeId, uint32_t subsetIndex, std::vector< SceneIndexRange > &ranges );
+
+    private:
+        SceneFrustum frustum;
+        mathfu::vec3 eyePosition;
+        uint32_t     nodeId = uint32_t( -1 ); /* The node of the last call, its object space eye and scale are reused */
+        mathfu::vec3 objectEyePosition;
+        float        worldScale = 1;
+    };
+
+    /**
+     * Selects the levels of detail of the nodes (see SceneMeshLod) from the projected error:
+     * the coarsest level with the error under the pixel threshold at the distance to the node bounds.
+     * The object space errors are scaled with the largest axis scale of the world matrix.
+     **/
+    class SceneLodSelector {
+    public:
+        uint32_t simplifiedNodeCount = 0; /* Nodes with the simplified levels selected since the last Begin() call */
+
+        void Begin( mathfu::mat4 const &viewMatrix, mathfu::mat4 const &projMatrix, float viewportHeight, float maxErrorPixels );
+
+        /**
+         * @return The level index in SceneMesh::lods, zero if the mesh has no levels or the eye is inside the node bounds.
+         **/
+        uint32_t Select( const Scene *scene, uint32_t nodeId );
+
+    private:
+        mathfu::vec3 eyePosition;
+        float        pixelsPerUnit  = 0; /* Projected size of the unit at the unit distance */
+        float        maxErrorPixels = 0;
+    };
+
+    /**
+     * Fills the scene with the randomly placed boxes (the meshes have only the bounding boxes), for the benchmarks.
+     **/
+    void GenerateSceneBoxes( Scene &scene, uint32_t nodeCount, float sceneSize = 1000.0f, uint32_t seed = 42 );
+
+    /**
+     * Builds the synthetic scene with the randomly placed boxes, and measures the culling against the camera frustum.
+     * The results are validated with the reference test (SceneFrustum::IsVisible()), the stats go to the console.
+     **/
+    void BenchmarkSceneCulling( uint32_t nodeCount, uint32_t iterationCount = 16 );
+
+    /**
+     * Builds the synthetic scene with the sphere meshes (the clusters are the patches of the sphere with the normal cones),
+     * and measures the cluster culling against the camera frustum. The stats (the triangles culled) go to the console.
+     **/
+    void BenchmarkSceneClusterCulling( uint32_t nodeCount, uint32_t iterationCount = 16 );
+}
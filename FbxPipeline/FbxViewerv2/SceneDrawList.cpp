@@ -0,0 +1,227 @@
+#include <fbxvpch.h>
+
+#include <SceneDrawList.h>
+#include <AppState.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace {
+    const uint32_t kRadixBitCount  = 8;
+    const uint32_t kRadixSize      = 1 << kRadixBitCount;
+    const uint32_t kRadixPassCount = 64 / kRadixBitCount;
+
+    inline uint64_t MaskField( uint32_t value, uint32_t bitCount ) {
+        return uint64_t( value ) & ( ( uint64_t( 1 ) << bitCount ) - 1 );
+    }
+}
+
+uint64_t apemode::SceneDrawList::MakeSortKey( uint32_t pipelineId, uint32_t bufferId, uint32_t materialId, uint32_t meshId, uint32_t subsetIndex ) {
+    uint64_t sortKey = MaskField( pipelineId, kPipelineBitCount );
+    sortKey = ( sortKey << kBufferBitCount ) | MaskField( bufferId, kBufferBitCount );
+    sortKey = ( sortKey << kMaterialBitCount ) | MaskField( materialId, kMaterialBitCount );
+    sortKey = ( sortKey << kMeshBitCount ) | MaskField( meshId, kMeshBitCount );
+    sortKey = ( sortKey << kSubsetBitCount ) | MaskField( subsetIndex, kSubsetBitCount );
+    return sortKey;
+}
+
+void apemode::SceneDrawList::Sort( ) {
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    const uint32_t packetCount = uint32_t( packets.size( ) );
+
+    stats             = SceneDrawListStats( );
+    stats.packetCount = packetCount;
+
+    sortItems[ 0 ].resize( packetCount );
+    sortItems[ 1 ].resize( packetCount );
+
+    //
+    // Build the histograms for all the passes at once.
+    //
+
+    uint32_t histograms[ kRadixPassCount ][ kRadixSize ] = {};
+    for ( uint32_t i = 0; i < packetCount; ++i ) {
+        const uint64_t sortKey = packets[ i ].sortKey;
+        sortItems[ 0 ][ i ]    = {sortKey, i};
+
+        for ( uint32_t pass = 0; pass < kRadixPassCount; ++pass )
+            ++histograms[ pass ][ ( sortKey >> ( pass * kRadixBitCount ) ) & ( kRadixSize - 1 ) ];
+    }
+
+    //
+    // Scatter the items by each digit, starting from the lowest one.
+    // The passes, where all the keys have the same digit, are skipped (the high bits are mostly zeros).
+    //
+
+    uint32_t src = 0;
+    for ( uint32_t pass = 0; pass < kRadixPassCount; ++pass ) {
+        auto &histogram = histograms[ pass ];
+
+        const uint32_t firstDigit = ( packetCount ? ( sortItems[ src ][ 0 ].sortKey >> ( pass * kRadixBitCount ) ) & ( kRadixSize - 1 ) : 0 );
+        if ( histogram[ firstDigit ] == packetCount )
+            continue;
+
+        uint32_t offsets[ kRadixSize ];
+        uint32_t offset = 0;
+        for ( uint32_t digit = 0; digit < kRadixSize; ++digit ) {
+            offsets[ digit ] = offset;
+            offset += histogram[ digit ];
+        }
+
+        auto &srcItems = sortItems[ src ];
+        auto &dstItems = sortItems[ 1 - src ];
+        for ( auto &item : srcItems )
+            dstItems[ offsets[ ( item.sortKey >> ( pass * kRadixBitCount ) ) & ( kRadixSize - 1 ) ]++ ] = item;
+
+        src = 1 - src;
+    }
+
+    //
+    // Emit the draws, the state is bound only if it changes.
+    //
+
+    draws.resize( packetCount );
+
+    const SceneDrawPacket *prevPacket = nullptr;
+    for ( uint32_t i = 0; i < packetCount; ++i ) {
+        const uint32_t         packetIndex = sortItems[ src ][ i ].packetIndex;
+        const SceneDrawPacket &packet      = packets[ packetIndex ];
+
+        uint32_t bindFlags = 0;
+        if ( nullptr == prevPacket || prevPacket->pipelineId != packet.pipelineId ) {
+            bindFlags |= SceneDraw::eBindFlag_Pipeline;
+            ++stats.pipelineBindCount;
+        }
+        if ( nullptr == prevPacket || prevPacket->bufferId != packet.bufferId ) {
+            bindFlags |= SceneDraw::eBindFlag_Buffer;
+            ++stats.bufferBindCount;
+        }
+        if ( nullptr == prevPacket || prevPacket->materialId != packet.materialId ) {
+            bindFlags |= SceneDraw::eBindFlag_Material;
+            ++stats.materialBindCount;
+        }
+
+        draws[ i ].packetIndex   = packetIndex;
+        draws[ i ].bindFlags     = bindFlags;
+        draws[ i ].instanceCount = 0;
+        prevPacket               = &packet;
+    }
+
+    //
+    // Group the instances: the runs of the same state, mesh and subset are drawn with the first draw of the run.
+    // The packets with the visible ranges are drawn alone.
+    //
+
+    for ( uint32_t i = 0; i < packetCount; ) {
+        const SceneDrawPacket &packet = packets[ draws[ i ].packetIndex ];
+
+        uint32_t j = i + 1;
+        for ( ; j < packetCount && 0 == packet.rangeCount; ++j ) {
+            const SceneDrawPacket &instancePacket = packets[ draws[ j ].packetIndex ];
+            if ( instancePacket.pipelineId != packet.pipelineId || instancePacket.bufferId != packet.bufferId ||
+                 instancePacket.materialId != packet.materialId || instancePacket.meshId != packet.meshId ||
+                 instancePacket.subsetIndex != packet.subsetIndex || 0 != instancePacket.rangeCount )
+                break;
+        }
+
+        draws[ i ].instanceCount = j - i;
+        ++stats.drawCount;
+        stats.drawCallCount += packet.rangeCount ? packet.rangeCount : 1;
+        i = j;
+    }
+
+    /* The same binds in the order the packets were added in. */
+    for ( uint32_t i = 0; i < packetCount; ++i ) {
+        stats.naivePipelineBindCount += 0 == i || packets[ i - 1 ].pipelineId != packets[ i ].pipelineId;
+        stats.naiveBufferBindCount += 0 == i || packets[ i - 1 ].bufferId != packets[ i ].bufferId;
+        stats.naiveMaterialBindCount += 0 == i || packets[ i - 1 ].materialId != packets[ i ].materialId;
+    }
+
+    const uint32_t bindCount      = stats.pipelineBindCount + stats.bufferBindCount + stats.materialBindCount;
+    const uint32_t naiveBindCount = stats.naivePipelineBindCount + stats.naiveBufferBindCount + stats.naiveMaterialBindCount;
+    stats.savedBindCount          = naiveBindCount > bindCount ? naiveBindCount - bindCount : 0;
+
+    std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+    stats.sortElapsedMs = elapsed.count( );
+}
+
+void apemode::BenchmarkSceneDrawList( uint32_t packetCount, uint32_t iterationCount ) {
+    if ( 0 == iterationCount )
+        return;
+
+    auto appState = apemode::AppState::GetCurrentState( );
+    if ( nullptr == appState || nullptr == appState->consoleLogger )
+        return;
+
+    //
+    // The packets are added in the scene order: the nodes use random meshes (that are spread over few buffers),
+    // every mesh has 1..4 subsets with random materials.
+    //
+
+    const uint32_t pipelineCount = 2;
+    const uint32_t bufferCount   = 4;
+    const uint32_t materialCount = 256;
+    const uint32_t meshCount     = 1024;
+
+    std::mt19937 rng( 42 );
+
+    std::vector< uint32_t > meshSubsetCounts( meshCount );
+    std::vector< uint32_t > meshMaterialIds( meshCount * 4 );
+    for ( uint32_t meshId = 0; meshId < meshCount; ++meshId ) {
+        meshSubsetCounts[ meshId ] = 1 + rng( ) % 4;
+        for ( uint32_t subsetIndex = 0; subsetIndex < 4; ++subsetIndex )
+            meshMaterialIds[ meshId * 4 + subsetIndex ] = rng( ) % materialCount;
+    }
+
+    SceneDrawList drawList;
+    for ( uint32_t nodeId = 0; drawList.packets.size( ) < packetCount; ++nodeId ) {
+        const uint32_t meshId = rng( ) % meshCount;
+        for ( uint32_t subsetIndex = 0; subsetIndex < meshSubsetCounts[ meshId ]; ++subsetIndex ) {
+            drawList.AddPacket( meshId % pipelineCount,
+                                meshId % bufferCount,
+                                meshMaterialIds[ meshId * 4 + subsetIndex ],
+                                meshId,
+                                subsetIndex,
+                                nodeId );
+        }
+    }
+
+    double elapsedMs = 0;
+    for ( uint32_t i = 0; i < iterationCount; ++i ) {
+        drawList.Sort( );
+        elapsedMs += drawList.stats.sortElapsedMs;
+    }
+
+    /* The radix sort is stable, the order should be exactly the same. */
+    std::vector< uint32_t > referenceOrder( drawList.packets.size( ) );
+    for ( uint32_t i = 0; i < referenceOrder.size( ); ++i )
+        referenceOrder[ i ] = i;
+
+    auto startTime = std::chrono::high_resolution_clock::now( );
+    std::stable_sort( referenceOrder.begin( ), referenceOrder.end( ), [&]( uint32_t a, uint32_t b ) {
+        return drawList.packets[ a ].sortKey < drawList.packets[ b ].sortKey;
+    } );
+    std::chrono::duration< double, std::milli > referenceElapsed = std::chrono::high_resolution_clock::now( ) - startTime;
+
+    uint32_t mismatchCount = 0;
+    for ( uint32_t i = 0; i < referenceOrder.size( ); ++i )
+        mismatchCount += referenceOrder[ i ] != drawList.draws[ i ].packetIndex;
+
+    auto &stats = drawList.stats;
+    appState->consoleLogger->info( "DrawList: {} packets ({} instanced draws), sort {:.3f} ms (std::stable_sort {:.3f} ms), {} mismatches",
+                                   stats.packetCount,
+                                   stats.drawCount,
+                                   elapsedMs / iterationCount,
+                                   referenceElapsed.count( ),
+                                   mismatchCount );
+    appState->consoleLogger->info( "DrawList: binds: pipeline {} (naive {}), buffer {} (naive {}), material {} (naive {}), {} saved",
+                                   stats.pipelineBindCount,
+                                   stats.naivePipelineBindCount,
+                                   stats.bufferBindCount,
+                                   stats.naiveBufferBindCount,
+                                   stats.materialBindCount,
+                                   stats.naiveMaterialBindCount,
+                                   stats.savedBindCount );
+}
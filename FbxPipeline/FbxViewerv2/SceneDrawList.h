@@ -0,0 +1,136 @@
+#pragma once
+
+#include <fbxvpch.h>
+
+namespace apemode {
+
+    /**
+     * Counters of the last SceneDrawList::Sort() call.
+     * The naive binds are counted in the packet order (the order they were added in).
+     **/
+    struct SceneDrawListStats {
+        uint32_t packetCount            = 0;
+        uint32_t drawCount              = 0; /* Instanced draws (the packets with the same state, mesh and subset are merged) */
+        uint32_t drawCallCount          = 0; /* The instanced draws, and the draws of the visible index ranges (a call per range) */
+        uint32_t pipelineBindCount      = 0;
+        uint32_t bufferBindCount        = 0;
+        uint32_t materialBindCount      = 0;
+        uint32_t naivePipelineBindCount = 0;
+        uint32_t naiveBufferBindCount   = 0;
+        uint32_t naiveMaterialBindCount = 0;
+        uint32_t savedBindCount         = 0; /* All the naive binds minus all the sorted binds */
+        double   sortElapsedMs          = 0;
+    };
+
+    /**
+     * Index range of the subset that is drawn instead of the whole subset (the visible clusters, see SceneClusterCuller).
+     **/
+    struct SceneIndexRange {
+        uint32_t baseIndex  = 0;
+        uint32_t indexCount = 0;
+    };
+
+    /**
+     * Everything needed to record a draw, the ids are opaque for the draw list (only compared).
+     **/
+    struct SceneDrawPacket {
+        uint64_t sortKey     = 0;
+        uint32_t pipelineId  = 0;
+        uint32_t bufferId    = 0; /* Vertex and index buffers */
+        uint32_t materialId  = 0;
+        uint32_t meshId      = 0;
+        uint32_t subsetIndex = 0;
+        uint32_t nodeId      = 0;
+        uint32_t firstRange  = 0; /* Index in SceneDrawList::ranges */
+        uint32_t rangeCount  = 0; /* Zero if the whole subset is drawn (only such packets are drawn as instances) */
+    };
+
+    /**
+     * Sorted packet with the state changes that need to be recorded before the draw.
+     **/
+    struct SceneDraw {
+        enum EBindFlags {
+            eBindFlag_Pipeline = 1,
+            eBindFlag_Buffer   = 2,
+            eBindFlag_Material = 4,
+        };
+
+        uint32_t packetIndex   = 0;
+        uint32_t bindFlags     = 0; /* EBindFlags */
+        uint32_t instanceCount = 0; /* Packets drawn at once (this one and the next ones), zero if drawn with the previous ones */
+    };
+
+    /**
+     * Gathers the draw packets, and sorts them to minimize the state changes.
+     * The packets are sorted by the 64-bit keys (LSD radix sort, stable), the key fields are (from the high bits):
+     * pipeline (4 bits), buffer (16 bits), material (16 bits), mesh (16 bits), subset (12 bits).
+     * The larger ids are wrapped, so they can be grouped worse, but the binds are always correct (the ids are compared, not the keys).
+     * The adjacent packets that differ only in nodes are drawn as instances,
+     * unless the packets have the visible index ranges (they are drawn per range).
+     * It does not depend on the graphics API.
+     **/
+    class SceneDrawList {
+    public:
+        static const uint32_t kPipelineBitCount = 4;
+        static const uint32_t kBufferBitCount   = 16;
+        static const uint32_t kMaterialBitCount = 16;
+        static const uint32_t kMeshBitCount     = 16;
+        static const uint32_t kSubsetBitCount   = 12;
+
+        std::vector< SceneDrawPacket > packets; /* In the order they were added */
+        std::vector< SceneIndexRange > ranges;  /* Visible index ranges of the packets */
+        std::vector< SceneDraw >       draws;   /* Sorted, filled in Sort() */
+        SceneDrawListStats             stats;
+
+        static uint64_t MakeSortKey( uint32_t pipelineId, uint32_t bufferId, uint32_t materialId, uint32_t meshId, uint32_t subsetIndex );
+
+        inline void Reset( ) {
+            packets.clear( );
+            ranges.clear( );
+            draws.clear( );
+        }
+
+        /**
+         * Adds the packet, the ranges are the last ones in SceneDrawList::ranges (appended by the caller).
+         **/
+        inline void AddPacket( uint32_t pipelineId,
+                               uint32_t bufferId,
+                               uint32_t materialId,
+                               uint32_t meshId,
+                               uint32_t subsetIndex,
+                               uint32_t nodeId,
+                               uint32_t firstRange = 0,
+                               uint32_t rangeCount = 0 ) {
+            packets.emplace_back( );
+            auto &packet       = packets.back( );
+            packet.sortKey     = MakeSortKey( pipelineId, bufferId, materialId, meshId, subsetIndex );
+            packet.pipelineId  = pipelineId;
+            packet.bufferId    = bufferId;
+            packet.materialId  = materialId;
+            packet.meshId      = meshId;
+            packet.subsetIndex = subsetIndex;
+            packet.nodeId      = nodeId;
+            packet.firstRange  = firstRange;
+            packet.rangeCount  = rangeCount;
+        }
+
+        /**
+         * Sorts the packets into the draws, sets the bind flags for the state changes, and groups the instances.
+         **/
+        void Sort( );
+
+    private:
+        struct SortItem {
+            uint64_t sortKey;
+            uint32_t packetIndex;
+        };
+
+        std::vector< SortItem > sortItems[ 2 ]; /* Ping-pong buffers for the radix sort passes */
+    };
+
+    /**
+     * Builds the draw lists of random packets (the scenes with many materials and few buffers),
+     * and measures the sorting. The order is validated against std::stable_sort, the stats go to the console.
+     **/
+    void BenchmarkSceneDrawList( uint32_t packetCount, uint32_t iterationCount = 16 );
+}
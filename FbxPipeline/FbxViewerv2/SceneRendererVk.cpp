@@ -2,56 +2,138 @@
 
 #include <QueuePools.Vulkan.h>
 #include <BufferPools.Vulkan.h>
+#include <UploadQueue.Vulkan.h>
+#include <MemoryAllocator.Vulkan.h>
 #include <ShaderCompiler.Vulkan.h>
 
 #include <SceneRendererVk.h>
 #include <Scene.h>
 #include <ArrayUtils.h>
+#include <AppState.h>
 #include <shaderc/shaderc.hpp>
+#include <tbb/tbb.h>
+#include <chrono>
 
 namespace apemodevk {
 
-    struct StaticVertex {
-        float position[ 3 ];
-        float normal[ 3 ];
-        float tangent[ 4 ];
-        float texcoords[ 2 ];
-        /*apemodem::vec3 position;
-        apemodem::vec3 normal;
-        apemodem::vec4 tangent;
-        apemodem::vec2 texcoords;*/
-    };
+    /**
+     * Vertex input format of the attribute (see VertexAttributeFb), VK_FORMAT_UNDEFINED if it is not supported.
+     * The octahedral normals and tangents are fetched as 2 snorm components.
+     **/
+    VkFormat GetVertexAttributeFormat( apemodefb::VertexAttributeFb const& attribute ) {
+        const uint32_t componentCount = attribute.component_count( );
+        const uint32_t bitWidth       = attribute.bit_width( );
+
+        switch ( attribute.encoding( ) ) {
+            case apemodefb::EVertexAttributeEncodingFb_Float:
+                switch ( componentCount ) {
+                    case 1: return VK_FORMAT_R32_SFLOAT;
+                    case 2: return VK_FORMAT_R32G32_SFLOAT;
+                    case 3: return VK_FORMAT_R32G32B32_SFLOAT;
+                    case 4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+                }
+                break;
+
+            case apemodefb::EVertexAttributeEncodingFb_Unorm:
+                switch ( bitWidth ) {
+                    case 8: return VK_FORMAT_R8G8B8A8_UNORM;
+                    case 10: return VK_FORMAT_A2B10G10R10_UNORM_PACK32; /* x is in the lowest bits */
+                    case 16: return componentCount <= 2 ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16B16A16_UNORM;
+                }
+                break;
+
+            case apemodefb::EVertexAttributeEncodingFb_Snorm:
+                switch ( bitWidth ) {
+                    case 8: return VK_FORMAT_R8G8B8A8_SNORM;
+                    case 10: return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+                    case 16: return componentCount <= 2 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R16G16B16A16_SNORM;
+                }
+                break;
+
+            case apemodefb::EVertexAttributeEncodingFb_Octahedral:
+                return 16 == bitWidth ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_UNDEFINED;
+
+            case apemodefb::EVertexAttributeEncodingFb_Half:
+                return componentCount <= 2 ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+
+            case apemodefb::EVertexAttributeEncodingFb_UInt:
+                return 8 == bitWidth ? VK_FORMAT_R8G8B8A8_UINT : VK_FORMAT_UNDEFINED;
+
+            default:
+                break;
+        }
 
-    struct PackedVertex {
-        uint32_t position;
-        uint32_t normal;
-        uint32_t tangent;
-        uint32_t texcoords;
-    };
+        return VK_FORMAT_UNDEFINED;
+    }
 
+    /* Written once per frame. */
     struct FrameUniformBuffer {
-        apemodem::mat4 worldMatrix;
         apemodem::mat4 viewMatrix;
         apemodem::mat4 projectionMatrix;
+    };
+
+    /* Pushed per draw. */
+    struct DrawPushConstants {
         apemodem::vec4 color;
         apemodem::vec4 positionOffset;
         apemodem::vec4 positionScale;
+        uint32_t       instanceOffset; /* The first node id of the draw in the instance buffer */
     };
 
     struct SceneDeviceAssetVk {
         GraphicsDevice*                                         pNode = nullptr;
         apemodevk::TDispatchableHandle< VkDescriptorSetLayout > hDescSetLayout;
+        apemodevk::TDispatchableHandle< VkDescriptorSetLayout > hStorageDescSetLayout;
         apemodevk::TDispatchableHandle< VkPipelineLayout >      hPipelineLayout;
         apemodevk::TDispatchableHandle< VkPipelineCache >       hPipelineCache;
-        apemodevk::TDispatchableHandle< VkPipeline >            hPipeline;
 
-        static uint32_t const kMaxFrameCount = 3;
+        static uint32_t const kMaxFrameCount    = 3;
+        static uint32_t const kMaxPipelineCount = 16; /* @see SceneDrawList::kPipelineBitCount */
+
+        /* A pipeline per vertex layout of the scene, the pipeline ids are the layout ids (@see Scene::vertexLayouts). */
+        apemodevk::TDispatchableHandle< VkPipeline > hPipelines[ kMaxPipelineCount ];
 
         apemodevk::TDescriptorSets< kMaxFrameCount > DescSets;
         apemodevk::HostBufferPool                    BufferPools[ kMaxFrameCount ];
         apemodevk::DescriptorSetPool                 DescSetPools[ kMaxFrameCount ];
 
+        /* All the world matrices of the scene, copied at once every frame. */
+        apemodevk::HostBufferPool    WorldMatrixBufferPools[ kMaxFrameCount ];
+        apemodevk::DescriptorSetPool WorldMatrixDescSetPools[ kMaxFrameCount ];
+
+        /* The node ids of the instances in the draw order, the vertex shader finds the world matrices with them. */
+        apemodevk::HostBufferPool    InstanceBufferPools[ kMaxFrameCount ];
+        apemodevk::DescriptorSetPool InstanceDescSetPools[ kMaxFrameCount ];
+        std::vector< uint32_t >      InstanceNodeIds;
+
+        /* Meshes are uploaded in the background, and drawn once they are resident. */
+        apemodevk::UploadQueue                         Uploader;
+        std::chrono::high_resolution_clock::time_point UploadStartTime;
+        bool                                           bFirstFrameReported = false;
+        bool                                           bUploadReported     = false;
+
+        /* The nodes outside the view frustum are not drawn. */
+        apemode::SceneCuller Culler;
+
+        /* The clusters of the visible subsets outside the view frustum or facing away are not drawn. */
+        apemode::SceneClusterCuller ClusterCuller;
 
+        /* The levels of the visible nodes are selected by the projected error. */
+        apemode::SceneLodSelector LodSelector;
+
+        /* The visible subsets are sorted to minimize the state changes. */
+        apemode::SceneDrawList DrawList;
+
+        /* The draws are recorded in parallel, each chunk into its own secondary buffer and pool. */
+        static uint32_t const kMaxRecordingChunkCount     = 16;
+        static uint32_t const kMinRecordingChunkDrawCount = 256;
+
+        struct RecordingChunk {
+            apemodevk::TDispatchableHandle< VkCommandPool >   hCmdPool;
+            apemodevk::TDispatchableHandle< VkCommandBuffer > hCmdBuffer; /* Secondary, freed before the pool */
+        };
+
+        RecordingChunk RecordingChunks[ kMaxFrameCount ][ kMaxRecordingChunkCount ];
 
         struct RecreateResourcesParameters {
             GraphicsDevice*  pNode       = nullptr;
@@ -60,7 +142,7 @@ namespace apemodevk {
             uint32_t         FrameCount  = 0;
         };
 
-        bool RecreateResources( apemode::SceneRendererVk::SceneUpdateParametersVk* pParams ) {
+        bool RecreateResources( const apemode::Scene* pScene, apemode::SceneRendererVk::SceneUpdateParametersVk* pParams ) {
             if ( nullptr == pParams->pNode )
                 return false;
 
@@ -128,10 +210,35 @@ namespace apemodevk {
                 return false;
             }
 
+            VkDescriptorSetLayoutBinding storageBindings[ 1 ];
+            InitializeStruct( storageBindings );
+
+            storageBindings[ 0 ].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+            storageBindings[ 0 ].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            storageBindings[ 0 ].descriptorCount = 1;
+
+            descSetLayoutCreateInfo.bindingCount = 1;
+            descSetLayoutCreateInfo.pBindings    = storageBindings;
+
+            if ( false == hStorageDescSetLayout.Recreate( *pParams->pNode, descSetLayoutCreateInfo ) ) {
+                DebugBreak( );
+                return false;
+            }
+
+            /* Set 0 is the frame uniform buffer, set 1 is the world matrix buffer, set 2 is the instance buffer (all per frame). */
+            VkDescriptorSetLayout pipelineDescSetLayouts[ 3 ] = {hDescSetLayout, hStorageDescSetLayout, hStorageDescSetLayout};
+
+            VkPushConstantRange pushConstant;
+            InitializeStruct( pushConstant );
+            pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            pushConstant.size       = sizeof( DrawPushConstants );
+
             VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
             InitializeStruct( pipelineLayoutCreateInfo );
-            pipelineLayoutCreateInfo.setLayoutCount = GetArraySizeU( descriptorSetLayouts );
-            pipelineLayoutCreateInfo.pSetLayouts    = descriptorSetLayouts;
+            pipelineLayoutCreateInfo.setLayoutCount         = GetArraySizeU( pipelineDescSetLayouts );
+            pipelineLayoutCreateInfo.pSetLayouts            = pipelineDescSetLayouts;
+            pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+            pipelineLayoutCreateInfo.pPushConstantRanges    = &pushConstant;
 
             if ( false == hPipelineLayout.Recreate( *pParams->pNode, pipelineLayoutCreateInfo ) ) {
                 DebugBreak( );
@@ -190,57 +297,14 @@ namespace apemodevk {
             graphicsPipelineCreateInfo.pStages    = shaderStageCreateInfo;
 
             //
-#if 1
-
-            vertexInputBindingDescription[ 0 ].stride    = sizeof( PackedVertex );
-            vertexInputBindingDescription[ 0 ].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-            vertexInputAttributeDescription[ 0 ].location = 0;
-            vertexInputAttributeDescription[ 0 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 0 ].format   = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-            vertexInputAttributeDescription[ 0 ].offset   = ( size_t )( &( (PackedVertex*) 0 )->position );
-
-            vertexInputAttributeDescription[ 1 ].location = 1;
-            vertexInputAttributeDescription[ 1 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 1 ].format   = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-            vertexInputAttributeDescription[ 1 ].offset   = ( size_t )( &( (PackedVertex*) 0 )->normal );
-
-            vertexInputAttributeDescription[ 2 ].location = 2;
-            vertexInputAttributeDescription[ 2 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 2 ].format   = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-            vertexInputAttributeDescription[ 2 ].offset   = ( size_t )( &( (PackedVertex*) 0 )->tangent );
-
-            vertexInputAttributeDescription[ 3 ].location = 3;
-            vertexInputAttributeDescription[ 3 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 3 ].format   = VK_FORMAT_R16G16_UNORM;
-            vertexInputAttributeDescription[ 3 ].offset   = ( size_t )( &( (PackedVertex*) 0 )->texcoords );
-
-#else
 
-            vertexInputBindingDescription[ 0 ].stride    = sizeof( StaticVertex );
             vertexInputBindingDescription[ 0 ].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-            vertexInputAttributeDescription[ 0 ].location = 0;
-            vertexInputAttributeDescription[ 0 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 0 ].format   = VK_FORMAT_R32G32B32_SFLOAT;
-            vertexInputAttributeDescription[ 0 ].offset   = ( size_t )( &( (StaticVertex*) 0 )->position );
-
-            vertexInputAttributeDescription[ 1 ].location = 1;
-            vertexInputAttributeDescription[ 1 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 1 ].format   = VK_FORMAT_R32G32B32_SFLOAT;
-            vertexInputAttributeDescription[ 1 ].offset   = ( size_t )( &( (StaticVertex*) 0 )->normal );
-
-            vertexInputAttributeDescription[ 2 ].location = 2;
-            vertexInputAttributeDescription[ 2 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 2 ].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
-            vertexInputAttributeDescription[ 2 ].offset   = ( size_t )( &( (StaticVertex*) 0 )->tangent );
-
-            vertexInputAttributeDescription[ 3 ].location = 3;
-            vertexInputAttributeDescription[ 3 ].binding  = vertexInputBindingDescription[ 0 ].binding;
-            vertexInputAttributeDescription[ 3 ].format   = VK_FORMAT_R32G32_SFLOAT;
-            vertexInputAttributeDescription[ 3 ].offset   = ( size_t )( &( (StaticVertex*) 0 )->texcoords );
-
-#endif
+            /* Position, normal, tangent and texcoords, the formats and offsets are set per vertex layout. */
+            for ( uint32_t i = 0; i < GetArraySizeU( vertexInputAttributeDescription ); ++i ) {
+                vertexInputAttributeDescription[ i ].location = i;
+                vertexInputAttributeDescription[ i ].binding  = vertexInputBindingDescription[ 0 ].binding;
+            }
 
             vertexInputStateCreateInfo.vertexBindingDescriptionCount   = GetArraySizeU( vertexInputBindingDescription );
             vertexInputStateCreateInfo.pVertexBindingDescriptions      = vertexInputBindingDescription;
@@ -315,9 +379,44 @@ namespace apemodevk {
                 return false;
             }
 
-            if ( false == hPipeline.Recreate( *pParams->pNode, hPipelineCache, graphicsPipelineCreateInfo ) ) {
-                DebugBreak( );
-                return false;
+            for ( uint32_t layoutId = 0; layoutId < pScene->vertexLayouts.size( ); ++layoutId ) {
+                auto appState = apemode::AppState::GetCurrentState( );
+                if ( layoutId == kMaxPipelineCount ) {
+                    if ( appState ) {
+                        appState->consoleLogger->error( "SceneRendererVk: Too many vertex layouts ({}), the meshes with the layouts after {} are not drawn.",
+                                                        pScene->vertexLayouts.size( ),
+                                                        kMaxPipelineCount );
+                    }
+                    break;
+                }
+
+                /* The joints of the skinned vertices are not fetched, the shaders do not use them so far. */
+                auto&                               vertexLayout    = pScene->vertexLayouts[ layoutId ];
+                const apemodefb::VertexAttributeFb* attributes[ 4 ] = {&vertexLayout.layout.position( ),
+                                                                       &vertexLayout.layout.normal( ),
+                                                                       &vertexLayout.layout.tangent( ),
+                                                                       &vertexLayout.layout.uv( )};
+
+                bool bSupported = true;
+                for ( uint32_t i = 0; i < GetArraySizeU( attributes ); ++i ) {
+                    vertexInputAttributeDescription[ i ].format = GetVertexAttributeFormat( *attributes[ i ] );
+                    vertexInputAttributeDescription[ i ].offset = attributes[ i ]->offset( );
+                    bSupported &= VK_FORMAT_UNDEFINED != vertexInputAttributeDescription[ i ].format;
+                }
+
+                vertexInputBindingDescription[ 0 ].stride = vertexLayout.vertexStride;
+
+                if ( false == bSupported ) {
+                    if ( appState ) {
+                        appState->consoleLogger->error( "SceneRendererVk: Vertex layout {} is not supported, its meshes are not drawn.", layoutId );
+                    }
+                    continue;
+                }
+
+                if ( false == hPipelines[ layoutId ].Recreate( *pParams->pNode, hPipelineCache, graphicsPipelineCreateInfo ) ) {
+                    DebugBreak( );
+                    return false;
+                }
             }
 
             VkPhysicalDeviceProperties adapterProps;
@@ -326,22 +425,201 @@ namespace apemodevk {
             for ( uint32_t i = 0; i < pParams->FrameCount; ++i ) {
                 BufferPools[ i ].Recreate( *pParams->pNode, *pParams->pNode, &adapterProps.limits, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, false );
                 DescSetPools[ i ].Recreate( *pParams->pNode, pParams->pDescPool, hDescSetLayout );
+                WorldMatrixBufferPools[ i ].Recreate( *pParams->pNode, *pParams->pNode, &adapterProps.limits, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false );
+                WorldMatrixDescSetPools[ i ].Recreate( *pParams->pNode, pParams->pDescPool, hStorageDescSetLayout );
+                InstanceBufferPools[ i ].Recreate( *pParams->pNode, *pParams->pNode, &adapterProps.limits, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false );
+                InstanceDescSetPools[ i ].Recreate( *pParams->pNode, pParams->pDescPool, hStorageDescSetLayout );
             }
 
             return true;
         }
     };
 
+    /**
+     * Device local buffer with the vertices followed by the indices,
+     * either of the single mesh or of the scene-wide geometry buffer shared by the meshes.
+     **/
+    struct SceneBufferDeviceAssetVk {
+        TDispatchableHandle< VkBuffer > hBuffer;
+        MemoryAllocation                Memory;
+        MemoryAllocator*                pMemoryAllocator = nullptr; /* Owns the memory */
+        uint32_t                        IndexOffset      = 0;
+        VkIndexType                     IndexType        = VK_INDEX_TYPE_UINT16;
+        uint64_t                        UploadTicket     = 0; /* Drawable once completed */
+
+        ~SceneBufferDeviceAssetVk( ) {
+            FreeMemory( );
+        }
+
+        void FreeMemory( ) {
+            if ( nullptr != pMemoryAllocator ) {
+                pMemoryAllocator->Free( Memory );
+                pMemoryAllocator = nullptr;
+            }
+        }
+
+        /**
+         * Creates the buffer and enqueues the uploads.
+         * @note The data must stay valid until the upload is completed (it points to the mapped scene file).
+         **/
+        bool Recreate( GraphicsDevice* pNode,
+                       UploadQueue&    uploader,
+                       const uint8_t*  pVertices,
+                       uint32_t        verticesByteSize,
+                       const uint8_t*  pIndices,
+                       uint32_t        indicesByteSize,
+                       VkIndexType     eIndexType ) {
+            const uint32_t storageAlignment    = (uint32_t) pNode->AdapterProps.limits.minStorageBufferOffsetAlignment;
+            const uint32_t verticesStorageSize = apemodem::AlignedOffset( verticesByteSize, storageAlignment );
+            const uint32_t totalSize           = verticesStorageSize + indicesByteSize;
+
+            IndexOffset = verticesStorageSize;
+            IndexType   = eIndexType;
+
+            static VkBufferUsageFlags eBufferUsage
+                = VK_BUFFER_USAGE_TRANSFER_DST_BIT  /* Copy data from staging buffers */
+                | VK_BUFFER_USAGE_INDEX_BUFFER_BIT  /* Use it as index buffer */
+                | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT /* Use it as vertex buffer */;
+
+            VkBufferCreateInfo bufferCreateInfo;
+            InitializeStruct( bufferCreateInfo );
+            bufferCreateInfo.usage = eBufferUsage;
+            bufferCreateInfo.size  = totalSize;
+
+            if ( false == hBuffer.Recreate( *pNode, *pNode, bufferCreateInfo ) ) {
+                return false;
+            }
+
+            /* Sub-allocated from the device local blocks, the previous buffer is already destroyed. */
+            FreeMemory( );
+            pMemoryAllocator = pNode->GetMemoryAllocator( );
+            if ( false == pMemoryAllocator->AllocateAndBind( hBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Memory ) ) {
+                return false;
+            }
+
+            /* The data stays in the mapped scene file, it is copied to the staging ring when the batch is recorded. */
+            uploader.Enqueue( pVertices, verticesByteSize, hBuffer, 0 );
+            UploadTicket = uploader.Enqueue( pIndices, indicesByteSize, hBuffer, verticesStorageSize );
+            return true;
+        }
+    };
+
     struct SceneMeshDeviceAssetVk {
-        SceneDeviceAssetVk*                   pSceneDeviceAsset = nullptr;
-        TDispatchableHandle< VkBuffer >       hBuffer;
-        TDispatchableHandle< VkDeviceMemory > hMemory;
-        uint32_t                              VertexCount = 0;
-        uint32_t                              IndexOffset = 0;
-        VkIndexType                           IndexType   = VK_INDEX_TYPE_UINT16;
-        apemodem::vec4                        positionOffset;
-        apemodem::vec4                        positionScale;
+        SceneDeviceAssetVk*             pSceneDeviceAsset = nullptr;
+        SceneBufferDeviceAssetVk        Buffer;            /* Unused if the mesh is merged into the geometry buffer */
+        const SceneBufferDeviceAssetVk* pBuffer = nullptr; /* Either the own or the geometry buffer */
+        uint32_t                        VertexCount = 0;
+        uint32_t                        BaseVertex  = 0; /* Vertex offset in the geometry buffer */
     };
+
+    double GetElapsedMs( std::chrono::high_resolution_clock::time_point start ) {
+        return std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now( ) - start ).count( );
+    }
+
+    /* The state that is set in every command buffer the draws are recorded into. */
+    struct SceneRecordingState {
+        VkViewport      viewport;
+        VkRect2D        scissor;
+        VkDescriptorSet descriptorSets[ 3 ];
+        uint32_t        dynamicOffsets[ 3 ];
+    };
+
+    /**
+     * Records the draws in [drawIndex, drawEnd), the range must start with the first instance (@see SceneDraw::instanceCount).
+     * The state is bound only when it changes, except the first draw, which binds all of it (nothing is inherited).
+     * It only reads the scene and the device asset, so the ranges can be recorded in parallel.
+     **/
+    void RecordSceneDraws( VkCommandBuffer            pCmdBuffer,
+                           const SceneDeviceAssetVk*  pDeviceAsset,
+                           const apemode::Scene*      pScene,
+                           const SceneRecordingState& recordingState,
+                           uint32_t                   drawIndex,
+                           uint32_t                   drawEnd ) {
+        auto& drawList = pDeviceAsset->DrawList;
+
+        vkCmdSetViewport( pCmdBuffer, 0, 1, &recordingState.viewport );
+        vkCmdSetScissor( pCmdBuffer, 0, 1, &recordingState.scissor );
+
+        vkCmdBindDescriptorSets( pCmdBuffer,
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 pDeviceAsset->hPipelineLayout,
+                                 0,
+                                 GetArraySizeU( recordingState.descriptorSets ),
+                                 recordingState.descriptorSets,
+                                 GetArraySizeU( recordingState.dynamicOffsets ),
+                                 recordingState.dynamicOffsets );
+
+        DrawPushConstants drawData;
+
+        for ( uint32_t i = drawIndex; i < drawEnd; ++i ) {
+            auto& draw = drawList.draws[ i ];
+
+            /* Drawn as the instance of the previous draw (the state is the same). */
+            if ( 0 == draw.instanceCount )
+                continue;
+
+            auto& packet           = drawList.packets[ draw.packetIndex ];
+            auto& mesh             = pScene->meshes[ packet.meshId ];
+            auto& subset           = mesh.subsets[ packet.subsetIndex ];
+            auto& submesh          = mesh.submeshes[ subset.submeshIndex ];
+            auto  pMeshDeviceAsset = (const SceneMeshDeviceAssetVk*) mesh.deviceAsset;
+
+            const uint32_t bindFlags = i == drawIndex ? ~0u : draw.bindFlags;
+
+            if ( bindFlags & apemode::SceneDraw::eBindFlag_Pipeline ) {
+                vkCmdBindPipeline( pCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pDeviceAsset->hPipelines[ packet.pipelineId ] );
+            }
+
+            if ( bindFlags & apemode::SceneDraw::eBindFlag_Material ) {
+                drawData.color = pScene->materials[ packet.materialId ].albedo;
+            }
+
+            /* The submeshes (spatial chunks) of the mesh have their own quantization frames. */
+            drawData.positionOffset = apemodem::vec4( submesh.positionOffset, 0.0f );
+            drawData.positionScale  = apemodem::vec4( submesh.positionScale, 1.0f );
+            drawData.instanceOffset = i;
+
+            vkCmdPushConstants( pCmdBuffer,
+                                pDeviceAsset->hPipelineLayout,
+                                VK_SHADER_STAGE_VERTEX_BIT,
+                                0,
+                                sizeof( DrawPushConstants ),
+                                &drawData );
+
+            /* The merged meshes share the buffers, they are bound once. */
+            if ( bindFlags & apemode::SceneDraw::eBindFlag_Buffer ) {
+                VkBuffer     vertexBuffers[ 1 ] = {pMeshDeviceAsset->pBuffer->hBuffer};
+                VkDeviceSize vertexOffsets[ 1 ] = {0};
+                vkCmdBindVertexBuffers( pCmdBuffer, 0, 1, vertexBuffers, vertexOffsets );
+
+                vkCmdBindIndexBuffer( pCmdBuffer,
+                                      pMeshDeviceAsset->pBuffer->hBuffer,
+                                      pMeshDeviceAsset->pBuffer->IndexOffset,
+                                      pMeshDeviceAsset->pBuffer->IndexType );
+            }
+
+            /* The visible clusters of the subset are drawn per range (the packet is not instanced). */
+            if ( packet.rangeCount ) {
+                for ( uint32_t r = packet.firstRange; r < packet.firstRange + packet.rangeCount; ++r ) {
+                    vkCmdDrawIndexed( pCmdBuffer,
+                                      drawList.ranges[ r ].indexCount,        /* IndexCount */
+                                      1,                                      /* InstanceCount */
+                                      drawList.ranges[ r ].baseIndex,         /* FirstIndex */
+                                      (int32_t) pMeshDeviceAsset->BaseVertex, /* VertexOffset */
+                                      0 );                                    /* FirstInstance */
+                }
+
+                continue;
+            }
+
+            vkCmdDrawIndexed( pCmdBuffer,
+                              subset.indexCount,                      /* IndexCount */
+                              draw.instanceCount,                     /* InstanceCount */
+                              subset.baseIndex,                       /* FirstIndex */
+                              (int32_t) pMeshDeviceAsset->BaseVertex, /* VertexOffset */
+                              0 );                                    /* FirstInstance */
+        }
+    }
 }
 
 void apemode::SceneRendererVk::UpdateScene( Scene* pScene, const SceneUpdateParametersBase* pParamsBase ) {
@@ -364,41 +642,41 @@ void apemode::SceneRendererVk::UpdateScene( Scene* pScene, const SceneUpdatePara
         deviceChanged |= true;
     }
 
+    /* The buffers are owned by the render family after the uploads, they are uploaded again for the other family. */
+    if ( pDeviceAsset->Uploader.GetRenderQueueFamilyId( ) != pParams->QueueFamilyId ) {
+        deviceChanged |= true;
+    }
+
     if ( deviceChanged ) {
+        /* Wait for the uploads to the previous buffers. */
+        pDeviceAsset->Uploader.Recreate( pParams->pNode, pParams->QueueFamilyId );
+        pDeviceAsset->UploadStartTime     = std::chrono::high_resolution_clock::now( );
+        pDeviceAsset->bFirstFrameReported = false;
+        pDeviceAsset->bUploadReported     = false;
 
-        /* Get queue from pool (only copying) */
-        auto pQueuePool = pParams->pNode->GetQueuePool( );
+        /* The shared buffers are uploaded first, most of the meshes are drawn from them. */
+        for ( auto& geometryBuffer : pScene->geometryBuffers ) {
+            auto pBufferDeviceAsset = (apemodevk::SceneBufferDeviceAssetVk*) geometryBuffer.deviceAsset;
+            if ( nullptr == pBufferDeviceAsset ) {
+                pBufferDeviceAsset         = new apemodevk::SceneBufferDeviceAssetVk( );
+                geometryBuffer.deviceAsset = pBufferDeviceAsset;
+            }
 
-        auto acquiredQueue = pQueuePool->Acquire( false, VK_QUEUE_TRANSFER_BIT, true );
-        while ( acquiredQueue.pQueue == nullptr ) {
-            acquiredQueue = pQueuePool->Acquire( false, VK_QUEUE_TRANSFER_BIT, false );
+            const VkIndexType eIndexType = geometryBuffer.indexType == apemodefb::EIndexTypeFb_UInt32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+            if ( false == pBufferDeviceAsset->Recreate( pParams->pNode,
+                                                        pDeviceAsset->Uploader,
+                                                        geometryBuffer.vertices,
+                                                        geometryBuffer.verticesSize,
+                                                        geometryBuffer.indices,
+                                                        geometryBuffer.indicesSize,
+                                                        eIndexType ) ) {
+                DebugBreak( );
+            }
         }
 
-        /* Get command buffer from pool (only copying) */
-        auto pCmdBufferPool = pParams->pNode->GetCommandBufferPool( );
-        auto acquiredCmdBuffer = pCmdBufferPool->Acquire( false, acquiredQueue.queueFamilyId );
-
-        apemodevk::HostBufferPool bufferPool;
-        bufferPool.Recreate( *pParams->pNode,
-                             *pParams->pNode,
-                             &pParams->pNode->AdapterProps.limits,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             false );
-
         uint32_t meshIndex = 0;
         auto & meshesFb = *pParamsBase->pSceneSrc->meshes( );
 
-        if ( VK_SUCCESS != vkResetCommandPool( *pParams->pNode, acquiredCmdBuffer.pCmdPool, 0 ) ) {
-            DebugBreak( );
-        }
-
-        VkCommandBufferBeginInfo commandBufferBeginInfo;
-        apemodevk::InitializeStruct( commandBufferBeginInfo );
-        commandBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        if ( VK_SUCCESS != vkBeginCommandBuffer( acquiredCmdBuffer.pCmdBuffer, &commandBufferBeginInfo ) ) {
-            DebugBreak( );
-        }
-
         for ( auto meshFb : meshesFb ) {
             /* Scene mesh. */
             auto& mesh = pScene->meshes[ meshIndex++ ];
@@ -411,141 +689,75 @@ void apemode::SceneRendererVk::UpdateScene( Scene* pScene, const SceneUpdatePara
                 mesh.deviceAsset = pMeshDeviceAsset;
             }
 
-            const uint32_t verticesByteSize = (uint32_t) meshFb->vertices( )->size( );
-            const uint32_t indicesByteSize  = (uint32_t) meshFb->indices( )->size( );
-
-            const uint32_t storageAlignment = (uint32_t) pDeviceAsset->pNode->AdapterProps.limits.minStorageBufferOffsetAlignment;
-            const uint32_t verticesStorageSize = apemodem::AlignedOffset( verticesByteSize, storageAlignment );
-            const uint32_t totalMeshSize = verticesStorageSize + indicesByteSize;
-
-            pMeshDeviceAsset->IndexOffset = verticesStorageSize;
-            if ( meshFb->index_type( ) == apemodefb::EIndexTypeFb_UInt32 ) {
-                pMeshDeviceAsset->IndexType = VK_INDEX_TYPE_UINT32;
-            }
-
-            auto & offset = meshFb->submeshes( )->begin( )->position_offset( );
-            pMeshDeviceAsset->positionOffset.x = offset.x();
-            pMeshDeviceAsset->positionOffset.y = offset.y();
-            pMeshDeviceAsset->positionOffset.z = offset.z();
-
-            auto & scale = meshFb->submeshes( )->begin( )->position_scale( );
-            pMeshDeviceAsset->positionScale.x = scale.x();
-            pMeshDeviceAsset->positionScale.y = scale.y();
-            pMeshDeviceAsset->positionScale.z = scale.z();
-
-            pMeshDeviceAsset->VertexCount = meshFb->submeshes( )->begin( )->vertex_count( );
-
+            pMeshDeviceAsset->VertexCount = mesh.vertexCount;
+            pMeshDeviceAsset->BaseVertex  = mesh.baseVertex;
 
-            auto verticesSuballocResult = bufferPool.Suballocate( meshFb->vertices( )->Data( ), verticesByteSize );
-            auto indicesSuballocResult = bufferPool.Suballocate( meshFb->indices( )->Data( ), indicesByteSize );
-
-            static VkBufferUsageFlags eBufferUsage
-                = VK_BUFFER_USAGE_TRANSFER_DST_BIT  /* Copy data from staging buffers */
-                | VK_BUFFER_USAGE_INDEX_BUFFER_BIT  /* Use it as index buffer */
-                | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT /* Use it as vertex buffer */;
-
-            VkBufferCreateInfo bufferCreateInfo;
-            apemodevk::InitializeStruct( bufferCreateInfo );
-            bufferCreateInfo.usage = eBufferUsage;
-            bufferCreateInfo.size  = totalMeshSize;
+            /* Merged mesh, the subsets are the index ranges in the geometry buffer. */
+            if ( mesh.geometryBufferId < pScene->geometryBuffers.size( ) ) {
+                pMeshDeviceAsset->pBuffer = (const apemodevk::SceneBufferDeviceAssetVk*) pScene->geometryBuffers[ mesh.geometryBufferId ].deviceAsset;
+                continue;
+            }
 
-            if ( false == pMeshDeviceAsset->hBuffer.Recreate( *pParams->pNode, *pParams->pNode, bufferCreateInfo ) ) {
-                DebugBreak( );
-            }
-
-            auto memoryAllocateInfo = pMeshDeviceAsset->hBuffer.GetMemoryAllocateInfo( VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-            if ( false == pMeshDeviceAsset->hMemory.Recreate( *pParams->pNode, memoryAllocateInfo ) ) {
+            const VkIndexType eIndexType = meshFb->index_type( ) == apemodefb::EIndexTypeFb_UInt32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+            if ( false == pMeshDeviceAsset->Buffer.Recreate( pParams->pNode,
+                                                             pDeviceAsset->Uploader,
+                                                             mesh.vertices,
+                                                             mesh.verticesSize,
+                                                             mesh.indices,
+                                                             mesh.indicesSize,
+                                                             eIndexType ) ) {
                 DebugBreak( );
             }
 
-            if ( false == pMeshDeviceAsset->hBuffer.BindMemory( pMeshDeviceAsset->hMemory, 0 ) ) {
-                DebugBreak( );
-            }
-
-            VkBufferMemoryBarrier bufferMemoryBarrier[ 3 ];
-            apemodevk::InitializeStruct( bufferMemoryBarrier );
-
-            bufferMemoryBarrier[ 0 ].size                = verticesSuballocResult.descBufferInfo.range;
-            bufferMemoryBarrier[ 0 ].offset              = verticesSuballocResult.descBufferInfo.offset;
-            bufferMemoryBarrier[ 0 ].buffer              = verticesSuballocResult.descBufferInfo.buffer;
-            bufferMemoryBarrier[ 0 ].srcAccessMask       = VK_ACCESS_HOST_WRITE_BIT;
-            bufferMemoryBarrier[ 0 ].dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
-            bufferMemoryBarrier[ 0 ].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            bufferMemoryBarrier[ 0 ].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-            bufferMemoryBarrier[ 1 ].size                = indicesSuballocResult.descBufferInfo.range;
-            bufferMemoryBarrier[ 1 ].offset              = indicesSuballocResult.descBufferInfo.offset;
-            bufferMemoryBarrier[ 1 ].buffer              = indicesSuballocResult.descBufferInfo.buffer;
-            bufferMemoryBarrier[ 1 ].srcAccessMask       = VK_ACCESS_HOST_WRITE_BIT;
-            bufferMemoryBarrier[ 1 ].dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
-            bufferMemoryBarrier[ 1 ].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            bufferMemoryBarrier[ 1 ].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-            bufferMemoryBarrier[ 2 ].size                = bufferCreateInfo.size;
-            bufferMemoryBarrier[ 2 ].offset              = 0;
-            bufferMemoryBarrier[ 2 ].buffer              = pMeshDeviceAsset->hBuffer;
-            bufferMemoryBarrier[ 2 ].srcAccessMask       = VK_ACCESS_SHADER_READ_BIT;
-            bufferMemoryBarrier[ 2 ].dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
-            bufferMemoryBarrier[ 2 ].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            bufferMemoryBarrier[ 2 ].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            pMeshDeviceAsset->pBuffer = &pMeshDeviceAsset->Buffer;
+        }
+    }
 
-            vkCmdPipelineBarrier( acquiredCmdBuffer.pCmdBuffer,
-                                  VK_PIPELINE_STAGE_HOST_BIT,
-                                  VK_PIPELINE_STAGE_HOST_BIT,
-                                  0,
-                                  0,
-                                  nullptr,
-                                  apemode::GetArraySize( bufferMemoryBarrier ),
-                                  bufferMemoryBarrier,
-                                  0,
-                                  nullptr );
+    /* Submit the next batches, the meshes with the completed tickets can be drawn after AcquireUploads(). */
+    pDeviceAsset->Uploader.Update( );
 
-            VkBufferCopy bufferCopy[ 2 ];
-            apemodevk::InitializeStruct( bufferCopy );
+    if ( false == pDeviceAsset->bUploadReported && pDeviceAsset->Uploader.IsIdle( ) ) {
+        pDeviceAsset->bUploadReported = true;
 
-            bufferCopy[ 0 ].srcOffset = verticesSuballocResult.descBufferInfo.offset;
-            bufferCopy[ 0 ].size      = verticesSuballocResult.descBufferInfo.range;
+        auto& uploadStats = pDeviceAsset->Uploader.GetStats( );
+        const double uploadMs = apemodevk::GetElapsedMs( pDeviceAsset->UploadStartTime );
+        const double uploadMb = uploadStats.CompletedBytes / ( 1024.0 * 1024.0 );
 
-            bufferCopy[ 1 ].srcOffset = indicesSuballocResult.descBufferInfo.offset;
-            bufferCopy[ 1 ].dstOffset = verticesStorageSize;
-            bufferCopy[ 1 ].size      = indicesSuballocResult.descBufferInfo.range;
-
-            vkCmdCopyBuffer( acquiredCmdBuffer.pCmdBuffer,                 /* Cmd */
-                             verticesSuballocResult.descBufferInfo.buffer, /* Src */
-                             pMeshDeviceAsset->hBuffer,                    /* Dst */
-                             1,
-                             &bufferCopy[ 0 ] );
-
-            vkCmdCopyBuffer( acquiredCmdBuffer.pCmdBuffer,                /* Cmd */
-                             indicesSuballocResult.descBufferInfo.buffer, /* Src */
-                             pMeshDeviceAsset->hBuffer,                   /* Dst */
-                             1,
-                             &bufferCopy[ 1 ] );
+        apemodevk::MemoryAllocator::Stats memoryStats;
+        pDeviceAsset->pNode->GetMemoryAllocator( )->GetStats( memoryStats );
+
+        if ( auto appState = apemode::AppState::GetCurrentState( ) ) {
+            appState->consoleLogger->info( "SceneRendererVk: Uploaded {} meshes ({:.1f} MB) in {:.1f} ms ({:.1f} MB/s, {} batches, {} copies).",
+                                           pScene->meshes.size( ),
+                                           uploadMb,
+                                           uploadMs,
+                                           uploadMb * 1000.0 / std::max( uploadMs, 0.001 ),
+                                           uploadStats.BatchCount,
+                                           uploadStats.CopyCount );
+            appState->consoleLogger->info( "SceneRendererVk: Device memory: {} allocations in {} blocks ({} dedicated, {:.1f} MB), utilization {:.1f}%, fragmentation {:.1f}%.",
+                                           memoryStats.AllocationCount,
+                                           memoryStats.BlockCount,
+                                           memoryStats.DedicatedBlockCount,
+                                           memoryStats.BlockSize / ( 1024.0 * 1024.0 ),
+                                           memoryStats.GetUtilization( ) * 100.0f,
+                                           memoryStats.GetFragmentation( ) * 100.0f );
         }
-
-        vkEndCommandBuffer( acquiredCmdBuffer.pCmdBuffer );
-
-        VkSubmitInfo submitInfo;
-        apemodevk::InitializeStruct( submitInfo );
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers    = &acquiredCmdBuffer.pCmdBuffer;
-
-        bufferPool.Flush( );
-
-        vkResetFences( *pParams->pNode, 1, &acquiredQueue.pFence );
-        vkQueueSubmit( acquiredQueue.pQueue, 1, &submitInfo, acquiredQueue.pFence );
-        vkWaitForFences( *pParams->pNode, 1, &acquiredQueue.pFence, true, UINT_MAX );
-
-        acquiredCmdBuffer.pFence = acquiredQueue.pFence;
-        pCmdBufferPool->Release( acquiredCmdBuffer );
-        pQueuePool->Release( acquiredQueue );
     }
 
-    if ( pDeviceAsset->hPipeline.IsNull( ) && nullptr != pParams && nullptr != pParams->pRenderPass && nullptr != pParams->pDescPool ) {
-        if ( false == pDeviceAsset->RecreateResources( pParams ) ) {
+    if ( pDeviceAsset->hPipelineLayout.IsNull( ) && nullptr != pParams && nullptr != pParams->pRenderPass && nullptr != pParams->pDescPool ) {
+        if ( false == pDeviceAsset->RecreateResources( pScene, pParams ) ) {
             return;
         }
     }
+}
+
+void apemode::SceneRendererVk::AcquireUploads( const Scene* pScene, VkCommandBuffer pCmdBuffer ) {
+    if ( nullptr == pScene || nullptr == pScene->deviceAsset || VK_NULL_HANDLE == pCmdBuffer ) {
+        return;
+    }
+
+    auto pDeviceAsset = (apemodevk::SceneDeviceAssetVk*) pScene->deviceAsset; /* TODO: const_cast */
+    pDeviceAsset->Uploader.RecordAcquireBarriers( pCmdBuffer );
 }
 
 void apemode::SceneRendererVk::RenderScene( const Scene* pScene, const SceneRenderParametersBase* pParamsBase ) {
@@ -561,9 +773,11 @@ void apemode::SceneRendererVk::RenderScene( const Scene* pScene, const SceneRend
         return;
     }
 
-    vkCmdBindPipeline( pParams->pCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pDeviceAsset->hPipeline );
+    auto startTime = std::chrono::high_resolution_clock::now( );
+
+    apemodevk::SceneRecordingState recordingState;
 
-    VkViewport viewport;
+    VkViewport& viewport = recordingState.viewport;
     apemodevk::InitializeStruct( viewport );
     viewport.x        = 0;
     viewport.y        = 0;
@@ -572,70 +786,261 @@ void apemode::SceneRendererVk::RenderScene( const Scene* pScene, const SceneRend
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
-    vkCmdSetViewport( pParams->pCmdBuffer, 0, 1, &viewport );
-
-    VkRect2D scissor;
+    VkRect2D& scissor = recordingState.scissor;
     apemodevk::InitializeStruct( scissor );
     scissor.offset.x      = 0;
     scissor.offset.y      = 0;
     scissor.extent.width  = ( uint32_t )( pParams->dims[ 0 ] * pParams->scale[ 0 ] );
     scissor.extent.height = ( uint32_t )( pParams->dims[ 1 ] * pParams->scale[ 1 ] );
 
-    vkCmdSetScissor(pParams->pCmdBuffer, 0, 1, &scissor);
-
     auto FrameIndex = ( pParams->FrameIndex ) % apemodevk::SceneDeviceAssetVk::kMaxFrameCount;
 
-    apemodevk::FrameUniformBuffer frameData;
-    frameData.projectionMatrix = pParams->ProjMatrix;
-    frameData.viewMatrix       = pParams->ViewMatrix;
+    pDeviceAsset->Culler.Cull( pScene, pParams->ViewMatrix, pParams->ProjMatrix );
+    if ( nullptr != pParams->pCullingStats ) {
+        *pParams->pCullingStats = pDeviceAsset->Culler.stats;
+    }
+
+    //
+    // Gather the subsets of the selected levels of the visible nodes with the resident meshes.
+    // The subsets with the clusters are culled per cluster, only the visible index ranges are drawn.
+    //
+
+    uint32_t drawnNodeCount = 0;
+
+    auto& drawList = pDeviceAsset->DrawList;
+    drawList.Reset( );
+
+    auto& clusterCuller = pDeviceAsset->ClusterCuller;
+    clusterCuller.Begin( pParams->ViewMatrix, pParams->ProjMatrix );
+
+    auto& lodSelector = pDeviceAsset->LodSelector;
+    lodSelector.Begin( pParams->ViewMatrix, pParams->ProjMatrix, pParams->dims[ 1 ] * pParams->scale[ 1 ], pParams->LodErrorPixels );
 
     for ( auto& node : pScene->nodes ) {
-        if ( node.meshId >= pScene->meshes.size( ) )
+        if ( node.meshId >= pScene->meshes.size( ) || false == pDeviceAsset->Culler.IsVisible( node.id ) )
             continue;
 
         auto& mesh = pScene->meshes[ node.meshId ];
 
+        /* The vertex layout is not supported. */
+        if ( mesh.vertexLayoutId >= apemodevk::SceneDeviceAssetVk::kMaxPipelineCount || pDeviceAsset->hPipelines[ mesh.vertexLayoutId ].IsNull( ) )
+            continue;
+
         if ( auto pMeshDeviceAsset = (const apemodevk::SceneMeshDeviceAssetVk*) mesh.deviceAsset ) {
-            for (auto& subset : mesh.subsets) {
-                auto& mat = pScene->materials[ node.materialIds[ subset.materialId ] ];
-
-                frameData.color          = mat.albedo;
-                frameData.positionOffset = pMeshDeviceAsset->positionOffset;
-                frameData.positionScale  = pMeshDeviceAsset->positionScale;
-                frameData.worldMatrix    = pScene->worldMatrices[ node.id ];
-
-                auto suballocResult = pDeviceAsset->BufferPools[ FrameIndex ].TSuballocate( frameData );
-                assert( VK_NULL_HANDLE != suballocResult.descBufferInfo.buffer );
-                suballocResult.descBufferInfo.range = sizeof( apemodevk::FrameUniformBuffer );
-                VkDescriptorSet descriptorSet[ 1 ]  = {pDeviceAsset->DescSetPools[ FrameIndex ].GetDescSet(
-                    suballocResult.descBufferInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC )};
-
-                vkCmdBindDescriptorSets( pParams->pCmdBuffer,
-                                         VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                         pDeviceAsset->hPipelineLayout,
-                                         0,
-                                         1,
-                                         descriptorSet,
-                                         1,
-                                         &suballocResult.dynamicOffset );
-
-                VkBuffer     vertexBuffers[ 1 ] = {pMeshDeviceAsset->hBuffer};
-                VkDeviceSize vertexOffsets[ 1 ] = {0};
-                vkCmdBindVertexBuffers( pParams->pCmdBuffer, 0, 1, vertexBuffers, vertexOffsets );
-
-                vkCmdBindIndexBuffer( pParams->pCmdBuffer,
-                                      pMeshDeviceAsset->hBuffer,
-                                      pMeshDeviceAsset->IndexOffset,
-                                      pMeshDeviceAsset->IndexType );
-
-                vkCmdDrawIndexed( pParams->pCmdBuffer,
-                                  subset.indexCount, /* IndexCount */
-                                  1,                 /* InstanceCount */
-                                  subset.baseIndex,  /* FirstIndex */
-                                  0,                 /* VertexOffset */
-                                  0 );               /* FirstInstance */
+            /* Still uploading. */
+            if ( false == pDeviceAsset->Uploader.IsCompleted( pMeshDeviceAsset->pBuffer->UploadTicket ) )
+                continue;
+
+            ++drawnNodeCount;
+
+            /* The meshes with own buffers go after the shared geometry buffers. */
+            const uint32_t bufferId = mesh.geometryBufferId < pScene->geometryBuffers.size( )
+                                    ? mesh.geometryBufferId
+                                    : uint32_t( pScene->geometryBuffers.size( ) ) + node.meshId;
+
+            /* All the subsets are the full mesh if there are no levels. */
+            uint32_t baseSubset  = 0;
+            uint32_t subsetCount = uint32_t( mesh.subsets.size( ) );
+            if ( false == mesh.lods.empty( ) ) {
+                auto& lod   = mesh.lods[ lodSelector.Select( pScene, node.id ) ];
+                baseSubset  = lod.baseSubset;
+                subsetCount = lod.subsetCount;
+            }
+
+            for ( uint32_t subsetIndex = baseSubset; subsetIndex < baseSubset + subsetCount; ++subsetIndex ) {
+                /* The subset was simplified away. */
+                if ( 0 == mesh.subsets[ subsetIndex ].indexCount )
+                    continue;
+
+                const uint32_t firstRange = uint32_t( drawList.ranges.size( ) );
+                if ( false == clusterCuller.Cull( pScene, node.id, subsetIndex, drawList.ranges ) )
+                    continue;
+
+                const uint32_t materialId = node.materialIds[ mesh.subsets[ subsetIndex ].materialId ];
+                const uint32_t rangeCount = uint32_t( drawList.ranges.size( ) ) - firstRange;
+                drawList.AddPacket( mesh.vertexLayoutId, bufferId, materialId, node.meshId, subsetIndex, node.id, firstRange, rangeCount );
+            }
+        }
+    }
+
+    if ( nullptr != pParams->pClusterCullingStats ) {
+        *pParams->pClusterCullingStats = clusterCuller.stats;
+    }
+
+    drawList.Sort( );
+    if ( nullptr != pParams->pDrawListStats ) {
+        *pParams->pDrawListStats = drawList.stats;
+    }
+
+    //
+    // The frame data is written once: the frame constants, all the world matrices (a single copy),
+    // and the node ids of the instances in the draw order (@see SceneDraw::instanceCount).
+    // The draws only push their constants.
+    //
+
+    uint32_t uploadedByteCount = 0;
+
+    if ( false == drawList.draws.empty( ) ) {
+        auto& instanceNodeIds = pDeviceAsset->InstanceNodeIds;
+        instanceNodeIds.resize( drawList.draws.size( ) );
+        for ( uint32_t i = 0; i < drawList.draws.size( ); ++i ) {
+            instanceNodeIds[ i ] = drawList.packets[ drawList.draws[ i ].packetIndex ].nodeId;
+        }
+
+        apemodevk::FrameUniformBuffer frameData;
+        frameData.projectionMatrix = pParams->ProjMatrix;
+        frameData.viewMatrix       = pParams->ViewMatrix;
+
+        const uint32_t worldMatricesByteSize   = uint32_t( pScene->worldMatrices.size( ) * sizeof( apemodem::mat4 ) );
+        const uint32_t instanceNodeIdsByteSize = uint32_t( instanceNodeIds.size( ) * sizeof( uint32_t ) );
+
+        auto frameSuballocResult    = pDeviceAsset->BufferPools[ FrameIndex ].TSuballocate( frameData );
+        auto worldSuballocResult    = pDeviceAsset->WorldMatrixBufferPools[ FrameIndex ].Suballocate( pScene->worldMatrices.data( ), worldMatricesByteSize );
+        auto instanceSuballocResult = pDeviceAsset->InstanceBufferPools[ FrameIndex ].Suballocate( instanceNodeIds.data( ), instanceNodeIdsByteSize );
+        assert( VK_NULL_HANDLE != frameSuballocResult.descBufferInfo.buffer );
+        assert( VK_NULL_HANDLE != worldSuballocResult.descBufferInfo.buffer );
+        assert( VK_NULL_HANDLE != instanceSuballocResult.descBufferInfo.buffer );
+        frameSuballocResult.descBufferInfo.range = sizeof( apemodevk::FrameUniformBuffer );
+
+        uploadedByteCount += sizeof( apemodevk::FrameUniformBuffer ) + worldMatricesByteSize + instanceNodeIdsByteSize;
+
+        /* The storage ranges cover the whole pages (one suballocation per page), so the sets are reused in the next frames. */
+        recordingState.descriptorSets[ 0 ] = pDeviceAsset->DescSetPools[ FrameIndex ].GetDescSet( frameSuballocResult.descBufferInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC );
+        recordingState.descriptorSets[ 1 ] = pDeviceAsset->WorldMatrixDescSetPools[ FrameIndex ].GetDescSet( worldSuballocResult.descBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC );
+        recordingState.descriptorSets[ 2 ] = pDeviceAsset->InstanceDescSetPools[ FrameIndex ].GetDescSet( instanceSuballocResult.descBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC );
+
+        recordingState.dynamicOffsets[ 0 ] = frameSuballocResult.dynamicOffset;
+        recordingState.dynamicOffsets[ 1 ] = worldSuballocResult.dynamicOffset;
+        recordingState.dynamicOffsets[ 2 ] = instanceSuballocResult.dynamicOffset;
+    }
+
+    //
+    // Record the draws, either inline, or in parallel into the secondary buffers (the chunks of the draw list),
+    // that are executed in the draw order. The workers do not write anything but their command buffers:
+    // the frame data is already in the buffers, and the per-draw data is pushed.
+    //
+
+    const uint32_t drawCount           = uint32_t( drawList.draws.size( ) );
+    uint32_t       recordingChunkCount = 0;
+
+    if ( drawCount && VK_NULL_HANDLE == pParams->pRenderPass ) {
+        apemodevk::RecordSceneDraws( pParams->pCmdBuffer, pDeviceAsset, pScene, recordingState, 0, drawCount );
+    } else if ( drawCount ) {
+        const uint32_t kMaxChunkCount     = apemodevk::SceneDeviceAssetVk::kMaxRecordingChunkCount;
+        const uint32_t kMinChunkDrawCount = apemodevk::SceneDeviceAssetVk::kMinRecordingChunkDrawCount;
+
+        /* At least kMinChunkDrawCount instanced draws per chunk, and a chunk per worker at most. */
+        const uint32_t threadCount   = uint32_t( tbb::task_scheduler_init::default_num_threads( ) );
+        const uint32_t maxChunkCount = threadCount < kMaxChunkCount ? threadCount : kMaxChunkCount;
+        recordingChunkCount = ( drawList.stats.drawCount + kMinChunkDrawCount - 1 ) / kMinChunkDrawCount;
+        recordingChunkCount = recordingChunkCount < maxChunkCount ? recordingChunkCount : maxChunkCount;
+        recordingChunkCount = recordingChunkCount ? recordingChunkCount : 1;
+
+        /* The chunks are split evenly, and start with the first instances. */
+        uint32_t chunkBegins[ kMaxChunkCount + 1 ];
+        for ( uint32_t c = 0; c < recordingChunkCount; ++c ) {
+            uint32_t drawIndex = uint32_t( uint64_t( c ) * drawCount / recordingChunkCount );
+            while ( drawIndex < drawCount && 0 == drawList.draws[ drawIndex ].instanceCount )
+                ++drawIndex;
+            chunkBegins[ c ] = drawIndex;
+        }
+        chunkBegins[ recordingChunkCount ] = drawCount;
+
+        /* The pools are created on the first use, and reused in the next frames. */
+        for ( uint32_t c = 0; c < recordingChunkCount; ++c ) {
+            auto& recordingChunk = pDeviceAsset->RecordingChunks[ FrameIndex ][ c ];
+            if ( recordingChunk.hCmdPool.IsNull( ) ) {
+                VkCommandPoolCreateInfo cmdPoolCreateInfo;
+                apemodevk::InitializeStruct( cmdPoolCreateInfo );
+                cmdPoolCreateInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                cmdPoolCreateInfo.queueFamilyIndex = pParams->QueueFamilyId;
+
+                if ( false == recordingChunk.hCmdPool.Recreate( *pParams->pNode, cmdPoolCreateInfo ) ) {
+                    DebugBreak( );
+                    return;
+                }
+
+                VkCommandBufferAllocateInfo cmdBufferAllocInfo;
+                apemodevk::InitializeStruct( cmdBufferAllocInfo );
+                cmdBufferAllocInfo.commandPool        = recordingChunk.hCmdPool;
+                cmdBufferAllocInfo.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                cmdBufferAllocInfo.commandBufferCount = 1;
+
+                if ( false == recordingChunk.hCmdBuffer.Recreate( *pParams->pNode, cmdBufferAllocInfo ) ) {
+                    DebugBreak( );
+                    return;
+                }
             }
         }
+
+        VkDevice device = *pParams->pNode;
+
+        tbb::parallel_for( uint32_t( 0 ), recordingChunkCount, [&]( uint32_t c ) {
+            auto& recordingChunk = pDeviceAsset->RecordingChunks[ FrameIndex ][ c ];
+
+            /* The frame is complete (@see Reset()), the buffer can be reset. */
+            apemodevk::CheckedCall( vkResetCommandPool( device, recordingChunk.hCmdPool, 0 ) );
+
+            VkCommandBufferInheritanceInfo inheritanceInfo;
+            apemodevk::InitializeStruct( inheritanceInfo );
+            inheritanceInfo.renderPass  = pParams->pRenderPass;
+            inheritanceInfo.subpass     = 0;
+            inheritanceInfo.framebuffer = pParams->pFramebuffer;
+
+            VkCommandBufferBeginInfo commandBufferBeginInfo;
+            apemodevk::InitializeStruct( commandBufferBeginInfo );
+            commandBufferBeginInfo.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+            apemodevk::CheckedCall( vkBeginCommandBuffer( recordingChunk.hCmdBuffer, &commandBufferBeginInfo ) );
+            apemodevk::RecordSceneDraws( recordingChunk.hCmdBuffer, pDeviceAsset, pScene, recordingState, chunkBegins[ c ], chunkBegins[ c + 1 ] );
+            apemodevk::CheckedCall( vkEndCommandBuffer( recordingChunk.hCmdBuffer ) );
+        } );
+
+        VkCommandBuffer secondaryCmdBuffers[ kMaxChunkCount ];
+        for ( uint32_t c = 0; c < recordingChunkCount; ++c ) {
+            secondaryCmdBuffers[ c ] = pDeviceAsset->RecordingChunks[ FrameIndex ][ c ].hCmdBuffer;
+        }
+
+        vkCmdExecuteCommands( pParams->pCmdBuffer, recordingChunkCount, secondaryCmdBuffers );
+    }
+
+    if ( nullptr != pParams->pRenderStats ) {
+        pParams->pRenderStats->drawCallCount       = drawList.stats.drawCallCount;
+        pParams->pRenderStats->simplifiedNodeCount = lodSelector.simplifiedNodeCount;
+        pParams->pRenderStats->pushConstantCount   = drawList.stats.drawCount;
+        pParams->pRenderStats->uploadedByteCount   = uploadedByteCount;
+        pParams->pRenderStats->recordingChunkCount = recordingChunkCount;
+        pParams->pRenderStats->recordElapsedMs     = apemodevk::GetElapsedMs( startTime );
+
+        /* The pools are reset per frame, the counters are of this frame. */
+        const apemodevk::DescriptorSetPool* descSetPools[ 3 ] = {&pDeviceAsset->DescSetPools[ FrameIndex ],
+                                                                 &pDeviceAsset->WorldMatrixDescSetPools[ FrameIndex ],
+                                                                 &pDeviceAsset->InstanceDescSetPools[ FrameIndex ]};
+
+        pParams->pRenderStats->descSetHitCount  = 0;
+        pParams->pRenderStats->descSetMissCount = 0;
+        for ( auto pDescSetPool : descSetPools ) {
+            pParams->pRenderStats->descSetHitCount += pDescSetPool->Stats.hitCount;
+            pParams->pRenderStats->descSetMissCount += pDescSetPool->Stats.missCount;
+        }
+    }
+
+    if ( drawnNodeCount && false == pDeviceAsset->bFirstFrameReported ) {
+        pDeviceAsset->bFirstFrameReported = true;
+
+        uint32_t residentMeshCount = 0;
+        for ( auto& mesh : pScene->meshes ) {
+            auto pMeshDeviceAsset = (const apemodevk::SceneMeshDeviceAssetVk*) mesh.deviceAsset;
+            residentMeshCount += pMeshDeviceAsset && pDeviceAsset->Uploader.IsCompleted( pMeshDeviceAsset->pBuffer->UploadTicket );
+        }
+
+        if ( auto appState = apemode::AppState::GetCurrentState( ) ) {
+            appState->consoleLogger->info( "SceneRendererVk: Time to first frame: {:.1f} ms ({} of {} meshes resident).",
+                                           apemodevk::GetElapsedMs( pDeviceAsset->UploadStartTime ),
+                                           residentMeshCount,
+                                           pScene->meshes.size( ) );
+        }
     }
 }
 
@@ -643,6 +1048,11 @@ void apemode::SceneRendererVk::Reset( const Scene* pScene, uint32_t FrameIndex )
     if ( nullptr != pScene ) {
         if ( auto pDeviceAsset = (apemodevk::SceneDeviceAssetVk*) pScene->deviceAsset ) { /* TODO: const_cast */
             pDeviceAsset->BufferPools[ FrameIndex ].Reset( );
+            pDeviceAsset->WorldMatrixBufferPools[ FrameIndex ].Reset( );
+            pDeviceAsset->InstanceBufferPools[ FrameIndex ].Reset( );
+            pDeviceAsset->DescSetPools[ FrameIndex ].Reset( );
+            pDeviceAsset->WorldMatrixDescSetPools[ FrameIndex ].Reset( );
+            pDeviceAsset->InstanceDescSetPools[ FrameIndex ].Reset( );
         }
     }
 }
@@ -651,6 +1061,8 @@ void apemode::SceneRendererVk::Flush( const Scene* pScene, uint32_t FrameIndex )
     if ( nullptr != pScene ) {
         if ( auto pDeviceAsset = (apemodevk::SceneDeviceAssetVk*) pScene->deviceAsset ) { /* TODO: const_cast */
             pDeviceAsset->BufferPools[ FrameIndex ].Flush( );
+            pDeviceAsset->WorldMatrixBufferPools[ FrameIndex ].Flush( );
+            pDeviceAsset->InstanceBufferPools[ FrameIndex ].Flush( );
         }
     }
 }
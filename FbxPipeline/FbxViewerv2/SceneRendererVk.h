@@ -1,9 +1,26 @@
 #pragma once
 
 #include <SceneRendererBase.h>
+#include <SceneCulling.h>
+#include <SceneDrawList.h>
 #include <GraphicsDevice.Vulkan.h>
 
 namespace apemode {
+
+    /**
+     * Counters of the last SceneRendererVk::RenderScene() call.
+     **/
+    struct SceneRenderStatsVk {
+        uint32_t drawCallCount       = 0;
+        uint32_t pushConstantCount   = 0;
+        uint32_t uploadedByteCount   = 0; /* Frame constants, world matrices and instance node ids */
+        uint32_t descSetHitCount     = 0; /* Cached descriptor sets */
+        uint32_t descSetMissCount    = 0; /* Written descriptor sets */
+        uint32_t recordingChunkCount = 0; /* Secondary command buffers recorded in parallel, zero if recorded inline */
+        uint32_t simplifiedNodeCount = 0; /* Nodes drawn with the simplified levels (see SceneLodSelector) */
+        double   recordElapsedMs     = 0; /* CPU time, including the culling and the draw sorting */
+    };
+
     class SceneRendererVk : public SceneRendererBase {
     public:
         struct SceneUpdateParametersVk : SceneUpdateParametersBase {
@@ -12,6 +29,7 @@ namespace apemode {
             VkDescriptorPool           pDescPool   = VK_NULL_HANDLE; /* Required */
             VkRenderPass               pRenderPass = VK_NULL_HANDLE; /* Required */
             uint32_t                   FrameCount  = 0;              /* Required */
+            uint32_t                   QueueFamilyId = 0;            /* Required, the family of the command buffers the scene is rendered with */
         };
 
         void UpdateScene( Scene* pScene, const SceneUpdateParametersBase* pParams ) override;
@@ -24,9 +42,28 @@ namespace apemode {
             VkCommandBuffer            pCmdBuffer  = VK_NULL_HANDLE; /* Required */
             apemodem::mat4             ViewMatrix;                   /* Required */
             apemodem::mat4             ProjMatrix;                   /* Required */
+            SceneCullingStats*         pCullingStats = nullptr;      /* Optional, filled with the culling results */
+            SceneClusterCullingStats*  pClusterCullingStats = nullptr; /* Optional, filled with the cluster culling results */
+            SceneDrawListStats*        pDrawListStats = nullptr;     /* Optional, filled with the draw sorting results */
+            SceneRenderStatsVk*        pRenderStats   = nullptr;     /* Optional, filled with the recording results */
+            VkRenderPass               pRenderPass    = VK_NULL_HANDLE; /* Optional, the draws are recorded in parallel if set (@see RenderScene()) */
+            VkFramebuffer              pFramebuffer   = VK_NULL_HANDLE; /* Optional, the framebuffer of the render pass */
+            uint32_t                   QueueFamilyId  = 0;              /* Required with the render pass, the family of the command buffer pool */
+            float                      LodErrorPixels = 1;              /* Optional, the max projected error of the mesh levels, zero draws the full meshes */
         };
 
         void Reset( const Scene* pScene, uint32_t FrameIndex ) override;
+        /**
+         * Records the barriers of the uploaded mesh buffers (the transfer queue family releases them).
+         * Must be recorded outside of the render pass, before RenderScene(), the uploaded meshes are drawn after that.
+         **/
+        void AcquireUploads( const Scene* pScene, VkCommandBuffer pCmdBuffer );
+        /**
+         * Records the visible scene nodes into the command buffer.
+         * If the render pass is set, the draws are recorded in parallel into the secondary command buffers,
+         * that are executed in the command buffer, so the render pass must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+         * Otherwise, the draws are recorded inline.
+         **/
         void RenderScene( const Scene* pScene, const SceneRenderParametersBase* pParams ) override;
         void Flush( const Scene* pScene, uint32_t FrameIndex ) override;
     };
@@ -0,0 +1,326 @@
+#include <fbxvpch.h>
+
+#include <SceneSkinning.h>
+#include <Scene.h>
+#include <AppState.h>
+
+#include <chrono>
+#include <random>
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __SSE__ )
+#include <xmmintrin.h>
+#define APEMODE_SKINNING_SSE 1
+#endif
+
+static_assert( sizeof( apemode::SceneSkinnedVertex ) == sizeof( float ) * 5, "Must be tightly packed." );
+
+namespace {
+    const float kInvWeightScale = 1.0f / 255.0f;
+
+    inline float Distance( const float *a, const float *b ) {
+        const float dx = a[ 0 ] - b[ 0 ];
+        const float dy = a[ 1 ] - b[ 1 ];
+        const float dz = a[ 2 ] - b[ 2 ];
+        return sqrtf( dx * dx + dy * dy + dz * dz );
+    }
+
+    inline double MeasureMs( std::chrono::high_resolution_clock::time_point start ) {
+        std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now( ) - start;
+        return elapsed.count( );
+    }
+}
+
+bool apemode::DecodeSkinnedVertices( const Scene *scene, SceneMesh const &mesh, std::vector< SceneSkinnedVertex > &vertices ) {
+    vertices.clear( );
+    if ( mesh.vertexFormat != apemodefb::EVertexFormat_Skinned || mesh.vertexLayoutId >= scene->vertexLayouts.size( ) )
+        return false;
+
+    /* Unorm positions (10_10_10_2 or 16_16_16_16) and 8_8_8_8 joints, see the exporter packing. */
+    auto &layout     = scene->vertexLayouts[ mesh.vertexLayoutId ].layout;
+    auto &positionFb = layout.position( );
+    if ( positionFb.encoding( ) != apemodefb::EVertexAttributeEncodingFb_Unorm ||
+         ( 10 != positionFb.bit_width( ) && 16 != positionFb.bit_width( ) ) || 8 != layout.joint_indices( ).bit_width( ) ||
+         8 != layout.joint_weights( ).bit_width( ) )
+        return false;
+
+    const uint8_t *data = mesh.vertices;
+    uint32_t       size = mesh.verticesSize;
+    if ( mesh.geometryBufferId < scene->geometryBuffers.size( ) ) {
+        auto &geometryBuffer = scene->geometryBuffers[ mesh.geometryBufferId ];
+        data = geometryBuffer.vertices + mesh.baseVertex * mesh.vertexStride;
+        size = geometryBuffer.verticesSize - mesh.baseVertex * mesh.vertexStride;
+    }
+
+    if ( nullptr == data || uint64_t( mesh.vertexCount ) * mesh.vertexStride > size )
+        return false;
+
+    const uint32_t positionMask = ( 1u << positionFb.bit_width( ) ) - 1;
+
+    /* Each submesh is quantized in its own bounds. */
+    vertices.resize( mesh.vertexCount );
+    for ( auto &submesh : mesh.submeshes ) {
+        for ( uint32_t i = submesh.baseVertex; i < submesh.baseVertex + submesh.vertexCount; ++i ) {
+            auto  vertexData = data + i * mesh.vertexStride;
+            auto &vertex     = vertices[ i ];
+
+            for ( uint32_t c = 0; c < 3; ++c ) {
+                const uint32_t bitOffset = c * positionFb.bit_width( );
+
+                uint32_t word;
+                memcpy( &word, vertexData + positionFb.offset( ) + bitOffset / 32 * sizeof( word ), sizeof( word ) );
+
+                const float position = float( ( word >> ( bitOffset % 32 ) ) & positionMask ) / float( positionMask );
+                vertex.position[ c ] = submesh.positionOffset[ c ] + submesh.positionScale[ c ] * position;
+            }
+
+            memcpy( vertex.jointIndices, vertexData + layout.joint_indices( ).offset( ), sizeof( vertex.jointIndices ) );
+            memcpy( vertex.jointWeights, vertexData + layout.joint_weights( ).offset( ), sizeof( vertex.jointWeights ) );
+        }
+    }
+
+    return true;
+}
+
+void apemode::CalculateSkinningMatrices( const Scene *scene, SceneSkin const &skin, std::vector< mathfu::mat4 > &skinningMatrices ) {
+    const uint32_t jointCount = uint32_t( skin.jointNodeIds.size( ) );
+    skinningMatrices.resize( jointCount );
+
+    for ( uint32_t j = 0; j < jointCount; ++j ) {
+        const uint32_t nodeId = skin.jointNodeIds[ j ];
+        if ( nodeId < scene->hierarchicalMatrices.size( ) && j < skin.inverseBindMatrices.size( ) ) {
+            skinningMatrices[ j ] = scene->hierarchicalMatrices[ nodeId ] * skin.inverseBindMatrices[ j ];
+        } else {
+            skinningMatrices[ j ] = mathfu::mat4::Identity( );
+        }
+    }
+}
+
+void apemode::SkinVerticesReference( const SceneSkinnedVertex *vertices,
+                                     uint32_t                  vertexCount,
+                                     const mathfu::mat4 *      skinningMatrices,
+                                     float *                   positions ) {
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        auto &vertex = vertices[ i ];
+
+        const mathfu::vec4 position( vertex.position[ 0 ], vertex.position[ 1 ], vertex.position[ 2 ], 1.0f );
+
+        mathfu::vec4 skinnedPosition( 0.0f );
+        for ( uint32_t j = 0; j < 4; ++j ) {
+            if ( vertex.jointWeights[ j ] )
+                skinnedPosition += ( skinningMatrices[ vertex.jointIndices[ j ] ] * position ) * ( vertex.jointWeights[ j ] * kInvWeightScale );
+        }
+
+        positions[ i * 4 + 0 ] = skinnedPosition.x;
+        positions[ i * 4 + 1 ] = skinnedPosition.y;
+        positions[ i * 4 + 2 ] = skinnedPosition.z;
+        positions[ i * 4 + 3 ] = 1.0f;
+    }
+}
+
+void apemode::SkinVertices( const SceneSkinnedVertex *vertices, uint32_t vertexCount, const mathfu::mat4 *skinningMatrices, float *positions ) {
+    const float *matrices = reinterpret_cast< const float * >( skinningMatrices );
+
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        auto &vertex = vertices[ i ];
+
+        /* The zero weights are blended too (no branches), the unused joint indices are zeros. */
+        const float *m0 = matrices + vertex.jointIndices[ 0 ] * 16;
+        const float *m1 = matrices + vertex.jointIndices[ 1 ] * 16;
+        const float *m2 = matrices + vertex.jointIndices[ 2 ] * 16;
+        const float *m3 = matrices + vertex.jointIndices[ 3 ] * 16;
+
+#ifdef APEMODE_SKINNING_SSE
+        const __m128 w0 = _mm_set1_ps( vertex.jointWeights[ 0 ] * kInvWeightScale );
+        const __m128 w1 = _mm_set1_ps( vertex.jointWeights[ 1 ] * kInvWeightScale );
+        const __m128 w2 = _mm_set1_ps( vertex.jointWeights[ 2 ] * kInvWeightScale );
+        const __m128 w3 = _mm_set1_ps( vertex.jointWeights[ 3 ] * kInvWeightScale );
+
+        /* Blends the matrix columns, then transforms the position with the blended matrix. */
+        __m128 p = _mm_setzero_ps( );
+        for ( uint32_t c = 0; c < 4; ++c ) {
+            const __m128 column = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( m0 + c * 4 ), w0 ), _mm_mul_ps( _mm_loadu_ps( m1 + c * 4 ), w1 ) ),
+                                              _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( m2 + c * 4 ), w2 ), _mm_mul_ps( _mm_loadu_ps( m3 + c * 4 ), w3 ) ) );
+            p = _mm_add_ps( p, c < 3 ? _mm_mul_ps( column, _mm_set1_ps( vertex.position[ c ] ) ) : column );
+        }
+
+        _mm_storeu_ps( positions + i * 4, p );
+#else
+        const float w0 = vertex.jointWeights[ 0 ] * kInvWeightScale;
+        const float w1 = vertex.jointWeights[ 1 ] * kInvWeightScale;
+        const float w2 = vertex.jointWeights[ 2 ] * kInvWeightScale;
+        const float w3 = vertex.jointWeights[ 3 ] * kInvWeightScale;
+
+        for ( uint32_t r = 0; r < 4; ++r ) {
+            float p = 0.0f;
+            for ( uint32_t c = 0; c < 4; ++c ) {
+                const uint32_t k = c * 4 + r;
+                const float    m = m0[ k ] * w0 + m1[ k ] * w1 + m2[ k ] * w2 + m3[ k ] * w3;
+                p += c < 3 ? m * vertex.position[ c ] : m;
+            }
+            positions[ i * 4 + r ] = p;
+        }
+#endif
+    }
+}
+
+bool apemode::ValidateSceneSkinning( const Scene *scene, SceneSkinningStats *pStats ) {
+    SceneSkinningStats stats;
+
+    std::vector< SceneSkinnedVertex > vertices;
+    std::vector< mathfu::mat4 >       skinningMatrices;
+    std::vector< float >              positions;
+    std::vector< float >              referencePositions;
+
+    for ( uint32_t meshId = 0; meshId < scene->meshes.size( ); ++meshId ) {
+        auto &mesh = scene->meshes[ meshId ];
+        if ( mesh.skinId >= scene->skins.size( ) || false == DecodeSkinnedVertices( scene, mesh, vertices ) )
+            continue;
+
+        auto &skin = scene->skins[ mesh.skinId ];
+        const uint32_t jointCount  = uint32_t( skin.jointNodeIds.size( ) );
+        const uint32_t vertexCount = uint32_t( vertices.size( ) );
+
+        ++stats.skinnedMeshCount;
+        stats.vertexCount += vertexCount;
+
+        bool bValidJoints = jointCount != 0;
+        for ( auto &vertex : vertices ) {
+            uint32_t weightSum   = 0;
+            bool     bValidJoint = true;
+            for ( uint32_t j = 0; j < 4; ++j ) {
+                weightSum += vertex.jointWeights[ j ];
+                bValidJoint &= vertex.jointIndices[ j ] < jointCount;
+            }
+
+            stats.invalidWeightCount += weightSum != 255;
+            stats.invalidJointCount += false == bValidJoint;
+            bValidJoints &= bValidJoint;
+        }
+
+        if ( false == bValidJoints )
+            continue;
+
+        CalculateSkinningMatrices( scene, skin, skinningMatrices );
+        positions.resize( vertexCount * 4 );
+        referencePositions.resize( vertexCount * 4 );
+
+        auto startTime = std::chrono::high_resolution_clock::now( );
+        SkinVerticesReference( vertices.data( ), vertexCount, skinningMatrices.data( ), referencePositions.data( ) );
+        stats.referenceElapsedMs += MeasureMs( startTime );
+
+        startTime = std::chrono::high_resolution_clock::now( );
+        SkinVertices( vertices.data( ), vertexCount, skinningMatrices.data( ), positions.data( ) );
+        stats.elapsedMs += MeasureMs( startTime );
+
+        for ( uint32_t i = 0; i < vertexCount; ++i ) {
+            const float error = Distance( positions.data( ) + i * 4, referencePositions.data( ) + i * 4 );
+            stats.maxReferenceError = error > stats.maxReferenceError ? error : stats.maxReferenceError;
+        }
+
+        /* In the bind pose the skinned positions are the world positions of the mesh node vertices. */
+        auto nodeIt = std::find_if( scene->nodes.begin( ), scene->nodes.end( ), [&]( SceneNode const &node ) { return node.meshId == meshId; } );
+        if ( nodeIt != scene->nodes.end( ) ) {
+            auto &worldMatrix = scene->worldMatrices[ nodeIt->id ];
+            for ( uint32_t i = 0; i < vertexCount; ++i ) {
+                const mathfu::vec4 position      = worldMatrix * mathfu::vec4( vertices[ i ].position[ 0 ], vertices[ i ].position[ 1 ], vertices[ i ].position[ 2 ], 1.0f );
+                const float        expected[ 3 ] = {position.x, position.y, position.z};
+                const float        error         = Distance( expected, referencePositions.data( ) + i * 4 );
+                stats.maxBindPoseError = error > stats.maxBindPoseError ? error : stats.maxBindPoseError;
+            }
+        }
+    }
+
+    auto appState = apemode::AppState::GetCurrentState( );
+    if ( nullptr != appState && nullptr != appState->consoleLogger ) {
+        appState->consoleLogger->info( "Skinning: {} meshes, {} skins, {} vertices, {} invalid weights, {} invalid joints",
+                                       stats.skinnedMeshCount,
+                                       scene->skins.size( ),
+                                       stats.vertexCount,
+                                       stats.invalidWeightCount,
+                                       stats.invalidJointCount );
+        appState->consoleLogger->info( "Skinning: {:.3f} ms (reference {:.3f} ms), max error {} (reference), {} (bind pose)",
+                                       stats.elapsedMs,
+                                       stats.referenceElapsedMs,
+                                       stats.maxReferenceError,
+                                       stats.maxBindPoseError );
+    }
+
+    if ( nullptr != pStats ) {
+        *pStats = stats;
+    }
+
+    return 0 == stats.invalidWeightCount && 0 == stats.invalidJointCount;
+}
+
+void apemode::BenchmarkSceneSkinning( uint32_t vertexCount, uint32_t jointCount, uint32_t iterationCount ) {
+    if ( 0 == vertexCount || 0 == iterationCount )
+        return;
+
+    auto appState = apemode::AppState::GetCurrentState( );
+    if ( nullptr == appState || nullptr == appState->consoleLogger )
+        return;
+
+    jointCount = std::min< uint32_t >( std::max< uint32_t >( jointCount, 1 ), 256 );
+
+    //
+    // Random vertices with 1..4 influences (the weights sum up to 255 as exported),
+    // the joints have random rotations and translations.
+    //
+
+    std::mt19937                            rng( 42 );
+    std::uniform_real_distribution< float > positionDistribution( -1.0f, 1.0f );
+    std::uniform_real_distribution< float > angleDistribution( -float( M_PI ), float( M_PI ) );
+
+    std::vector< SceneSkinnedVertex > vertices( vertexCount );
+    for ( auto &vertex : vertices ) {
+        for ( uint32_t i = 0; i < 3; ++i )
+            vertex.position[ i ] = positionDistribution( rng );
+
+        const uint32_t influenceCount = 1 + rng( ) % 4;
+
+        uint32_t weightSum = 0;
+        for ( uint32_t j = 0; j < 4; ++j ) {
+            vertex.jointIndices[ j ] = j < influenceCount ? uint8_t( rng( ) % jointCount ) : 0;
+            vertex.jointWeights[ j ] = j < influenceCount ? uint8_t( 1 + rng( ) % ( 255 / influenceCount ) ) : 0;
+            weightSum += vertex.jointWeights[ j ];
+        }
+
+        vertex.jointWeights[ 0 ] = uint8_t( vertex.jointWeights[ 0 ] + 255 - weightSum );
+    }
+
+    std::vector< mathfu::mat4 > skinningMatrices( jointCount );
+    for ( auto &skinningMatrix : skinningMatrices ) {
+        const mathfu::vec3 angles( angleDistribution( rng ), angleDistribution( rng ), angleDistribution( rng ) );
+        const mathfu::vec3 translation( positionDistribution( rng ), positionDistribution( rng ), positionDistribution( rng ) );
+        skinningMatrix = mathfu::mat4::FromTranslationVector( translation ) * mathfu::quat::FromEulerAngles( angles ).ToMatrix4( );
+    }
+
+    std::vector< float > positions( vertexCount * 4 );
+    std::vector< float > referencePositions( vertexCount * 4 );
+
+    auto measure = [&]( void ( *pSkinVertices )( const SceneSkinnedVertex *, uint32_t, const mathfu::mat4 *, float * ), float *pPositions ) {
+        double elapsedMs = 0;
+        for ( uint32_t i = 0; i <= iterationCount; ++i ) {
+            auto startTime = std::chrono::high_resolution_clock::now( );
+            pSkinVertices( vertices.data( ), vertexCount, skinningMatrices.data( ), pPositions );
+            elapsedMs += i ? MeasureMs( startTime ) : 0.0; /* Warm up */
+        }
+        return elapsedMs / iterationCount;
+    };
+
+    const double referenceMs = measure( &SkinVerticesReference, referencePositions.data( ) );
+    const double skinningMs  = measure( &SkinVertices, positions.data( ) );
+
+    float maxError = 0;
+    for ( uint32_t i = 0; i < vertexCount; ++i ) {
+        const float error = Distance( positions.data( ) + i * 4, referencePositions.data( ) + i * 4 );
+        maxError = error > maxError ? error : maxError;
+    }
+
+    appState->consoleLogger->info( "Skinning: {} vertices, {} joints, {} iterations", vertexCount, jointCount, iterationCount );
+    appState->consoleLogger->info( "Skinning: {:.3f} ms (reference {:.3f} ms, {:.2f}x), max error {}",
+                                   skinningMs,
+                                   referenceMs,
+                                   skinningMs > 0 ? referenceMs / skinningMs : 0.0,
+                                   maxError );
+}
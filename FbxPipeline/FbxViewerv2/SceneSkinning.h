@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fbxvpch.h>
+
+namespace apemode {
+
+    class Scene;
+    struct SceneMesh;
+    struct SceneSkin;
+
+    /**
+     * Skinned vertex decoded from SkinnedVertexFb: the object-space position and the quantized influences.
+     **/
+    struct SceneSkinnedVertex {
+        float   position[ 3 ];
+        uint8_t jointIndices[ 4 ];
+        uint8_t jointWeights[ 4 ]; /* Unorm, sum up to 255 */
+    };
+
+    /**
+     * Counters of the last ValidateSceneSkinning() call.
+     **/
+    struct SceneSkinningStats {
+        uint32_t skinnedMeshCount   = 0;
+        uint32_t vertexCount        = 0;
+        uint32_t invalidWeightCount = 0; /* Vertices with the weights that do not sum up to 255 */
+        uint32_t invalidJointCount  = 0; /* Vertices with the joint indices out of the skin range */
+        float    maxBindPoseError   = 0; /* Max distance between the skinned positions and the node world positions */
+        float    maxReferenceError  = 0; /* Max distance between SkinVertices() and SkinVerticesReference() */
+        double   elapsedMs          = 0; /* SkinVertices() */
+        double   referenceElapsedMs = 0; /* SkinVerticesReference() */
+    };
+
+    /**
+     * Decodes the vertices of the skinned mesh (the positions are dequantized with the submesh position offsets and scales).
+     * @return False if the mesh is not skinned or its vertices are not available.
+     **/
+    bool DecodeSkinnedVertices( const Scene *scene, SceneMesh const &mesh, std::vector< SceneSkinnedVertex > &vertices );
+
+    /**
+     * Skinning matrices of the joints: the hierarchical matrices of the joint nodes times the inverse bind matrices.
+     * The matrices of the missing joints are identities.
+     **/
+    void CalculateSkinningMatrices( const Scene *scene, SceneSkin const &skin, std::vector< mathfu::mat4 > &skinningMatrices );
+
+    /**
+     * Linear blend skinning of the positions, reference implementation (scalar, one influence at a time).
+     * @param positions The skinned positions, 4 floats per vertex (w is 1).
+     **/
+    void SkinVerticesReference( const SceneSkinnedVertex *vertices,
+                                uint32_t                  vertexCount,
+                                const mathfu::mat4 *      skinningMatrices,
+                                float *                   positions );
+
+    /**
+     * Linear blend skinning of the positions, the matrices of the influences are blended with SSE (scalar fallback).
+     * @param positions The skinned positions, 4 floats per vertex (w is 1).
+     **/
+    void SkinVertices( const SceneSkinnedVertex *vertices, uint32_t vertexCount, const mathfu::mat4 *skinningMatrices, float *positions );
+
+    /**
+     * Validates the skinned meshes of the scene: the weights and joint indices, and the skinned positions against
+     * the world positions of the nodes (they match in the bind pose), SkinVertices() is compared to the reference.
+     * The stats go to the console.
+     * @return True if all the influences are valid.
+     **/
+    bool ValidateSceneSkinning( const Scene *scene, SceneSkinningStats *pStats = nullptr );
+
+    /**
+     * Skins the random vertices with the random joint matrices, compares SkinVertices() to SkinVerticesReference()
+     * and measures both (the timings and the max error go to the console).
+     **/
+    void BenchmarkSceneSkinning( uint32_t vertexCount, uint32_t jointCount = 64, uint32_t iterationCount = 16 );
+}
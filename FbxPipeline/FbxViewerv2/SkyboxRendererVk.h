@@ -48,6 +48,6 @@ namespace apemodevk {
         apemodevk::TDispatchableHandle< VkPipelineCache >       hPipelineCache;
         apemodevk::TDispatchableHandle< VkPipeline >            hPipeline;
         apemodevk::TDispatchableHandle< VkBuffer >              hVertexBuffer;
-        apemodevk::TDispatchableHandle< VkDeviceMemory >        hVertexBufferMemory;
+        apemodevk::MemoryAllocation                             VertexBufferMemory;
     };
 }
\ No newline at end of file
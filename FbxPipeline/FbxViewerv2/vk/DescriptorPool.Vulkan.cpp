@@ -3,6 +3,7 @@
 
 #include <CommandQueue.Vulkan.h>
 #include <PipelineLayout.Vulkan.h>
+#include <CityHash.h>
 
 apemodevk::DescriptorPool::DescriptorPool () : pNode (nullptr)
 {
@@ -290,44 +291,93 @@ void apemodevk::DescriptorSetUpdater::Flush()
     }
 }
 
+namespace {
+    uint64_t HashBufferSetKey( VkDescriptorSetLayout pLayout,
+                               VkBuffer              pBuffer,
+                               uint32_t              offset,
+                               uint32_t              range,
+                               VkDescriptorType      eType ) {
+        apemode::CityHash64Wrapper hashBuilder;
+        hashBuilder.CombineWith( reinterpret_cast< uint64_t >( pLayout ) );
+        hashBuilder.CombineWith( reinterpret_cast< uint64_t >( pBuffer ) );
+        hashBuilder.CombineWith( ( uint64_t( offset ) << 32 ) | range );
+        hashBuilder.CombineWith( uint64_t( eType ) );
+        return hashBuilder.Value;
+    }
+}
+
 bool apemodevk::DescriptorSetPool::Recreate( VkDevice              pInLogicalDevice,
                                              VkDescriptorPool      pInDescPool,
                                              VkDescriptorSetLayout pInLayout ) {
     pLogicalDevice = pInLogicalDevice;
     pDescriptorPool = pInDescPool;
     pDescriptorSetLayout = pInLayout;
+
+    /* The sets were allocated from the previous pool (it is reset by the owner). */
+    BufferSets.clear( );
+    BufferSetLookup.clear( );
+    FreeSets.clear( );
+    RetiredSets.clear( );
+    Stats = DescriptorSetPoolStats( );
     return true;
 }
 
 VkDescriptorSet apemodevk::DescriptorSetPool::GetDescSet( const VkDescriptorBufferInfo& InDescriptorBufferInfo,
                                                           VkDescriptorType              eInType ) {
-    auto descSetIt = std::find_if( BufferSets.begin( ), BufferSets.end( ), [&]( const auto& allocatedSet ) {
-        return allocatedSet.pBuffer == InDescriptorBufferInfo.buffer &&           /* Buffer handles must match */
-               allocatedSet.eType == eInType &&                                   /* Descriptor type must match */
-               allocatedSet.offset == (uint32_t) InDescriptorBufferInfo.offset && /* Offsets must match */
-               allocatedSet.range >= (uint32_t) InDescriptorBufferInfo.range;     /* Range can be greater */
-    } );
-
-    if ( descSetIt != BufferSets.end( ) )
-        return descSetIt->pDescriptorSet;
-
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-    InitializeStruct( descriptorSetAllocateInfo );
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.descriptorPool = pDescriptorPool;
-    descriptorSetAllocateInfo.pSetLayouts = &pDescriptorSetLayout;
+    const uint32_t offset = (uint32_t) InDescriptorBufferInfo.offset;
+    const uint32_t range  = (uint32_t) InDescriptorBufferInfo.range;
+    const uint64_t key    = HashBufferSetKey( pDescriptorSetLayout, InDescriptorBufferInfo.buffer, offset, range, eInType );
+
+    uint32_t bufferSetIndex = uint32_t( BufferSets.size( ) );
+
+    auto lookupIt = BufferSetLookup.find( key );
+    if ( lookupIt != BufferSetLookup.end( ) ) {
+        bufferSetIndex  = lookupIt->second;
+        auto& bufferSet = BufferSets[ bufferSetIndex ];
+
+        if ( bufferSet.pBuffer == InDescriptorBufferInfo.buffer && bufferSet.eType == eInType &&
+             bufferSet.offset == offset && bufferSet.range == range ) {
+            bufferSet.bUsed = true;
+            ++Stats.hitCount;
+            return bufferSet.pDescriptorSet;
+        }
+
+        /* Collisions are replaced in place, the set can be rewritten only if it was not used since the last Reset(). */
+        if ( bufferSet.bUsed ) {
+            RetiredSets.push_back( bufferSet.pDescriptorSet );
+        } else {
+            FreeSets.push_back( bufferSet.pDescriptorSet );
+        }
+    }
+
+    ++Stats.missCount;
 
     VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-    if ( VK_SUCCESS != vkAllocateDescriptorSets( pLogicalDevice, &descriptorSetAllocateInfo, &descriptorSet ) ) {
-        DebugBreak( );
-        return nullptr;
+    if ( false == FreeSets.empty( ) ) {
+        descriptorSet = FreeSets.back( );
+        FreeSets.pop_back( );
+    } else {
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+        InitializeStruct( descriptorSetAllocateInfo );
+        descriptorSetAllocateInfo.descriptorSetCount = 1;
+        descriptorSetAllocateInfo.descriptorPool = pDescriptorPool;
+        descriptorSetAllocateInfo.pSetLayouts = &pDescriptorSetLayout;
+
+        if ( VK_SUCCESS != pfnAllocateDescriptorSets( pLogicalDevice, &descriptorSetAllocateInfo, &descriptorSet ) ) {
+            DebugBreak( );
+            return nullptr;
+        }
+
+        ++Stats.allocatedCount;
     }
 
-    BufferSets.emplace_back( DescriptorBufferInfo{descriptorSet,
-                                                  InDescriptorBufferInfo.buffer,
-                                                  (uint32_t) InDescriptorBufferInfo.offset,
-                                                  (uint32_t) InDescriptorBufferInfo.range,
-                                                  eInType} );
+    if ( bufferSetIndex == BufferSets.size( ) ) {
+        BufferSets.emplace_back( );
+    }
+
+    BufferSets[ bufferSetIndex ]       = DescriptorBufferInfo{descriptorSet, InDescriptorBufferInfo.buffer, offset, range, eInType};
+    BufferSets[ bufferSetIndex ].bUsed = true;
+    BufferSetLookup[ key ]             = bufferSetIndex;
 
     VkWriteDescriptorSet writeDescriptorSet;
     InitializeStruct( writeDescriptorSet );
@@ -335,11 +385,46 @@ VkDescriptorSet apemodevk::DescriptorSetPool::GetDescSet( const VkDescriptorBuff
     writeDescriptorSet.descriptorType  = eInType;
     writeDescriptorSet.pBufferInfo = &InDescriptorBufferInfo;
     writeDescriptorSet.dstSet = descriptorSet;
-    vkUpdateDescriptorSets( pLogicalDevice, 1, &writeDescriptorSet, 0, nullptr );
+    pfnUpdateDescriptorSets( pLogicalDevice, 1, &writeDescriptorSet, 0, nullptr );
 
     return descriptorSet;
 }
 
+void apemodevk::DescriptorSetPool::Reset( ) {
+    const uint32_t evictedCount = uint32_t( std::count_if( BufferSets.begin( ), BufferSets.end( ), [&]( const DescriptorBufferInfo& bufferSet ) {
+        return false == bufferSet.bUsed;
+    } ) );
+
+    Stats              = DescriptorSetPoolStats( );
+    Stats.evictedCount = evictedCount;
+
+    /* Not in use by the device anymore. */
+    FreeSets.insert( FreeSets.end( ), RetiredSets.begin( ), RetiredSets.end( ) );
+    RetiredSets.clear( );
+
+    if ( 0 == evictedCount ) {
+        for ( auto& bufferSet : BufferSets )
+            bufferSet.bUsed = false;
+        return;
+    }
+
+    /* Keep the used sets, and rebuild the lookup for the new indices. */
+    uint32_t keptCount = 0;
+    BufferSetLookup.clear( );
+    for ( auto& bufferSet : BufferSets ) {
+        if ( false == bufferSet.bUsed ) {
+            FreeSets.push_back( bufferSet.pDescriptorSet );
+            continue;
+        }
+
+        bufferSet.bUsed = false;
+        BufferSetLookup[ HashBufferSetKey( pDescriptorSetLayout, bufferSet.pBuffer, bufferSet.offset, bufferSet.range, bufferSet.eType ) ] = keptCount;
+        BufferSets[ keptCount++ ] = bufferSet;
+    }
+
+    BufferSets.resize( keptCount );
+}
+
 apemodevk::DescriptorSetPool::DescriptorBufferInfo::DescriptorBufferInfo( ) {
 }
 
@@ -347,3 +432,114 @@ apemodevk::DescriptorSetPool::DescriptorBufferInfo::DescriptorBufferInfo(
     VkDescriptorSet pDescriptorSet, VkBuffer pBuffer, uint32_t offset, uint32_t range, VkDescriptorType eType )
     : pDescriptorSet( pDescriptorSet ), pBuffer( pBuffer ), offset( offset ), range( range ), eType( eType ) {
 }
+
+namespace {
+    uint32_t MockAllocatedSetCount = 0;
+    uint32_t MockWrittenSetCount   = 0;
+
+    /* Non-dispatchable handles are either pointers or 64-bit integers. */
+    template < typename THandle >
+    THandle MockHandle( uint64_t id ) {
+        return (THandle)( uintptr_t ) id;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL MockAllocateDescriptorSets( VkDevice                           pDevice,
+                                                               const VkDescriptorSetAllocateInfo* pAllocateInfo,
+                                                               VkDescriptorSet*                   pDescriptorSets ) {
+        (void) pDevice;
+        for ( uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i )
+            pDescriptorSets[ i ] = MockHandle< VkDescriptorSet >( ++MockAllocatedSetCount );
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL MockUpdateDescriptorSets( VkDevice                    pDevice,
+                                                         uint32_t                    writeCount,
+                                                         const VkWriteDescriptorSet* pWrites,
+                                                         uint32_t                    copyCount,
+                                                         const VkCopyDescriptorSet*  pCopies ) {
+        (void) pDevice;
+        (void) pWrites;
+        (void) copyCount;
+        (void) pCopies;
+        MockWrittenSetCount += writeCount;
+    }
+
+    VkDescriptorBufferInfo MockBufferInfo( uint64_t bufferId, VkDeviceSize offset ) {
+        VkDescriptorBufferInfo bufferInfo;
+        bufferInfo.buffer = MockHandle< VkBuffer >( bufferId );
+        bufferInfo.offset = offset;
+        bufferInfo.range  = 256;
+        return bufferInfo;
+    }
+}
+
+#define apemodevk_TestDescriptorSetPool_Check( expr )                                  \
+    if ( false == ( expr ) ) {                                                         \
+        apemodevk::platform::DebugTrace( "TestDescriptorSetPool: Failed: %s", #expr ); \
+        return false;                                                                  \
+    }
+
+bool apemodevk::TestDescriptorSetPool( ) {
+    MockAllocatedSetCount = 0;
+    MockWrittenSetCount   = 0;
+
+    const VkDescriptorType eType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
+    DescriptorSetPool pool;
+    pool.pfnAllocateDescriptorSets = MockAllocateDescriptorSets;
+    pool.pfnUpdateDescriptorSets   = MockUpdateDescriptorSets;
+    pool.Recreate( MockHandle< VkDevice >( 1 ), MockHandle< VkDescriptorPool >( 1 ), MockHandle< VkDescriptorSetLayout >( 1 ) );
+
+    //
+    // Miss: the set is allocated and written, hit: the same set is returned without writes.
+    //
+
+    const VkDescriptorSet setA = pool.GetDescSet( MockBufferInfo( 1, 0 ), eType );
+    apemodevk_TestDescriptorSetPool_Check( VK_NULL_HANDLE != setA );
+    apemodevk_TestDescriptorSetPool_Check( 1 == pool.Stats.missCount && 1 == pool.Stats.allocatedCount && 1 == MockWrittenSetCount );
+
+    apemodevk_TestDescriptorSetPool_Check( setA == pool.GetDescSet( MockBufferInfo( 1, 0 ), eType ) );
+    apemodevk_TestDescriptorSetPool_Check( 1 == pool.Stats.hitCount && 1 == pool.Stats.missCount && 1 == MockWrittenSetCount );
+
+    /* The offset is the part of the key. */
+    const VkDescriptorSet setB = pool.GetDescSet( MockBufferInfo( 1, 256 ), eType );
+    apemodevk_TestDescriptorSetPool_Check( setA != setB && 2 == pool.Stats.allocatedCount );
+
+    //
+    // Eviction: the set that was not used since the previous reset is rewritten for the new buffer.
+    //
+
+    pool.Reset( );
+    apemodevk_TestDescriptorSetPool_Check( 0 == pool.Stats.evictedCount );
+
+    apemodevk_TestDescriptorSetPool_Check( setA == pool.GetDescSet( MockBufferInfo( 1, 0 ), eType ) );
+    pool.Reset( );
+    apemodevk_TestDescriptorSetPool_Check( 1 == pool.Stats.evictedCount && 1 == pool.BufferSets.size( ) && 1 == pool.FreeSets.size( ) );
+
+    apemodevk_TestDescriptorSetPool_Check( setB == pool.GetDescSet( MockBufferInfo( 2, 0 ), eType ) );
+    apemodevk_TestDescriptorSetPool_Check( 0 == pool.Stats.allocatedCount && 1 == pool.Stats.missCount && 2 == MockAllocatedSetCount );
+
+    //
+    // Collision: the key of the new buffer is mapped to the entry of the used set, the entry is replaced in place,
+    // and the replaced set is freed in the next reset (it could be in use).
+    //
+
+    apemodevk_TestDescriptorSetPool_Check( setA == pool.GetDescSet( MockBufferInfo( 1, 0 ), eType ) );
+    apemodevk_TestDescriptorSetPool_Check( setB == pool.GetDescSet( MockBufferInfo( 2, 0 ), eType ) );
+
+    const VkDescriptorBufferInfo collidingBufferInfo = MockBufferInfo( 3, 0 );
+    pool.BufferSetLookup[ HashBufferSetKey( pool.pDescriptorSetLayout, collidingBufferInfo.buffer, 0, 256, eType ) ] = 0;
+
+    const size_t          bufferSetCount = pool.BufferSets.size( );
+    const VkDescriptorSet setC           = pool.GetDescSet( collidingBufferInfo, eType );
+    apemodevk_TestDescriptorSetPool_Check( setC != pool.BufferSets[ 1 ].pDescriptorSet && 3 == MockAllocatedSetCount );
+    apemodevk_TestDescriptorSetPool_Check( bufferSetCount == pool.BufferSets.size( ) && setC == pool.BufferSets[ 0 ].pDescriptorSet );
+    apemodevk_TestDescriptorSetPool_Check( 1 == pool.RetiredSets.size( ) && setA == pool.RetiredSets.back( ) );
+
+    pool.Reset( );
+    apemodevk_TestDescriptorSetPool_Check( pool.RetiredSets.empty( ) && 1 == pool.FreeSets.size( ) && setA == pool.FreeSets.back( ) );
+
+    return true;
+}
+
+#undef apemodevk_TestDescriptorSetPool_Check
@@ -208,6 +208,24 @@ namespace apemodevk
         operator VkDescriptorSetLayoutBinding( ) const;
     };
 
+    /**
+     * Counters of the DescriptorSetPool since the last Reset() call.
+     **/
+    struct DescriptorSetPoolStats {
+        uint32_t hitCount       = 0; /* Returned the cached sets */
+        uint32_t missCount      = 0; /* Written the sets (allocated or reused the evicted ones) */
+        uint32_t allocatedCount = 0; /* Allocated from the descriptor pool */
+        uint32_t evictedCount   = 0; /* Evicted in the last Reset() call */
+    };
+
+    /**
+     * Caches the descriptor sets with the single buffer binding.
+     * The sets are looked up by (layout, buffer, offset, range, type), so the suballocations from the same buffer
+     * share the set, the dynamic offsets are left to the caller. The sets that were not used since the previous
+     * Reset() call are evicted, and rewritten for the new buffers (they are never freed to the descriptor pool).
+     * The pool is not thread-safe, it is supposed to be used per frame (@see HostBufferPool).
+     * The allocation and update functions can be replaced (the pool is tested without the device, @see TestDescriptorSetPool()).
+     **/
     struct DescriptorSetPool {
 
         /* VkDescriptorBufferInfo with uint32_t + VkDescriptorSet */
@@ -217,17 +235,36 @@ namespace apemodevk
             uint32_t         offset         = 0;
             uint32_t         range          = 0;
             VkDescriptorType eType          = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+            bool             bUsed          = false; /* Since the last Reset() */
 
             DescriptorBufferInfo( );
             DescriptorBufferInfo( VkDescriptorSet pDescriptorSet, VkBuffer pBuffer, uint32_t offset, uint32_t range, VkDescriptorType eType );
         };
 
-        VkDevice                            pLogicalDevice       = VK_NULL_HANDLE;
-        VkDescriptorPool                    pDescriptorPool      = VK_NULL_HANDLE;
-        VkDescriptorSetLayout               pDescriptorSetLayout = VK_NULL_HANDLE;
-        std::vector< DescriptorBufferInfo > BufferSets;
+        VkDevice                                 pLogicalDevice       = VK_NULL_HANDLE;
+        VkDescriptorPool                         pDescriptorPool      = VK_NULL_HANDLE;
+        VkDescriptorSetLayout                    pDescriptorSetLayout = VK_NULL_HANDLE;
+        std::vector< DescriptorBufferInfo >      BufferSets;
+        std::unordered_map< uint64_t, uint32_t > BufferSetLookup; /* Key hash to the BufferSets index */
+        std::vector< VkDescriptorSet >           FreeSets;        /* Evicted, rewritten on misses */
+        std::vector< VkDescriptorSet >           RetiredSets;     /* Replaced on collisions while used, freed in Reset() */
+        DescriptorSetPoolStats                   Stats;
+        PFN_vkAllocateDescriptorSets             pfnAllocateDescriptorSets = vkAllocateDescriptorSets;
+        PFN_vkUpdateDescriptorSets               pfnUpdateDescriptorSets   = vkUpdateDescriptorSets;
 
         bool            Recreate( VkDevice pInLogicalDevice, VkDescriptorPool pInDescPool, VkDescriptorSetLayout pInLayout );
         VkDescriptorSet GetDescSet( const VkDescriptorBufferInfo& InDescriptorBufferInfo, VkDescriptorType eInType );
+
+        /**
+         * Evicts the sets that were not used since the previous call, and resets the counters.
+         * The sets of this pool must not be in use by the device (call it when the frame is reset).
+         **/
+        void Reset( );
     };
-}
\ No newline at end of file
+
+    /**
+     * Checks the hits, misses, evictions and collisions of the DescriptorSetPool with the mocked allocation and update functions.
+     * Does not require a device, returns false on the first failed check (it is traced).
+     **/
+    bool TestDescriptorSetPool( );
+}
@@ -3,6 +3,7 @@
 #include <GraphicsManager.Vulkan.h>
 
 #include <QueuePools.Vulkan.h>
+#include <MemoryAllocator.Vulkan.h>
 #include <ShaderCompiler.Vulkan.h>
 
 #include <GraphicsManager.KnownExtensions.Vulkan.h>
@@ -240,6 +241,8 @@ bool apemodevk::GraphicsDevice::RecreateResourcesFor( VkPhysicalDevice InAdapter
                                                          QueueProps.data( ),
                                                          QueueProps.data( ) + QueueProps.size( ) ) );
 
+            pMemoryAllocator.reset( new MemoryAllocator( hLogicalDevice, AdapterProps, MemoryProps ) );
+
             return bOk;
         }
     }
@@ -303,6 +306,14 @@ const apemodevk::CommandBufferPool* apemodevk::GraphicsDevice::GetCommandBufferP
     return pCmdBufferPool.get( );
 }
 
+apemodevk::MemoryAllocator* apemodevk::GraphicsDevice::GetMemoryAllocator( ) {
+    return pMemoryAllocator.get( );
+}
+
+const apemodevk::MemoryAllocator* apemodevk::GraphicsDevice::GetMemoryAllocator( ) const {
+    return pMemoryAllocator.get( );
+}
+
 apemodevk::GraphicsManager& apemodevk::GraphicsDevice::GetGraphicsManager( ) {
     return *pManager;
 }
@@ -9,6 +9,7 @@ namespace apemodevk {
 
     class QueuePool;
     class CommandBufferPool;
+    class MemoryAllocator;
     class ShaderCompiler;
 
     class GraphicsDevice : public apemodevk::NoCopyAssignPolicy {
@@ -38,6 +39,8 @@ namespace apemodevk {
         const QueuePool *        GetQueuePool( ) const;
         CommandBufferPool *      GetCommandBufferPool( );
         const CommandBufferPool *GetCommandBufferPool( ) const;
+        MemoryAllocator *        GetMemoryAllocator( );
+        const MemoryAllocator *  GetMemoryAllocator( ) const;
         GraphicsManager &        GetGraphicsManager( );
         const GraphicsManager &  GetGraphicsManager( ) const;
 
@@ -65,5 +68,6 @@ namespace apemodevk {
         std::vector< VkExtensionProperties > DeviceExtensionProps;
         std::unique_ptr< QueuePool >         pQueuePool;
         std::unique_ptr< CommandBufferPool > pCmdBufferPool;
+        std::unique_ptr< MemoryAllocator >   pMemoryAllocator;
     };
 }
\ No newline at end of file
@@ -0,0 +1,361 @@
+#include "MemoryAllocator.Vulkan.h"
+
+namespace {
+    uint32_t CeilLog2( VkDeviceSize value ) {
+        uint32_t order = 0;
+        while ( ( VkDeviceSize( 1 ) << order ) < value ) {
+            ++order;
+        }
+
+        return order;
+    }
+
+    uint32_t FloorLog2( VkDeviceSize value ) {
+        uint32_t order = 0;
+        while ( ( VkDeviceSize( 2 ) << order ) <= value ) {
+            ++order;
+        }
+
+        return order;
+    }
+}
+
+float apemodevk::MemoryAllocator::Stats::GetUtilization( ) const {
+    return BlockSize ? float( double( RequestedSize ) / double( BlockSize ) ) : 0.0f;
+}
+
+float apemodevk::MemoryAllocator::Stats::GetFragmentation( ) const {
+    const VkDeviceSize freeSize = BlockSize - UsedSize;
+    return freeSize ? float( 1.0 - double( LargestFreeSize ) / double( freeSize ) ) : 0.0f;
+}
+
+apemodevk::MemoryAllocator::MemoryAllocator( VkDevice                                pInDevice,
+                                             VkPhysicalDeviceProperties const&       adapterProps,
+                                             VkPhysicalDeviceMemoryProperties const& memoryProps )
+    : pDevice( pInDevice )
+    , NonCoherentAtomSize( adapterProps.limits.nonCoherentAtomSize ? adapterProps.limits.nonCoherentAtomSize : 1 )
+    , MemoryProps( memoryProps ) {
+
+    /* Small heaps (like the host visible device local heap) get smaller blocks. */
+    for ( uint32_t i = 0; i < MemoryProps.memoryTypeCount; ++i ) {
+        const VkDeviceSize heapSize   = MemoryProps.memoryHeaps[ MemoryProps.memoryTypes[ i ].heapIndex ].size;
+        const VkDeviceSize blockSize  = heapSize / kHeapSizeFraction > kMinBlockSize ? heapSize / kHeapSizeFraction : kMinBlockSize;
+        const uint32_t     blockOrder = FloorLog2( blockSize );
+
+        for ( auto& pool : Pools[ i ] ) {
+            pool.BlockOrder = blockOrder < kMaxOrder ? blockOrder : kMaxOrder;
+        }
+    }
+}
+
+apemodevk::MemoryAllocator::~MemoryAllocator( ) {
+    for ( auto& memoryTypePools : Pools ) {
+        for ( auto& pool : memoryTypePools ) {
+            for ( auto& block : pool.Blocks ) {
+                FreeBlock( block );
+            }
+        }
+    }
+}
+
+uint32_t apemodevk::MemoryAllocator::FindMemoryType( uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryPropertyFlags ) const {
+    for ( uint32_t i = 0; i < MemoryProps.memoryTypeCount; ++i ) {
+        if ( ( memoryTypeBits & ( 1 << i ) ) &&
+             ( MemoryProps.memoryTypes[ i ].propertyFlags & memoryPropertyFlags ) == memoryPropertyFlags ) {
+            return i;
+        }
+    }
+
+    return uint32_t( -1 );
+}
+
+bool apemodevk::MemoryAllocator::AllocateBlock( uint32_t memoryTypeIndex, VkDeviceSize size, uint32_t order, Block& block ) {
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    InitializeStruct( memoryAllocateInfo );
+    memoryAllocateInfo.allocationSize  = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    if ( VK_SUCCESS != CheckedCall( vkAllocateMemory( pDevice, &memoryAllocateInfo, nullptr, &block.hMemory ) ) ) {
+        block.hMemory = VK_NULL_HANDLE;
+        return false;
+    }
+
+    /* Only one mapping per memory object is allowed, so the whole block is mapped once. */
+    if ( MemoryProps.memoryTypes[ memoryTypeIndex ].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) {
+        if ( VK_SUCCESS != CheckedCall( vkMapMemory( pDevice, block.hMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast< void** >( &block.pMapped ) ) ) ) {
+            FreeBlock( block );
+            return false;
+        }
+    }
+
+    block.Size  = size;
+    block.Order = order;
+
+    if ( order ) {
+        block.FreeLists.resize( order - kMinOrder + 1 );
+        block.FreeLists.back( ).push_back( 0 );
+    }
+
+    return true;
+}
+
+void apemodevk::MemoryAllocator::FreeBlock( Block& block ) {
+    if ( VK_NULL_HANDLE != block.hMemory ) {
+        if ( nullptr != block.pMapped ) {
+            vkUnmapMemory( pDevice, block.hMemory );
+        }
+
+        vkFreeMemory( pDevice, block.hMemory, nullptr );
+    }
+
+    block = Block( );
+}
+
+bool apemodevk::MemoryAllocator::AllocateInBlock( Block& block, uint32_t order, VkDeviceSize& offset ) {
+    /* Find the smallest free range that fits. */
+    uint32_t freeOrder = order;
+    while ( freeOrder <= block.Order && block.FreeLists[ freeOrder - kMinOrder ].empty( ) ) {
+        ++freeOrder;
+    }
+
+    if ( freeOrder > block.Order ) {
+        return false;
+    }
+
+    offset = block.FreeLists[ freeOrder - kMinOrder ].back( );
+    block.FreeLists[ freeOrder - kMinOrder ].pop_back( );
+
+    /* Split it, the upper halves become free. */
+    while ( freeOrder > order ) {
+        --freeOrder;
+        block.FreeLists[ freeOrder - kMinOrder ].push_back( offset + ( VkDeviceSize( 1 ) << freeOrder ) );
+    }
+
+    return true;
+}
+
+void apemodevk::MemoryAllocator::FreeInBlock( Block& block, uint32_t order, VkDeviceSize offset ) {
+    /* Merge with the free buddies. */
+    while ( order < block.Order ) {
+        auto& freeList = block.FreeLists[ order - kMinOrder ];
+
+        const VkDeviceSize buddyOffset = offset ^ ( VkDeviceSize( 1 ) << order );
+        auto               buddyIt     = std::find( freeList.begin( ), freeList.end( ), buddyOffset );
+        if ( buddyIt == freeList.end( ) ) {
+            break;
+        }
+
+        *buddyIt = freeList.back( );
+        freeList.pop_back( );
+
+        offset = std::min( offset, buddyOffset );
+        ++order;
+    }
+
+    block.FreeLists[ order - kMinOrder ].push_back( offset );
+}
+
+bool apemodevk::MemoryAllocator::Allocate( VkMemoryRequirements const& memoryRequirements,
+                                           VkMemoryPropertyFlags       memoryPropertyFlags,
+                                           bool                        bOptimal,
+                                           MemoryAllocation&           allocation ) {
+    allocation = MemoryAllocation( );
+
+    const uint32_t memoryTypeIndex = FindMemoryType( memoryRequirements.memoryTypeBits, memoryPropertyFlags );
+    if ( uint32_t( -1 ) == memoryTypeIndex ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    std::lock_guard< std::mutex > guard( Lock );
+    Pool& pool = Pools[ memoryTypeIndex ][ bOptimal ];
+
+    /* Buddy ranges are aligned to their sizes. */
+    const uint32_t sizeOrder = CeilLog2( std::max( memoryRequirements.size, memoryRequirements.alignment ) );
+    const uint32_t order     = sizeOrder > kMinOrder ? sizeOrder : kMinOrder;
+
+    /* Reuse the slots of the freed blocks. */
+    auto findFreeBlockSlot = [&]( ) {
+        auto blockIt = std::find_if( pool.Blocks.begin( ), pool.Blocks.end( ), []( Block const& block ) {
+            return VK_NULL_HANDLE == block.hMemory;
+        } );
+
+        if ( blockIt == pool.Blocks.end( ) ) {
+            pool.Blocks.emplace_back( );
+            return uint32_t( pool.Blocks.size( ) - 1 );
+        }
+
+        return uint32_t( std::distance( pool.Blocks.begin( ), blockIt ) );
+    };
+
+    uint32_t     blockId         = uint32_t( -1 );
+    uint32_t     allocationOrder = 0;
+    VkDeviceSize offset          = 0;
+
+    if ( order > pool.BlockOrder ) {
+        /* Does not fit into the block, allocate the dedicated one. */
+        blockId = findFreeBlockSlot( );
+        if ( false == AllocateBlock( memoryTypeIndex, memoryRequirements.size, 0, pool.Blocks[ blockId ] ) ) {
+            apemodevk::platform::DebugBreak( );
+            return false;
+        }
+
+        pool.Blocks[ blockId ].UsedSize = memoryRequirements.size;
+    } else {
+        for ( uint32_t i = 0; i < pool.Blocks.size( ); ++i ) {
+            if ( pool.Blocks[ i ].Order && AllocateInBlock( pool.Blocks[ i ], order, offset ) ) {
+                blockId = i;
+                break;
+            }
+        }
+
+        if ( uint32_t( -1 ) == blockId ) {
+            blockId = findFreeBlockSlot( );
+            if ( false == AllocateBlock( memoryTypeIndex, VkDeviceSize( 1 ) << pool.BlockOrder, pool.BlockOrder, pool.Blocks[ blockId ] ) ||
+                 false == AllocateInBlock( pool.Blocks[ blockId ], order, offset ) ) {
+                apemodevk::platform::DebugBreak( );
+                return false;
+            }
+        }
+
+        allocationOrder = order;
+        pool.Blocks[ blockId ].UsedSize += VkDeviceSize( 1 ) << order;
+    }
+
+    Block& block = pool.Blocks[ blockId ];
+    block.RequestedSize += memoryRequirements.size;
+    ++block.AllocationCount;
+
+    allocation.hMemory         = block.hMemory;
+    allocation.Offset          = offset;
+    allocation.Size            = memoryRequirements.size;
+    allocation.pMapped         = block.pMapped ? block.pMapped + offset : nullptr;
+    allocation.MemoryTypeIndex = memoryTypeIndex;
+    allocation.BlockId         = blockId;
+    allocation.Order           = allocationOrder;
+    allocation.bOptimal        = bOptimal;
+    return true;
+}
+
+bool apemodevk::MemoryAllocator::AllocateAndBind( VkBuffer hBuffer, VkMemoryPropertyFlags memoryPropertyFlags, MemoryAllocation& allocation ) {
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements( pDevice, hBuffer, &memoryRequirements );
+
+    if ( false == Allocate( memoryRequirements, memoryPropertyFlags, false, allocation ) ) {
+        return false;
+    }
+
+    if ( VK_SUCCESS != CheckedCall( vkBindBufferMemory( pDevice, hBuffer, allocation.hMemory, allocation.Offset ) ) ) {
+        Free( allocation );
+        return false;
+    }
+
+    return true;
+}
+
+bool apemodevk::MemoryAllocator::AllocateAndBind( VkImage               hImage,
+                                                  VkImageTiling         eTiling,
+                                                  VkMemoryPropertyFlags memoryPropertyFlags,
+                                                  MemoryAllocation&     allocation ) {
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements( pDevice, hImage, &memoryRequirements );
+
+    if ( false == Allocate( memoryRequirements, memoryPropertyFlags, VK_IMAGE_TILING_OPTIMAL == eTiling, allocation ) ) {
+        return false;
+    }
+
+    if ( VK_SUCCESS != CheckedCall( vkBindImageMemory( pDevice, hImage, allocation.hMemory, allocation.Offset ) ) ) {
+        Free( allocation );
+        return false;
+    }
+
+    return true;
+}
+
+void apemodevk::MemoryAllocator::Free( MemoryAllocation& allocation ) {
+    if ( allocation.IsNull( ) ) {
+        return;
+    }
+
+    std::lock_guard< std::mutex > guard( Lock );
+    Pool&  pool  = Pools[ allocation.MemoryTypeIndex ][ allocation.bOptimal ];
+    Block& block = pool.Blocks[ allocation.BlockId ];
+    assert( block.hMemory == allocation.hMemory );
+
+    if ( 0 == allocation.Order ) {
+        FreeBlock( block );
+    } else {
+        FreeInBlock( block, allocation.Order, allocation.Offset );
+        block.UsedSize -= VkDeviceSize( 1 ) << allocation.Order;
+        block.RequestedSize -= allocation.Size;
+        --block.AllocationCount;
+
+        /* Keep one empty block to avoid allocating it again right away. */
+        if ( 0 == block.AllocationCount ) {
+            const auto blockCount = std::count_if( pool.Blocks.begin( ), pool.Blocks.end( ), []( Block const& poolBlock ) {
+                return 0 != poolBlock.Order;
+            } );
+
+            if ( blockCount > 1 ) {
+                FreeBlock( block );
+            }
+        }
+    }
+
+    allocation = MemoryAllocation( );
+}
+
+bool apemodevk::MemoryAllocator::Flush( MemoryAllocation const& allocation ) {
+    if ( allocation.IsNull( ) || nullptr == allocation.pMapped ||
+         ( MemoryProps.memoryTypes[ allocation.MemoryTypeIndex ].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) ) {
+        return true;
+    }
+
+    VkDeviceSize blockSize = 0;
+    {
+        std::lock_guard< std::mutex > guard( Lock );
+        blockSize = Pools[ allocation.MemoryTypeIndex ][ allocation.bOptimal ].Blocks[ allocation.BlockId ].Size;
+    }
+
+    /* The range must be aligned to nonCoherentAtomSize (or end at the end of the block). */
+    const VkDeviceSize rangeStart = allocation.Offset / NonCoherentAtomSize * NonCoherentAtomSize;
+    const VkDeviceSize rangeEnd   = ( allocation.Offset + allocation.Size + NonCoherentAtomSize - 1 ) / NonCoherentAtomSize * NonCoherentAtomSize;
+
+    VkMappedMemoryRange range;
+    InitializeStruct( range );
+    range.memory = allocation.hMemory;
+    range.offset = rangeStart;
+    range.size   = rangeEnd < blockSize ? rangeEnd - rangeStart : VK_WHOLE_SIZE;
+
+    return VK_SUCCESS == CheckedCall( vkFlushMappedMemoryRanges( pDevice, 1, &range ) );
+}
+
+void apemodevk::MemoryAllocator::GetStats( Stats& stats ) const {
+    stats = Stats( );
+
+    std::lock_guard< std::mutex > guard( Lock );
+    for ( auto& memoryTypePools : Pools ) {
+        for ( auto& pool : memoryTypePools ) {
+            for ( auto& block : pool.Blocks ) {
+                if ( VK_NULL_HANDLE == block.hMemory ) {
+                    continue;
+                }
+
+                ++stats.BlockCount;
+                stats.DedicatedBlockCount += 0 == block.Order;
+                stats.AllocationCount += block.AllocationCount;
+                stats.BlockSize += block.Size;
+                stats.UsedSize += block.UsedSize;
+                stats.RequestedSize += block.RequestedSize;
+
+                /* The largest order with free ranges (dedicated blocks have none). */
+                for ( uint32_t order = block.Order; block.Order && order >= kMinOrder; --order ) {
+                    if ( false == block.FreeLists[ order - kMinOrder ].empty( ) ) {
+                        stats.LargestFreeSize = std::max( stats.LargestFreeSize, VkDeviceSize( 1 ) << order );
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
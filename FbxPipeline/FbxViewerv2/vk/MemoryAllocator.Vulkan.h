@@ -0,0 +1,109 @@
+#pragma once
+
+#include <GraphicsDevice.Vulkan.h>
+#include <mutex>
+
+namespace apemodevk {
+
+    class GraphicsDevice;
+
+    /* Placed sub-range of the device memory block. */
+    struct MemoryAllocation {
+        VkDeviceMemory hMemory         = VK_NULL_HANDLE; /* Block memory handle */
+        VkDeviceSize   Offset          = 0;              /* Offset in block memory, aligned */
+        VkDeviceSize   Size            = 0;              /* Requested size */
+        uint8_t*       pMapped         = nullptr;        /* Points at Offset, null if the memory is not host visible */
+        uint32_t       MemoryTypeIndex = 0;
+        uint32_t       BlockId         = 0;
+        uint32_t       Order           = 0; /* Buddy order (log2 of the allocated size), 0 for dedicated blocks */
+        uint32_t       bOptimal        = 0; /* Optimal tiling image */
+
+        bool IsNull( ) const {
+            return VK_NULL_HANDLE == hMemory;
+        }
+    };
+
+    /**
+     * Sub-allocates device memory from large blocks (one vkAllocateMemory call per block).
+     * Each memory type has its own pools of blocks, each block is managed by buddy allocator,
+     * so the sub-ranges are aligned to their (power of two) sizes, that covers the alignment requirements.
+     * Buffers (and linear images) and optimal images never share blocks, so bufferImageGranularity is always respected.
+     * Requests that exceed the block size get dedicated blocks.
+     * Host visible blocks are persistently mapped.
+     * MemoryAllocator is created by device. Thread-safe.
+     **/
+    class MemoryAllocator {
+    public:
+        static const uint32_t     kMinOrder         = 8;  /* 256 bytes */
+        static const uint32_t     kMaxOrder         = 26; /* 64 MB */
+        static const VkDeviceSize kMinBlockSize     = VkDeviceSize( 1 ) << 20;
+        static const uint32_t     kHeapSizeFraction = 8; /* Block size limit for small heaps */
+
+        struct Stats {
+            uint32_t     BlockCount          = 0;
+            uint32_t     DedicatedBlockCount = 0;
+            uint32_t     AllocationCount     = 0;
+            VkDeviceSize BlockSize           = 0; /* Allocated device memory */
+            VkDeviceSize UsedSize            = 0; /* Allocated sub-ranges (rounded to power of two) */
+            VkDeviceSize RequestedSize       = 0; /* Requested sizes */
+            VkDeviceSize LargestFreeSize     = 0; /* Largest free sub-range */
+
+            float GetUtilization( ) const;  /* Requested size / block size */
+            float GetFragmentation( ) const; /* 1 - largest free sub-range / total free size */
+        };
+
+        ~MemoryAllocator( );
+
+        /**
+         * @param bOptimal Optimal tiling image (buffers and linear images go to the separate blocks).
+         * @note The allocation must be released, @see Free().
+         **/
+        bool Allocate( VkMemoryRequirements const& memoryRequirements,
+                       VkMemoryPropertyFlags       memoryPropertyFlags,
+                       bool                        bOptimal,
+                       MemoryAllocation&           allocation );
+
+        bool AllocateAndBind( VkBuffer hBuffer, VkMemoryPropertyFlags memoryPropertyFlags, MemoryAllocation& allocation );
+        bool AllocateAndBind( VkImage hImage, VkImageTiling eTiling, VkMemoryPropertyFlags memoryPropertyFlags, MemoryAllocation& allocation );
+
+        /* Null allocations are ignored, the allocation is reset. */
+        void Free( MemoryAllocation& allocation );
+
+        /* Flushes the mapped range if the memory is not host coherent. */
+        bool Flush( MemoryAllocation const& allocation );
+
+        void GetStats( Stats& stats ) const;
+
+    private:
+        friend class GraphicsDevice;
+        MemoryAllocator( VkDevice pInDevice, VkPhysicalDeviceProperties const& adapterProps, VkPhysicalDeviceMemoryProperties const& memoryProps );
+
+        struct Block {
+            VkDeviceMemory                             hMemory         = VK_NULL_HANDLE;
+            uint8_t*                                   pMapped         = nullptr;
+            VkDeviceSize                               Size            = 0;
+            VkDeviceSize                               UsedSize        = 0;
+            VkDeviceSize                               RequestedSize   = 0;
+            uint32_t                                   AllocationCount = 0;
+            uint32_t                                   Order           = 0; /* 0 for dedicated blocks */
+            std::vector< std::vector< VkDeviceSize > > FreeLists;           /* Free offsets per order */
+        };
+
+        struct Pool {
+            std::vector< Block > Blocks;
+            uint32_t             BlockOrder = 0;
+        };
+
+        uint32_t FindMemoryType( uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryPropertyFlags ) const;
+        bool     AllocateBlock( uint32_t memoryTypeIndex, VkDeviceSize size, uint32_t order, Block& block );
+        void     FreeBlock( Block& block );
+        bool     AllocateInBlock( Block& block, uint32_t order, VkDeviceSize& offset );
+        void     FreeInBlock( Block& block, uint32_t order, VkDeviceSize offset );
+
+        VkDevice                         pDevice = VK_NULL_HANDLE;
+        VkDeviceSize                     NonCoherentAtomSize = 1;
+        VkPhysicalDeviceMemoryProperties MemoryProps;
+        Pool                             Pools[ VK_MAX_MEMORY_TYPES ][ 2 ]; /* Linear and optimal */
+        mutable std::mutex               Lock;
+    };
+}
@@ -0,0 +1,334 @@
+#include "UploadQueue.Vulkan.h"
+
+apemodevk::UploadQueue::~UploadQueue( ) {
+    Destroy( );
+}
+
+bool apemodevk::UploadQueue::Recreate( GraphicsDevice* pInNode, uint32_t renderQueueFamilyId, uint32_t ringSize, uint32_t maxBatchCount ) {
+    Destroy( );
+
+    if ( nullptr == pInNode || 0 == ringSize || 0 == maxBatchCount ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    /* Prefer the dedicated transfer queue family (exact match is checked first),
+     * the render family is the one the acquire barriers are recorded on. */
+    auto pQueuePool         = pInNode->GetQueuePool( );
+    auto pTransferQueuePool = pQueuePool->GetPool( VK_QUEUE_TRANSFER_BIT, false );
+    auto pRenderQueuePool   = pQueuePool->GetPool( renderQueueFamilyId );
+    if ( nullptr == pTransferQueuePool || nullptr == pRenderQueuePool ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    pNode               = pInNode;
+    QueueFamilyIds[ 0 ] = pTransferQueuePool->queueFamilyId;
+    QueueFamilyIds[ 1 ] = pRenderQueuePool->queueFamilyId;
+    MaxBatchCount       = maxBatchCount < kMaxBatchCount ? maxBatchCount : kMaxBatchCount;
+    RingSize            = ( ringSize + kAlignment - 1 ) / kAlignment * kAlignment;
+    MaxBatchSize        = RingSize / MaxBatchCount / kAlignment * kAlignment;
+
+    /* Each batch should be able to copy at least something. */
+    if ( 0 == MaxBatchSize ) {
+        MaxBatchSize = kAlignment;
+    }
+
+    VkBufferCreateInfo bufferCreateInfo;
+    InitializeStruct( bufferCreateInfo );
+    bufferCreateInfo.size  = RingSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    if ( false == hRingBuffer.Recreate( *pNode, *pNode, bufferCreateInfo ) ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    /* Coherent memory, no need to flush the ranges before submissions. */
+    auto memoryAllocateInfo = hRingBuffer.GetMemoryAllocateInfo( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+    if ( false == hRingMemory.Recreate( *pNode, memoryAllocateInfo ) ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    if ( false == hRingBuffer.BindMemory( hRingMemory, 0 ) ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    /* Stays mapped until destroyed. */
+    pMapped = hRingMemory.Map( 0, RingSize, 0 );
+    if ( nullptr == pMapped ) {
+        apemodevk::platform::DebugBreak( );
+        return false;
+    }
+
+    VkFenceCreateInfo fenceCreateInfo;
+    InitializeStruct( fenceCreateInfo );
+
+    for ( uint32_t i = 0; i < MaxBatchCount; ++i ) {
+        if ( false == Batches[ i ].hFence.Recreate( *pNode, fenceCreateInfo ) ) {
+            apemodevk::platform::DebugBreak( );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void apemodevk::UploadQueue::Destroy( ) {
+    for ( ; BatchCount; --BatchCount ) {
+        Batches[ BatchHead ].hFence.Wait( );
+        BatchHead = ( BatchHead + 1 ) % MaxBatchCount;
+    }
+
+    for ( auto& batch : Batches ) {
+        batch.hFence.Destroy( );
+    }
+
+    if ( nullptr != pMapped ) {
+        hRingMemory.Unmap( );
+        pMapped = nullptr;
+    }
+
+    hRingBuffer.Destroy( );
+    hRingMemory.Destroy( );
+    Requests.clear( );
+    AcquireBarriers.clear( );
+
+    pNode      = nullptr;
+    RingHead   = 0;
+    RingTail   = 0;
+    StreamHead = 0;
+    BatchHead  = 0;
+    Statistics = Stats( );
+}
+
+uint64_t apemodevk::UploadQueue::Enqueue( const void* pSrc, VkDeviceSize size, VkBuffer hDstBuffer, VkDeviceSize dstOffset ) {
+    if ( 0 != size ) {
+        Request request;
+        request.pSrc       = reinterpret_cast< const uint8_t* >( pSrc );
+        request.Size       = size;
+        request.hDstBuffer = hDstBuffer;
+        request.DstOffset  = dstOffset;
+
+        Requests.push_back( request );
+        Statistics.EnqueuedBytes += size;
+    }
+
+    return Statistics.EnqueuedBytes;
+}
+
+uint32_t apemodevk::UploadQueue::AllocateRingSpace( VkDeviceSize size, uint64_t batchRingStart, uint32_t& offset ) {
+    /* The chunk is limited by the free space, the end of the ring (no wrapping) and the batch size. */
+    const uint64_t freeSize       = RingSize - ( RingHead - RingTail );
+    const uint64_t contiguousSize = RingSize - RingHead % RingSize;
+    const uint64_t batchSize      = MaxBatchSize - ( RingHead - batchRingStart );
+
+    const uint32_t chunkSize = (uint32_t) std::min( std::min( size, freeSize ), std::min( contiguousSize, batchSize ) );
+    if ( 0 != chunkSize ) {
+        /* Free and contiguous sizes are aligned, so the aligned chunk still fits. */
+        offset = uint32_t( RingHead % RingSize );
+        RingHead += ( chunkSize + kAlignment - 1 ) / kAlignment * kAlignment;
+    }
+
+    return chunkSize;
+}
+
+bool apemodevk::UploadQueue::SubmitBatch( ) {
+    if ( Requests.empty( ) || BatchCount == MaxBatchCount || RingHead - RingTail == RingSize ) {
+        return false;
+    }
+
+    /* The batches are tracked with their own fences, ignore the one of the queue. */
+    auto pQueuePool    = pNode->GetQueuePool( );
+    auto acquiredQueue = pQueuePool->Acquire( true, QueueFamilyIds[ 0 ] );
+    if ( VK_NULL_HANDLE == acquiredQueue.pQueue ) {
+        /* Used by the other thread, try on the next update. */
+        return false;
+    }
+
+    auto pCmdBufferPool    = pNode->GetCommandBufferPool( );
+    auto acquiredCmdBuffer = pCmdBufferPool->Acquire( false, QueueFamilyIds[ 0 ] );
+
+    if ( VK_SUCCESS != vkResetCommandPool( *pNode, acquiredCmdBuffer.pCmdPool, 0 ) ) {
+        apemodevk::platform::DebugBreak( );
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    InitializeStruct( commandBufferBeginInfo );
+    commandBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if ( VK_SUCCESS != vkBeginCommandBuffer( acquiredCmdBuffer.pCmdBuffer, &commandBufferBeginInfo ) ) {
+        apemodevk::platform::DebugBreak( );
+    }
+
+    auto& batch = Batches[ ( BatchHead + BatchCount ) % MaxBatchCount ];
+    batch.Barriers.clear( );
+
+    /* The ownership is transferred only if the families differ, the memory barrier is recorded anyway. */
+    const bool     bTransferOwnership = QueueFamilyIds[ 0 ] != QueueFamilyIds[ 1 ];
+    const uint64_t batchRingStart     = RingHead;
+
+    while ( false == Requests.empty( ) ) {
+        auto& request = Requests.front( );
+
+        uint32_t       offset    = 0;
+        const uint32_t chunkSize = AllocateRingSpace( request.Size - request.CopiedSize, batchRingStart, offset );
+        if ( 0 == chunkSize ) {
+            break;
+        }
+
+        memcpy( pMapped + offset, request.pSrc + request.CopiedSize, chunkSize );
+
+        VkBufferCopy bufferCopy;
+        InitializeStruct( bufferCopy );
+        bufferCopy.srcOffset = offset;
+        bufferCopy.dstOffset = request.DstOffset + request.CopiedSize;
+        bufferCopy.size      = chunkSize;
+
+        vkCmdCopyBuffer( acquiredCmdBuffer.pCmdBuffer, /* Cmd */
+                         hRingBuffer,                  /* Src */
+                         request.hDstBuffer,           /* Dst */
+                         1,
+                         &bufferCopy );
+
+        auto& barriers = batch.Barriers;
+        if ( false == barriers.empty( ) && barriers.back( ).buffer == request.hDstBuffer &&
+             barriers.back( ).offset + barriers.back( ).size == bufferCopy.dstOffset ) {
+            barriers.back( ).size += chunkSize;
+        } else {
+            VkBufferMemoryBarrier barrier;
+            InitializeStruct( barrier );
+            barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask       = 0; /* Ignored for the release */
+            barrier.srcQueueFamilyIndex = bTransferOwnership ? QueueFamilyIds[ 0 ] : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = bTransferOwnership ? QueueFamilyIds[ 1 ] : VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer              = request.hDstBuffer;
+            barrier.offset              = bufferCopy.dstOffset;
+            barrier.size                = chunkSize;
+            barriers.push_back( barrier );
+        }
+
+        ++Statistics.CopyCount;
+        StreamHead += chunkSize;
+        request.CopiedSize += chunkSize;
+
+        if ( request.CopiedSize == request.Size ) {
+            Requests.pop_front( );
+        }
+    }
+
+    /* Release the copied ranges, the render queue acquires them once the fence is signalled. */
+    vkCmdPipelineBarrier( acquiredCmdBuffer.pCmdBuffer,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          0,
+                          0,
+                          nullptr,
+                          (uint32_t) batch.Barriers.size( ),
+                          batch.Barriers.data( ),
+                          0,
+                          nullptr );
+
+    vkEndCommandBuffer( acquiredCmdBuffer.pCmdBuffer );
+
+    batch.RingEnd   = RingHead;
+    batch.StreamEnd = StreamHead;
+
+    VkSubmitInfo submitInfo;
+    InitializeStruct( submitInfo );
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &acquiredCmdBuffer.pCmdBuffer;
+
+    vkResetFences( *pNode, 1, batch.hFence );
+    if ( VK_SUCCESS != vkQueueSubmit( acquiredQueue.pQueue, 1, &submitInfo, batch.hFence ) ) {
+        apemodevk::platform::DebugBreak( );
+    }
+
+    /* The command buffer is not reused until the fence is signalled. */
+    acquiredCmdBuffer.pFence = batch.hFence;
+    pCmdBufferPool->Release( acquiredCmdBuffer );
+    pQueuePool->Release( acquiredQueue );
+
+    ++BatchCount;
+    ++Statistics.BatchCount;
+    return true;
+}
+
+void apemodevk::UploadQueue::Update( ) {
+    if ( nullptr == pNode ) {
+        return;
+    }
+
+    /* Retire in submission order, the ring space is freed in the same order. */
+    while ( BatchCount && Batches[ BatchHead ].hFence.IsSignalled( ) ) {
+        RingTail                  = Batches[ BatchHead ].RingEnd;
+        Statistics.CompletedBytes = Batches[ BatchHead ].StreamEnd;
+
+        auto& barriers = Batches[ BatchHead ].Barriers;
+        AcquireBarriers.insert( AcquireBarriers.end( ), barriers.begin( ), barriers.end( ) );
+        barriers.clear( );
+
+        BatchHead = ( BatchHead + 1 ) % MaxBatchCount;
+        --BatchCount;
+    }
+
+    while ( SubmitBatch( ) ) {
+    }
+}
+
+void apemodevk::UploadQueue::Flush( ) {
+    Update( );
+
+    /* Copied only, the ranges still need to be acquired, @see RecordAcquireBarriers(). */
+    while ( false == Requests.empty( ) || BatchCount ) {
+        if ( BatchCount ) {
+            Batches[ BatchHead ].hFence.Wait( );
+        }
+
+        Update( );
+    }
+}
+
+void apemodevk::UploadQueue::RecordAcquireBarriers( VkCommandBuffer pCmdBuffer ) {
+    if ( false == AcquireBarriers.empty( ) ) {
+        /* The same ranges and families as released, the writes are made visible to the vertex input.
+         * Without the ownership transfer, this is a plain memory barrier for the transfer writes. */
+        for ( auto& barrier : AcquireBarriers ) {
+            const bool bTransferOwnership = VK_QUEUE_FAMILY_IGNORED != barrier.srcQueueFamilyIndex;
+            barrier.srcAccessMask         = bTransferOwnership ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask         = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        }
+
+        vkCmdPipelineBarrier( pCmdBuffer,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                              0,
+                              0,
+                              nullptr,
+                              (uint32_t) AcquireBarriers.size( ),
+                              AcquireBarriers.data( ),
+                              0,
+                              nullptr );
+
+        AcquireBarriers.clear( );
+    }
+
+    Statistics.AcquiredBytes = Statistics.CompletedBytes;
+}
+
+bool apemodevk::UploadQueue::IsCompleted( uint64_t ticket ) const {
+    return ticket <= Statistics.AcquiredBytes;
+}
+
+bool apemodevk::UploadQueue::IsIdle( ) const {
+    return Requests.empty( ) && 0 == BatchCount && Statistics.AcquiredBytes == Statistics.EnqueuedBytes;
+}
+
+const apemodevk::UploadQueue::Stats& apemodevk::UploadQueue::GetStats( ) const {
+    return Statistics;
+}
+
+uint32_t apemodevk::UploadQueue::GetRenderQueueFamilyId( ) const {
+    return QueueFamilyIds[ 1 ];
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <GraphicsDevice.Vulkan.h>
+#include <QueuePools.Vulkan.h>
+#include <deque>
+
+namespace apemodevk {
+
+    /**
+     * Uploads buffer data asynchronously through a fixed-size staging ring buffer.
+     * The copies are recorded in batches and submitted to a transfer-capable queue from QueuePool,
+     * each batch is tracked with its own fence, its ring space is reused once the fence is signalled.
+     * The data that does not fit into the free ring space is split into chunks and uploaded over several batches.
+     * Enqueue() returns a ticket (the position of the end of the data in the upload stream),
+     * the destination range can be used once the ticket is completed, @see IsCompleted().
+     * The destination buffers are exclusive, the copied ranges are released by the transfer queue family
+     * after the copies, and acquired by the render queue family (@see Recreate()) once the batch is retired (@see RecordAcquireBarriers()).
+     * Does not require a swapchain. Not thread-safe.
+     **/
+    class UploadQueue {
+    public:
+        static const uint32_t kAlignment            = 16;
+        static const uint32_t kMaxBatchCount        = 8;
+        static const uint32_t kDefaultRingSize      = 16 * 1024 * 1024;
+        static const uint32_t kDefaultMaxBatchCount = 4;
+
+        struct Stats {
+            uint64_t EnqueuedBytes  = 0;
+            uint64_t CompletedBytes = 0; /* Copied (the batch fences are signalled) */
+            uint64_t AcquiredBytes  = 0; /* Visible to the render queue (the acquire barriers are recorded) */
+            uint32_t BatchCount     = 0; /* Submitted batches */
+            uint32_t CopyCount      = 0; /* Recorded copy commands */
+        };
+
+        ~UploadQueue( );
+
+        /**
+         * @param pInNode Graphics device.
+         * @param renderQueueFamilyId Queue family of the command buffers that use the destination buffers (they are released to it).
+         * @param ringSize Staging ring size in bytes.
+         * @param maxBatchCount Maximum number of batches in flight (the ring is evenly split between them).
+         **/
+        bool Recreate( GraphicsDevice* pInNode,
+                       uint32_t        renderQueueFamilyId,
+                       uint32_t        ringSize      = kDefaultRingSize,
+                       uint32_t        maxBatchCount = kDefaultMaxBatchCount );
+
+        /* Waits for the batches in flight and releases the resources. */
+        void Destroy( );
+
+        /**
+         * Queues the upload, no copying or submission happens until Update().
+         * @note The source data must remain valid until the ticket is completed.
+         * @return Ticket for the upload, @see IsCompleted().
+         **/
+        uint64_t Enqueue( const void* pSrc, VkDeviceSize size, VkBuffer hDstBuffer, VkDeviceSize dstOffset );
+
+        /**
+         * Retires the completed batches (in submission order) and submits the new ones
+         * while there is free ring space and free batch slots.
+         * Never blocks, should be called once per frame.
+         **/
+        void Update( );
+
+        /* Updates and waits until all the queued uploads are copied (the ranges still need to be acquired). */
+        void Flush( );
+
+        /**
+         * Records the barriers that make the copied ranges of the retired batches visible to the vertex input,
+         * and acquire them for the render queue family (if the transfer queue family differs).
+         * Must be recorded into the command buffer of the render queue family outside of the render pass, before the draws,
+         * the tickets are completed after that (the command buffer must be submitted before the draws that use them).
+         **/
+        void RecordAcquireBarriers( VkCommandBuffer pCmdBuffer );
+
+        /* The ticket is copied and acquired, the range can be used in the command buffer after the acquire barriers. */
+        bool IsCompleted( uint64_t ticket ) const;
+        bool IsIdle( ) const;
+
+        const Stats& GetStats( ) const;
+        uint32_t     GetRenderQueueFamilyId( ) const;
+
+    private:
+        struct Request {
+            const uint8_t* pSrc       = nullptr;
+            VkDeviceSize   Size       = 0;
+            VkDeviceSize   CopiedSize = 0;
+            VkBuffer       hDstBuffer = VK_NULL_HANDLE;
+            VkDeviceSize   DstOffset  = 0;
+        };
+
+        struct Batch {
+            TDispatchableHandle< VkFence >       hFence;
+            uint64_t                             RingEnd   = 0; /* Ring position to free up to when completed */
+            uint64_t                             StreamEnd = 0; /* Upload stream position when completed */
+            std::vector< VkBufferMemoryBarrier > Barriers;      /* Released destination ranges (the adjacent copies are merged) */
+        };
+
+        bool     SubmitBatch( );
+        uint32_t AllocateRingSpace( VkDeviceSize size, uint64_t batchRingStart, uint32_t& offset );
+
+        GraphicsDevice*                       pNode = nullptr;
+        TDispatchableHandle< VkBuffer >       hRingBuffer;
+        TDispatchableHandle< VkDeviceMemory > hRingMemory;
+        uint8_t*                              pMapped             = nullptr;
+        uint32_t                              RingSize            = 0;
+        uint32_t                              MaxBatchSize        = 0;
+        uint32_t                              MaxBatchCount       = 0;
+        uint64_t                              RingHead            = 0; /* Next write position (monotonic) */
+        uint64_t                              RingTail            = 0; /* Oldest position in use (monotonic) */
+        uint64_t                              StreamHead          = 0; /* Recorded bytes */
+        uint32_t                              QueueFamilyIds[ 2 ] = {}; /* Transfer and render */
+        std::deque< Request >                 Requests;
+        std::vector< VkBufferMemoryBarrier >  AcquireBarriers; /* Ranges of the retired batches to acquire */
+        Batch                                 Batches[ kMaxBatchCount ]; /* Ring of batch slots */
+        uint32_t                              BatchHead  = 0;            /* Oldest batch in flight */
+        uint32_t                              BatchCount = 0;            /* Batches in flight */
+        Stats                                 Statistics;
+    };
+}
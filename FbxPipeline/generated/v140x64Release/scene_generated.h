@@ -14,34 +14,64 @@ struct vec3;
 
 struct vec4;
 
+struct mat4;
+
 struct StaticVertexFb;
 
 struct PackedVertexFb;
 
+struct SkinnedVertexFb;
+
+struct VertexAttributeFb;
+
+struct VertexLayoutFb;
+
 struct TextureFb;
 
 struct SubmeshFb;
 
 struct SubsetFb;
 
+struct MeshletFb;
+
+struct MeshLodFb;
+
+struct BlobFb;
+
+struct ContainerHeaderFb;
+
 struct NameFb;
 
 struct TransformFb;
 
+struct GeometryBufferFb;
+
+struct MeshletsFb;
+
 struct MeshFb;
 
 struct MaterialPropFb;
 
+struct AnimKeyFb;
+
+struct AnimTrackFb;
+
 struct MaterialFb;
 
 struct NodeFb;
 
 struct FileFb;
 
+struct AnimLayerFb;
+
+struct AnimStackFb;
+
+struct SkinFb;
+
 struct SceneFb;
 
 enum EVersion {
-  EVersion_Value = 3,
+  EVersion_Value = 5,
   EVersion_MIN = EVersion_Value,
   EVersion_MAX = EVersion_Value
 };
@@ -59,6 +89,25 @@ inline const char *EnumNameEVersion(EVersion e) {
   return EnumNamesEVersion()[index];
 }
 
+enum EContainerFb {
+  EContainerFb_Magic = 1129857606,
+  EContainerFb_MIN = EContainerFb_Magic,
+  EContainerFb_MAX = EContainerFb_Magic
+};
+
+inline const char **EnumNamesEContainerFb() {
+  static const char *names[] = {
+    "Magic",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameEContainerFb(EContainerFb e) {
+  const size_t index = static_cast<int>(e) - static_cast<int>(EContainerFb_Magic);
+  return EnumNamesEContainerFb()[index];
+}
+
 enum ECullingType {
   ECullingType_CullingOff = 0,
   ECullingType_CullingOnCCW = 1,
@@ -133,14 +182,16 @@ inline const char *EnumNameEBlendMode(EBlendMode e) {
 enum EVertexFormat {
   EVertexFormat_Static = 0,
   EVertexFormat_Packed = 1,
+  EVertexFormat_Skinned = 2,
   EVertexFormat_MIN = EVertexFormat_Static,
-  EVertexFormat_MAX = EVertexFormat_Packed
+  EVertexFormat_MAX = EVertexFormat_Skinned
 };
 
 inline const char **EnumNamesEVertexFormat() {
   static const char *names[] = {
     "Static",
     "Packed",
+    "Skinned",
     nullptr
   };
   return names;
@@ -203,6 +254,60 @@ inline const char *EnumNameEMaterialPropTypeFb(EMaterialPropTypeFb e) {
   return EnumNamesEMaterialPropTypeFb()[index];
 }
 
+enum EAnimChannelFb {
+  EAnimChannelFb_Translation = 0,
+  EAnimChannelFb_Rotation = 1,
+  EAnimChannelFb_Scaling = 2,
+  EAnimChannelFb_MIN = EAnimChannelFb_Translation,
+  EAnimChannelFb_MAX = EAnimChannelFb_Scaling
+};
+
+inline const char **EnumNamesEAnimChannelFb() {
+  static const char *names[] = {
+    "Translation",
+    "Rotation",
+    "Scaling",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameEAnimChannelFb(EAnimChannelFb e) {
+  const size_t index = static_cast<int>(e);
+  return EnumNamesEAnimChannelFb()[index];
+}
+
+enum EVertexAttributeEncodingFb {
+  EVertexAttributeEncodingFb_None = 0,
+  EVertexAttributeEncodingFb_Float = 1,
+  EVertexAttributeEncodingFb_Unorm = 2,
+  EVertexAttributeEncodingFb_Snorm = 3,
+  EVertexAttributeEncodingFb_UInt = 4,
+  EVertexAttributeEncodingFb_Half = 5,
+  EVertexAttributeEncodingFb_Octahedral = 6,
+  EVertexAttributeEncodingFb_MIN = EVertexAttributeEncodingFb_None,
+  EVertexAttributeEncodingFb_MAX = EVertexAttributeEncodingFb_Octahedral
+};
+
+inline const char **EnumNamesEVertexAttributeEncodingFb() {
+  static const char *names[] = {
+    "None",
+    "Float",
+    "Unorm",
+    "Snorm",
+    "UInt",
+    "Half",
+    "Octahedral",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameEVertexAttributeEncodingFb(EVertexAttributeEncodingFb e) {
+  const size_t index = static_cast<int>(e);
+  return EnumNamesEVertexAttributeEncodingFb()[index];
+}
+
 MANUALLY_ALIGNED_STRUCT(4) vec2 FLATBUFFERS_FINAL_CLASS {
  private:
   float x_;
@@ -293,6 +398,41 @@ MANUALLY_ALIGNED_STRUCT(4) vec4 FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(vec4, 16);
 
+MANUALLY_ALIGNED_STRUCT(4) mat4 FLATBUFFERS_FINAL_CLASS {
+ private:
+  vec4 x_;
+  vec4 y_;
+  vec4 z_;
+  vec4 w_;
+
+ public:
+  mat4() {
+    memset(this, 0, sizeof(mat4));
+  }
+  mat4(const mat4 &_o) {
+    memcpy(this, &_o, sizeof(mat4));
+  }
+  mat4(const vec4 &_x, const vec4 &_y, const vec4 &_z, const vec4 &_w)
+      : x_(_x),
+        y_(_y),
+        z_(_z),
+        w_(_w) {
+  }
+  const vec4 &x() const {
+    return x_;
+  }
+  const vec4 &y() const {
+    return y_;
+  }
+  const vec4 &z() const {
+    return z_;
+  }
+  const vec4 &w() const {
+    return w_;
+  }
+};
+STRUCT_END(mat4, 64);
+
 MANUALLY_ALIGNED_STRUCT(4) StaticVertexFb FLATBUFFERS_FINAL_CLASS {
  private:
   vec3 position_;
@@ -363,6 +503,131 @@ MANUALLY_ALIGNED_STRUCT(4) PackedVertexFb FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(PackedVertexFb, 16);
 
+MANUALLY_ALIGNED_STRUCT(4) SkinnedVertexFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint32_t position_;
+  uint32_t normal_;
+  uint32_t tangent_;
+  uint32_t uv_;
+  uint32_t joint_indices_;
+  uint32_t joint_weights_;
+
+ public:
+  SkinnedVertexFb() {
+    memset(this, 0, sizeof(SkinnedVertexFb));
+  }
+  SkinnedVertexFb(const SkinnedVertexFb &_o) {
+    memcpy(this, &_o, sizeof(SkinnedVertexFb));
+  }
+  SkinnedVertexFb(uint32_t _position, uint32_t _normal, uint32_t _tangent, uint32_t _uv, uint32_t _joint_indices, uint32_t _joint_weights)
+      : position_(flatbuffers::EndianScalar(_position)),
+        normal_(flatbuffers::EndianScalar(_normal)),
+        tangent_(flatbuffers::EndianScalar(_tangent)),
+        uv_(flatbuffers::EndianScalar(_uv)),
+        joint_indices_(flatbuffers::EndianScalar(_joint_indices)),
+        joint_weights_(flatbuffers::EndianScalar(_joint_weights)) {
+  }
+  uint32_t position() const {
+    return flatbuffers::EndianScalar(position_);
+  }
+  uint32_t normal() const {
+    return flatbuffers::EndianScalar(normal_);
+  }
+  uint32_t tangent() const {
+    return flatbuffers::EndianScalar(tangent_);
+  }
+  uint32_t uv() const {
+    return flatbuffers::EndianScalar(uv_);
+  }
+  uint32_t joint_indices() const {
+    return flatbuffers::EndianScalar(joint_indices_);
+  }
+  uint32_t joint_weights() const {
+    return flatbuffers::EndianScalar(joint_weights_);
+  }
+};
+STRUCT_END(SkinnedVertexFb, 24);
+
+MANUALLY_ALIGNED_STRUCT(1) VertexAttributeFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint8_t encoding_;
+  uint8_t component_count_;
+  uint8_t bit_width_;
+  uint8_t offset_;
+
+ public:
+  VertexAttributeFb() {
+    memset(this, 0, sizeof(VertexAttributeFb));
+  }
+  VertexAttributeFb(const VertexAttributeFb &_o) {
+    memcpy(this, &_o, sizeof(VertexAttributeFb));
+  }
+  VertexAttributeFb(EVertexAttributeEncodingFb _encoding, uint8_t _component_count, uint8_t _bit_width, uint8_t _offset)
+      : encoding_(flatbuffers::EndianScalar(static_cast<uint8_t>(_encoding))),
+        component_count_(flatbuffers::EndianScalar(_component_count)),
+        bit_width_(flatbuffers::EndianScalar(_bit_width)),
+        offset_(flatbuffers::EndianScalar(_offset)) {
+  }
+  EVertexAttributeEncodingFb encoding() const {
+    return static_cast<EVertexAttributeEncodingFb>(flatbuffers::EndianScalar(encoding_));
+  }
+  uint8_t component_count() const {
+    return flatbuffers::EndianScalar(component_count_);
+  }
+  uint8_t bit_width() const {
+    return flatbuffers::EndianScalar(bit_width_);
+  }
+  uint8_t offset() const {
+    return flatbuffers::EndianScalar(offset_);
+  }
+};
+STRUCT_END(VertexAttributeFb, 4);
+
+MANUALLY_ALIGNED_STRUCT(1) VertexLayoutFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  VertexAttributeFb position_;
+  VertexAttributeFb normal_;
+  VertexAttributeFb tangent_;
+  VertexAttributeFb uv_;
+  VertexAttributeFb joint_indices_;
+  VertexAttributeFb joint_weights_;
+
+ public:
+  VertexLayoutFb() {
+    memset(this, 0, sizeof(VertexLayoutFb));
+  }
+  VertexLayoutFb(const VertexLayoutFb &_o) {
+    memcpy(this, &_o, sizeof(VertexLayoutFb));
+  }
+  VertexLayoutFb(const VertexAttributeFb &_position, const VertexAttributeFb &_normal, const VertexAttributeFb &_tangent, const VertexAttributeFb &_uv, const VertexAttributeFb &_joint_indices, const VertexAttributeFb &_joint_weights)
+      : position_(_position),
+        normal_(_normal),
+        tangent_(_tangent),
+        uv_(_uv),
+        joint_indices_(_joint_indices),
+        joint_weights_(_joint_weights) {
+  }
+  const VertexAttributeFb &position() const {
+    return position_;
+  }
+  const VertexAttributeFb &normal() const {
+    return normal_;
+  }
+  const VertexAttributeFb &tangent() const {
+    return tangent_;
+  }
+  const VertexAttributeFb &uv() const {
+    return uv_;
+  }
+  const VertexAttributeFb &joint_indices() const {
+    return joint_indices_;
+  }
+  const VertexAttributeFb &joint_weights() const {
+    return joint_weights_;
+  }
+};
+STRUCT_END(VertexLayoutFb, 24);
+
 MANUALLY_ALIGNED_STRUCT(8) TextureFb FLATBUFFERS_FINAL_CLASS {
  private:
   uint32_t id_;
@@ -447,6 +712,7 @@ MANUALLY_ALIGNED_STRUCT(4) SubmeshFb FLATBUFFERS_FINAL_CLASS {
   uint16_t subset_count_;
   uint32_t vertex_format_;
   uint16_t vertex_stride_;
+  VertexLayoutFb vertex_layout_;
   int16_t padding0__;
 
  public:
@@ -456,7 +722,7 @@ MANUALLY_ALIGNED_STRUCT(4) SubmeshFb FLATBUFFERS_FINAL_CLASS {
   SubmeshFb(const SubmeshFb &_o) {
     memcpy(this, &_o, sizeof(SubmeshFb));
   }
-  SubmeshFb(const vec3 &_bbox_min, const vec3 &_bbox_max, const vec3 &_position_offset, const vec3 &_position_scale, const vec2 &_uv_offset, const vec2 &_uv_scale, uint32_t _base_vertex, uint32_t _vertex_count, uint32_t _base_index, uint32_t _index_count, uint16_t _base_subset, uint16_t _subset_count, EVertexFormat _vertex_format, uint16_t _vertex_stride)
+  SubmeshFb(const vec3 &_bbox_min, const vec3 &_bbox_max, const vec3 &_position_offset, const vec3 &_position_scale, const vec2 &_uv_offset, const vec2 &_uv_scale, uint32_t _base_vertex, uint32_t _vertex_count, uint32_t _base_index, uint32_t _index_count, uint16_t _base_subset, uint16_t _subset_count, EVertexFormat _vertex_format, uint16_t _vertex_stride, const VertexLayoutFb &_vertex_layout)
       : bbox_min_(_bbox_min),
         bbox_max_(_bbox_max),
         position_offset_(_position_offset),
@@ -471,6 +737,7 @@ MANUALLY_ALIGNED_STRUCT(4) SubmeshFb FLATBUFFERS_FINAL_CLASS {
         subset_count_(flatbuffers::EndianScalar(_subset_count)),
         vertex_format_(flatbuffers::EndianScalar(static_cast<uint32_t>(_vertex_format))),
         vertex_stride_(flatbuffers::EndianScalar(_vertex_stride)),
+        vertex_layout_(_vertex_layout),
         padding0__(0) {
     (void)padding0__;
   }
@@ -516,8 +783,11 @@ MANUALLY_ALIGNED_STRUCT(4) SubmeshFb FLATBUFFERS_FINAL_CLASS {
   uint16_t vertex_stride() const {
     return flatbuffers::EndianScalar(vertex_stride_);
   }
+  const VertexLayoutFb &vertex_layout() const {
+    return vertex_layout_;
+  }
 };
-STRUCT_END(SubmeshFb, 92);
+STRUCT_END(SubmeshFb, 116);
 
 MANUALLY_ALIGNED_STRUCT(4) SubsetFb FLATBUFFERS_FINAL_CLASS {
  private:
@@ -549,6 +819,166 @@ MANUALLY_ALIGNED_STRUCT(4) SubsetFb FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(SubsetFb, 12);
 
+MANUALLY_ALIGNED_STRUCT(4) MeshletFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  vec3 center_;
+  float radius_;
+  vec3 cone_apex_;
+  vec3 cone_axis_;
+  float cone_cutoff_;
+  uint32_t base_index_;
+  uint32_t base_vertex_index_;
+  uint32_t base_triangle_;
+  uint8_t vertex_count_;
+  uint8_t triangle_count_;
+  uint16_t subset_index_;
+
+ public:
+  MeshletFb() {
+    memset(this, 0, sizeof(MeshletFb));
+  }
+  MeshletFb(const MeshletFb &_o) {
+    memcpy(this, &_o, sizeof(MeshletFb));
+  }
+  MeshletFb(const vec3 &_center, float _radius, const vec3 &_cone_apex, const vec3 &_cone_axis, float _cone_cutoff, uint32_t _base_index, uint32_t _base_vertex_index, uint32_t _base_triangle, uint8_t _vertex_count, uint8_t _triangle_count, uint16_t _subset_index)
+      : center_(_center),
+        radius_(flatbuffers::EndianScalar(_radius)),
+        cone_apex_(_cone_apex),
+        cone_axis_(_cone_axis),
+        cone_cutoff_(flatbuffers::EndianScalar(_cone_cutoff)),
+        base_index_(flatbuffers::EndianScalar(_base_index)),
+        base_vertex_index_(flatbuffers::EndianScalar(_base_vertex_index)),
+        base_triangle_(flatbuffers::EndianScalar(_base_triangle)),
+        vertex_count_(flatbuffers::EndianScalar(_vertex_count)),
+        triangle_count_(flatbuffers::EndianScalar(_triangle_count)),
+        subset_index_(flatbuffers::EndianScalar(_subset_index)) {
+  }
+  const vec3 &center() const {
+    return center_;
+  }
+  float radius() const {
+    return flatbuffers::EndianScalar(radius_);
+  }
+  const vec3 &cone_apex() const {
+    return cone_apex_;
+  }
+  const vec3 &cone_axis() const {
+    return cone_axis_;
+  }
+  float cone_cutoff() const {
+    return flatbuffers::EndianScalar(cone_cutoff_);
+  }
+  uint32_t base_index() const {
+    return flatbuffers::EndianScalar(base_index_);
+  }
+  uint32_t base_vertex_index() const {
+    return flatbuffers::EndianScalar(base_vertex_index_);
+  }
+  uint32_t base_triangle() const {
+    return flatbuffers::EndianScalar(base_triangle_);
+  }
+  uint8_t vertex_count() const {
+    return flatbuffers::EndianScalar(vertex_count_);
+  }
+  uint8_t triangle_count() const {
+    return flatbuffers::EndianScalar(triangle_count_);
+  }
+  uint16_t subset_index() const {
+    return flatbuffers::EndianScalar(subset_index_);
+  }
+};
+STRUCT_END(MeshletFb, 60);
+
+MANUALLY_ALIGNED_STRUCT(4) MeshLodFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  float error_;
+  uint32_t base_subset_;
+  uint32_t subset_count_;
+
+ public:
+  MeshLodFb() {
+    memset(this, 0, sizeof(MeshLodFb));
+  }
+  MeshLodFb(const MeshLodFb &_o) {
+    memcpy(this, &_o, sizeof(MeshLodFb));
+  }
+  MeshLodFb(float _error, uint32_t _base_subset, uint32_t _subset_count)
+      : error_(flatbuffers::EndianScalar(_error)),
+        base_subset_(flatbuffers::EndianScalar(_base_subset)),
+        subset_count_(flatbuffers::EndianScalar(_subset_count)) {
+  }
+  float error() const {
+    return flatbuffers::EndianScalar(error_);
+  }
+  uint32_t base_subset() const {
+    return flatbuffers::EndianScalar(base_subset_);
+  }
+  uint32_t subset_count() const {
+    return flatbuffers::EndianScalar(subset_count_);
+  }
+};
+STRUCT_END(MeshLodFb, 12);
+
+MANUALLY_ALIGNED_STRUCT(8) BlobFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint64_t offset_;
+  uint64_t size_;
+
+ public:
+  BlobFb() {
+    memset(this, 0, sizeof(BlobFb));
+  }
+  BlobFb(const BlobFb &_o) {
+    memcpy(this, &_o, sizeof(BlobFb));
+  }
+  BlobFb(uint64_t _offset, uint64_t _size)
+      : offset_(flatbuffers::EndianScalar(_offset)),
+        size_(flatbuffers::EndianScalar(_size)) {
+  }
+  uint64_t offset() const {
+    return flatbuffers::EndianScalar(offset_);
+  }
+  uint64_t size() const {
+    return flatbuffers::EndianScalar(size_);
+  }
+};
+STRUCT_END(BlobFb, 16);
+
+MANUALLY_ALIGNED_STRUCT(8) ContainerHeaderFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint32_t magic_;
+  uint32_t version_;
+  uint64_t scene_offset_;
+  uint64_t scene_size_;
+
+ public:
+  ContainerHeaderFb() {
+    memset(this, 0, sizeof(ContainerHeaderFb));
+  }
+  ContainerHeaderFb(const ContainerHeaderFb &_o) {
+    memcpy(this, &_o, sizeof(ContainerHeaderFb));
+  }
+  ContainerHeaderFb(EContainerFb _magic, uint32_t _version, uint64_t _scene_offset, uint64_t _scene_size)
+      : magic_(flatbuffers::EndianScalar(static_cast<uint32_t>(_magic))),
+        version_(flatbuffers::EndianScalar(_version)),
+        scene_offset_(flatbuffers::EndianScalar(_scene_offset)),
+        scene_size_(flatbuffers::EndianScalar(_scene_size)) {
+  }
+  EContainerFb magic() const {
+    return static_cast<EContainerFb>(flatbuffers::EndianScalar(magic_));
+  }
+  uint32_t version() const {
+    return flatbuffers::EndianScalar(version_);
+  }
+  uint64_t scene_offset() const {
+    return flatbuffers::EndianScalar(scene_offset_);
+  }
+  uint64_t scene_size() const {
+    return flatbuffers::EndianScalar(scene_size_);
+  }
+};
+STRUCT_END(ContainerHeaderFb, 24);
+
 MANUALLY_ALIGNED_STRUCT(4) TransformFb FLATBUFFERS_FINAL_CLASS {
  private:
   vec3 translation_;
@@ -654,6 +1084,66 @@ MANUALLY_ALIGNED_STRUCT(8) MaterialPropFb FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(MaterialPropFb, 24);
 
+MANUALLY_ALIGNED_STRUCT(4) AnimKeyFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  float time_;
+  vec3 value_;
+
+ public:
+  AnimKeyFb() {
+    memset(this, 0, sizeof(AnimKeyFb));
+  }
+  AnimKeyFb(const AnimKeyFb &_o) {
+    memcpy(this, &_o, sizeof(AnimKeyFb));
+  }
+  AnimKeyFb(float _time, const vec3 &_value)
+      : time_(flatbuffers::EndianScalar(_time)),
+        value_(_value) {
+  }
+  float time() const {
+    return flatbuffers::EndianScalar(time_);
+  }
+  const vec3 &value() const {
+    return value_;
+  }
+};
+STRUCT_END(AnimKeyFb, 16);
+
+MANUALLY_ALIGNED_STRUCT(4) AnimTrackFb FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint32_t node_id_;
+  uint32_t channel_;
+  uint32_t base_key_;
+  uint32_t key_count_;
+
+ public:
+  AnimTrackFb() {
+    memset(this, 0, sizeof(AnimTrackFb));
+  }
+  AnimTrackFb(const AnimTrackFb &_o) {
+    memcpy(this, &_o, sizeof(AnimTrackFb));
+  }
+  AnimTrackFb(uint32_t _node_id, EAnimChannelFb _channel, uint32_t _base_key, uint32_t _key_count)
+      : node_id_(flatbuffers::EndianScalar(_node_id)),
+        channel_(flatbuffers::EndianScalar(static_cast<uint32_t>(_channel))),
+        base_key_(flatbuffers::EndianScalar(_base_key)),
+        key_count_(flatbuffers::EndianScalar(_key_count)) {
+  }
+  uint32_t node_id() const {
+    return flatbuffers::EndianScalar(node_id_);
+  }
+  EAnimChannelFb channel() const {
+    return static_cast<EAnimChannelFb>(flatbuffers::EndianScalar(channel_));
+  }
+  uint32_t base_key() const {
+    return flatbuffers::EndianScalar(base_key_);
+  }
+  uint32_t key_count() const {
+    return flatbuffers::EndianScalar(key_count_);
+  }
+};
+STRUCT_END(AnimTrackFb, 16);
+
 struct NameFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum {
     VT_H = 4,
@@ -728,82 +1218,352 @@ inline flatbuffers::Offset<NameFb> CreateNameFbDirect(
       v ? _fbb.CreateString(v) : 0);
 }
 
-struct MeshFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+struct GeometryBufferFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum {
-    VT_VERTICES = 4,
-    VT_SUBMESHES = 6,
-    VT_SUBSETS = 8,
-    VT_INDICES = 10,
-    VT_INDEX_TYPE = 12
+    VT_VERTEX_FORMAT = 4,
+    VT_VERTEX_STRIDE = 6,
+    VT_INDEX_TYPE = 8,
+    VT_VERTICES = 10,
+    VT_INDICES = 12,
+    VT_VERTICES_BLOB = 14,
+    VT_INDICES_BLOB = 16
   };
-  const flatbuffers::Vector<uint8_t> *vertices() const {
-    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_VERTICES);
+  EVertexFormat vertex_format() const {
+    return static_cast<EVertexFormat>(GetField<uint32_t>(VT_VERTEX_FORMAT, 0));
   }
-  const flatbuffers::Vector<const SubmeshFb *> *submeshes() const {
-    return GetPointer<const flatbuffers::Vector<const SubmeshFb *> *>(VT_SUBMESHES);
+  uint32_t vertex_stride() const {
+    return GetField<uint32_t>(VT_VERTEX_STRIDE, 0);
   }
-  const flatbuffers::Vector<const SubsetFb *> *subsets() const {
-    return GetPointer<const flatbuffers::Vector<const SubsetFb *> *>(VT_SUBSETS);
+  EIndexTypeFb index_type() const {
+    return static_cast<EIndexTypeFb>(GetField<uint32_t>(VT_INDEX_TYPE, 0));
+  }
+  const flatbuffers::Vector<uint8_t> *vertices() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_VERTICES);
   }
   const flatbuffers::Vector<uint8_t> *indices() const {
     return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_INDICES);
   }
-  EIndexTypeFb index_type() const {
-    return static_cast<EIndexTypeFb>(GetField<uint32_t>(VT_INDEX_TYPE, 0));
+  const BlobFb *vertices_blob() const {
+    return GetStruct<const BlobFb *>(VT_VERTICES_BLOB);
+  }
+  const BlobFb *indices_blob() const {
+    return GetStruct<const BlobFb *>(VT_INDICES_BLOB);
   }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
+           VerifyField<uint32_t>(verifier, VT_VERTEX_FORMAT) &&
+           VerifyField<uint32_t>(verifier, VT_VERTEX_STRIDE) &&
+           VerifyField<uint32_t>(verifier, VT_INDEX_TYPE) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, VT_VERTICES) &&
            verifier.Verify(vertices()) &&
-           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SUBMESHES) &&
-           verifier.Verify(submeshes()) &&
-           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SUBSETS) &&
-           verifier.Verify(subsets()) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, VT_INDICES) &&
            verifier.Verify(indices()) &&
-           VerifyField<uint32_t>(verifier, VT_INDEX_TYPE) &&
+           VerifyField<BlobFb>(verifier, VT_VERTICES_BLOB) &&
+           VerifyField<BlobFb>(verifier, VT_INDICES_BLOB) &&
            verifier.EndTable();
   }
 };
 
-struct MeshFbBuilder {
+struct GeometryBufferFbBuilder {
   flatbuffers::FlatBufferBuilder &fbb_;
   flatbuffers::uoffset_t start_;
-  void add_vertices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vertices) {
-    fbb_.AddOffset(MeshFb::VT_VERTICES, vertices);
+  void add_vertex_format(EVertexFormat vertex_format) {
+    fbb_.AddElement<uint32_t>(GeometryBufferFb::VT_VERTEX_FORMAT, static_cast<uint32_t>(vertex_format), 0);
   }
-  void add_submeshes(flatbuffers::Offset<flatbuffers::Vector<const SubmeshFb *>> submeshes) {
-    fbb_.AddOffset(MeshFb::VT_SUBMESHES, submeshes);
+  void add_vertex_stride(uint32_t vertex_stride) {
+    fbb_.AddElement<uint32_t>(GeometryBufferFb::VT_VERTEX_STRIDE, vertex_stride, 0);
   }
-  void add_subsets(flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> subsets) {
-    fbb_.AddOffset(MeshFb::VT_SUBSETS, subsets);
+  void add_index_type(EIndexTypeFb index_type) {
+    fbb_.AddElement<uint32_t>(GeometryBufferFb::VT_INDEX_TYPE, static_cast<uint32_t>(index_type), 0);
+  }
+  void add_vertices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vertices) {
+    fbb_.AddOffset(GeometryBufferFb::VT_VERTICES, vertices);
   }
   void add_indices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> indices) {
-    fbb_.AddOffset(MeshFb::VT_INDICES, indices);
+    fbb_.AddOffset(GeometryBufferFb::VT_INDICES, indices);
   }
-  void add_index_type(EIndexTypeFb index_type) {
-    fbb_.AddElement<uint32_t>(MeshFb::VT_INDEX_TYPE, static_cast<uint32_t>(index_type), 0);
+  void add_vertices_blob(const BlobFb *vertices_blob) {
+    fbb_.AddStruct(GeometryBufferFb::VT_VERTICES_BLOB, vertices_blob);
   }
-  MeshFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+  void add_indices_blob(const BlobFb *indices_blob) {
+    fbb_.AddStruct(GeometryBufferFb::VT_INDICES_BLOB, indices_blob);
+  }
+  GeometryBufferFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
   }
-  MeshFbBuilder &operator=(const MeshFbBuilder &);
-  flatbuffers::Offset<MeshFb> Finish() {
-    const auto end = fbb_.EndTable(start_, 5);
-    auto o = flatbuffers::Offset<MeshFb>(end);
+  GeometryBufferFbBuilder &operator=(const GeometryBufferFbBuilder &);
+  flatbuffers::Offset<GeometryBufferFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 7);
+    auto o = flatbuffers::Offset<GeometryBufferFb>(end);
     return o;
   }
 };
 
-inline flatbuffers::Offset<MeshFb> CreateMeshFb(
+inline flatbuffers::Offset<GeometryBufferFb> CreateGeometryBufferFb(
     flatbuffers::FlatBufferBuilder &_fbb,
+    EVertexFormat vertex_format = EVertexFormat_Static,
+    uint32_t vertex_stride = 0,
+    EIndexTypeFb index_type = EIndexTypeFb_UInt16,
     flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vertices = 0,
-    flatbuffers::Offset<flatbuffers::Vector<const SubmeshFb *>> submeshes = 0,
-    flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> subsets = 0,
     flatbuffers::Offset<flatbuffers::Vector<uint8_t>> indices = 0,
-    EIndexTypeFb index_type = EIndexTypeFb_UInt16) {
+    const BlobFb *vertices_blob = 0,
+    const BlobFb *indices_blob = 0) {
+  GeometryBufferFbBuilder builder_(_fbb);
+  builder_.add_indices_blob(indices_blob);
+  builder_.add_vertices_blob(vertices_blob);
+  builder_.add_indices(indices);
+  builder_.add_vertices(vertices);
+  builder_.add_index_type(index_type);
+  builder_.add_vertex_stride(vertex_stride);
+  builder_.add_vertex_format(vertex_format);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<GeometryBufferFb> CreateGeometryBufferFbDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    EVertexFormat vertex_format = EVertexFormat_Static,
+    uint32_t vertex_stride = 0,
+    EIndexTypeFb index_type = EIndexTypeFb_UInt16,
+    const std::vector<uint8_t> *vertices = nullptr,
+    const std::vector<uint8_t> *indices = nullptr,
+    const BlobFb *vertices_blob = 0,
+    const BlobFb *indices_blob = 0) {
+  return CreateGeometryBufferFb(
+      _fbb,
+      vertex_format,
+      vertex_stride,
+      index_type,
+      vertices ? _fbb.CreateVector<uint8_t>(*vertices) : 0,
+      indices ? _fbb.CreateVector<uint8_t>(*indices) : 0,
+      vertices_blob,
+      indices_blob);
+}
+
+struct MeshletsFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_MESHLETS = 4,
+    VT_VERTEX_INDICES = 6,
+    VT_TRIANGLES = 8
+  };
+  const flatbuffers::Vector<const MeshletFb *> *meshlets() const {
+    return GetPointer<const flatbuffers::Vector<const MeshletFb *> *>(VT_MESHLETS);
+  }
+  const flatbuffers::Vector<uint32_t> *vertex_indices() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_VERTEX_INDICES);
+  }
+  const flatbuffers::Vector<uint8_t> *triangles() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_TRIANGLES);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MESHLETS) &&
+           verifier.Verify(meshlets()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_VERTEX_INDICES) &&
+           verifier.Verify(vertex_indices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_TRIANGLES) &&
+           verifier.Verify(triangles()) &&
+           verifier.EndTable();
+  }
+};
+
+struct MeshletsFbBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_meshlets(flatbuffers::Offset<flatbuffers::Vector<const MeshletFb *>> meshlets) {
+    fbb_.AddOffset(MeshletsFb::VT_MESHLETS, meshlets);
+  }
+  void add_vertex_indices(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> vertex_indices) {
+    fbb_.AddOffset(MeshletsFb::VT_VERTEX_INDICES, vertex_indices);
+  }
+  void add_triangles(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> triangles) {
+    fbb_.AddOffset(MeshletsFb::VT_TRIANGLES, triangles);
+  }
+  MeshletsFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  MeshletsFbBuilder &operator=(const MeshletsFbBuilder &);
+  flatbuffers::Offset<MeshletsFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 3);
+    auto o = flatbuffers::Offset<MeshletsFb>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<MeshletsFb> CreateMeshletsFb(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::Vector<const MeshletFb *>> meshlets = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> vertex_indices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> triangles = 0) {
+  MeshletsFbBuilder builder_(_fbb);
+  builder_.add_triangles(triangles);
+  builder_.add_vertex_indices(vertex_indices);
+  builder_.add_meshlets(meshlets);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<MeshletsFb> CreateMeshletsFbDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    const std::vector<const MeshletFb *> *meshlets = nullptr,
+    const std::vector<uint32_t> *vertex_indices = nullptr,
+    const std::vector<uint8_t> *triangles = nullptr) {
+  return CreateMeshletsFb(
+      _fbb,
+      meshlets ? _fbb.CreateVector<const MeshletFb *>(*meshlets) : 0,
+      vertex_indices ? _fbb.CreateVector<uint32_t>(*vertex_indices) : 0,
+      triangles ? _fbb.CreateVector<uint8_t>(*triangles) : 0);
+}
+
+struct MeshFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_VERTICES = 4,
+    VT_SUBMESHES = 6,
+    VT_SUBSETS = 8,
+    VT_INDICES = 10,
+    VT_INDEX_TYPE = 12,
+    VT_VERTICES_BLOB = 14,
+    VT_INDICES_BLOB = 16,
+    VT_GEOMETRY_BUFFER_ID = 18,
+    VT_SKIN_ID = 20,
+    VT_MESHLETS = 22,
+    VT_LODS = 24,
+    VT_LOD_SUBSETS = 26
+  };
+  const flatbuffers::Vector<uint8_t> *vertices() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_VERTICES);
+  }
+  const flatbuffers::Vector<const SubmeshFb *> *submeshes() const {
+    return GetPointer<const flatbuffers::Vector<const SubmeshFb *> *>(VT_SUBMESHES);
+  }
+  const flatbuffers::Vector<const SubsetFb *> *subsets() const {
+    return GetPointer<const flatbuffers::Vector<const SubsetFb *> *>(VT_SUBSETS);
+  }
+  const flatbuffers::Vector<uint8_t> *indices() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_INDICES);
+  }
+  EIndexTypeFb index_type() const {
+    return static_cast<EIndexTypeFb>(GetField<uint32_t>(VT_INDEX_TYPE, 0));
+  }
+  const BlobFb *vertices_blob() const {
+    return GetStruct<const BlobFb *>(VT_VERTICES_BLOB);
+  }
+  const BlobFb *indices_blob() const {
+    return GetStruct<const BlobFb *>(VT_INDICES_BLOB);
+  }
+  uint32_t geometry_buffer_id() const {
+    return GetField<uint32_t>(VT_GEOMETRY_BUFFER_ID, 4294967295);
+  }
+  uint32_t skin_id() const {
+    return GetField<uint32_t>(VT_SKIN_ID, 4294967295);
+  }
+  const MeshletsFb *meshlets() const {
+    return GetPointer<const MeshletsFb *>(VT_MESHLETS);
+  }
+  const flatbuffers::Vector<const MeshLodFb *> *lods() const {
+    return GetPointer<const flatbuffers::Vector<const MeshLodFb *> *>(VT_LODS);
+  }
+  const flatbuffers::Vector<const SubsetFb *> *lod_subsets() const {
+    return GetPointer<const flatbuffers::Vector<const SubsetFb *> *>(VT_LOD_SUBSETS);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_VERTICES) &&
+           verifier.Verify(vertices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SUBMESHES) &&
+           verifier.Verify(submeshes()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SUBSETS) &&
+           verifier.Verify(subsets()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_INDICES) &&
+           verifier.Verify(indices()) &&
+           VerifyField<uint32_t>(verifier, VT_INDEX_TYPE) &&
+           VerifyField<BlobFb>(verifier, VT_VERTICES_BLOB) &&
+           VerifyField<BlobFb>(verifier, VT_INDICES_BLOB) &&
+           VerifyField<uint32_t>(verifier, VT_GEOMETRY_BUFFER_ID) &&
+           VerifyField<uint32_t>(verifier, VT_SKIN_ID) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MESHLETS) &&
+           verifier.VerifyTable(meshlets()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LODS) &&
+           verifier.Verify(lods()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LOD_SUBSETS) &&
+           verifier.Verify(lod_subsets()) &&
+           verifier.EndTable();
+  }
+};
+
+struct MeshFbBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_vertices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vertices) {
+    fbb_.AddOffset(MeshFb::VT_VERTICES, vertices);
+  }
+  void add_submeshes(flatbuffers::Offset<flatbuffers::Vector<const SubmeshFb *>> submeshes) {
+    fbb_.AddOffset(MeshFb::VT_SUBMESHES, submeshes);
+  }
+  void add_subsets(flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> subsets) {
+    fbb_.AddOffset(MeshFb::VT_SUBSETS, subsets);
+  }
+  void add_indices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> indices) {
+    fbb_.AddOffset(MeshFb::VT_INDICES, indices);
+  }
+  void add_index_type(EIndexTypeFb index_type) {
+    fbb_.AddElement<uint32_t>(MeshFb::VT_INDEX_TYPE, static_cast<uint32_t>(index_type), 0);
+  }
+  void add_vertices_blob(const BlobFb *vertices_blob) {
+    fbb_.AddStruct(MeshFb::VT_VERTICES_BLOB, vertices_blob);
+  }
+  void add_indices_blob(const BlobFb *indices_blob) {
+    fbb_.AddStruct(MeshFb::VT_INDICES_BLOB, indices_blob);
+  }
+  void add_geometry_buffer_id(uint32_t geometry_buffer_id) {
+    fbb_.AddElement<uint32_t>(MeshFb::VT_GEOMETRY_BUFFER_ID, geometry_buffer_id, 4294967295);
+  }
+  void add_skin_id(uint32_t skin_id) {
+    fbb_.AddElement<uint32_t>(MeshFb::VT_SKIN_ID, skin_id, 4294967295);
+  }
+  void add_meshlets(flatbuffers::Offset<MeshletsFb> meshlets) {
+    fbb_.AddOffset(MeshFb::VT_MESHLETS, meshlets);
+  }
+  void add_lods(flatbuffers::Offset<flatbuffers::Vector<const MeshLodFb *>> lods) {
+    fbb_.AddOffset(MeshFb::VT_LODS, lods);
+  }
+  void add_lod_subsets(flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> lod_subsets) {
+    fbb_.AddOffset(MeshFb::VT_LOD_SUBSETS, lod_subsets);
+  }
+  MeshFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  MeshFbBuilder &operator=(const MeshFbBuilder &);
+  flatbuffers::Offset<MeshFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 12);
+    auto o = flatbuffers::Offset<MeshFb>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<MeshFb> CreateMeshFb(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vertices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SubmeshFb *>> submeshes = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> subsets = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> indices = 0,
+    EIndexTypeFb index_type = EIndexTypeFb_UInt16,
+    const BlobFb *vertices_blob = 0,
+    const BlobFb *indices_blob = 0,
+    uint32_t geometry_buffer_id = 4294967295,
+    uint32_t skin_id = 4294967295,
+    flatbuffers::Offset<MeshletsFb> meshlets = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const MeshLodFb *>> lods = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SubsetFb *>> lod_subsets = 0) {
   MeshFbBuilder builder_(_fbb);
+  builder_.add_indices_blob(indices_blob);
+  builder_.add_lod_subsets(lod_subsets);
+  builder_.add_lods(lods);
+  builder_.add_meshlets(meshlets);
+  builder_.add_skin_id(skin_id);
+  builder_.add_geometry_buffer_id(geometry_buffer_id);
+  builder_.add_vertices_blob(vertices_blob);
   builder_.add_index_type(index_type);
   builder_.add_indices(indices);
   builder_.add_subsets(subsets);
@@ -818,14 +1578,28 @@ inline flatbuffers::Offset<MeshFb> CreateMeshFbDirect(
     const std::vector<const SubmeshFb *> *submeshes = nullptr,
     const std::vector<const SubsetFb *> *subsets = nullptr,
     const std::vector<uint8_t> *indices = nullptr,
-    EIndexTypeFb index_type = EIndexTypeFb_UInt16) {
+    EIndexTypeFb index_type = EIndexTypeFb_UInt16,
+    const BlobFb *vertices_blob = 0,
+    const BlobFb *indices_blob = 0,
+    uint32_t geometry_buffer_id = 4294967295,
+    uint32_t skin_id = 4294967295,
+    flatbuffers::Offset<MeshletsFb> meshlets = 0,
+    const std::vector<const MeshLodFb *> *lods = nullptr,
+    const std::vector<const SubsetFb *> *lod_subsets = nullptr) {
   return CreateMeshFb(
       _fbb,
       vertices ? _fbb.CreateVector<uint8_t>(*vertices) : 0,
       submeshes ? _fbb.CreateVector<const SubmeshFb *>(*submeshes) : 0,
       subsets ? _fbb.CreateVector<const SubsetFb *>(*subsets) : 0,
       indices ? _fbb.CreateVector<uint8_t>(*indices) : 0,
-      index_type);
+      index_type,
+      vertices_blob,
+      indices_blob,
+      geometry_buffer_id,
+      skin_id,
+      meshlets,
+      lods ? _fbb.CreateVector<const MeshLodFb *>(*lods) : 0,
+      lod_subsets ? _fbb.CreateVector<const SubsetFb *>(*lod_subsets) : 0);
 }
 
 struct MaterialFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -1123,6 +1897,351 @@ inline flatbuffers::Offset<FileFb> CreateFileFbDirect(
       buffer ? _fbb.CreateVector<uint8_t>(*buffer) : 0);
 }
 
+struct AnimLayerFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_ID = 4,
+    VT_NAME_ID = 6,
+    VT_STACK_ID = 8,
+    VT_TRACKS = 10,
+    VT_KEYS = 12
+  };
+  uint32_t id() const {
+    return GetField<uint32_t>(VT_ID, 0);
+  }
+  uint64_t name_id() const {
+    return GetField<uint64_t>(VT_NAME_ID, 0);
+  }
+  bool KeyCompareLessThan(const AnimLayerFb *o) const {
+    return name_id() < o->name_id();
+  }
+  int KeyCompareWithValue(uint64_t val) const {
+    const auto key = name_id();
+    if (key < val) {
+      return -1;
+    } else if (key > val) {
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+  uint32_t stack_id() const {
+    return GetField<uint32_t>(VT_STACK_ID, 0);
+  }
+  const flatbuffers::Vector<const AnimTrackFb *> *tracks() const {
+    return GetPointer<const flatbuffers::Vector<const AnimTrackFb *> *>(VT_TRACKS);
+  }
+  const flatbuffers::Vector<const AnimKeyFb *> *keys() const {
+    return GetPointer<const flatbuffers::Vector<const AnimKeyFb *> *>(VT_KEYS);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint32_t>(verifier, VT_ID) &&
+           VerifyField<uint64_t>(verifier, VT_NAME_ID) &&
+           VerifyField<uint32_t>(verifier, VT_STACK_ID) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_TRACKS) &&
+           verifier.Verify(tracks()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_KEYS) &&
+           verifier.Verify(keys()) &&
+           verifier.EndTable();
+  }
+};
+
+struct AnimLayerFbBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_id(uint32_t id) {
+    fbb_.AddElement<uint32_t>(AnimLayerFb::VT_ID, id, 0);
+  }
+  void add_name_id(uint64_t name_id) {
+    fbb_.AddElement<uint64_t>(AnimLayerFb::VT_NAME_ID, name_id, 0);
+  }
+  void add_stack_id(uint32_t stack_id) {
+    fbb_.AddElement<uint32_t>(AnimLayerFb::VT_STACK_ID, stack_id, 0);
+  }
+  void add_tracks(flatbuffers::Offset<flatbuffers::Vector<const AnimTrackFb *>> tracks) {
+    fbb_.AddOffset(AnimLayerFb::VT_TRACKS, tracks);
+  }
+  void add_keys(flatbuffers::Offset<flatbuffers::Vector<const AnimKeyFb *>> keys) {
+    fbb_.AddOffset(AnimLayerFb::VT_KEYS, keys);
+  }
+  AnimLayerFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  AnimLayerFbBuilder &operator=(const AnimLayerFbBuilder &);
+  flatbuffers::Offset<AnimLayerFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 5);
+    auto o = flatbuffers::Offset<AnimLayerFb>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<AnimLayerFb> CreateAnimLayerFb(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    uint32_t stack_id = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const AnimTrackFb *>> tracks = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const AnimKeyFb *>> keys = 0) {
+  AnimLayerFbBuilder builder_(_fbb);
+  builder_.add_name_id(name_id);
+  builder_.add_keys(keys);
+  builder_.add_tracks(tracks);
+  builder_.add_stack_id(stack_id);
+  builder_.add_id(id);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<AnimLayerFb> CreateAnimLayerFbDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    uint32_t stack_id = 0,
+    const std::vector<const AnimTrackFb *> *tracks = nullptr,
+    const std::vector<const AnimKeyFb *> *keys = nullptr) {
+  return CreateAnimLayerFb(
+      _fbb,
+      id,
+      name_id,
+      stack_id,
+      tracks ? _fbb.CreateVector<const AnimTrackFb *>(*tracks) : 0,
+      keys ? _fbb.CreateVector<const AnimKeyFb *>(*keys) : 0);
+}
+
+struct AnimStackFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_ID = 4,
+    VT_NAME_ID = 6,
+    VT_START_TIME = 8,
+    VT_STOP_TIME = 10,
+    VT_SAMPLE_RATE = 12,
+    VT_LAYER_IDS = 14
+  };
+  uint32_t id() const {
+    return GetField<uint32_t>(VT_ID, 0);
+  }
+  uint64_t name_id() const {
+    return GetField<uint64_t>(VT_NAME_ID, 0);
+  }
+  bool KeyCompareLessThan(const AnimStackFb *o) const {
+    return name_id() < o->name_id();
+  }
+  int KeyCompareWithValue(uint64_t val) const {
+    const auto key = name_id();
+    if (key < val) {
+      return -1;
+    } else if (key > val) {
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+  float start_time() const {
+    return GetField<float>(VT_START_TIME, 0.0f);
+  }
+  float stop_time() const {
+    return GetField<float>(VT_STOP_TIME, 0.0f);
+  }
+  float sample_rate() const {
+    return GetField<float>(VT_SAMPLE_RATE, 0.0f);
+  }
+  const flatbuffers::Vector<uint32_t> *layer_ids() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_LAYER_IDS);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint32_t>(verifier, VT_ID) &&
+           VerifyField<uint64_t>(verifier, VT_NAME_ID) &&
+           VerifyField<float>(verifier, VT_START_TIME) &&
+           VerifyField<float>(verifier, VT_STOP_TIME) &&
+           VerifyField<float>(verifier, VT_SAMPLE_RATE) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LAYER_IDS) &&
+           verifier.Verify(layer_ids()) &&
+           verifier.EndTable();
+  }
+};
+
+struct AnimStackFbBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_id(uint32_t id) {
+    fbb_.AddElement<uint32_t>(AnimStackFb::VT_ID, id, 0);
+  }
+  void add_name_id(uint64_t name_id) {
+    fbb_.AddElement<uint64_t>(AnimStackFb::VT_NAME_ID, name_id, 0);
+  }
+  void add_start_time(float start_time) {
+    fbb_.AddElement<float>(AnimStackFb::VT_START_TIME, start_time, 0.0f);
+  }
+  void add_stop_time(float stop_time) {
+    fbb_.AddElement<float>(AnimStackFb::VT_STOP_TIME, stop_time, 0.0f);
+  }
+  void add_sample_rate(float sample_rate) {
+    fbb_.AddElement<float>(AnimStackFb::VT_SAMPLE_RATE, sample_rate, 0.0f);
+  }
+  void add_layer_ids(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> layer_ids) {
+    fbb_.AddOffset(AnimStackFb::VT_LAYER_IDS, layer_ids);
+  }
+  AnimStackFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  AnimStackFbBuilder &operator=(const AnimStackFbBuilder &);
+  flatbuffers::Offset<AnimStackFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 6);
+    auto o = flatbuffers::Offset<AnimStackFb>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<AnimStackFb> CreateAnimStackFb(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    float start_time = 0.0f,
+    float stop_time = 0.0f,
+    float sample_rate = 0.0f,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> layer_ids = 0) {
+  AnimStackFbBuilder builder_(_fbb);
+  builder_.add_name_id(name_id);
+  builder_.add_layer_ids(layer_ids);
+  builder_.add_sample_rate(sample_rate);
+  builder_.add_stop_time(stop_time);
+  builder_.add_start_time(start_time);
+  builder_.add_id(id);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<AnimStackFb> CreateAnimStackFbDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    float start_time = 0.0f,
+    float stop_time = 0.0f,
+    float sample_rate = 0.0f,
+    const std::vector<uint32_t> *layer_ids = nullptr) {
+  return CreateAnimStackFb(
+      _fbb,
+      id,
+      name_id,
+      start_time,
+      stop_time,
+      sample_rate,
+      layer_ids ? _fbb.CreateVector<uint32_t>(*layer_ids) : 0);
+}
+
+struct SkinFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_ID = 4,
+    VT_NAME_ID = 6,
+    VT_JOINT_NODE_IDS = 8,
+    VT_JOINT_PARENT_INDICES = 10,
+    VT_INVERSE_BIND_MATRICES = 12
+  };
+  uint32_t id() const {
+    return GetField<uint32_t>(VT_ID, 0);
+  }
+  uint64_t name_id() const {
+    return GetField<uint64_t>(VT_NAME_ID, 0);
+  }
+  bool KeyCompareLessThan(const SkinFb *o) const {
+    return name_id() < o->name_id();
+  }
+  int KeyCompareWithValue(uint64_t val) const {
+    const auto key = name_id();
+    if (key < val) {
+      return -1;
+    } else if (key > val) {
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+  const flatbuffers::Vector<uint32_t> *joint_node_ids() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_JOINT_NODE_IDS);
+  }
+  const flatbuffers::Vector<uint32_t> *joint_parent_indices() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_JOINT_PARENT_INDICES);
+  }
+  const flatbuffers::Vector<const mat4 *> *inverse_bind_matrices() const {
+    return GetPointer<const flatbuffers::Vector<const mat4 *> *>(VT_INVERSE_BIND_MATRICES);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint32_t>(verifier, VT_ID) &&
+           VerifyField<uint64_t>(verifier, VT_NAME_ID) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_JOINT_NODE_IDS) &&
+           verifier.Verify(joint_node_ids()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_JOINT_PARENT_INDICES) &&
+           verifier.Verify(joint_parent_indices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_INVERSE_BIND_MATRICES) &&
+           verifier.Verify(inverse_bind_matrices()) &&
+           verifier.EndTable();
+  }
+};
+
+struct SkinFbBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_id(uint32_t id) {
+    fbb_.AddElement<uint32_t>(SkinFb::VT_ID, id, 0);
+  }
+  void add_name_id(uint64_t name_id) {
+    fbb_.AddElement<uint64_t>(SkinFb::VT_NAME_ID, name_id, 0);
+  }
+  void add_joint_node_ids(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> joint_node_ids) {
+    fbb_.AddOffset(SkinFb::VT_JOINT_NODE_IDS, joint_node_ids);
+  }
+  void add_joint_parent_indices(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> joint_parent_indices) {
+    fbb_.AddOffset(SkinFb::VT_JOINT_PARENT_INDICES, joint_parent_indices);
+  }
+  void add_inverse_bind_matrices(flatbuffers::Offset<flatbuffers::Vector<const mat4 *>> inverse_bind_matrices) {
+    fbb_.AddOffset(SkinFb::VT_INVERSE_BIND_MATRICES, inverse_bind_matrices);
+  }
+  SkinFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  SkinFbBuilder &operator=(const SkinFbBuilder &);
+  flatbuffers::Offset<SkinFb> Finish() {
+    const auto end = fbb_.EndTable(start_, 5);
+    auto o = flatbuffers::Offset<SkinFb>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<SkinFb> CreateSkinFb(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> joint_node_ids = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> joint_parent_indices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const mat4 *>> inverse_bind_matrices = 0) {
+  SkinFbBuilder builder_(_fbb);
+  builder_.add_name_id(name_id);
+  builder_.add_inverse_bind_matrices(inverse_bind_matrices);
+  builder_.add_joint_parent_indices(joint_parent_indices);
+  builder_.add_joint_node_ids(joint_node_ids);
+  builder_.add_id(id);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<SkinFb> CreateSkinFbDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t id = 0,
+    uint64_t name_id = 0,
+    const std::vector<uint32_t> *joint_node_ids = nullptr,
+    const std::vector<uint32_t> *joint_parent_indices = nullptr,
+    const std::vector<const mat4 *> *inverse_bind_matrices = nullptr) {
+  return CreateSkinFb(
+      _fbb,
+      id,
+      name_id,
+      joint_node_ids ? _fbb.CreateVector<uint32_t>(*joint_node_ids) : 0,
+      joint_parent_indices ? _fbb.CreateVector<uint32_t>(*joint_parent_indices) : 0,
+      inverse_bind_matrices ? _fbb.CreateVector<const mat4 *>(*inverse_bind_matrices) : 0);
+}
+
 struct SceneFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum {
     VT_TRANSFORMS = 4,
@@ -1131,7 +2250,11 @@ struct SceneFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_MATERIALS = 10,
     VT_TEXTURES = 12,
     VT_FILES = 14,
-    VT_NAMES = 16
+    VT_NAMES = 16,
+    VT_GEOMETRY_BUFFERS = 18,
+    VT_ANIM_STACKS = 20,
+    VT_ANIM_LAYERS = 22,
+    VT_SKINS = 24
   };
   const flatbuffers::Vector<const TransformFb *> *transforms() const {
     return GetPointer<const flatbuffers::Vector<const TransformFb *> *>(VT_TRANSFORMS);
@@ -1154,6 +2277,18 @@ struct SceneFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::Vector<flatbuffers::Offset<NameFb>> *names() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<NameFb>> *>(VT_NAMES);
   }
+  const flatbuffers::Vector<flatbuffers::Offset<GeometryBufferFb>> *geometry_buffers() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<GeometryBufferFb>> *>(VT_GEOMETRY_BUFFERS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<AnimStackFb>> *anim_stacks() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<AnimStackFb>> *>(VT_ANIM_STACKS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<AnimLayerFb>> *anim_layers() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<AnimLayerFb>> *>(VT_ANIM_LAYERS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<SkinFb>> *skins() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<SkinFb>> *>(VT_SKINS);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, VT_TRANSFORMS) &&
@@ -1175,6 +2310,18 @@ struct SceneFb FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<flatbuffers::uoffset_t>(verifier, VT_NAMES) &&
            verifier.Verify(names()) &&
            verifier.VerifyVectorOfTables(names()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_GEOMETRY_BUFFERS) &&
+           verifier.Verify(geometry_buffers()) &&
+           verifier.VerifyVectorOfTables(geometry_buffers()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_ANIM_STACKS) &&
+           verifier.Verify(anim_stacks()) &&
+           verifier.VerifyVectorOfTables(anim_stacks()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_ANIM_LAYERS) &&
+           verifier.Verify(anim_layers()) &&
+           verifier.VerifyVectorOfTables(anim_layers()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SKINS) &&
+           verifier.Verify(skins()) &&
+           verifier.VerifyVectorOfTables(skins()) &&
            verifier.EndTable();
   }
 };
@@ -1203,13 +2350,25 @@ struct SceneFbBuilder {
   void add_names(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<NameFb>>> names) {
     fbb_.AddOffset(SceneFb::VT_NAMES, names);
   }
+  void add_geometry_buffers(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<GeometryBufferFb>>> geometry_buffers) {
+    fbb_.AddOffset(SceneFb::VT_GEOMETRY_BUFFERS, geometry_buffers);
+  }
+  void add_anim_stacks(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<AnimStackFb>>> anim_stacks) {
+    fbb_.AddOffset(SceneFb::VT_ANIM_STACKS, anim_stacks);
+  }
+  void add_anim_layers(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<AnimLayerFb>>> anim_layers) {
+    fbb_.AddOffset(SceneFb::VT_ANIM_LAYERS, anim_layers);
+  }
+  void add_skins(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SkinFb>>> skins) {
+    fbb_.AddOffset(SceneFb::VT_SKINS, skins);
+  }
   SceneFbBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
   }
   SceneFbBuilder &operator=(const SceneFbBuilder &);
   flatbuffers::Offset<SceneFb> Finish() {
-    const auto end = fbb_.EndTable(start_, 7);
+    const auto end = fbb_.EndTable(start_, 11);
     auto o = flatbuffers::Offset<SceneFb>(end);
     return o;
   }
@@ -1223,8 +2382,16 @@ inline flatbuffers::Offset<SceneFb> CreateSceneFb(
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<MaterialFb>>> materials = 0,
     flatbuffers::Offset<flatbuffers::Vector<const TextureFb *>> textures = 0,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<FileFb>>> files = 0,
-    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<NameFb>>> names = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<NameFb>>> names = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<GeometryBufferFb>>> geometry_buffers = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<AnimStackFb>>> anim_stacks = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<AnimLayerFb>>> anim_layers = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SkinFb>>> skins = 0) {
   SceneFbBuilder builder_(_fbb);
+  builder_.add_skins(skins);
+  builder_.add_anim_layers(anim_layers);
+  builder_.add_anim_stacks(anim_stacks);
+  builder_.add_geometry_buffers(geometry_buffers);
   builder_.add_names(names);
   builder_.add_files(files);
   builder_.add_textures(textures);
@@ -1243,7 +2410,11 @@ inline flatbuffers::Offset<SceneFb> CreateSceneFbDirect(
     const std::vector<flatbuffers::Offset<MaterialFb>> *materials = nullptr,
     const std::vector<const TextureFb *> *textures = nullptr,
     const std::vector<flatbuffers::Offset<FileFb>> *files = nullptr,
-    const std::vector<flatbuffers::Offset<NameFb>> *names = nullptr) {
+    const std::vector<flatbuffers::Offset<NameFb>> *names = nullptr,
+    const std::vector<flatbuffers::Offset<GeometryBufferFb>> *geometry_buffers = nullptr,
+    const std::vector<flatbuffers::Offset<AnimStackFb>> *anim_stacks = nullptr,
+    const std::vector<flatbuffers::Offset<AnimLayerFb>> *anim_layers = nullptr,
+    const std::vector<flatbuffers::Offset<SkinFb>> *skins = nullptr) {
   return CreateSceneFb(
       _fbb,
       transforms ? _fbb.CreateVector<const TransformFb *>(*transforms) : 0,
@@ -1252,7 +2423,11 @@ inline flatbuffers::Offset<SceneFb> CreateSceneFbDirect(
       materials ? _fbb.CreateVector<flatbuffers::Offset<MaterialFb>>(*materials) : 0,
       textures ? _fbb.CreateVector<const TextureFb *>(*textures) : 0,
       files ? _fbb.CreateVector<flatbuffers::Offset<FileFb>>(*files) : 0,
-      names ? _fbb.CreateVector<flatbuffers::Offset<NameFb>>(*names) : 0);
+      names ? _fbb.CreateVector<flatbuffers::Offset<NameFb>>(*names) : 0,
+      geometry_buffers ? _fbb.CreateVector<flatbuffers::Offset<GeometryBufferFb>>(*geometry_buffers) : 0,
+      anim_stacks ? _fbb.CreateVector<flatbuffers::Offset<AnimStackFb>>(*anim_stacks) : 0,
+      anim_layers ? _fbb.CreateVector<flatbuffers::Offset<AnimLayerFb>>(*anim_layers) : 0,
+      skins ? _fbb.CreateVector<flatbuffers::Offset<SkinFb>>(*skins) : 0);
 }
 
 inline const apemodefb::SceneFb *GetSceneFb(const void *buf) {
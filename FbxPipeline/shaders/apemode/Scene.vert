@@ -1,14 +1,29 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout( std140, binding = 0 ) uniform FrameUniformBuffer {
-    mat4 worldMatrix;
+/* Written once per frame. */
+layout( std140, set = 0, binding = 0 ) uniform FrameUniformBuffer {
     mat4 viewMatrix;
     mat4 projectionMatrix;
+} frameInfo;
+
+/* All the world matrices of the scene (indexed with the node ids). */
+layout( std430, set = 1, binding = 0 ) readonly buffer WorldMatrixBuffer {
+    mat4 worldMatrices[];
+} worldInfo;
+
+/* The node ids of the instances in the draw order. */
+layout( std430, set = 2, binding = 0 ) readonly buffer InstanceBuffer {
+    uint nodeIds[];
+} instanceInfo;
+
+/* Pushed per draw. */
+layout( push_constant ) uniform DrawPushConstants {
     vec4 color;
     vec4 positionOffset;
     vec4 positionScale;
-} frameInfo;
+    uint instanceOffset;
+} drawInfo;
 
 layout( location = 0 ) in vec3 inPosition;
 layout( location = 1 ) in vec3 inNormal;
@@ -17,7 +32,9 @@ layout( location = 3 ) in vec2 inTexcoords;
 layout( location = 0 ) out vec4 outColor;
 
 void main( ) {
-    outColor    = frameInfo.color;
-    gl_Position = frameInfo.projectionMatrix * frameInfo.viewMatrix * frameInfo.worldMatrix *
-                  vec4( inPosition.zyx * frameInfo.positionScale.xyz + frameInfo.positionOffset.xyz, 1.0 );
-}
\ No newline at end of file
+    mat4 worldMatrix = worldInfo.worldMatrices[ instanceInfo.nodeIds[ drawInfo.instanceOffset + gl_InstanceIndex ] ];
+
+    outColor    = drawInfo.color;
+    gl_Position = frameInfo.projectionMatrix * frameInfo.viewMatrix * worldMatrix *
+                  vec4( inPosition.xyz * drawInfo.positionScale.xyz + drawInfo.positionOffset.xyz, 1.0 );
+}